@@ -0,0 +1,134 @@
+/** @file   ThreadScheduler.h
+    @author Philip Abbet
+
+    Declaration of the class 'ThreadScheduler', used by the benchmarks
+*/
+
+#ifndef _ATHENA_PHYSICS_BENCHMARKS_THREADSCHEDULER_H_
+#define _ATHENA_PHYSICS_BENCHMARKS_THREADSCHEDULER_H_
+
+#include <Athena-Physics/TaskScheduler.h>
+#include <vector>
+
+#ifdef _WIN32
+    #include <windows.h>
+#else
+    #include <pthread.h>
+    #include <unistd.h>
+#endif
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Minimal task scheduler, starting one thread per submitted task
+///
+/// Good enough to compare the parallel features of the worlds with the sequential ones
+/// (a real scheduler would reuse its threads: the measured speedups are lower bounds).
+//---------------------------------------------------------------------------------------
+class ThreadScheduler: public Athena::Physics::ITaskScheduler
+{
+    //_____ Construction / Destruction __________
+public:
+    ThreadScheduler()
+    : m_nbRunning(0)
+    {
+#ifdef _WIN32
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        m_nbThreads = (unsigned int) info.dwNumberOfProcessors;
+#else
+        long nbProcessors = sysconf(_SC_NPROCESSORS_ONLN);
+        m_nbThreads = (nbProcessors > 0 ? (unsigned int) nbProcessors : 1);
+#endif
+    }
+
+    virtual ~ThreadScheduler()
+    {
+        for (unsigned int i = 0; i < m_threads.size(); ++i)
+            wait(i);
+    }
+
+
+    //_____ Implementation of ITaskScheduler __________
+public:
+    virtual unsigned int getNbThreads() const
+    {
+        return m_nbThreads;
+    }
+
+    virtual tTaskHandle submit(ITask* pTask)
+    {
+        // Reuse the handles once all the tasks are completed
+        if (m_nbRunning == 0)
+            m_threads.clear();
+
+        tThread thread;
+        thread.bRunning = true;
+
+#ifdef _WIN32
+        thread.handle = CreateThread(0, 0, &ThreadScheduler::execute, pTask, 0, 0);
+#else
+        pthread_create(&thread.handle, 0, &ThreadScheduler::execute, pTask);
+#endif
+
+        m_threads.push_back(thread);
+        ++m_nbRunning;
+
+        return (tTaskHandle) m_threads.size() - 1;
+    }
+
+    virtual void wait(tTaskHandle handle)
+    {
+        tThread& thread = m_threads[handle];
+        if (!thread.bRunning)
+            return;
+
+#ifdef _WIN32
+        WaitForSingleObject(thread.handle, INFINITE);
+        CloseHandle(thread.handle);
+#else
+        pthread_join(thread.handle, 0);
+#endif
+
+        thread.bRunning = false;
+        --m_nbRunning;
+    }
+
+
+    //_____ Internal types __________
+private:
+    struct tThread
+    {
+#ifdef _WIN32
+        HANDLE      handle;
+#else
+        pthread_t   handle;
+#endif
+        bool        bRunning;
+    };
+
+
+    //_____ Internal methods __________
+private:
+#ifdef _WIN32
+    static DWORD WINAPI execute(LPVOID pTask)
+    {
+        static_cast<ITask*>(pTask)->execute();
+        return 0;
+    }
+#else
+    static void* execute(void* pTask)
+    {
+        static_cast<ITask*>(pTask)->execute();
+        return 0;
+    }
+#endif
+
+
+    //_____ Attributes __________
+private:
+    unsigned int            m_nbThreads;
+    std::vector<tThread>    m_threads;
+    unsigned int            m_nbRunning;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/** @file   bench_CollisionAlgorithms.cpp
+    @author Philip Abbet
+
+    A/B benchmark of the specialized collision algorithms of
+    'Athena::Physics::CollisionConfiguration' against the generic ones of Bullet
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/CollisionConfiguration.h>
+#include <iostream>
+
+using namespace Athena::Physics;
+using namespace std;
+
+
+// Number of contact computations per measurement
+static const unsigned int NB_ITERATIONS = 200000;
+
+// Number of positions cycled through by the first object
+static const unsigned int NB_POSITIONS = 64;
+
+
+// Measures the narrowphase of a pair of objects with the algorithms of a configuration
+struct CollisionAlgorithmsFixture
+{
+    CollisionAlgorithmsFixture()
+    {
+        genericConfiguration.enableFastAlgorithms(false);
+
+        pFastDispatcher = new btCollisionDispatcher(&fastConfiguration);
+        pGenericDispatcher = new btCollisionDispatcher(&genericConfiguration);
+    }
+
+    ~CollisionAlgorithmsFixture()
+    {
+        delete pFastDispatcher;
+        delete pGenericDispatcher;
+    }
+
+    // Returns the mean duration of a contact computation (in nanoseconds), and the
+    // number of computations which found contacts
+    double measure(btCollisionDispatcher* pDispatcher, const btTransform* transforms,
+                   unsigned int &nbContacts)
+    {
+        // Like in a world, the algorithm (and its manifold) persists between the steps
+        btCollisionAlgorithm* pAlgorithm = pDispatcher->findAlgorithm(&objectA, &objectB);
+
+        btDispatcherInfo dispatchInfo;
+        nbContacts = 0;
+
+        btClock clock;
+
+        for (unsigned int i = 0; i < NB_ITERATIONS; ++i)
+        {
+            objectA.setWorldTransform(transforms[i % NB_POSITIONS]);
+
+            btManifoldResult result(&objectA, &objectB);
+            pAlgorithm->processCollision(&objectA, &objectB, dispatchInfo, &result);
+
+            if (result.getPersistentManifold() && (result.getPersistentManifold()->getNumContacts() > 0))
+                ++nbContacts;
+        }
+
+        double duration = double(clock.getTimeMicroseconds()) * 1000.0 / NB_ITERATIONS;
+
+        pAlgorithm->~btCollisionAlgorithm();
+        pDispatcher->freeCollisionAlgorithm(pAlgorithm);
+
+        return duration;
+    }
+
+    // Measure both configurations, with the first object moving around a position
+    // (penetrating the second one, then resting on it, then separated from it)
+    void compare(const char* strName, btCollisionShape* pShapeA, const btTransform& transformA,
+                 btCollisionShape* pShapeB, const btTransform& transformB)
+    {
+        objectA.setCollisionShape(pShapeA);
+        objectB.setCollisionShape(pShapeB);
+        objectB.setWorldTransform(transformB);
+
+        btTransform transforms[NB_POSITIONS];
+        for (unsigned int i = 0; i < NB_POSITIONS; ++i)
+        {
+            btScalar angle = SIMD_2_PI * btScalar(i) / btScalar(NB_POSITIONS);
+
+            transforms[i] = transformA;
+            transforms[i].getOrigin() += btVector3(btScalar(0.1) * btCos(angle),
+                                                   btScalar(0.05) * btSin(angle * btScalar(3.0)),
+                                                   btScalar(0.1) * btSin(angle));
+            transforms[i].setRotation(btQuaternion(btVector3(0.0f, 1.0f, 0.0f), angle) *
+                                      transformA.getRotation());
+        }
+
+        // Warm-up (and identical workload for both configurations)
+        measure(pFastDispatcher, transforms, nbFastContacts);
+        measure(pGenericDispatcher, transforms, nbGenericContacts);
+
+        fastDuration = measure(pFastDispatcher, transforms, nbFastContacts);
+        genericDuration = measure(pGenericDispatcher, transforms, nbGenericContacts);
+
+        cout << strName << ": " << fastDuration << " ns (specialized), " << genericDuration
+             << " ns (Bullet), speedup: x" << (genericDuration / fastDuration) << endl;
+    }
+
+    CollisionConfiguration  fastConfiguration;
+    CollisionConfiguration  genericConfiguration;
+    btCollisionDispatcher*  pFastDispatcher;
+    btCollisionDispatcher*  pGenericDispatcher;
+    btCollisionObject       objectA;
+    btCollisionObject       objectB;
+    double                  fastDuration;
+    double                  genericDuration;
+    unsigned int            nbFastContacts;
+    unsigned int            nbGenericContacts;
+};
+
+
+SUITE(CollisionAlgorithmsBenchmark)
+{
+    TEST_FIXTURE(CollisionAlgorithmsFixture, SphereBox)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btBoxShape box(btVector3(1.0f, 1.0f, 1.0f));
+
+        compare("sphere - box", &sphere, btTransform(btQuaternion::getIdentity(), btVector3(0.8f, 1.48f, 0.3f)),
+                &box, btTransform::getIdentity());
+
+        // Both configurations must see the same contacts
+        CHECK(nbFastContacts > 0);
+        CHECK_CLOSE(double(nbGenericContacts), double(nbFastContacts), NB_ITERATIONS * 0.01);
+    }
+
+
+    TEST_FIXTURE(CollisionAlgorithmsFixture, SphereCapsule)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btCapsuleShape capsule(btScalar(0.5), btScalar(2.0));
+
+        compare("sphere - capsule", &sphere, btTransform(btQuaternion::getIdentity(), btVector3(0.98f, 0.3f, 0.0f)),
+                &capsule, btTransform::getIdentity());
+
+        CHECK(nbFastContacts > 0);
+        CHECK_CLOSE(double(nbGenericContacts), double(nbFastContacts), NB_ITERATIONS * 0.01);
+    }
+
+
+    TEST_FIXTURE(CollisionAlgorithmsFixture, CapsuleCapsule)
+    {
+        btCapsuleShape capsuleA(btScalar(0.5), btScalar(2.0));
+        btCapsuleShape capsuleB(btScalar(0.5), btScalar(2.0));
+
+        compare("capsule - capsule", &capsuleA,
+                btTransform(btQuaternion(btVector3(0.0f, 0.0f, 1.0f), SIMD_HALF_PI), btVector3(0.0f, 0.98f, 0.0f)),
+                &capsuleB, btTransform::getIdentity());
+
+        CHECK(nbFastContacts > 0);
+        CHECK_CLOSE(double(nbGenericContacts), double(nbFastContacts), NB_ITERATIONS * 0.01);
+    }
+}
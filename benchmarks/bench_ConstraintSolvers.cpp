@@ -0,0 +1,404 @@
+/** @file   bench_ConstraintSolvers.cpp
+    @author Philip Abbet
+
+    Benchmark of the constraint solvers of 'Athena::Physics::World' (cost of a step and
+    remaining error, on stacking, ragdoll and vehicle scenes)
+*/
+
+#include <UnitTest++.h>
+#include "../unittests/PhysicsEnvironment.h"
+#include "ThreadScheduler.h"
+#include <iostream>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+// Number of simulated steps per measurement
+static const unsigned int NB_STEPS = 300;
+
+// Duration of a step
+static const Real TIME_STEP = Real(1.0 / 60.0);
+
+
+//---------------------------------------------------------------------------------------
+// Base class of the scenes
+//---------------------------------------------------------------------------------------
+class BenchmarkScene
+{
+public:
+    virtual ~BenchmarkScene()
+    {
+    }
+
+    // Fill the world
+    virtual void build(PhysicsEnvironment& environment) = 0;
+
+    // Called after each step
+    virtual void measure() = 0;
+
+    // Returns the error accumulated by the solver (in meters)
+    virtual double getError() const = 0;
+
+    // Returns the name of the scene
+    virtual const char* getName() const = 0;
+};
+
+
+//---------------------------------------------------------------------------------------
+// Base class of the scenes made of jointed bodies: the error is the mean distance
+// between the pivots of the joints, over all the steps
+//---------------------------------------------------------------------------------------
+class JointsScene: public BenchmarkScene
+{
+public:
+    JointsScene()
+    : m_totalError(0.0), m_nbMeasures(0)
+    {
+    }
+
+    virtual void measure()
+    {
+        for (unsigned int i = 0; i < m_joints.size(); ++i)
+        {
+            const tJoint& joint = m_joints[i];
+
+            btVector3 pivotA = joint.pBodyA->getWorldTransform() * joint.pivotA;
+            btVector3 pivotB = joint.pBodyB->getWorldTransform() * joint.pivotB;
+
+            m_totalError += (pivotA - pivotB).length();
+        }
+
+        m_nbMeasures += (unsigned int) m_joints.size();
+    }
+
+    virtual double getError() const
+    {
+        return (m_nbMeasures > 0 ? m_totalError / m_nbMeasures : 0.0);
+    }
+
+protected:
+    // Add a joint between two bodies (in their initial orientation), its main axis
+    // (twist axis of the cone-twist joints, rotation axis of the hinges) given by the
+    // rotation of the X axis (cone-twist) or Z axis (hinge)
+    btTypedConstraint* addJoint(PhysicsEnvironment& environment, Body* pBodyA, Body* pBodyB,
+                                const btVector3& pivot, const btQuaternion& rotation,
+                                bool bHinge)
+    {
+        btRigidBody* pRigidBodyA = pBodyA->getRigidBody();
+        btRigidBody* pRigidBodyB = pBodyB->getRigidBody();
+
+        btTransform frameA(rotation, pivot - pRigidBodyA->getWorldTransform().getOrigin());
+        btTransform frameB(rotation, pivot - pRigidBodyB->getWorldTransform().getOrigin());
+
+        btTypedConstraint* pConstraint;
+        if (bHinge)
+            pConstraint = new btHingeConstraint(*pRigidBodyA, *pRigidBodyB, frameA, frameB);
+        else
+            pConstraint = new btConeTwistConstraint(*pRigidBodyA, *pRigidBodyB, frameA, frameB);
+
+        environment.addConstraint(pConstraint);
+
+        tJoint joint;
+        joint.pBodyA = pRigidBodyA;
+        joint.pBodyB = pRigidBodyB;
+        joint.pivotA = frameA.getOrigin();
+        joint.pivotB = frameB.getOrigin();
+
+        m_joints.push_back(joint);
+
+        return pConstraint;
+    }
+
+private:
+    struct tJoint
+    {
+        btRigidBody*    pBodyA;
+        btRigidBody*    pBodyB;
+        btVector3       pivotA;     // In the space of the first body
+        btVector3       pivotB;     // In the space of the second body
+    };
+
+    std::vector<tJoint> m_joints;
+    double              m_totalError;
+    unsigned int        m_nbMeasures;
+};
+
+
+//---------------------------------------------------------------------------------------
+// Towers of boxes: the error is the mean distance travelled by the boxes
+//---------------------------------------------------------------------------------------
+class StackingScene: public BenchmarkScene
+{
+public:
+    virtual void build(PhysicsEnvironment& environment)
+    {
+        const unsigned int NB_TOWERS = 8;
+        const unsigned int NB_BOXES = 15;
+
+        environment.createGround();
+
+        for (unsigned int i = 0; i < NB_TOWERS; ++i)
+        {
+            for (unsigned int j = 0; j < NB_BOXES; ++j)
+            {
+                Vector3 position(Real(i % 4) * 4.0f, 0.5f + Real(j), Real(i / 4) * 4.0f);
+
+                Body* pBody = environment.createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, position);
+                pBody->enableDeactivation(false);
+
+                m_boxes.push_back(pBody->getRigidBody());
+                m_initialPositions.push_back(pBody->getRigidBody()->getWorldTransform().getOrigin());
+            }
+        }
+    }
+
+    virtual void measure()
+    {
+    }
+
+    virtual double getError() const
+    {
+        double error = 0.0;
+        for (unsigned int i = 0; i < m_boxes.size(); ++i)
+            error += (m_boxes[i]->getWorldTransform().getOrigin() - m_initialPositions[i]).length();
+
+        return error / m_boxes.size();
+    }
+
+    virtual const char* getName() const
+    {
+        return "stacking";
+    }
+
+private:
+    std::vector<btRigidBody*>   m_boxes;
+    std::vector<btVector3>      m_initialPositions;
+};
+
+
+//---------------------------------------------------------------------------------------
+// Ragdolls falling on the ground
+//---------------------------------------------------------------------------------------
+class RagdollsScene: public JointsScene
+{
+public:
+    virtual void build(PhysicsEnvironment& environment)
+    {
+        const unsigned int NB_RAGDOLLS = 16;
+
+        environment.createGround();
+
+        for (unsigned int i = 0; i < NB_RAGDOLLS; ++i)
+            createRagdoll(environment, Vector3(Real(i % 4) * 3.0f, 1.0f, Real(i / 4) * 3.0f));
+    }
+
+    virtual const char* getName() const
+    {
+        return "ragdolls";
+    }
+
+private:
+    void createRagdoll(PhysicsEnvironment& environment, const Vector3& origin)
+    {
+        const btVector3 base(origin.x, origin.y, origin.z);
+
+        const btQuaternion alongX = btQuaternion::getIdentity();
+        const btQuaternion alongY(btVector3(0.0f, 0.0f, 1.0f), SIMD_HALF_PI);
+        const btQuaternion aroundX(btVector3(0.0f, 1.0f, 0.0f), SIMD_HALF_PI);
+        const btQuaternion aroundY(btVector3(1.0f, 0.0f, 0.0f), -SIMD_HALF_PI);
+
+        Body* pPelvis = createPart(environment, origin, 0.15f, 0.2f, PrimitiveShape::AXIS_Y, Vector3(0.0f, 1.0f, 0.0f));
+        Body* pSpine  = createPart(environment, origin, 0.15f, 0.28f, PrimitiveShape::AXIS_Y, Vector3(0.0f, 1.4f, 0.0f));
+        Body* pHead   = createPart(environment, origin, 0.1f, 0.05f, PrimitiveShape::AXIS_Y, Vector3(0.0f, 1.75f, 0.0f));
+
+        setLimits(addJoint(environment, pPelvis, pSpine, base + btVector3(0.0f, 1.15f, 0.0f), alongY, false),
+                  SIMD_PI * 0.25f, SIMD_PI * 0.25f, SIMD_PI * 0.25f);
+        setLimits(addJoint(environment, pSpine, pHead, base + btVector3(0.0f, 1.6f, 0.0f), alongY, false),
+                  SIMD_PI * 0.25f, SIMD_PI * 0.25f, SIMD_HALF_PI);
+
+        for (int side = -1; side <= 1; side += 2)
+        {
+            Real x = Real(side);
+
+            Body* pUpperLeg = createPart(environment, origin, 0.07f, 0.45f, PrimitiveShape::AXIS_Y, Vector3(x * 0.18f, 0.65f, 0.0f));
+            Body* pLowerLeg = createPart(environment, origin, 0.05f, 0.37f, PrimitiveShape::AXIS_Y, Vector3(x * 0.18f, 0.2f, 0.0f));
+            Body* pUpperArm = createPart(environment, origin, 0.05f, 0.33f, PrimitiveShape::AXIS_X, Vector3(x * 0.35f, 1.45f, 0.0f));
+            Body* pLowerArm = createPart(environment, origin, 0.04f, 0.25f, PrimitiveShape::AXIS_X, Vector3(x * 0.7f, 1.45f, 0.0f));
+
+            setLimits(addJoint(environment, pPelvis, pUpperLeg, base + btVector3(x * 0.18f, 0.9f, 0.0f), alongY, false),
+                      SIMD_PI * 0.25f, SIMD_PI * 0.25f, 0.0f);
+            setLimits(addJoint(environment, pUpperLeg, pLowerLeg, base + btVector3(x * 0.18f, 0.425f, 0.0f), aroundX, true),
+                      -SIMD_HALF_PI, 0.0f);
+            setLimits(addJoint(environment, pSpine, pUpperArm, base + btVector3(x * 0.2f, 1.45f, 0.0f), alongX, false),
+                      SIMD_HALF_PI, SIMD_HALF_PI, 0.0f);
+            setLimits(addJoint(environment, pUpperArm, pLowerArm, base + btVector3(x * 0.55f, 1.45f, 0.0f), aroundY, true),
+                      -SIMD_HALF_PI, SIMD_HALF_PI);
+        }
+    }
+
+    Body* createPart(PhysicsEnvironment& environment, const Vector3& origin, Real radius, Real height,
+                     PrimitiveShape::tAxis axis, const Vector3& position)
+    {
+        Body* pBody = environment.createCapsule(radius, height, axis, 5.0f, origin + position);
+        pBody->enableDeactivation(false);
+        return pBody;
+    }
+
+    void setLimits(btTypedConstraint* pConstraint, btScalar swing1, btScalar swing2, btScalar twist)
+    {
+        static_cast<btConeTwistConstraint*>(pConstraint)->setLimit(swing1, swing2, twist);
+    }
+
+    void setLimits(btTypedConstraint* pConstraint, btScalar low, btScalar high)
+    {
+        static_cast<btHingeConstraint*>(pConstraint)->setLimit(low, high);
+    }
+};
+
+
+//---------------------------------------------------------------------------------------
+// Vehicles (heavy chassis, light wheels driven by motors) driving over bumps
+//---------------------------------------------------------------------------------------
+class VehiclesScene: public JointsScene
+{
+public:
+    virtual void build(PhysicsEnvironment& environment)
+    {
+        const unsigned int NB_VEHICLES = 8;
+
+        environment.createGround();
+
+        for (int i = -3; i <= 3; ++i)
+        {
+            if (i == 0)
+                continue;
+
+            environment.createBox(Vector3(100.0f, 0.2f, 0.6f), 0.0f, Vector3(0.0f, 0.1f, Real(i) * 8.0f));
+        }
+
+        for (unsigned int i = 0; i < NB_VEHICLES; ++i)
+            createVehicle(environment, Vector3((Real(i) - Real(NB_VEHICLES / 2)) * 5.0f, 0.0f, 0.0f));
+    }
+
+    virtual const char* getName() const
+    {
+        return "vehicles";
+    }
+
+private:
+    void createVehicle(PhysicsEnvironment& environment, const Vector3& origin)
+    {
+        const btVector3 base(origin.x, origin.y, origin.z);
+
+        // Rotation axis of the wheels: X
+        const btQuaternion aroundX(btVector3(0.0f, 1.0f, 0.0f), SIMD_HALF_PI);
+
+        Body* pChassis = environment.createBox(Vector3(2.0f, 0.5f, 4.0f), 800.0f, origin + Vector3(0.0f, 0.9f, 0.0f));
+        pChassis->enableDeactivation(false);
+
+        for (int i = 0; i < 4; ++i)
+        {
+            Vector3 position((i & 1 ? 1.2f : -1.2f), 0.4f, (i & 2 ? 1.4f : -1.4f));
+
+            Body* pWheel = environment.createCylinder(0.4f, 0.3f, PrimitiveShape::AXIS_X, 20.0f, origin + position);
+            pWheel->enableDeactivation(false);
+
+            btHingeConstraint* pHinge = static_cast<btHingeConstraint*>(
+                    addJoint(environment, pChassis, pWheel, base + btVector3(position.x, position.y, position.z),
+                             aroundX, true));
+
+            pHinge->enableAngularMotor(true, btScalar(10.0), btScalar(50.0));
+        }
+    }
+};
+
+
+//---------------------------------------------------------------------------------------
+// Runs the scenes with each solver and preset
+//---------------------------------------------------------------------------------------
+struct ConstraintSolversFixture
+{
+    void compare(BenchmarkScene* pScene, World::tSolverType type, World::tSolverPreset preset)
+    {
+        static const char* SOLVER_NAMES[] = { "sequential impulse", "parallel islands" };
+        static const char* PRESET_NAMES[] = { "fast", "balanced", "accurate" };
+
+        PhysicsEnvironment environment;
+
+        environment.pWorld->setTaskScheduler(&scheduler);
+        environment.pWorld->setSolverType(type);
+        environment.pWorld->setSolverPreset(preset);
+
+        pScene->build(environment);
+
+        unsigned long duration = 0;
+
+        for (unsigned int i = 0; i < NB_STEPS; ++i)
+        {
+            btClock clock;
+            environment.pWorld->stepSimulation(TIME_STEP, 1, TIME_STEP);
+            duration += clock.getTimeMicroseconds();
+
+            pScene->measure();
+        }
+
+        error = pScene->getError();
+
+        cout << pScene->getName() << " (" << SOLVER_NAMES[type] << ", " << PRESET_NAMES[preset]
+             << "): " << (double(duration) / NB_STEPS / 1000.0) << " ms per step, error: "
+             << (error * 1000.0) << " mm" << endl;
+    }
+
+    template<class T>
+    void compareAll()
+    {
+        if (!World::isParallelSolvingSupported())
+        {
+            cout << "Bullet compiled without BT_NO_PROFILE: the islands are never solved in "
+                    "parallel" << endl;
+        }
+
+        for (int type = World::SOLVER_SEQUENTIAL_IMPULSE; type <= World::SOLVER_PARALLEL_ISLANDS; ++type)
+        {
+            for (int preset = World::SOLVER_FAST; preset <= World::SOLVER_ACCURATE; ++preset)
+            {
+                T scene;
+                compare(&scene, (World::tSolverType) type, (World::tSolverPreset) preset);
+            }
+        }
+    }
+
+    ThreadScheduler scheduler;
+    double          error;
+};
+
+
+SUITE(ConstraintSolversBenchmark)
+{
+    TEST_FIXTURE(ConstraintSolversFixture, Stacking)
+    {
+        compareAll<StackingScene>();
+
+        // The towers must still stand with the accurate settings
+        CHECK(error < 0.1);
+    }
+
+
+    TEST_FIXTURE(ConstraintSolversFixture, Ragdolls)
+    {
+        compareAll<RagdollsScene>();
+
+        CHECK(error < 0.05);
+    }
+
+
+    TEST_FIXTURE(ConstraintSolversFixture, Vehicles)
+    {
+        compareAll<VehiclesScene>();
+
+        CHECK(error < 0.05);
+    }
+}
@@ -0,0 +1,150 @@
+/** @file   bench_DebrisSystem.cpp
+    @author Philip Abbet
+
+    Benchmark of the class 'Athena::Physics::DebrisSystem' (cost of an update of 10000
+    fragments falling on static objects)
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/DebrisSystem.h>
+#include "../unittests/PhysicsEnvironment.h"
+#include "ThreadScheduler.h"
+#include <iostream>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+// Number of fragments
+static const unsigned int NB_FRAGMENTS = 10000;
+
+// Number of updates during which all the fragments are falling
+static const unsigned int NB_FALLING_STEPS = 30;
+
+// Total number of updates (the fragments are resting on the ground at the end)
+static const unsigned int NB_STEPS = 300;
+
+// Duration of an update
+static const Real TIME_STEP = Real(1.0 / 60.0);
+
+// Radius of the fragments
+static const Real RADIUS = Real(0.05);
+
+
+// Drops fragments on a ground covered by some static boxes
+struct DebrisSystemFixture: public PhysicsEnvironment
+{
+    DebrisSystemFixture()
+    {
+        createGround();
+
+        for (unsigned int i = 0; i < 16; ++i)
+        {
+            createBox(Vector3(1.0f, 0.5f, 1.0f), 0.0f,
+                      Vector3(Real(i % 4) * 6.0f - 9.0f, 0.5f, Real(i / 4) * 6.0f - 9.0f));
+        }
+
+        pDebris = new DebrisSystem(pWorld, NB_FRAGMENTS);
+    }
+
+    ~DebrisSystemFixture()
+    {
+        delete pDebris;
+    }
+
+    void spawn()
+    {
+        pDebris->clear();
+
+        DebrisSystem::tFragment fragment;
+        fragment.size               = Vector3(RADIUS, RADIUS, RADIUS);
+        fragment.orientation        = Quaternion::IDENTITY;
+        fragment.angularVelocity    = Vector3(3.0f, 1.0f, -2.0f);
+        fragment.lifetime           = 0.0f;
+
+        // A grid of 100x100 fragments, at various heights (the lowest ones reach the
+        // boxes after about 0.5 second)
+        for (unsigned int i = 0; i < NB_FRAGMENTS; ++i)
+        {
+            Real x = Real(i % 100) * 0.2f - 10.0f;
+            Real z = Real(i / 100) * 0.2f - 10.0f;
+
+            fragment.shape          = (i % 3 == 0 ? DebrisSystem::SHAPE_BOX : DebrisSystem::SHAPE_SPHERE);
+            fragment.position       = Vector3(x, 2.5f + Real(i % 7) * 0.5f, z);
+            fragment.linearVelocity = Vector3(-x * 0.1f, 0.0f, -z * 0.1f);
+
+            pDebris->spawn(fragment);
+        }
+    }
+
+    // Measure the mean cost of the updates while all the fragments are falling, and the
+    // mean cost over all the updates (in seconds)
+    void measure(const char* strName)
+    {
+        spawn();
+
+        fallingCost = 0.0;
+        totalCost = 0.0;
+
+        for (unsigned int i = 0; i < NB_STEPS; ++i)
+        {
+            pDebris->update(TIME_STEP);
+
+            if (i < NB_FALLING_STEPS)
+                fallingCost += pDebris->getLastUpdateCost();
+
+            totalCost += pDebris->getLastUpdateCost();
+        }
+
+        fallingCost /= NB_FALLING_STEPS;
+        totalCost /= NB_STEPS;
+
+        cout << "debris (" << strName << "): " << fallingCost * 1000.0 << " ms per update (all falling), "
+             << totalCost * 1000.0 << " ms per update (mean), " << pDebris->getNbAwakeFragments()
+             << " fragments awake at the end" << endl;
+    }
+
+    // Returns the lowest fragment (relative to the ground)
+    Real getLowestPosition() const
+    {
+        Real lowest = 1000.0f;
+        for (unsigned int i = 0; i < pDebris->getNbFragments(); ++i)
+            lowest = std::min(lowest, pDebris->getPosition(i).y);
+
+        return lowest;
+    }
+
+    DebrisSystem*   pDebris;
+    double          fallingCost;
+    double          totalCost;
+};
+
+
+SUITE(DebrisSystemBenchmark)
+{
+    TEST_FIXTURE(DebrisSystemFixture, Sequential)
+    {
+        measure("sequential");
+
+        CHECK_EQUAL(NB_FRAGMENTS, pDebris->getNbFragments());
+        CHECK(pDebris->getNbAwakeFragments() < NB_FRAGMENTS / 2);
+        CHECK(getLowestPosition() > RADIUS * 0.5f);
+        CHECK(fallingCost < 1e-3);
+    }
+
+
+    TEST_FIXTURE(DebrisSystemFixture, Parallel)
+    {
+        ThreadScheduler scheduler;
+        pWorld->setTaskScheduler(&scheduler);
+
+        measure("parallel");
+
+        pWorld->setTaskScheduler(0);
+
+        CHECK(getLowestPosition() > RADIUS * 0.5f);
+        CHECK(fallingCost < 1e-3);
+    }
+}
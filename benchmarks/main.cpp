@@ -0,0 +1,13 @@
+/** @file   main.cpp
+    @author Philip Abbet
+
+    Entry point of the benchmarks of Athena-Physics
+*/
+
+#include <UnitTest++.h>
+
+
+int main(int argc, char** argv)
+{
+    return UnitTest::RunAllTests();
+}
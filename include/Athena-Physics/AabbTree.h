@@ -0,0 +1,212 @@
+/** @file   AabbTree.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::AabbTree'
+*/
+
+#ifndef _ATHENA_PHYSICS_AABBTREE_H_
+#define _ATHENA_PHYSICS_AABBTREE_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <LinearMath/btAlignedObjectArray.h>
+#include <LinearMath/btAabbUtil2.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Flat bounding volume hierarchy over a fixed set of axis-aligned bounding boxes
+///
+/// The tree is built once from a list of boxes (each identified by its index in that
+/// list) and stored as an array of nodes in depth-first order. Each node knows the index
+/// of the node following its subtree, so the queries don't need any stack and can be
+/// performed concurrently by several threads once the tree is built.
+///
+/// It is meant for sets of boxes that don't move (or rarely), for which rebuilding the
+/// whole tree is cheaper than maintaining a dynamic one.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL AabbTree
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    //-----------------------------------------------------------------------------------
+    AabbTree();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~AabbTree();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Build the tree
+    ///
+    /// @param  pMins       Minimum corners of the boxes
+    /// @param  pMaxs       Maximum corners of the boxes
+    /// @param  nbBoxes     Number of boxes
+    ///
+    /// @remark The boxes are identified by their index in the arrays in the results of
+    ///         the queries
+    //-----------------------------------------------------------------------------------
+    void build(const btVector3* pMins, const btVector3* pMaxs, unsigned int nbBoxes);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove all the boxes from the tree
+    //-----------------------------------------------------------------------------------
+    void clear();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the tree is empty
+    //-----------------------------------------------------------------------------------
+    inline bool isEmpty() const
+    {
+        return (m_nodes.size() == 0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of boxes in the tree
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbBoxes() const
+    {
+        return m_nbBoxes;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve all the boxes overlapping with the given one
+    ///
+    /// @param  aabbMin     Minimum corner of the box
+    /// @param  aabbMax     Maximum corner of the box
+    /// @retval results     Indices of the overlapping boxes (appended to the list)
+    /// @return             The number of boxes found
+    //-----------------------------------------------------------------------------------
+    unsigned int query(const btVector3& aabbMin, const btVector3& aabbMax,
+                       std::vector<unsigned int> &results) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve all the boxes intersected by a segment
+    ///
+    /// @param  from        Start point of the segment
+    /// @param  to          End point of the segment
+    /// @retval results     Indices of the intersected boxes (appended to the list)
+    /// @return             The number of boxes found
+    //-----------------------------------------------------------------------------------
+    unsigned int queryRay(const btVector3& from, const btVector3& to,
+                          std::vector<unsigned int> &results) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Call a visitor for each box overlapping with the given one
+    ///
+    /// Unlike query(), no memory is allocated. The visitor is called with the index of
+    /// each box found (as in 'bool visitor(unsigned int box)'), and returns false to stop
+    /// the traversal.
+    ///
+    /// @param  aabbMin     Minimum corner of the box
+    /// @param  aabbMax     Maximum corner of the box
+    /// @param  visitor     The visitor
+    //-----------------------------------------------------------------------------------
+    template <typename T>
+    void visit(const btVector3& aabbMin, const btVector3& aabbMax, T& visitor) const
+    {
+        int nbNodes = m_nodes.size();
+        int index = 0;
+
+        while (index < nbNodes)
+        {
+            const tNode& node = m_nodes[index];
+
+            if (TestAabbAgainstAabb2(aabbMin, aabbMax, node.aabbMin, node.aabbMax))
+            {
+                if ((node.box >= 0) && !visitor((unsigned int) node.box))
+                    return;
+
+                ++index;
+            }
+            else
+            {
+                index = node.escape;
+            }
+        }
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Call a visitor for each box intersected by a segment
+    ///
+    /// @param  from        Start point of the segment
+    /// @param  to          End point of the segment
+    /// @param  visitor     The visitor
+    ///
+    /// @see    visit()
+    //-----------------------------------------------------------------------------------
+    template <typename T>
+    void visitRay(const btVector3& from, const btVector3& to, T& visitor) const
+    {
+        int nbNodes = m_nodes.size();
+        int index = 0;
+
+        // Precompute what the slab tests need
+        btVector3 direction = to - from;
+        btVector3 invDirection(direction.getX() == btScalar(0.0) ? BT_LARGE_FLOAT : btScalar(1.0) / direction.getX(),
+                               direction.getY() == btScalar(0.0) ? BT_LARGE_FLOAT : btScalar(1.0) / direction.getY(),
+                               direction.getZ() == btScalar(0.0) ? BT_LARGE_FLOAT : btScalar(1.0) / direction.getZ());
+        unsigned int signs[3] = { invDirection.getX() < btScalar(0.0),
+                                  invDirection.getY() < btScalar(0.0),
+                                  invDirection.getZ() < btScalar(0.0) };
+
+        btVector3 bounds[2];
+        btScalar param;
+
+        while (index < nbNodes)
+        {
+            const tNode& node = m_nodes[index];
+
+            bounds[0] = node.aabbMin;
+            bounds[1] = node.aabbMax;
+
+            if (btRayAabb2(from, invDirection, signs, bounds, param, btScalar(0.0), btScalar(1.0)))
+            {
+                if ((node.box >= 0) && !visitor((unsigned int) node.box))
+                    return;
+
+                ++index;
+            }
+            else
+            {
+                index = node.escape;
+            }
+        }
+    }
+
+
+    //_____ Internal types __________
+private:
+    struct tNode
+    {
+        btVector3   aabbMin;
+        btVector3   aabbMax;
+        int         box;        ///< Index of the box (leaves only), -1 otherwise
+        int         escape;     ///< Index of the node following the subtree
+    };
+
+
+    //_____ Internal methods __________
+private:
+    void buildSubtree(unsigned int* pIndices, unsigned int nbIndices,
+                      const btVector3* pMins, const btVector3* pMaxs);
+
+
+    //_____ Attributes __________
+private:
+    btAlignedObjectArray<tNode> m_nodes;    ///< The nodes, in depth-first order
+    unsigned int                m_nbBoxes;  ///< Number of boxes in the tree
+};
+
+}
+}
+
+#endif
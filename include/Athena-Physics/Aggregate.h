@@ -0,0 +1,185 @@
+/** @file   Aggregate.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::Aggregate'
+*/
+
+#ifndef _ATHENA_PHYSICS_AGGREGATE_H_
+#define _ATHENA_PHYSICS_AGGREGATE_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Group of bodies appearing as one object in the broadphase
+///
+/// Ragdolls, vehicles or piles of attached debris put a lot of bodies close to each
+/// other in the broadphase. An aggregate replaces them by one proxy, whose bounding box
+/// encloses all its members. The pairs between the members and the other objects are
+/// only created (by the aggregate itself, during the collision detection) when an object
+/// overlaps with the bounding box of the aggregate.
+///
+/// The members don't collide with each other (their joints usually take care of that).
+/// They are still paired with the ghost objects in the broadphase, so the ghost objects
+/// work as usual. Their filter mask only accepts the ghost objects: the other pairs
+/// involving a member are rejected by the broadphase, before any filter callback.
+///
+/// @remark The simulation islands are merged using the pairs of the members: like any
+///         body, a member is simulated (and sleeps) together with the objects it touches
+/// @remark The aggregate must be destroyed before the world
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL Aggregate
+{
+    friend class World;
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world
+    //-----------------------------------------------------------------------------------
+    Aggregate(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    ///
+    /// The members are put back in the broadphase
+    //-----------------------------------------------------------------------------------
+    ~Aggregate();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add a body to the aggregate
+    ///
+    /// @remark A body can only belong to one aggregate
+    //-----------------------------------------------------------------------------------
+    void addBody(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove a body from the aggregate
+    //-----------------------------------------------------------------------------------
+    void removeBody(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of bodies in the aggregate
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbBodies() const
+    {
+        return (unsigned int) m_bodies.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns a body of the aggregate
+    //-----------------------------------------------------------------------------------
+    inline Body* getBody(unsigned int index) const
+    {
+        assert(index < m_bodies.size());
+        return m_bodies[index];
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of pairs between the members and the other objects
+    ///         created during the last collision detection
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbPairs() const
+    {
+        return (unsigned int) m_pPairCache->getNumOverlappingPairs();
+    }
+
+
+    //_____ Collision detection __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world before the narrowphase
+    //-----------------------------------------------------------------------------------
+    void beginDispatch();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world after the narrowphase, to destroy the pairs of the
+    ///         members which don't overlap with their object anymore
+    //-----------------------------------------------------------------------------------
+    void endDispatch(btDispatcher* pDispatcher);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destroy the pairs of the members involving a broadphase proxy (called by
+    ///         the world before the proxy is destroyed)
+    //-----------------------------------------------------------------------------------
+    void removeProxy(btBroadphaseProxy* pProxy, btDispatcher* pDispatcher);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destroy all the pairs of the members
+    //-----------------------------------------------------------------------------------
+    void clearPairs(btDispatcher* pDispatcher);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Merge the simulation islands of the members with the ones of the objects
+    ///         they are paired with (called by the island manager of the world)
+    //-----------------------------------------------------------------------------------
+    void findUnions(btUnionFind& unionFind) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the aggregate using a broadphase proxy (0 if it isn't the proxy of
+    ///         an aggregate)
+    //-----------------------------------------------------------------------------------
+    static Aggregate* fromProxy(const btBroadphaseProxy* pProxy);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the aggregate of the body owning a broadphase proxy (0 if it isn't
+    ///         the proxy of a member of an aggregate)
+    //-----------------------------------------------------------------------------------
+    static Aggregate* fromMemberProxy(const btBroadphaseProxy* pProxy);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Process a pair of the broadphase involving at least one aggregate, by
+    ///         processing the pairs of their members overlapping with each other
+    ///
+    /// Called by the near callback of the dispatcher (see
+    /// CollisionManager::customNearCallback())
+    //-----------------------------------------------------------------------------------
+    static void expandPair(btBroadphasePair& collisionPair, btCollisionDispatcher& dispatcher,
+                           const btDispatcherInfo& dispatchInfo);
+
+
+    //_____ Internal types __________
+private:
+    typedef std::pair<int, int> tPairKey;
+
+
+    //_____ Internal methods __________
+private:
+    void collectProxies(const btBroadphaseProxy* pOther,
+                        std::vector<btBroadphaseProxy*> &proxies) const;
+    void processPair(btBroadphaseProxy* pProxy1, btBroadphaseProxy* pProxy2,
+                     btCollisionDispatcher& dispatcher, const btDispatcherInfo& dispatchInfo);
+
+
+    //_____ Constants __________
+public:
+    static const short MEMBER_FILTER    = 0x2000;   ///< Broadphase filter group of the members
+    static const short PROXY_FILTER     = 0x4000;   ///< Broadphase filter group of the aggregates
+
+
+    //_____ Attributes __________
+private:
+    World*                          m_pWorld;       ///< The world
+    std::vector<Body*>              m_bodies;       ///< The members
+    btCollisionShape*               m_pShape;       ///< Shape enclosing the members
+    btCollisionObject*              m_pProxy;       ///< Object representing the aggregate in the broadphase
+    btOverlappingPairCache*         m_pPairCache;   ///< Pairs between the members and the other objects
+    std::vector<tPairKey>           m_foundPairs;   ///< Pairs found during the current collision detection
+    std::vector<btBroadphaseProxy*> m_proxies1;     ///< Scratch list used during the collision detection
+    std::vector<btBroadphaseProxy*> m_proxies2;     ///< Scratch list used during the collision detection
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,178 @@
+/** @file   BitStream.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::BitStream'
+*/
+
+#ifndef _ATHENA_PHYSICS_BITSTREAM_H_
+#define _ATHENA_PHYSICS_BITSTREAM_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Buffer of bits, written and read sequentially
+///
+/// The values are packed without any padding, least significant bits first. The bits
+/// are written at the end of the buffer, and read from a cursor starting at its
+/// beginning.
+///
+/// Used to encode the state of the bodies for the network replication.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL BitStream
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    //-----------------------------------------------------------------------------------
+    BitStream();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor, to read data received from the network
+    ///
+    /// @param  pData   The data (copied)
+    /// @param  size    Size of the data, in bytes
+    //-----------------------------------------------------------------------------------
+    BitStream(const unsigned char* pData, unsigned int size);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~BitStream();
+
+
+    //_____ Writing __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Write the least significant bits of a value
+    ///
+    /// @param  value   The value
+    /// @param  nbBits  The number of bits to write (from 1 to 32)
+    //-----------------------------------------------------------------------------------
+    void write(unsigned int value, unsigned int nbBits);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Write a boolean, on one bit
+    //-----------------------------------------------------------------------------------
+    inline void writeBool(bool bValue)
+    {
+        write(bValue ? 1 : 0, 1);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Write an unsigned value with a variable number of bits (small values
+    ///         take less space)
+    //-----------------------------------------------------------------------------------
+    void writeVariable(unsigned int value);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Write a signed value with a variable number of bits (values close to 0
+    ///         take less space)
+    //-----------------------------------------------------------------------------------
+    inline void writeVariableSigned(int value)
+    {
+        // Zig-zag encoding: 0, -1, 1, -2, 2...
+        writeVariable(((unsigned int) value << 1) ^ (unsigned int) (value >> 31));
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove all the bits from the stream
+    //-----------------------------------------------------------------------------------
+    void clear();
+
+
+    //_____ Reading __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Read a value
+    ///
+    /// @param  nbBits  The number of bits to read (from 1 to 32)
+    /// @return         The value (0 if the end of the stream was reached)
+    //-----------------------------------------------------------------------------------
+    unsigned int read(unsigned int nbBits);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Read a boolean, on one bit
+    //-----------------------------------------------------------------------------------
+    inline bool readBool()
+    {
+        return (read(1) != 0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Read an unsigned value written by writeVariable()
+    //-----------------------------------------------------------------------------------
+    unsigned int readVariable();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Read a signed value written by writeVariableSigned()
+    //-----------------------------------------------------------------------------------
+    inline int readVariableSigned()
+    {
+        unsigned int value = readVariable();
+        return (int) (value >> 1) ^ -((int) (value & 1));
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move the read cursor back to the beginning of the stream
+    //-----------------------------------------------------------------------------------
+    inline void rewind()
+    {
+        m_readPosition = 0;
+        m_bOverflow = false;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if a read went past the end of the stream (the data is
+    ///         truncated or corrupted)
+    //-----------------------------------------------------------------------------------
+    inline bool hasOverflowed() const
+    {
+        return m_bOverflow;
+    }
+
+
+    //_____ Data __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the bytes of the stream (the last one is padded with zeroes)
+    //-----------------------------------------------------------------------------------
+    inline const unsigned char* getData() const
+    {
+        return (m_data.empty() ? 0 : &m_data[0]);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the size of the stream, in bytes
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getSize() const
+    {
+        return (unsigned int) m_data.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the size of the stream, in bits
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbBits() const
+    {
+        return m_nbBits;
+    }
+
+
+    //_____ Attributes __________
+private:
+    std::vector<unsigned char>  m_data;             ///< The bytes
+    unsigned int                m_nbBits;           ///< Number of bits written
+    unsigned int                m_readPosition;     ///< Position of the read cursor, in bits
+    bool                        m_bOverflow;        ///< Indicates if a read went past the end
+};
+
+}
+}
+
+#endif
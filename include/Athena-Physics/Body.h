@@ -49,6 +49,12 @@ namespace Physics {
 //---------------------------------------------------------------------------------------
 class ATHENA_PHYSICS_SYMBOL Body: public CollisionObject, public btMotionState
 {
+    friend class Aggregate;
+    friend class BodyPool;
+    friend class World;
+    friend class WorldStreamer;
+
+
     //_____ Construction / Destruction __________
 public:
     //-----------------------------------------------------------------------------------
@@ -171,6 +177,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void enableDeactivation(bool bEnabled)
     {
+        assert(!isSimulationInProgress());
+
         m_pBody->setActivationState(bEnabled ? WANTS_DEACTIVATION : DISABLE_DEACTIVATION);
     }
 
@@ -181,6 +189,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void enableSimulation(bool bEnabled)
     {
+        assert(!isSimulationInProgress());
+
         m_pBody->setActivationState(bEnabled ? WANTS_DEACTIVATION : DISABLE_SIMULATION);
     }
 
@@ -191,6 +201,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void enableRotation(bool bEnabled)
     {
+        assert(!isSimulationInProgress());
+
         m_bRotationEnabled = bEnabled;
         setAngularFactor( bEnabled ? 1.0f : 0.0f );
     }
@@ -202,6 +214,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void setLinearVelocity(const Math::Vector3& velocity)
     {
+        assert(!isSimulationInProgress());
+
         Entities::Transforms* pTransforms = getTransforms();
         if (pTransforms)
             m_pBody->setLinearVelocity(toBullet(pTransforms->getWorldOrientation() * velocity));
@@ -214,6 +228,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void setWorldLinearVelocity(const Math::Vector3& velocity)
     {
+        assert(!isSimulationInProgress());
+
         m_pBody->setLinearVelocity(toBullet(velocity));
     }
 
@@ -222,6 +238,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline Math::Vector3 getLinearVelocity()
     {
+        assert(!isSimulationInProgress());
+
         return fromBullet(m_pBody->getLinearVelocity());
     }
 
@@ -230,6 +248,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void setAngularVelocity(const Math::Vector3& velocity)
     {
+        assert(!isSimulationInProgress());
+
         m_pBody->setAngularVelocity(toBullet(velocity));
     }
 
@@ -238,6 +258,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline Math::Vector3 getAngularVelocity()
     {
+        assert(!isSimulationInProgress());
+
         return fromBullet(m_pBody->getAngularVelocity());
     }
 
@@ -248,6 +270,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void setAngularFactor(const Math::Vector3& factors)
     {
+        assert(!isSimulationInProgress());
+
         m_pBody->setAngularFactor(toBullet(factors));
     }
 
@@ -259,6 +283,8 @@ public:
     //-----------------------------------------------------------------------------------
     inline void setAngularFactor(Math::Real factor)
     {
+        assert(!isSimulationInProgress());
+
         m_pBody->setAngularFactor(factor);
     }
 
@@ -272,6 +298,62 @@ public:
         return fromBullet(m_pBody->getAngularFactor());
     }
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Enable or disable the continuous collision detection (CCD) of the body
+    ///
+    /// Prevents a fast body from going through the other objects during a step. Only the
+    /// steps where the body moves more than the motion threshold pay the cost of the CCD:
+    /// the body is swept (as a sphere) from its previous position to the new one, and
+    /// stopped at the first hit.
+    ///
+    /// Disabled by default.
+    //-----------------------------------------------------------------------------------
+    void enableCcd(bool bEnabled = true);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the continuous collision detection is enabled
+    //-----------------------------------------------------------------------------------
+    inline bool isCcdEnabled() const
+    {
+        return m_bCcdEnabled;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the distance the body must move during a step to use the continuous
+    ///         collision detection
+    ///
+    /// @param  threshold   The distance, 0 to compute it from the collision shape (half
+    ///                     of its smallest dimension)
+    //-----------------------------------------------------------------------------------
+    void setCcdMotionThreshold(Math::Real threshold);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the distance the body must move during a step to use the
+    ///         continuous collision detection (0: computed from the collision shape)
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getCcdMotionThreshold() const
+    {
+        return m_ccdMotionThreshold;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the radius of the sphere swept by the continuous collision detection
+    ///
+    /// The sphere must be contained in the collision shape.
+    ///
+    /// @param  radius  The radius, 0 to compute it from the collision shape
+    //-----------------------------------------------------------------------------------
+    void setCcdSweptSphereRadius(Math::Real radius);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the radius of the sphere swept by the continuous collision
+    ///         detection (0: computed from the collision shape)
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getCcdSweptSphereRadius() const
+    {
+        return m_ccdSweptSphereRadius;
+    }
+
     //-----------------------------------------------------------------------------------
     /// @brief  Returns the Bullet's rigid body
     //-----------------------------------------------------------------------------------
@@ -280,6 +362,63 @@ public:
         return m_pBody;
     }
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the index of the body in its world
+    ///
+    /// The index doesn't change while the body is in the world (or suspended, see
+    /// World::suspendBodies()), and is reused by another body once it is removed from
+    /// it.
+    ///
+    /// @return The index, INVALID_INDEX if the body isn't in the world
+    ///
+    /// @see    World::getBody()
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getWorldIndex() const
+    {
+        return m_worldIndex;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the body was removed from the simulation by
+    ///         World::suspendBodies()
+    //-----------------------------------------------------------------------------------
+    inline bool isSuspended() const
+    {
+        return m_bSuspended;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the aggregate the body belongs to (0 if none)
+    //-----------------------------------------------------------------------------------
+    inline Aggregate* getAggregate() const
+    {
+        return m_pAggregate;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the pool the body belongs to (0 if none)
+    //-----------------------------------------------------------------------------------
+    inline BodyPool* getPool() const
+    {
+        return m_pPool;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the body is parked in its pool (see BodyPool::release())
+    //-----------------------------------------------------------------------------------
+    inline bool isParked() const
+    {
+        return m_bParked;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the streamer the body is registered to (0 if none)
+    //-----------------------------------------------------------------------------------
+    inline WorldStreamer* getStreamer() const
+    {
+        return m_pStreamer;
+    }
+
     //-----------------------------------------------------------------------------------
     /// @brief  Called when the transforms affecting this component have changed
     ///
@@ -292,7 +431,13 @@ public:
     virtual void onTransformsChanged();
 
 protected:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called when the material of the collision object has changed
+    //-----------------------------------------------------------------------------------
+    virtual void onMaterialChanged();
+
     void updateBody();
+    void updateCcd();
 
 
     //_____ Links management __________
@@ -352,6 +497,8 @@ public:
 public:
     static const std::string TYPE;  ///< Name of the type of component
 
+    static const unsigned int INVALID_INDEX = 0xFFFFFFFF;   ///< Index of the bodies not in a world
+
 
     //_____ Attributes __________
 protected:
@@ -359,6 +506,19 @@ protected:
     Math::Real      m_mass;             ///< The mass of the body
     CollisionShape* m_pShape;           ///< The collision shape
     bool            m_bRotationEnabled; ///< Indicates if the rotations are enabled
+    unsigned int    m_worldIndex;       ///< Index of the body in its world
+    unsigned int    m_movedStamp;       ///< Used by the world to track the bodies that moved
+    bool            m_bSuspended;       ///< Indicates if the body is suspended
+    Math::Vector3   m_suspensionOrigin; ///< Origin of the world when the body was suspended
+    Aggregate*      m_pAggregate;       ///< The aggregate the body belongs to
+    BodyPool*       m_pPool;            ///< The pool the body belongs to
+    unsigned int    m_poolArchetype;    ///< Archetype of the body in its pool
+    bool            m_bParked;          ///< Indicates if the body is parked in its pool
+    Math::Real      m_parkingOffset;    ///< Offset of the parking spot of the body in its pool
+    WorldStreamer*  m_pStreamer;        ///< The streamer the body is registered to
+    bool            m_bCcdEnabled;          ///< Indicates if the continuous collision detection is enabled
+    Math::Real      m_ccdMotionThreshold;   ///< Motion threshold of the CCD (0: automatic)
+    Math::Real      m_ccdSweptSphereRadius; ///< Radius of the sphere swept by the CCD (0: automatic)
 };
 
 }
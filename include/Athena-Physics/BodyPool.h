@@ -0,0 +1,224 @@
+/** @file   BodyPool.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::BodyPool'
+*/
+
+#ifndef _ATHENA_PHYSICS_BODYPOOL_H_
+#define _ATHENA_PHYSICS_BODYPOOL_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Math/Vector3.h>
+#include <Athena-Math/Quaternion.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Recycles the bodies of objects frequently created and destroyed (projectiles,
+///         pickups, ...)
+///
+/// The bodies are grouped by archetype: all the bodies of an archetype are created the
+/// same way (entity, body, collision shape, properties) by a factory provided by the
+/// application.
+///
+/// A released body isn't destroyed nor removed from the world: it is parked, out of the
+/// simulation (far from everything, without simulation and without broadphase pairs).
+/// Each body has its own parking spot, in a row starting at the parking position, so
+/// the parked bodies don't overlap each other in the broadphase.
+/// Acquiring a body of an archetype unparks the last released one in constant time,
+/// without any allocation: its state is reset, and it is put at the requested location.
+/// The factory is only called when no body of the archetype is parked.
+///
+/// @remark The parked bodies must not be modified (the modifications re-adding them to
+///         the world would unpark them), nor registered to a WorldStreamer or an
+///         Aggregate
+/// @remark The pool must be destroyed before the world
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL BodyPool
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Interface to implement to create and destroy the bodies of an archetype
+    //-----------------------------------------------------------------------------------
+    class IFactory
+    {
+        //_____ Construction / Destruction __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Constructor
+        //-------------------------------------------------------------------------------
+        IFactory()
+        {
+        }
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Destructor
+        //-------------------------------------------------------------------------------
+        virtual ~IFactory()
+        {
+        }
+
+
+        //_____ Methods to implement __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Create a body (and its entity, collision shape, ...) in the world of
+        ///         the pool
+        ///
+        /// The body must have a collision shape.
+        //-------------------------------------------------------------------------------
+        virtual Body* createBody() = 0;
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Destroy a body created by createBody()
+        //-------------------------------------------------------------------------------
+        virtual void destroyBody(Body* pBody) = 0;
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world
+    //-----------------------------------------------------------------------------------
+    BodyPool(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    ///
+    /// The parked bodies are destroyed, the acquired ones are left to the application
+    //-----------------------------------------------------------------------------------
+    ~BodyPool();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add an archetype
+    ///
+    /// @param  pFactory    The factory creating the bodies of the archetype (not owned by
+    ///                     the pool)
+    /// @param  nbBodies    Number of bodies to create and park immediately
+    /// @return             Identifier of the archetype
+    //-----------------------------------------------------------------------------------
+    unsigned int addArchetype(IFactory* pFactory, unsigned int nbBodies = 0);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of archetypes
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbArchetypes() const
+    {
+        return (unsigned int) m_archetypes.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Create bodies of an archetype until a number of them are parked
+    //-----------------------------------------------------------------------------------
+    void reserve(unsigned int archetype, unsigned int nbBodies);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Get a body of an archetype
+    ///
+    /// @param  archetype       Identifier of the archetype
+    /// @param  position        World position of the body
+    /// @param  orientation     World orientation of the body
+    /// @param  linearVelocity  Linear velocity of the body
+    /// @param  angularVelocity Angular velocity of the body
+    /// @return                 The body
+    //-----------------------------------------------------------------------------------
+    Body* acquire(unsigned int archetype, const Math::Vector3& position,
+                  const Math::Quaternion& orientation = Math::Quaternion::IDENTITY,
+                  const Math::Vector3& linearVelocity = Math::Vector3::ZERO,
+                  const Math::Vector3& angularVelocity = Math::Vector3::ZERO);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Give back a body acquired from the pool
+    //-----------------------------------------------------------------------------------
+    void release(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of bodies of an archetype
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbBodies(unsigned int archetype) const
+    {
+        assert(archetype < m_archetypes.size());
+        return (unsigned int) m_archetypes[archetype].bodies.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of parked bodies of an archetype
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbParkedBodies(unsigned int archetype) const
+    {
+        assert(archetype < m_archetypes.size());
+        return (unsigned int) m_archetypes[archetype].parked.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the position where the parked bodies are put (far from everything
+    ///         else)
+    ///
+    /// The parking spots of the bodies are aligned along the X axis from that position.
+    /// The bodies already parked stay where they are until they are parked again.
+    //-----------------------------------------------------------------------------------
+    inline void setParkingPosition(const Math::Vector3& position)
+    {
+        m_parkingPosition = position;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the position where the parked bodies are put
+    //-----------------------------------------------------------------------------------
+    inline const Math::Vector3& getParkingPosition() const
+    {
+        return m_parkingPosition;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called when a body of the pool is destroyed (internal, do not use)
+    //-----------------------------------------------------------------------------------
+    void onBodyDestroyed(Body* pBody);
+
+
+    //_____ Internal types __________
+private:
+    struct tArchetype
+    {
+        IFactory*           pFactory;   ///< The factory
+        std::vector<Body*>  bodies;     ///< All the bodies of the archetype
+        std::vector<Body*>  parked;     ///< The parked bodies
+    };
+
+
+    //_____ Internal methods __________
+private:
+    Body* create(unsigned int archetype);
+    Body* initialize(Body* pBody, const Math::Vector3& position,
+                     const Math::Quaternion& orientation, const Math::Vector3& linearVelocity,
+                     const Math::Vector3& angularVelocity);
+    void park(Body* pBody);
+
+
+    //_____ Constants __________
+public:
+    static const short PARKED_FILTER = 0x1000;  ///< Broadphase filter group of the parked bodies
+
+
+    //_____ Attributes __________
+private:
+    World*                      m_pWorld;           ///< The world
+    std::vector<tArchetype>     m_archetypes;       ///< The archetypes
+    Math::Vector3               m_parkingPosition;  ///< Where the parked bodies are put
+    Math::Real                  m_parkingLength;    ///< Length of the row of parking spots
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,163 @@
+/** @file   BudgetController.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::BudgetController'
+*/
+
+#ifndef _ATHENA_PHYSICS_BUDGETCONTROLLER_H_
+#define _ATHENA_PHYSICS_BUDGETCONTROLLER_H_
+
+#include <Athena-Physics/Prerequisites.h>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Keeps the cost of the simulation steps of a world inside a time budget
+///
+/// When a step takes more time than allowed, the next ones usually need more substeps
+/// to catch up, which makes them even slower. With a budget, the world measures the
+/// cost of its steps, and:
+///   - limits the number of substeps to the number fitting in the budget (the time that
+///     can't be simulated is dropped, the simulation is slowed down instead)
+///   - if the steps are still too expensive, degrades the simulation by levels: each
+///     level uses less iterations of the constraint solver, and brings the bands of the
+///     simulation LOD closer to the observers
+///
+/// The simulation gets back to the full quality (one level at a time) once the steps
+/// are cheap enough again.
+///
+/// Without budget (the default), nothing is changed.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL BudgetController
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world
+    //-----------------------------------------------------------------------------------
+    BudgetController(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~BudgetController();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the time budget of a simulation step
+    ///
+    /// @param  budget  The budget (in seconds), 0 to disable it
+    //-----------------------------------------------------------------------------------
+    void setBudget(Math::Real budget);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the time budget of a simulation step (in seconds, 0 if disabled)
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getBudget() const
+    {
+        return m_budget;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the current level of degradation (0: full quality)
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getLevel() const
+    {
+        return m_level;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the last step was degraded (less substeps than requested, or
+    ///         level of degradation above 0)
+    //-----------------------------------------------------------------------------------
+    inline bool isDegraded() const
+    {
+        return m_bLimitedSubSteps || (m_level > 0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of degraded steps since the budget was set
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbDegradedSteps() const
+    {
+        return m_nbDegradedSteps;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the cost of the last step (in seconds)
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getLastCost() const
+    {
+        return m_lastCost;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the average cost of the recent steps (in seconds)
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getAverageCost() const
+    {
+        return m_averageCost;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of iterations of the constraint solver to use at the
+    ///         current level of degradation
+    //-----------------------------------------------------------------------------------
+    unsigned int getIterations(unsigned int nbIterations) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world before each simulation step
+    ///
+    /// @param  nbMaxSubSteps   Maximum number of substeps requested
+    /// @return                 Maximum number of substeps to use
+    //-----------------------------------------------------------------------------------
+    unsigned int beforeStep(unsigned int nbMaxSubSteps);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world after each simulation step
+    ///
+    /// @param  cost        Duration of the step (in seconds)
+    /// @param  nbSubSteps  Number of substeps done
+    //-----------------------------------------------------------------------------------
+    void afterStep(Math::Real cost, unsigned int nbSubSteps);
+
+
+    //_____ Internal methods __________
+private:
+    void apply();
+
+
+    //_____ Constants __________
+public:
+    static const unsigned int MAX_LEVEL         = 3;    ///< Maximum level of degradation
+    static const unsigned int DEGRADE_DELAY     = 3;    ///< Number of steps over the budget before degrading
+    static const unsigned int RECOVER_DELAY     = 60;   ///< Number of cheap steps before recovering
+    static const Math::Real   RECOVER_THRESHOLD;        ///< Fraction of the budget under which a step is cheap
+    static const Math::Real   SMOOTHING;                ///< Weight of the last step in the average cost
+
+
+    //_____ Attributes __________
+private:
+    World*          m_pWorld;               ///< The world
+    Math::Real      m_budget;               ///< Time budget of a step (0: disabled)
+    unsigned int    m_level;                ///< Level of degradation
+    unsigned int    m_appliedLevel;         ///< Level of degradation applied to the world
+    bool            m_bLimitedSubSteps;     ///< Indicates if the substeps of the last step were limited
+    unsigned int    m_nbDegradedSteps;      ///< Number of degraded steps
+    Math::Real      m_lastCost;             ///< Cost of the last step
+    Math::Real      m_averageCost;          ///< Average cost of the recent steps
+    Math::Real      m_subStepCost;          ///< Average cost of a substep (0: unknown)
+    unsigned int    m_nbStepsOver;          ///< Number of consecutive steps over the budget
+    unsigned int    m_nbStepsUnder;         ///< Number of consecutive cheap steps
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,94 @@
+/** @file   CollisionConfiguration.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::CollisionConfiguration'
+*/
+
+#ifndef _ATHENA_PHYSICS_COLLISIONCONFIGURATION_H_
+#define _ATHENA_PHYSICS_COLLISIONCONFIGURATION_H_
+
+#include <Athena-Physics/Prerequisites.h>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Collision configuration used by the worlds
+///
+/// Registers specialized collision algorithms for the most common pairs of primitive
+/// shapes which are handled by the generic (GJK/EPA) algorithm in the default
+/// configuration:
+///   - sphere - box
+///   - sphere - capsule
+///   - capsule - capsule
+///
+/// They compute the closest points directly, and generate two contact points at once for
+/// parallel capsules (so they don't roll while the persistent manifold fills up). The
+/// sphere - sphere and box - box pairs already use specialized algorithms in the default
+/// configuration.
+///
+/// The specialized algorithms can be disabled (for instance to compare both paths), see
+/// World::enableFastCollisionAlgorithms().
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL CollisionConfiguration: public btDefaultCollisionConfiguration
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    //-----------------------------------------------------------------------------------
+    CollisionConfiguration();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    virtual ~CollisionConfiguration();
+
+
+    //_____ Implementation of btCollisionConfiguration __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the function creating the collision algorithms for a pair of
+    ///         shape types
+    //-----------------------------------------------------------------------------------
+    virtual btCollisionAlgorithmCreateFunc* getCollisionAlgorithmCreateFunc(int proxyType0,
+                                                                            int proxyType1);
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Enable or disable the specialized collision algorithms
+    ///
+    /// @remark The dispatchers created with this configuration must register the
+    ///         creation functions again (see btCollisionDispatcher::registerCollisionCreateFunc())
+    //-----------------------------------------------------------------------------------
+    inline void enableFastAlgorithms(bool bEnabled)
+    {
+        m_bFastAlgorithms = bEnabled;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the specialized collision algorithms are enabled
+    //-----------------------------------------------------------------------------------
+    inline bool areFastAlgorithmsEnabled() const
+    {
+        return m_bFastAlgorithms;
+    }
+
+
+    //_____ Attributes __________
+private:
+    btCollisionAlgorithmCreateFunc* m_pSphereBoxCreateFunc;
+    btCollisionAlgorithmCreateFunc* m_pBoxSphereCreateFunc;
+    btCollisionAlgorithmCreateFunc* m_pSphereCapsuleCreateFunc;
+    btCollisionAlgorithmCreateFunc* m_pCapsuleSphereCreateFunc;
+    btCollisionAlgorithmCreateFunc* m_pCapsuleCapsuleCreateFunc;
+    bool                            m_bFastAlgorithms;  ///< Indicates if the specialized algorithms are enabled
+};
+
+}
+}
+
+#endif
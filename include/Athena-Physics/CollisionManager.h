@@ -29,6 +29,10 @@ namespace Physics {
 ///
 /// By default, all the Worlds shares the same Collision Manager. A World might choose to
 /// use its own Collision Manager though.
+///
+/// The decisions of the collision filter can be cached on the broadphase pairs (see
+/// ICollisionFilter::filterCollision()), until the pair is destroyed or invalidate() is
+/// called.
 //---------------------------------------------------------------------------------------
 class ATHENA_PHYSICS_SYMBOL CollisionManager: public btOverlapFilterCallback
 {
@@ -56,17 +60,54 @@ public:
         }
 
 
+        //_____ Internal types __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Decision of the filter for a collision pair
+        //-------------------------------------------------------------------------------
+        enum tResult
+        {
+            RESULT_COLLIDE,             ///< The objects collide (asked again at the next step)
+            RESULT_IGNORE,              ///< The objects don't collide (asked again at the next step)
+            RESULT_COLLIDE_CACHED,      ///< The objects collide until the pair is invalidated
+            RESULT_IGNORE_CACHED,       ///< The objects don't collide until the pair is invalidated
+        };
+
+
         //_____ Methods to implement __________
     public:
         //-------------------------------------------------------------------------------
         /// @brief  Called for each collision pair during the narrowphase
         ///
+        /// Only called by the default implementation of filterCollision()
+        ///
         /// @param  pComponent1     First collision object of the collision pair
         /// @param  pComponent2     Second collision object of the collision pair
         /// @return                 'true' if a collision must happen
         //-------------------------------------------------------------------------------
         virtual bool needsCollision(CollisionObject* pComponent1,
-                                    CollisionObject* pComponent2) = 0;
+                                    CollisionObject* pComponent2)
+        {
+            return true;
+        }
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Called for each collision pair during the narrowphase, unless a
+        ///         cached decision is available for the pair
+        ///
+        /// The default implementation calls needsCollision(), and never caches its
+        /// decision. Override it if the decision doesn't change for the lifetime of the
+        /// pair (until CollisionManager::invalidate() is called).
+        ///
+        /// @param  pComponent1     First collision object of the collision pair
+        /// @param  pComponent2     Second collision object of the collision pair
+        /// @return                 The decision, and if it must be cached
+        //-------------------------------------------------------------------------------
+        virtual tResult filterCollision(CollisionObject* pComponent1,
+                                        CollisionObject* pComponent2)
+        {
+            return (needsCollision(pComponent1, pComponent2) ? RESULT_COLLIDE : RESULT_IGNORE);
+        }
     };
 
 
@@ -109,12 +150,20 @@ public:
     void enableCollision(tCollisionGroup group1, tCollisionGroup group2,
                          bool bEnableFilter = false);
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the collisions between two groups are enabled
+    ///
+    /// The default group (255) collides with everything
+    //-----------------------------------------------------------------------------------
+    bool isCollisionEnabled(tCollisionGroup group1, tCollisionGroup group2) const;
+
     //-----------------------------------------------------------------------------------
     /// @brief  Sets the collision filter
     //-----------------------------------------------------------------------------------
     inline void setFilter(ICollisionFilter* pFilter)
     {
         m_pFilter = pFilter;
+        invalidateAll();
     }
 
     //-----------------------------------------------------------------------------------
@@ -125,6 +174,19 @@ public:
         return m_pFilter;
     }
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Discard the cached decisions of the collision filter for the pairs
+    ///         involving a collision object
+    ///
+    /// To call when the state used by the filter to take its decisions changes
+    //-----------------------------------------------------------------------------------
+    void invalidate(CollisionObject* pComponent);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Discard all the cached decisions of the collision filter
+    //-----------------------------------------------------------------------------------
+    void invalidateAll();
+
 
     //_____ Static methods __________
 public:
@@ -139,10 +201,27 @@ public:
                                    btCollisionDispatcher& dispatcher,
                                    const btDispatcherInfo& dispatchInfo);
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of times the stamps of the cached decisions were
+    ///         reset (after reaching their maximum value)
+    ///
+    /// The worlds must then discard the decisions cached in their pairs (see
+    /// clearCachedDecisions()) before their next collision detection.
+    //-----------------------------------------------------------------------------------
+    static unsigned int getStampGeneration();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Discard the decisions of the collision filter cached in the pairs of a
+    ///         pair cache
+    //-----------------------------------------------------------------------------------
+    static void clearCachedDecisions(btOverlappingPairCache* pPairCache);
+
 
 private:
     static tCollisionGroup getGroupOfCollisionObject(btCollisionObject* pObject);
     static CollisionObject* getComponentOfCollisionObject(btCollisionObject* pObject, tCollisionGroup &group);
+    bool filterPair(btBroadphasePair& collisionPair, CollisionObject* pComponent1,
+                    CollisionObject* pComponent2);
 
 
     //_____ Constants __________
@@ -172,6 +251,7 @@ private:
     tPairState          m_collisionPairs[NB_PAIRS]; ///< Holds all the collision pair infos
     tPairState*         m_indexedPairs[NB_GROUPS];  ///< Used to quickly retrieve a collision pair infos
     ICollisionFilter*   m_pFilter;                  ///< The collision filter
+    unsigned int        m_filterStamp;              ///< Stamp of the last invalidation of all the cached decisions
 };
 
 }
@@ -20,6 +20,8 @@ namespace Physics {
 //---------------------------------------------------------------------------------------
 class ATHENA_PHYSICS_SYMBOL CollisionObject: public PhysicalComponent
 {
+    friend class CollisionManager;
+
     //_____ Construction / Destruction __________
 public:
     //-----------------------------------------------------------------------------------
@@ -79,6 +81,29 @@ public:
         return m_collisionGroup;
     }
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the physical material of the collision object
+    ///
+    /// @see    MaterialTable
+    //-----------------------------------------------------------------------------------
+    void setMaterial(tMaterialID material);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the physical material of the collision object
+    //-----------------------------------------------------------------------------------
+    inline tMaterialID getMaterial() const
+    {
+        return m_material;
+    }
+
+protected:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called when the material of the collision object has changed
+    //-----------------------------------------------------------------------------------
+    virtual void onMaterialChanged()
+    {
+    }
+
 
     //_____ Management of the properties __________
 public:
@@ -130,6 +155,8 @@ public:
     //_____ Attributes __________
 protected:
     tCollisionGroup m_collisionGroup;   ///< The collision group
+    unsigned int    m_filterStamp;      ///< Used to invalidate the cached decisions of the collision filter
+    tMaterialID     m_material;         ///< The physical material
 };
 
 }
@@ -0,0 +1,195 @@
+/** @file   CommandBuffer.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::CommandBuffer'
+*/
+
+#ifndef _ATHENA_PHYSICS_COMMANDBUFFER_H_
+#define _ATHENA_PHYSICS_COMMANDBUFFER_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Math/Vector3.h>
+#include <Athena-Math/Quaternion.h>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Buffer of commands modifying the bodies of a world, applied at the next step
+///         boundary
+///
+/// The bodies can't be modified from a worker thread, from a callback called during the
+/// simulation, or while an asynchronous step is in progress. Instead, the modifications
+/// can be recorded in the command buffer of the world, from any thread and without
+/// locking. They are applied on the thread calling World::stepSimulation() (or
+/// World::stepSimulationAsync()) right before the step, in the order in which they were
+/// recorded.
+///
+/// Rules:
+///   - the recording must be finished (and made visible to the simulation thread, by the
+///     usual synchronisation of the application) before the step starts
+///   - the bodies and collision shapes referenced by the commands must not be destroyed
+///     before the commands are applied (a body destroyed with pending commands
+///     discards them)
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL CommandBuffer
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world to which the commands are applied
+    //-----------------------------------------------------------------------------------
+    CommandBuffer(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~CommandBuffer();
+
+
+    //_____ Recording of commands (thread-safe) __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add a body to the simulation (if it has a collision shape)
+    //-----------------------------------------------------------------------------------
+    void addBody(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove a body from the simulation (its component isn't destroyed)
+    //-----------------------------------------------------------------------------------
+    void removeBody(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Deferred version of Body::setCollisionShape()
+    //-----------------------------------------------------------------------------------
+    void setCollisionShape(Body* pBody, CollisionShape* pShape);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Deferred version of Body::setMass()
+    //-----------------------------------------------------------------------------------
+    void setMass(Body* pBody, Math::Real mass);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Deferred version of Body::setKinematic()
+    //-----------------------------------------------------------------------------------
+    void setKinematic(Body* pBody, bool bKinematic = true);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Apply an impulse to a body
+    ///
+    /// @param  pBody               The body
+    /// @param  impulse             The impulse, in world space
+    /// @param  relativePosition    Point of application, relative to the center of mass
+    ///                             of the body (in world space)
+    //-----------------------------------------------------------------------------------
+    void applyImpulse(Body* pBody, const Math::Vector3& impulse,
+                      const Math::Vector3& relativePosition = Math::Vector3::ZERO);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Deferred version of Body::setWorldLinearVelocity()
+    //-----------------------------------------------------------------------------------
+    void setLinearVelocity(Body* pBody, const Math::Vector3& velocity);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Deferred version of Body::setAngularVelocity()
+    //-----------------------------------------------------------------------------------
+    void setAngularVelocity(Body* pBody, const Math::Vector3& velocity);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a body instantaneously (its velocities aren't modified)
+    ///
+    /// @param  pBody           The body
+    /// @param  position        The new position, in world space
+    /// @param  orientation     The new orientation, in world space
+    //-----------------------------------------------------------------------------------
+    void teleport(Body* pBody, const Math::Vector3& position,
+                  const Math::Quaternion& orientation);
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Apply the recorded commands, in order, then clear the buffer
+    ///
+    /// Called by the world before each simulation step. No command must be recorded
+    /// during the call.
+    //-----------------------------------------------------------------------------------
+    void apply();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Discard the recorded commands concerning a body
+    ///
+    /// Called when a body is destroyed. No command must be recorded during the call.
+    //-----------------------------------------------------------------------------------
+    void discard(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the buffer doesn't contain any command
+    //-----------------------------------------------------------------------------------
+    inline bool isEmpty() const
+    {
+        return (m_pCurrentBlock == m_pFirstBlock) && (m_pFirstBlock->nbReserved == 0);
+    }
+
+
+    //_____ Constants __________
+public:
+    static const unsigned int BLOCK_SIZE = 128;     ///< Number of commands per block of memory
+
+
+    //_____ Internal types __________
+private:
+    enum tCommandType
+    {
+        COMMAND_NONE,       ///< Discarded command
+        COMMAND_ADD_BODY,
+        COMMAND_REMOVE_BODY,
+        COMMAND_SET_COLLISION_SHAPE,
+        COMMAND_SET_MASS,
+        COMMAND_SET_KINEMATIC,
+        COMMAND_APPLY_IMPULSE,
+        COMMAND_SET_LINEAR_VELOCITY,
+        COMMAND_SET_ANGULAR_VELOCITY,
+        COMMAND_TELEPORT,
+    };
+
+    struct tCommand
+    {
+        tCommandType        type;
+        Body*               pBody;
+        CollisionShape*     pShape;
+        Math::Vector3       vector;
+        Math::Vector3       position;
+        Math::Quaternion    orientation;
+        Math::Real          value;
+        bool                bFlag;
+    };
+
+    struct tBlock
+    {
+        tCommand            commands[BLOCK_SIZE];
+        volatile long       nbReserved;     ///< Number of reserved commands (can exceed BLOCK_SIZE)
+        tBlock* volatile    pNext;          ///< Next block
+    };
+
+
+    //_____ Internal methods __________
+private:
+    tCommand* record(tCommandType type, Body* pBody);
+    void execute(const tCommand& command);
+
+
+    //_____ Attributes __________
+private:
+    World*              m_pWorld;           ///< The world to which the commands are applied
+    tBlock*             m_pFirstBlock;      ///< First block of the list (never released)
+    tBlock* volatile    m_pCurrentBlock;    ///< Block in which the commands are recorded
+};
+
+}
+}
+
+#endif
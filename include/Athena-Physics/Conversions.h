@@ -23,6 +23,9 @@ btQuaternion toBullet(const Math::Quaternion& q);
 Math::Vector3 fromBullet(const btVector3& v);
 Math::Quaternion fromBullet(const btQuaternion& q);
 
+btVector3 toBulletPosition(const Math::Vector3& position, const Math::Vector3& origin);
+Math::Vector3 fromBulletPosition(const btVector3& position, const Math::Vector3& origin);
+
 }
 }
 
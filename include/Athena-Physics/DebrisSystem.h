@@ -0,0 +1,341 @@
+/** @file   DebrisSystem.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::DebrisSystem'
+*/
+
+#ifndef _ATHENA_PHYSICS_DEBRISSYSTEM_H_
+#define _ATHENA_PHYSICS_DEBRISSYSTEM_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/World.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Simulates a lot of small and short-lived fragments (debris of explosions,
+///         particles, ...) outside of the Bullet's world
+///
+/// The fragments aren't bodies: they don't have any component, Bullet's object or
+/// broadphase proxy. Their state is stored in one array per value (structure of arrays),
+/// which the integration processes four fragments at a time when SSE is available.
+///
+/// The fragments collide with the static objects of the world, using one ray per moving
+/// fragment, cast from its center in a batch against the snapshot of the static objects
+/// (see World::getStaticSnapshot()). The extent of a box along the movement, and along
+/// the normal of the surface hit, is given by its half extents projected on those
+/// directions. The fragments don't collide with each other nor with the dynamic bodies.
+///
+/// The rays and their results are stored in arrays allocated once by the debris system,
+/// so the updates don't allocate any memory.
+///
+/// A fragment falls asleep once it has been almost immobile for SLEEP_DELAY seconds: it
+/// isn't simulated anymore, but still ages. A fragment is destroyed when its lifetime is
+/// over.
+///
+/// The debris system must be updated by the application after each simulation step of
+/// the world (not during it).
+///
+/// @remark The indices of the fragments change when fragments are spawned, fall asleep
+///         or are destroyed
+/// @remark The debris system must be destroyed before the world
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL DebrisSystem
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  The shapes of the fragments
+    //-----------------------------------------------------------------------------------
+    enum tShape
+    {
+        SHAPE_SPHERE,
+        SHAPE_BOX,
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Describes a new fragment
+    //-----------------------------------------------------------------------------------
+    struct tFragment
+    {
+        tShape              shape;              ///< Shape of the fragment
+        Math::Vector3       size;               ///< Half extents of a box (the radius of a sphere in 'x')
+        Math::Vector3       position;           ///< Position
+        Math::Quaternion    orientation;        ///< Orientation
+        Math::Vector3       linearVelocity;     ///< Linear velocity
+        Math::Vector3       angularVelocity;    ///< Angular velocity
+        Math::Real          lifetime;           ///< Lifetime (in seconds, 0: infinite)
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld      The world
+    /// @param  capacity    Maximum number of fragments
+    //-----------------------------------------------------------------------------------
+    DebrisSystem(World* pWorld, unsigned int capacity = 10000);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~DebrisSystem();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add a fragment
+    ///
+    /// @return 'false' if the maximum number of fragments is reached
+    //-----------------------------------------------------------------------------------
+    bool spawn(const tFragment& fragment);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destroy all the fragments
+    //-----------------------------------------------------------------------------------
+    void clear();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Wake up all the sleeping fragments
+    ///
+    /// Must be called when the objects on which fragments are lying are moved or removed.
+    //-----------------------------------------------------------------------------------
+    void wakeUp();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Simulate the fragments
+    ///
+    /// @param  timeStep    The elapsed time (in seconds)
+    //-----------------------------------------------------------------------------------
+    void update(Math::Real timeStep);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the world
+    //-----------------------------------------------------------------------------------
+    inline World* getWorld() const
+    {
+        return m_pWorld;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the maximum number of fragments
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getCapacity() const
+    {
+        return m_capacity;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the duration of the last update (in seconds)
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getLastUpdateCost() const
+    {
+        return m_lastUpdateCost;
+    }
+
+
+    //_____ Management of the fragments __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of fragments
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbFragments() const
+    {
+        return m_nbFragments;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of fragments that aren't sleeping (their indices are
+    ///         the first ones)
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbAwakeFragments() const
+    {
+        return m_nbAwake;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if a fragment is sleeping
+    //-----------------------------------------------------------------------------------
+    inline bool isSleeping(unsigned int index) const
+    {
+        assert(index < m_nbFragments);
+        return (index >= m_nbAwake);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the shape of a fragment
+    //-----------------------------------------------------------------------------------
+    inline tShape getShape(unsigned int index) const
+    {
+        assert(index < m_nbFragments);
+        return (tShape) m_shapes[index];
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the size of a fragment (see tFragment::size)
+    //-----------------------------------------------------------------------------------
+    Math::Vector3 getSize(unsigned int index) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the position of a fragment
+    //-----------------------------------------------------------------------------------
+    Math::Vector3 getPosition(unsigned int index) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the orientation of a fragment
+    //-----------------------------------------------------------------------------------
+    Math::Quaternion getOrientation(unsigned int index) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the linear velocity of a fragment
+    //-----------------------------------------------------------------------------------
+    Math::Vector3 getLinearVelocity(unsigned int index) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the remaining lifetime of a fragment (in seconds, 0 if infinite)
+    //-----------------------------------------------------------------------------------
+    Math::Real getLifetime(unsigned int index) const;
+
+
+    //_____ Parameters __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the collision group of the fragments: only the objects whose group
+    ///         can collide with it are hit (255: all the objects)
+    //-----------------------------------------------------------------------------------
+    inline void setCollisionGroup(tCollisionGroup group)
+    {
+        m_collisionGroup = group;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the collision group of the fragments
+    //-----------------------------------------------------------------------------------
+    inline tCollisionGroup getCollisionGroup() const
+    {
+        return m_collisionGroup;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the friction of the fragments (from 0 to 1: fraction of the tangential
+    ///         velocity lost at each impact)
+    //-----------------------------------------------------------------------------------
+    void setFriction(Math::Real friction);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the friction of the fragments
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getFriction() const
+    {
+        return m_friction;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the restitution (bounciness) of the fragments
+    //-----------------------------------------------------------------------------------
+    void setRestitution(Math::Real restitution);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the restitution of the fragments
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getRestitution() const
+    {
+        return m_restitution;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the speed under which a fragment is considered immobile
+    //-----------------------------------------------------------------------------------
+    void setSleepThreshold(Math::Real threshold);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the speed under which a fragment is considered immobile
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getSleepThreshold() const
+    {
+        return m_sleepThreshold;
+    }
+
+
+    //_____ Internal types __________
+private:
+    // The arrays of values of the fragments
+    enum tChannel
+    {
+        POSITION_X,
+        POSITION_Y,
+        POSITION_Z,
+        ORIENTATION_X,
+        ORIENTATION_Y,
+        ORIENTATION_Z,
+        ORIENTATION_W,
+        LINEAR_VELOCITY_X,
+        LINEAR_VELOCITY_Y,
+        LINEAR_VELOCITY_Z,
+        ANGULAR_VELOCITY_X,
+        ANGULAR_VELOCITY_Y,
+        ANGULAR_VELOCITY_Z,
+        SIZE_X,
+        SIZE_Y,
+        SIZE_Z,
+        RADIUS,
+        LIFETIME,
+        REST_TIME,
+
+        NB_CHANNELS
+    };
+
+
+    //_____ Internal methods __________
+private:
+    void integrate(btScalar timeStep);
+    void collide(btScalar timeStep);
+    void sleep(btScalar timeStep);
+    void expire(btScalar timeStep);
+    void copyFragment(unsigned int dest, unsigned int src);
+
+    inline btScalar* channel(tChannel channel)
+    {
+        return &m_channels[channel][0];
+    }
+
+    inline btScalar value(tChannel channel, unsigned int index) const
+    {
+        return m_channels[channel][index];
+    }
+
+
+    //_____ Constants __________
+public:
+    static const Math::Real SLEEP_DELAY;    ///< Time during which a fragment must be immobile to fall asleep
+
+
+    //_____ Attributes __________
+private:
+    World*                              m_pWorld;                   ///< The world
+    unsigned int                        m_capacity;                 ///< Maximum number of fragments
+    unsigned int                        m_nbFragments;              ///< Number of fragments
+    unsigned int                        m_nbAwake;                  ///< Number of fragments not sleeping
+    btAlignedObjectArray<btScalar>      m_channels[NB_CHANNELS];    ///< Values of the fragments
+    btAlignedObjectArray<unsigned char> m_shapes;                   ///< Shapes of the fragments
+    tCollisionGroup                     m_collisionGroup;           ///< Collision group of the fragments
+    Math::Real                          m_friction;                 ///< Friction of the fragments
+    Math::Real                          m_restitution;              ///< Restitution of the fragments
+    Math::Real                          m_sleepThreshold;           ///< Speed under which a fragment is immobile
+    Math::Real                          m_lastUpdateCost;           ///< Duration of the last update (in seconds)
+
+    std::vector<World::tRay>            m_rays;                     ///< Rays of the moving fragments
+    std::vector<World::tRayHit>         m_hits;                     ///< Results of the rays
+    std::vector<unsigned int>           m_rayFragments;             ///< Fragment of each ray
+};
+
+}
+}
+
+#endif
@@ -80,12 +80,33 @@ public:
         return m_pShape;
     }
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates that the ghost object will never move (or rarely)
+    ///
+    /// Static ghost objects (triggers) aren't inserted in the broadphase of the world, but
+    /// in a separate index only tested against the moving bodies (see TriggerIndex).
+    /// They don't detect the other ghost objects nor the static bodies.
+    ///
+    /// Disabled by default
+    //-----------------------------------------------------------------------------------
+    void setStatic(bool bStatic = true);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the ghost object is a static one
+    //-----------------------------------------------------------------------------------
+    inline bool isStatic() const
+    {
+        return m_bStatic;
+    }
+
     //-----------------------------------------------------------------------------------
     /// @brief  Returns the number of objects that are overlapping with the shape of
     ///         the ghost object
     //-----------------------------------------------------------------------------------
     inline unsigned int getNbOverlappingObjects() const
     {
+        assert(!isSimulationInProgress());
+
         return (unsigned) m_pGhostObject->getNumOverlappingObjects();
     }
 
@@ -174,6 +195,7 @@ public:
 protected:
     btGhostObject*  m_pGhostObject;     ///< The ghost object
     CollisionShape* m_pShape;           ///< The shape
+    bool            m_bStatic;          ///< Indicates if the ghost object is static
 };
 
 }
@@ -0,0 +1,77 @@
+/** @file   InlineShape.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::InlineShape'
+*/
+
+#ifndef _ATHENA_PHYSICS_INLINESHAPE_H_
+#define _ATHENA_PHYSICS_INLINESHAPE_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/World.h>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Bullet convex shape built in place from the description of a primitive
+///
+/// Used by the spatial queries, to avoid any heap allocation when the caller only
+/// provides a World::tPrimitive. Meant to be allocated on the stack.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL InlineShape
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  primitive   Description of the shape
+    //-----------------------------------------------------------------------------------
+    InlineShape(const World::tPrimitive& primitive);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~InlineShape();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the Bullet's collision shape
+    //-----------------------------------------------------------------------------------
+    inline btConvexShape* get() const
+    {
+        return m_pShape;
+    }
+
+
+    //_____ Internal types __________
+private:
+    template <size_t A, size_t B>
+    struct MaxSize
+    {
+        enum { value = (A > B ? A : B) };
+    };
+
+    enum
+    {
+        STORAGE_SIZE = MaxSize<sizeof(btBoxShape),
+                       MaxSize<sizeof(btCapsuleShape),
+                       MaxSize<sizeof(btConeShape),
+                       MaxSize<sizeof(btCylinderShape), sizeof(btSphereShape)>::value>::value>::value>::value
+    };
+
+
+    //_____ Attributes __________
+private:
+    btConvexShape*  m_pShape;                           ///< The shape (built in m_storage)
+    ATTRIBUTE_ALIGNED16(char m_storage[STORAGE_SIZE]);  ///< Storage of the shape
+};
+
+}
+}
+
+#endif
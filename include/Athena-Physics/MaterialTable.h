@@ -0,0 +1,212 @@
+/** @file   MaterialTable.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::MaterialTable'
+*/
+
+#ifndef _ATHENA_PHYSICS_MATERIALTABLE_H_
+#define _ATHENA_PHYSICS_MATERIALTABLE_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <BulletCollision/CollisionDispatch/btManifoldResult.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  The physical materials of a world
+///
+/// Each collision object uses a material (see CollisionObject::setMaterial()). The
+/// friction and restitution of a contact are given by the combination of the materials
+/// of both objects, precomputed in a table: the contact points get their values with one
+/// lookup, when they are added to a manifold.
+///
+/// The combination of two materials uses the combine mode with the highest priority
+/// (COMBINE_AVERAGE < COMBINE_MIN < COMBINE_MULTIPLY < COMBINE_MAX) of both materials.
+/// It can also be overridden for a specific pair of materials.
+///
+/// Material 0 is the default one. When one of the objects uses it, the friction and
+/// restitution of the Bullet's objects are combined by Bullet, like before the
+/// materials existed (so the objects without material keep the values set on their
+/// Bullet's object).
+///
+/// The values are applied by a callback installed in the 'gContactAddedCallback' global
+/// variable of Bullet when a world is created. The callback previously set by the
+/// application (if any) is still called by it, after the values were applied.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL MaterialTable
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  The ways to combine the values of two materials
+    //-----------------------------------------------------------------------------------
+    enum tCombineMode
+    {
+        COMBINE_AVERAGE,    ///< (a + b) / 2
+        COMBINE_MIN,        ///< min(a, b)
+        COMBINE_MULTIPLY,   ///< a * b (the default, like Bullet)
+        COMBINE_MAX,        ///< max(a, b)
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  A material
+    //-----------------------------------------------------------------------------------
+    struct tMaterial
+    {
+        Math::Real      friction;               ///< Friction coefficient
+        Math::Real      restitution;            ///< Restitution (bounciness)
+        tCombineMode    frictionCombine;        ///< Combination of the frictions
+        tCombineMode    restitutionCombine;     ///< Combination of the restitutions
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Values used by the contacts between two materials
+    //-----------------------------------------------------------------------------------
+    struct tCombination
+    {
+        btScalar        friction;
+        btScalar        restitution;
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    //-----------------------------------------------------------------------------------
+    MaterialTable();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~MaterialTable();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set a material
+    ///
+    /// The materials between the last one and this one are created with the values of
+    /// the default material.
+    //-----------------------------------------------------------------------------------
+    void setMaterial(tMaterialID id, const tMaterial& material);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns a material (the default one if not set)
+    //-----------------------------------------------------------------------------------
+    const tMaterial& getMaterial(tMaterialID id) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of materials
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbMaterials() const
+    {
+        return (unsigned int) m_materials.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Override the values used by the contacts between two materials
+    ///
+    /// @remark The contacts involving the default material don't use the table, so the
+    ///         combinations with it have no effect
+    //-----------------------------------------------------------------------------------
+    void setCombination(tMaterialID id1, tMaterialID id2, Math::Real friction,
+                        Math::Real restitution);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of overridden combinations
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbOverriddenCombinations() const
+    {
+        return (unsigned int) m_overrides.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns an overridden combination
+    //-----------------------------------------------------------------------------------
+    inline const tCombination& getOverriddenCombination(unsigned int index, tMaterialID &id1,
+                                                        tMaterialID &id2) const
+    {
+        assert(index < m_overrides.size());
+
+        id1 = m_overrides[index].id1;
+        id2 = m_overrides[index].id2;
+
+        return m_overrides[index].combination;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove all the overridden combinations
+    //-----------------------------------------------------------------------------------
+    void resetCombinations();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the values used by the contacts between two materials
+    //-----------------------------------------------------------------------------------
+    inline const tCombination& getCombination(tMaterialID id1, tMaterialID id2) const
+    {
+        unsigned int nbMaterials = (unsigned int) m_materials.size();
+
+        if (id1 >= nbMaterials)
+            id1 = 0;
+
+        if (id2 >= nbMaterials)
+            id2 = 0;
+
+        return m_combinations[id1 * nbMaterials + id2];
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Callback used by Bullet when a contact point is added to a manifold
+    ///         (internal, do not use)
+    //-----------------------------------------------------------------------------------
+    static bool contactAddedCallback(btManifoldPoint& cp,
+                                     const btCollisionObject* pObject0, int partId0, int index0,
+                                     const btCollisionObject* pObject1, int partId1, int index1);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Install contactAddedCallback() in Bullet, keeping the callback previously
+    ///         set to call it (internal, do not use)
+    //-----------------------------------------------------------------------------------
+    static void installContactAddedCallback();
+
+
+    //_____ Internal types __________
+private:
+    struct tOverride
+    {
+        tMaterialID     id1;
+        tMaterialID     id2;
+        tCombination    combination;
+    };
+
+
+    //_____ Internal methods __________
+private:
+    void updateCombinations();
+    static btScalar combine(btScalar value1, btScalar value2, tCombineMode mode);
+
+
+    //_____ Constants __________
+public:
+    static const tMaterialID DEFAULT_MATERIAL = 0;      ///< The default material
+
+    static MaterialTable*    _CurrentTable;             ///< Table of the world being simulated (internal, do not use)
+    static ContactAddedCallback _PreviousCallback;      ///< Callback set before ours (internal, do not use)
+
+
+    //_____ Attributes __________
+private:
+    std::vector<tMaterial>      m_materials;        ///< The materials
+    std::vector<tCombination>   m_combinations;     ///< Combinations of all the pairs of materials
+    std::vector<tOverride>      m_overrides;        ///< Overridden combinations
+};
+
+}
+}
+
+#endif
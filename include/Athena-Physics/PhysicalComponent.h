@@ -73,6 +73,20 @@ public:
     //-----------------------------------------------------------------------------------
     World* getWorld() const;
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the world is simulating a step on a worker thread, in which
+    ///         case the component must not be modified
+    ///
+    /// @see    World::stepSimulationAsync()
+    //-----------------------------------------------------------------------------------
+    bool isSimulationInProgress() const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the origin of the physical world (see World::shiftOrigin()), in
+    ///         the coordinates of the entities
+    //-----------------------------------------------------------------------------------
+    Math::Vector3 getWorldOrigin() const;
+
 
     //_____ Management of the properties __________
 public:
@@ -36,13 +36,33 @@ namespace Athena
     //------------------------------------------------------------------------------------
     namespace Physics
     {
+        class Aggregate;
         class Body;
+        class BodyPool;
+        class BudgetController;
+        class CollisionConfiguration;
         class CollisionManager;
         class CollisionObject;
         class CollisionShape;
+        class CommandBuffer;
+        class DebrisSystem;
         class GhostObject;
+        class MaterialTable;
         class PhysicalComponent;
+        class ProjectileSystem;
+        class QueryQueue;
+        class ReplicationDecoder;
+        class ReplicationEncoder;
+        class SimulationLod;
+        class TriggerIndex;
         class World;
+        class WorldSnapshot;
+        class WorldStreamer;
+
+        class AabbTree;
+        class BitStream;
+        class InlineShape;
+        class ITaskScheduler;
 
         class CompoundShape;
         class PrimitiveShape;
@@ -53,6 +73,11 @@ namespace Athena
         //------------------------------------------------------------------------------------
         typedef unsigned char tCollisionGroup;
 
+        //------------------------------------------------------------------------------------
+        /// @brief  Identifies a physical material (see MaterialTable)
+        //------------------------------------------------------------------------------------
+        typedef unsigned char tMaterialID;
+
         //------------------------------------------------------------------------------------
         /// @brief  Initialize the Physics module
         //------------------------------------------------------------------------------------
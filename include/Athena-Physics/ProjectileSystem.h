@@ -0,0 +1,259 @@
+/** @file   ProjectileSystem.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::ProjectileSystem'
+*/
+
+#ifndef _ATHENA_PHYSICS_PROJECTILESYSTEM_H_
+#define _ATHENA_PHYSICS_PROJECTILESYSTEM_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/World.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Simulates the projectiles of a world (bullets, arrows, ...) without rigid
+///         bodies
+///
+/// The projectiles are points following a ballistic trajectory (gravity of the world
+/// and quadratic drag). Their state is stored in one array per value, processed by
+/// loops that the compiler can vectorize.
+///
+/// After each simulation step of the world, the projectiles are moved, and the
+/// segments they travelled are cast in one batch (see World::rayCastBatch(), split
+/// between the worker threads of the task scheduler) against the snapshot published at
+/// the end of the step, or against the world itself if the snapshots are disabled (see
+/// World::enableSnapshots()). A projectile is destroyed when it hits an object (the
+/// listener is notified) or when its lifetime is over.
+///
+/// The listener is notified of the impacts of a step once all of them are known, in the
+/// order of the projectiles. If it removes an object from the world (or destroys it)
+/// during a notification, the remaining impacts with that object aren't reported.
+///
+/// The projectiles don't interact with the simulation: they don't push the objects
+/// they hit, and don't take part in the broadphase or the constraint solver.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL ProjectileSystem
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Identifies a projectile
+    //-----------------------------------------------------------------------------------
+    typedef unsigned int tProjectileID;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Describes a new projectile
+    //-----------------------------------------------------------------------------------
+    struct tProjectile
+    {
+        Math::Vector3   position;   ///< Start position
+        Math::Vector3   velocity;   ///< Start velocity
+        Math::Real      drag;       ///< Drag coefficient (deceleration = drag * speed^2)
+        Math::Real      lifetime;   ///< Lifetime (in seconds)
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Describes the impact of a projectile
+    //-----------------------------------------------------------------------------------
+    struct tHit
+    {
+        tProjectileID       id;         ///< The projectile
+        CollisionObject*    pObject;    ///< The object hit
+        Math::Vector3       position;   ///< Position of the impact
+        Math::Vector3       normal;     ///< Normal of the surface at the impact
+        Math::Vector3       velocity;   ///< Velocity of the projectile at the impact
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Interface to implement to be notified when projectiles hit objects
+    //-----------------------------------------------------------------------------------
+    class IListener
+    {
+        //_____ Construction / Destruction __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Constructor
+        //-------------------------------------------------------------------------------
+        IListener()
+        {
+        }
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Destructor
+        //-------------------------------------------------------------------------------
+        virtual ~IListener()
+        {
+        }
+
+
+        //_____ Methods to implement __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Called when a projectile hits an object (the projectile is already
+        ///         destroyed)
+        ///
+        /// The object can be removed from the world or destroyed: the other impacts
+        /// of the step with it are then discarded.
+        //-------------------------------------------------------------------------------
+        virtual void onProjectileHit(const tHit& hit) = 0;
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world owning the projectile system
+    //-----------------------------------------------------------------------------------
+    ProjectileSystem(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~ProjectileSystem();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add a projectile
+    ///
+    /// @return The identifier of the projectile
+    //-----------------------------------------------------------------------------------
+    tProjectileID fire(const tProjectile& projectile);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destroy all the projectiles
+    //-----------------------------------------------------------------------------------
+    void clear();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move the projectiles and test their collisions
+    ///
+    /// Called by the world after each simulation step
+    ///
+    /// @param  timeStep    The simulated time (in seconds)
+    //-----------------------------------------------------------------------------------
+    void update(Math::Real timeStep);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of projectiles
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbProjectiles() const
+    {
+        return (unsigned int) m_ids.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the identifier of a projectile
+    ///
+    /// @remark The indices of the projectiles change when projectiles are destroyed
+    //-----------------------------------------------------------------------------------
+    inline tProjectileID getID(unsigned int index) const
+    {
+        assert(index < m_ids.size());
+        return m_ids[index];
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the position of a projectile
+    //-----------------------------------------------------------------------------------
+    Math::Vector3 getPosition(unsigned int index) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the velocity of a projectile
+    //-----------------------------------------------------------------------------------
+    Math::Vector3 getVelocity(unsigned int index) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the collision group of the projectiles: only the objects whose group
+    ///         can collide with it are hit (255: all the objects)
+    //-----------------------------------------------------------------------------------
+    inline void setCollisionGroup(tCollisionGroup group)
+    {
+        m_collisionGroup = group;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the collision group of the projectiles
+    //-----------------------------------------------------------------------------------
+    inline tCollisionGroup getCollisionGroup() const
+    {
+        return m_collisionGroup;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Sets the listener notified when projectiles hit objects
+    //-----------------------------------------------------------------------------------
+    inline void setListener(IListener* pListener)
+    {
+        m_pListener = pListener;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the listener notified when projectiles hit objects
+    //-----------------------------------------------------------------------------------
+    inline IListener* getListener() const
+    {
+        return m_pListener;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called when an object is removed from the world, so the impacts not
+    ///         notified yet don't reference it (internal, do not use)
+    //-----------------------------------------------------------------------------------
+    void onObjectRemoved(CollisionObject* pObject);
+
+
+    //_____ Internal types __________
+private:
+    // The arrays of values of the projectiles
+    enum tChannel
+    {
+        POSITION_X,
+        POSITION_Y,
+        POSITION_Z,
+        VELOCITY_X,
+        VELOCITY_Y,
+        VELOCITY_Z,
+        DRAG,
+        LIFETIME,
+
+        NB_CHANNELS
+    };
+
+
+    //_____ Internal methods __________
+private:
+    void remove(unsigned int index);
+
+    inline btScalar* channel(tChannel channel)
+    {
+        return &m_channels[channel][0];
+    }
+
+
+    //_____ Attributes __________
+private:
+    World*                          m_pWorld;                   ///< The world
+    btAlignedObjectArray<btScalar>  m_channels[NB_CHANNELS];    ///< Values of the projectiles
+    std::vector<tProjectileID>      m_ids;                      ///< Identifiers of the projectiles
+    tProjectileID                   m_nextID;                   ///< Identifier of the next projectile
+    tCollisionGroup                 m_collisionGroup;           ///< Collision group of the projectiles
+    IListener*                      m_pListener;                ///< The listener
+
+    std::vector<World::tRay>        m_rays;                     ///< Segments travelled during the step
+    std::vector<World::tRayHit>     m_rayHits;                  ///< Results of the segments
+    std::vector<tHit>               m_hits;                     ///< Impacts of the step
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,308 @@
+/** @file   QueryQueue.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::QueryQueue'
+*/
+
+#ifndef _ATHENA_PHYSICS_QUERYQUEUE_H_
+#define _ATHENA_PHYSICS_QUERYQUEUE_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/World.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Queue of deferred spatial queries
+///
+/// The queries that can tolerate some latency (AI perception, validation of spawn
+/// points, ...) can be submitted to the queue of the world instead of being performed
+/// immediately. Each submission returns a handle, used later to poll the result.
+///
+/// The pending queries are processed after each simulation step, in submission order,
+/// until the time budget of the queue is exhausted (the remaining ones are processed
+/// after the next step). When the world has a task scheduler, the rays and sweeps are
+/// processed in parallel by the worker threads.
+///
+/// In asynchronous mode, the queries are instead processed by a worker thread on the
+/// last snapshot of the world, while the next step is simulated (see
+/// setAsynchronous()).
+///
+/// The results stay available until they are retrieved (or the query is cancelled).
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL QueryQueue
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Identifies a submitted query
+    //-----------------------------------------------------------------------------------
+    struct tQueryHandle
+    {
+        unsigned int    slot;       ///< Index of the slot used by the query
+        unsigned int    serial;     ///< Serial number of the query (0: invalid handle)
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Status of a query
+    //-----------------------------------------------------------------------------------
+    enum tStatus
+    {
+        STATUS_PENDING,     ///< The query wasn't processed yet
+        STATUS_DONE,        ///< The query was processed (and the result retrieved)
+        STATUS_INVALID,     ///< Invalid handle, or result already retrieved
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world on which the queries are performed
+    //-----------------------------------------------------------------------------------
+    QueryQueue(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~QueryQueue();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Submit a ray cast
+    ///
+    /// @see    World::rayCast()
+    //-----------------------------------------------------------------------------------
+    tQueryHandle submitRayCast(const World::tRay& ray, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Submit the sweep of a primitive shape
+    ///
+    /// @see    World::sweep()
+    //-----------------------------------------------------------------------------------
+    tQueryHandle submitSweep(const World::tPrimitive& primitive, const World::tSweep& sweep,
+                             tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Submit an overlap test of a primitive shape
+    ///
+    /// At most MAX_OVERLAP_RESULTS objects are reported
+    ///
+    /// @see    World::overlap()
+    //-----------------------------------------------------------------------------------
+    tQueryHandle submitOverlap(const World::tPrimitive& primitive, const World::tPose& pose,
+                               tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the result of a ray cast
+    ///
+    /// @param  handle  Handle of the query
+    /// @retval hit     The result (if the status is STATUS_DONE)
+    /// @return         The status of the query
+    ///
+    /// @remark Once retrieved, the result isn't available anymore
+    //-----------------------------------------------------------------------------------
+    tStatus getRayCastResult(const tQueryHandle& handle, World::tRayHit &hit);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the result of a sweep
+    ///
+    /// @param  handle  Handle of the query
+    /// @retval hit     The result (if the status is STATUS_DONE)
+    /// @return         The status of the query
+    ///
+    /// @remark Once retrieved, the result isn't available anymore
+    //-----------------------------------------------------------------------------------
+    tStatus getSweepResult(const tQueryHandle& handle, World::tSweepHit &hit);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the result of an overlap test
+    ///
+    /// @param  handle      Handle of the query
+    /// @retval pResults    The overlapping objects (if the status is STATUS_DONE)
+    /// @param  maxResults  Size of the pResults array
+    /// @retval nbResults   Number of overlapping objects written in pResults
+    /// @return             The status of the query
+    ///
+    /// @remark Once retrieved, the result isn't available anymore
+    //-----------------------------------------------------------------------------------
+    tStatus getOverlapResult(const tQueryHandle& handle, CollisionObject** pResults,
+                             unsigned int maxResults, unsigned int &nbResults);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Cancel a query (or discard its result)
+    //-----------------------------------------------------------------------------------
+    void cancel(const tQueryHandle& handle);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of queries waiting to be processed
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbPendingQueries() const
+    {
+        return (unsigned int) (m_pending.size() - m_firstPending);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Sets the time budget allowed to process the queries after each
+    ///         simulation step
+    ///
+    /// @param  budget  The budget, in seconds (0: no limit, the default)
+    //-----------------------------------------------------------------------------------
+    inline void setBudget(Math::Real budget)
+    {
+        m_budget = budget;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the time budget allowed to process the queries after each
+    ///         simulation step
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getBudget() const
+    {
+        return m_budget;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Enable or disable the asynchronous mode
+    ///
+    /// In asynchronous mode, the pending queries are processed on the last snapshot of
+    /// the world by a task running during the simulation step, instead of after it. The
+    /// results are thus one step older, but the queries don't add to the duration of
+    /// the step anymore.
+    ///
+    /// The mode is only effective when the world has a task scheduler and publishes
+    /// snapshots (see World::enableSnapshots()), otherwise the queries are processed
+    /// after the step as usual.
+    //-----------------------------------------------------------------------------------
+    inline void setAsynchronous(bool bAsynchronous)
+    {
+        m_bAsynchronous = bAsynchronous;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the asynchronous mode is enabled
+    //-----------------------------------------------------------------------------------
+    inline bool isAsynchronous() const
+    {
+        return m_bAsynchronous;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Process the pending queries, until the time budget is exhausted
+    ///
+    /// Called by the world after each simulation step. The world must not be modified
+    /// or simulated during the call.
+    ///
+    /// When the world has a task scheduler, the rays and sweeps are split between the
+    /// worker threads, which query a snapshot of the world built for the call.
+    ///
+    /// @return The number of queries processed
+    //-----------------------------------------------------------------------------------
+    inline unsigned int process()
+    {
+        return process(m_budget);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Process the pending queries, until the given time budget is exhausted
+    ///
+    /// @param  budget  The budget, in seconds (0: no limit)
+    /// @return         The number of queries processed
+    //-----------------------------------------------------------------------------------
+    unsigned int process(Math::Real budget);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Start to process the pending queries in the background, if the
+    ///         asynchronous mode is effective
+    ///
+    /// Called by the world before each simulation step. The queue must not be used
+    /// until wait() is called.
+    ///
+    /// @return 'true' if the processing was started
+    //-----------------------------------------------------------------------------------
+    bool launch();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Wait for the end of the processing started by launch()
+    ///
+    /// @return The number of queries processed
+    //-----------------------------------------------------------------------------------
+    unsigned int wait();
+
+
+    //_____ Constants __________
+public:
+    static const unsigned int MAX_OVERLAP_RESULTS = 16;     ///< Maximum number of objects reported by an overlap test
+
+
+    //_____ Internal types __________
+private:
+    enum tQueryType
+    {
+        QUERY_RAY,
+        QUERY_SWEEP,
+        QUERY_OVERLAP,
+    };
+
+    enum tState
+    {
+        STATE_FREE,
+        STATE_PENDING,
+        STATE_DONE,
+    };
+
+    struct tQuery
+    {
+        tQueryType          type;
+        tState              state;
+        unsigned int        serial;
+        tCollisionGroup     group;
+
+        World::tRay         ray;
+        World::tSweep       sweep;
+        World::tPose        pose;
+        World::tPrimitive   primitive;
+
+        World::tRayHit      hit;
+        unsigned int        nbResults;
+        CollisionObject*    results[MAX_OVERLAP_RESULTS];
+    };
+
+    class ProcessTask;
+    class AsynchronousTask;
+
+
+    //_____ Internal methods __________
+private:
+    tQueryHandle allocate(tQueryType type, tCollisionGroup group);
+    tQuery* getQuery(const tQueryHandle& handle, tQueryType type);
+    void release(unsigned int slot);
+    void execute(tQuery& query, const WorldSnapshot* pSnapshot = 0);
+    unsigned int process(const WorldSnapshot* pSnapshot, Math::Real budget);
+
+
+    //_____ Attributes __________
+private:
+    World*                      m_pWorld;               ///< The world on which the queries are performed
+    std::vector<tQuery>         m_queries;              ///< Slots of the queries
+    std::vector<unsigned int>   m_freeSlots;            ///< Free slots
+    std::vector<tQueryHandle>   m_pending;              ///< Pending queries (in submission order)
+    size_t                      m_firstPending;         ///< Index of the first unprocessed query in m_pending
+    unsigned int                m_nextSerial;           ///< Serial number of the next query
+    Math::Real                  m_budget;               ///< Time budget after each step (seconds, 0: no limit)
+    bool                        m_bAsynchronous;        ///< Indicates if the asynchronous mode is enabled
+    AsynchronousTask*           m_pAsynchronousTask;    ///< Task processing the queries in asynchronous mode
+    ITaskScheduler::tTaskHandle m_asynchronousHandle;   ///< Handle of the task (when running)
+    bool                        m_bRunning;             ///< Indicates if the task is running
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,90 @@
+/** @file   Replication.h
+    @author Philip Abbet
+
+    Declaration of the types and functions shared by the encoder and the decoder of the
+    network replication of the bodies
+*/
+
+#ifndef _ATHENA_PHYSICS_REPLICATION_H_
+#define _ATHENA_PHYSICS_REPLICATION_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Math/Vector3.h>
+
+
+namespace Athena {
+namespace Physics {
+
+//---------------------------------------------------------------------------------------
+/// @brief  Precision of the replicated state of the bodies (must be the same on the
+///         encoder and the decoder)
+//---------------------------------------------------------------------------------------
+struct tReplicationSettings
+{
+    Math::Real      positionPrecision;  ///< Precision of the positions, in world units
+    Math::Real      velocityPrecision;  ///< Precision of the velocities (linear and angular)
+    unsigned int    orientationBits;    ///< Number of bits of each of the three components of the orientations (2 to 10)
+    bool            bVelocities;        ///< Indicates if the velocities are replicated
+
+    tReplicationSettings()
+    : positionPrecision(Math::Real(1.0) / 1024), velocityPrecision(Math::Real(1.0) / 256),
+      orientationBits(10), bVelocities(true)
+    {
+    }
+};
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Quantized state of a body
+//---------------------------------------------------------------------------------------
+struct tQuantizedBodyState
+{
+    int             position[3];        ///< Position, in units of positionPrecision
+    unsigned int    orientation;        ///< Orientation, using the "smallest three" encoding
+    int             linearVelocity[3];  ///< Linear velocity, in units of velocityPrecision
+    int             angularVelocity[3]; ///< Angular velocity, in units of velocityPrecision
+    bool            bPresent;           ///< Indicates if there is a body at that index
+};
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Quantize the state of a body
+///
+/// The position is quantized in the coordinates of the entities, so the encoder and the
+/// decoder don't need to use the same origin (see World::shiftOrigin())
+//---------------------------------------------------------------------------------------
+void ATHENA_PHYSICS_SYMBOL quantizeBodyState(const btRigidBody* pRigidBody, const Math::Vector3& origin,
+                                             const tReplicationSettings& settings, tQuantizedBodyState &state);
+
+//---------------------------------------------------------------------------------------
+/// @brief  Retrieve the state of a body from its quantized version
+//---------------------------------------------------------------------------------------
+void ATHENA_PHYSICS_SYMBOL dequantizeBodyState(const tQuantizedBodyState& state, const Math::Vector3& origin,
+                                               const tReplicationSettings& settings, btTransform &transform,
+                                               btVector3 &linearVelocity, btVector3 &angularVelocity);
+
+//---------------------------------------------------------------------------------------
+/// @brief  Indicates if two quantized states are identical
+//---------------------------------------------------------------------------------------
+bool ATHENA_PHYSICS_SYMBOL isSameBodyState(const tQuantizedBodyState& state1, const tQuantizedBodyState& state2);
+
+//---------------------------------------------------------------------------------------
+/// @brief  Write the fields of a quantized state which differ from a baseline state
+///
+/// @remark The 'bPresent' flag isn't written
+//---------------------------------------------------------------------------------------
+void ATHENA_PHYSICS_SYMBOL writeBodyState(BitStream &stream, const tQuantizedBodyState& state,
+                                          const tQuantizedBodyState& baseline, const tReplicationSettings& settings);
+
+//---------------------------------------------------------------------------------------
+/// @brief  Read a quantized state written by writeBodyState()
+///
+/// @remark The 'bPresent' flag isn't modified
+//---------------------------------------------------------------------------------------
+void ATHENA_PHYSICS_SYMBOL readBodyState(BitStream &stream, const tQuantizedBodyState& baseline,
+                                         const tReplicationSettings& settings, tQuantizedBodyState &state);
+
+}
+}
+
+#endif
@@ -0,0 +1,113 @@
+/** @file   ReplicationDecoder.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::ReplicationDecoder'
+*/
+
+#ifndef _ATHENA_PHYSICS_REPLICATIONDECODER_H_
+#define _ATHENA_PHYSICS_REPLICATIONDECODER_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/Replication.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Decode the frames written by a ReplicationEncoder, and apply them to the
+///         bodies of a world
+///
+/// The decoder keeps the last frames received, since the encoder uses them as baselines.
+/// The frames older than the last one applied (received out of order) are kept, but not
+/// applied.
+///
+/// The state of a frame is applied to the body at the same index in the world (see
+/// World::getBody()); the frames don't add or remove bodies.
+///
+/// @see    ReplicationEncoder
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL ReplicationDecoder
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld      The world
+    /// @param  settings    The precision of the state (must be the same as the one of
+    ///                     the encoder)
+    //-----------------------------------------------------------------------------------
+    ReplicationDecoder(World* pWorld,
+                       const tReplicationSettings& settings = tReplicationSettings());
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~ReplicationDecoder();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Decode a frame and apply it to the bodies
+    ///
+    /// @param  stream  The stream from which the frame is read (at the position of its
+    ///                 read cursor)
+    /// @param  frame   Identifier of the frame (to acknowledge to the encoder)
+    /// @return         'false' if the frame can't be decoded (unknown baseline or
+    ///                 corrupted data), in which case it must not be acknowledged
+    ///
+    /// @remark Must not be called during an asynchronous step
+    //-----------------------------------------------------------------------------------
+    bool decode(BitStream &stream, unsigned short &frame);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Forget all the frames received
+    //-----------------------------------------------------------------------------------
+    void reset();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the precision of the state
+    //-----------------------------------------------------------------------------------
+    inline const tReplicationSettings& getSettings() const
+    {
+        return m_settings;
+    }
+
+
+    //_____ Constants __________
+public:
+    static const unsigned int NB_FRAMES = 32;   ///< Number of frames kept as potential baselines
+
+
+    //_____ Internal types __________
+private:
+    struct tFrame
+    {
+        unsigned short                      id;
+        bool                                bValid;
+        std::vector<tQuantizedBodyState>    states;     ///< By body index
+    };
+
+
+    //_____ Internal methods __________
+private:
+    void apply(const tFrame& frame);
+
+
+    //_____ Attributes __________
+private:
+    World*                              m_pWorld;           ///< The world
+    tReplicationSettings                m_settings;         ///< The precision of the state
+    tFrame                              m_frames[NB_FRAMES];///< The last frames received
+    std::vector<tQuantizedBodyState>    m_applied;          ///< The state last applied to the bodies
+    unsigned short                      m_lastFrame;        ///< Identifier of the last frame applied
+    bool                                m_bHasLastFrame;    ///< Indicates if a frame was applied
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,125 @@
+/** @file   ReplicationEncoder.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::ReplicationEncoder'
+*/
+
+#ifndef _ATHENA_PHYSICS_REPLICATIONENCODER_H_
+#define _ATHENA_PHYSICS_REPLICATIONENCODER_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/Replication.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Encode the state of the bodies of a world, to replicate it over the network
+///
+/// Each call to encode() quantizes the state of all the bodies of the world into a new
+/// frame, and writes in a bit stream only the bodies whose quantized state differs from
+/// the one in a baseline frame: the last frame acknowledged by the receiver. Without
+/// baseline (at the beginning, or if the acknowledged frame is too old), the state of all
+/// the bodies is written.
+///
+/// The bodies are identified by their index in the world (see Body::getWorldIndex()):
+/// the receiver must have the same bodies at the same indices.
+///
+/// One encoder is needed per receiver, since each one has its own baseline.
+///
+/// @see    ReplicationDecoder
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL ReplicationEncoder
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld      The world
+    /// @param  settings    The precision of the state (must be the same as the one of
+    ///                     the decoder)
+    //-----------------------------------------------------------------------------------
+    ReplicationEncoder(World* pWorld,
+                       const tReplicationSettings& settings = tReplicationSettings());
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~ReplicationEncoder();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Encode the current state of the bodies in a new frame
+    ///
+    /// @param  stream  The stream in which the frame is written (at the end)
+    /// @return         Identifier of the frame
+    ///
+    /// @remark Must not be called during an asynchronous step
+    //-----------------------------------------------------------------------------------
+    unsigned short encode(BitStream &stream);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called when the receiver acknowledged the reception of a frame
+    ///
+    /// The frame becomes the baseline of the next ones (if it is more recent than the
+    /// current one).
+    //-----------------------------------------------------------------------------------
+    void acknowledge(unsigned short frame);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Forget the baseline (the next frame will contain all the bodies)
+    //-----------------------------------------------------------------------------------
+    void reset();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of bodies written in the last frame
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbEncodedBodies() const
+    {
+        return m_nbEncodedBodies;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the precision of the state
+    //-----------------------------------------------------------------------------------
+    inline const tReplicationSettings& getSettings() const
+    {
+        return m_settings;
+    }
+
+
+    //_____ Constants __________
+public:
+    static const unsigned int NB_FRAMES = 32;   ///< Number of frames kept as potential baselines
+
+
+    //_____ Internal types __________
+private:
+    struct tFrame
+    {
+        unsigned short                      id;
+        bool                                bValid;
+        std::vector<tQuantizedBodyState>    states;     ///< By body index
+    };
+
+
+    //_____ Attributes __________
+private:
+    World*                  m_pWorld;           ///< The world
+    tReplicationSettings    m_settings;         ///< The precision of the state
+    tFrame                  m_frames[NB_FRAMES];///< The last frames
+    unsigned short          m_nextFrame;        ///< Identifier of the next frame
+    unsigned short          m_baseline;         ///< Identifier of the baseline frame
+    bool                    m_bHasBaseline;     ///< Indicates if there is a baseline frame
+    unsigned int            m_nbEncodedBodies;  ///< Number of bodies written in the last frame
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,227 @@
+/** @file   SimulationLod.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::SimulationLod'
+*/
+
+#ifndef _ATHENA_PHYSICS_SIMULATIONLOD_H_
+#define _ATHENA_PHYSICS_SIMULATIONLOD_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Math/Vector3.h>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Reduces the cost of the simulation of the dynamic bodies far from all the
+///         observers
+///
+/// The space around the observers (usually the players) is divided in bands, by
+/// distance. The bodies of the farthest bands are only simulated once every N substeps:
+///   - during the skipped substeps, they are put to sleep, so they aren't integrated,
+///     nor solved, nor tested against the other sleeping bodies
+///   - during their substep, their velocities, gravity, damping and sleeping thresholds
+///     are scaled so they cover the time elapsed since they were last simulated (their
+///     deactivation time progresses accordingly)
+///
+/// The substeps of the bodies of a band are spread over the N substeps, to keep the cost
+/// constant. The phase of a body is given by its simulation island (the lowest index of
+/// the bodies of the island), so the bodies resting on each other (like a pile of
+/// debris) are simulated during the same substeps. A band can also freeze its bodies
+/// entirely (until an awake body touches them, or they get closer to an observer).
+///
+/// The solver must never see two bodies simulated at different rates in contact (or
+/// constrained together): the impulses would exchange N times the momentum. So a body
+/// whose potential contacts (the pairs whose bounding boxes overlap) or constraints
+/// involve a body simulated at another rate is simulated at full rate during the
+/// substep, and the time it skipped is lost. A skipped body woken up by an awake one
+/// touching it is simulated normally, and that substep isn't covered again later.
+///
+/// Since a body keeps its position and velocity when changing band, the transitions are
+/// smooth. A margin (see setHysteresis()) prevents the bodies near a limit from
+/// changing band at each step.
+///
+/// Without band or without observer, all the bodies are simulated at full rate.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL SimulationLod
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  A band of distance
+    //-----------------------------------------------------------------------------------
+    struct tBand
+    {
+        Math::Real      distance;   ///< Minimal distance to the closest observer
+        unsigned int    interval;   ///< The bodies are simulated once every 'interval'
+                                    ///  substeps (0 to freeze them)
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world
+    //-----------------------------------------------------------------------------------
+    SimulationLod(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~SimulationLod();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the bands
+    ///
+    /// @param  pBands      The bands, sorted by increasing distance (the bodies closer
+    ///                     than the first one are simulated at full rate)
+    /// @param  nbBands     The number of bands (0 to disable the LOD)
+    //-----------------------------------------------------------------------------------
+    void setBands(const tBand* pBands, unsigned int nbBands);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of bands
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbBands() const
+    {
+        return (unsigned int) m_bands.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the positions of the observers (usually once per step)
+    //-----------------------------------------------------------------------------------
+    void setObservers(const Math::Vector3* pPositions, unsigned int nbObservers);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the distance a body must go past the limit of a farther band to
+    ///         enter it
+    //-----------------------------------------------------------------------------------
+    inline void setHysteresis(Math::Real distance)
+    {
+        assert(distance >= Math::Real(0.0));
+        m_hysteresis = distance;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the distance a body must go past the limit of a farther band to
+    ///         enter it
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getHysteresis() const
+    {
+        return m_hysteresis;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the scale applied to the distances of the bands
+    ///
+    /// A scale lower than 1 brings the bands closer to the observers (used to reduce the
+    /// cost of the simulation, see BudgetController)
+    //-----------------------------------------------------------------------------------
+    inline void setDistanceScale(Math::Real scale)
+    {
+        assert(scale > Math::Real(0.0));
+        m_distanceScale = scale;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the scale applied to the distances of the bands
+    //-----------------------------------------------------------------------------------
+    inline Math::Real getDistanceScale() const
+    {
+        return m_distanceScale;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the band of a body (0: full rate, i: band i - 1)
+    //-----------------------------------------------------------------------------------
+    unsigned int getBand(Body* pBody) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of bodies that skipped the last substep
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbSkippedBodies() const
+    {
+        return m_nbSkippedBodies;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world before each simulation step
+    //-----------------------------------------------------------------------------------
+    void beforeStep();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world after each substep of the simulation
+    ///
+    /// @param  timeStep    Duration of the substep
+    //-----------------------------------------------------------------------------------
+    void afterSubStep(btScalar timeStep);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called by the world after each simulation step
+    //-----------------------------------------------------------------------------------
+    void afterStep();
+
+
+    //_____ Internal types __________
+private:
+    struct tBodyLod
+    {
+        unsigned int    band;       ///< Current band (0: full rate)
+        unsigned int    skipped;    ///< Number of substeps skipped since the body was last simulated
+        unsigned int    scale;      ///< Scale of the body during the current substep (0: skipped)
+        bool            bReduced;   ///< Indicates if the body is simulated at a reduced rate during the current step
+    };
+
+    struct tModifiedBody
+    {
+        btRigidBody*    pRigidBody;
+        unsigned int    index;                      ///< Index of the body
+        unsigned int    scale;                      ///< Scale applied to the body (0 if put to sleep)
+        btVector3       gravity;                    ///< Original gravity of the body
+        btVector3       linearVelocity;             ///< Original linear velocity of the body
+        btVector3       angularVelocity;            ///< Original angular velocity of the body
+        btScalar        linearDamping;              ///< Original linear damping of the body
+        btScalar        angularDamping;             ///< Original angular damping of the body
+        btScalar        linearSleepingThreshold;    ///< Original linear sleeping threshold of the body
+        btScalar        angularSleepingThreshold;   ///< Original angular sleeping threshold of the body
+        int             activationState;            ///< Original activation state of the body
+    };
+
+
+    //_____ Internal methods __________
+private:
+    void prepareSubStep();
+    void restore(bool bSimulated, btScalar timeStep);
+    unsigned int getScale(const btCollisionObject* pObject) const;
+    bool makeConsistent(const btCollisionObject* pObject1, const btCollisionObject* pObject2);
+    bool promote(const btCollisionObject* pObject);
+
+
+    //_____ Attributes __________
+private:
+    World*                              m_pWorld;           ///< The world
+    std::vector<tBand>                  m_bands;            ///< The bands
+    std::vector<Math::Vector3>          m_observers;        ///< Positions of the observers
+    btAlignedObjectArray<btVector3>     m_localObservers;   ///< Positions of the observers, relative to the origin of the world
+    Math::Real                          m_hysteresis;       ///< Margin when entering a farther band
+    Math::Real                          m_distanceScale;    ///< Scale applied to the distances of the bands
+    std::vector<tBodyLod>               m_bodies;           ///< LOD of the bodies, by index
+    std::vector<unsigned int>           m_reducedBodies;    ///< Indices of the bodies simulated at a reduced rate during the current step
+    std::vector<unsigned int>           m_islandPhases;     ///< Phase of the simulation islands (lowest index of their reduced bodies)
+    unsigned int                        m_nbSkippedBodies;  ///< Number of bodies that skipped the last substep
+    btAlignedObjectArray<tModifiedBody> m_modifiedBodies;   ///< The bodies modified for the current substep
+    unsigned int                        m_step;             ///< Substep counter
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,118 @@
+/** @file   TaskScheduler.h
+    @author Philip Abbet
+
+    Declaration of the interface 'Athena::Physics::ITaskScheduler'
+*/
+
+#ifndef _ATHENA_PHYSICS_TASKSCHEDULER_H_
+#define _ATHENA_PHYSICS_TASKSCHEDULER_H_
+
+#include <Athena-Physics/Prerequisites.h>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Interface to implement to let the physical worlds use the worker threads of
+///         the application
+///
+/// Athena-Physics doesn't create any thread by itself. When a task scheduler is
+/// assigned to a world (see World::setTaskScheduler()), the world splits some of its
+/// work (like the large batches of spatial queries) into tasks, and let the scheduler
+/// execute them. Without scheduler, everything is done on the calling thread.
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL ITaskScheduler
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  A task to execute
+    //-----------------------------------------------------------------------------------
+    class ITask
+    {
+        //_____ Construction / Destruction __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Constructor
+        //-------------------------------------------------------------------------------
+        ITask()
+        {
+        }
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Destructor
+        //-------------------------------------------------------------------------------
+        virtual ~ITask()
+        {
+        }
+
+
+        //_____ Methods to implement __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Execute the task (called from any thread)
+        //-------------------------------------------------------------------------------
+        virtual void execute() = 0;
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Identifies a submitted task
+    //-----------------------------------------------------------------------------------
+    typedef unsigned int tTaskHandle;
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    //-----------------------------------------------------------------------------------
+    ITaskScheduler()
+    {
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    virtual ~ITaskScheduler()
+    {
+    }
+
+
+    //_____ Methods to implement __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of threads able to execute the tasks
+    //-----------------------------------------------------------------------------------
+    virtual unsigned int getNbThreads() const = 0;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Submit a task, that must be executed as soon as possible by a worker
+    ///         thread
+    ///
+    /// @param  pTask   The task (must stay valid until its completion)
+    /// @return         The handle of the task
+    //-----------------------------------------------------------------------------------
+    virtual tTaskHandle submit(ITask* pTask) = 0;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Wait for the completion of a submitted task
+    ///
+    /// @param  handle  The handle of the task
+    //-----------------------------------------------------------------------------------
+    virtual void wait(tTaskHandle handle) = 0;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Execute a list of tasks and wait for their completion
+    ///
+    /// The default implementation submits all the tasks but the last one, executes the
+    /// last one on the calling thread and waits for the others. Override it if your
+    /// scheduler provides a better way to do it.
+    //-----------------------------------------------------------------------------------
+    virtual void run(ITask** pTasks, unsigned int nbTasks);
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,188 @@
+/** @file   TriggerIndex.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::TriggerIndex'
+*/
+
+#ifndef _ATHENA_PHYSICS_TRIGGERINDEX_H_
+#define _ATHENA_PHYSICS_TRIGGERINDEX_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/AabbTree.h>
+#include <map>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Index of the static ghost objects (triggers) of a world
+///
+/// Static triggers (see GhostObject::setStatic()) aren't inserted in the broadphase of
+/// the world. Instead, they are stored in a flat bounding volume hierarchy, rebuilt only
+/// when a trigger is added, removed or moved. After each simulation step, the bounding
+/// boxes of the moving bodies (and only those) are tested against it. The cost of the
+/// broadphase doesn't depend on the number of triggers anymore.
+///
+/// The list of overlapping objects of each static trigger is maintained, so
+/// GhostObject::getOverlappingObject() works as usual. Additionally, a listener can be
+/// notified when an object enters or leaves a trigger.
+///
+/// @remark Like with the ghost objects in the broadphase, the overlap tests only use the
+///         bounding boxes of the objects
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL TriggerIndex
+{
+    //_____ Internal types __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Interface to implement to be notified when objects enter or leave the
+    ///         static triggers
+    //-----------------------------------------------------------------------------------
+    class IListener
+    {
+        //_____ Construction / Destruction __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Constructor
+        //-------------------------------------------------------------------------------
+        IListener()
+        {
+        }
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Destructor
+        //-------------------------------------------------------------------------------
+        virtual ~IListener()
+        {
+        }
+
+
+        //_____ Methods to implement __________
+    public:
+        //-------------------------------------------------------------------------------
+        /// @brief  Called when an object starts to overlap with a trigger
+        //-------------------------------------------------------------------------------
+        virtual void onTriggerEnter(GhostObject* pTrigger, CollisionObject* pObject) = 0;
+
+        //-------------------------------------------------------------------------------
+        /// @brief  Called when an object stops to overlap with a trigger
+        //-------------------------------------------------------------------------------
+        virtual void onTriggerExit(GhostObject* pTrigger, CollisionObject* pObject) = 0;
+    };
+
+
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld  The world owning the index
+    //-----------------------------------------------------------------------------------
+    TriggerIndex(World* pWorld);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~TriggerIndex();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add a static trigger to the index
+    //-----------------------------------------------------------------------------------
+    void addTrigger(GhostObject* pTrigger);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove a static trigger from the index
+    //-----------------------------------------------------------------------------------
+    void removeTrigger(GhostObject* pTrigger);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates that a static trigger has been moved
+    //-----------------------------------------------------------------------------------
+    inline void onTriggerMoved(GhostObject* pTrigger)
+    {
+        m_bDirty = true;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates that a collision object was removed from the world
+    ///
+    /// The object leaves all the triggers it was overlapping with
+    //-----------------------------------------------------------------------------------
+    void onObjectRemoved(btCollisionObject* pObject);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move all the triggers by -offset (see World::shiftOrigin())
+    //-----------------------------------------------------------------------------------
+    void shiftOrigin(const btVector3& offset);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Test the moving bodies of the world against the triggers
+    ///
+    /// Called by the world after each simulation step, with the bodies moved by the
+    /// step or by the user since the previous one (the other bodies can't have entered
+    /// or left a trigger)
+    ///
+    /// @param  pBodies     The bodies that moved
+    /// @param  nbBodies    The number of bodies
+    //-----------------------------------------------------------------------------------
+    void update(Body* const* pBodies, unsigned int nbBodies);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of static triggers in the index
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbTriggers() const
+    {
+        return (unsigned int) m_triggers.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Sets the listener notified when objects enter or leave the triggers
+    //-----------------------------------------------------------------------------------
+    inline void setListener(IListener* pListener)
+    {
+        m_pListener = pListener;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the listener notified when objects enter or leave the triggers
+    //-----------------------------------------------------------------------------------
+    inline IListener* getListener() const
+    {
+        return m_pListener;
+    }
+
+
+    //_____ Internal types __________
+private:
+    typedef std::vector<GhostObject*>                               tTriggersList;
+    typedef std::map<btCollisionObject*, tTriggersList>             tOverlapsMap;
+
+
+    //_____ Internal methods __________
+private:
+    void rebuild();
+    void enter(GhostObject* pTrigger, btCollisionObject* pObject);
+    void leave(GhostObject* pTrigger, btCollisionObject* pObject);
+
+
+    //_____ Attributes __________
+private:
+    World*                      m_pWorld;       ///< The world owning the index
+    tTriggersList               m_triggers;     ///< The static triggers
+    AabbTree                    m_tree;         ///< Hierarchy of the bounding boxes of the triggers
+    bool                        m_bDirty;       ///< Indicates that the tree must be rebuilt
+    tOverlapsMap                m_overlaps;     ///< Triggers overlapped by each object (sorted)
+    IListener*                  m_pListener;    ///< The listener
+    std::vector<unsigned int>   m_candidates;   ///< Scratch list used during the updates
+    tTriggersList               m_current;      ///< Scratch list used during the updates
+};
+
+}
+}
+
+#endif
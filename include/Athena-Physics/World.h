@@ -9,7 +9,10 @@
 
 #include <Athena-Physics/Prerequisites.h>
 #include <Athena-Physics/PhysicalComponent.h>
+#include <Athena-Physics/PrimitiveShape.h>
+#include <Athena-Physics/TaskScheduler.h>
 #include <BulletSoftBody/btSoftRigidDynamicsWorld.h>
+#include <map>
 
 namespace Athena {
 namespace Physics {
@@ -24,8 +27,12 @@ namespace Physics {
 //---------------------------------------------------------------------------------------
 class ATHENA_PHYSICS_SYMBOL World: public PhysicalComponent
 {
+    friend class Aggregate;
     friend class Body;
+    friend class BudgetController;
+    friend class CommandBuffer;
     friend class GhostObject;
+    friend class QueryQueue;
 
 
     //_____ Internal types __________
@@ -41,11 +48,144 @@ public:
     };
 
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  The available constraint solvers
+    //-----------------------------------------------------------------------------------
+    enum tSolverType
+    {
+        SOLVER_SEQUENTIAL_IMPULSE,  ///< Sequential impulse solver of Bullet (the default)
+        SOLVER_PARALLEL_ISLANDS,    ///< Sequential impulse solver, the islands being solved in
+                                    ///  parallel by the task scheduler
+        SOLVER_CUSTOM,              ///< Solver provided by the application (see setCustomSolver())
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Predefined settings of the constraint solver
+    //-----------------------------------------------------------------------------------
+    enum tSolverPreset
+    {
+        SOLVER_FAST,        ///< Few iterations, for the worlds where stability matters less than speed
+        SOLVER_BALANCED,    ///< The default settings of Bullet
+        SOLVER_ACCURATE,    ///< More iterations, split impulse and two friction directions
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  The ways to compute the friction of the contacts
+    //-----------------------------------------------------------------------------------
+    enum tFrictionMode
+    {
+        FRICTION_ONE_DIRECTION,             ///< Along the relative velocity only (the default)
+        FRICTION_TWO_DIRECTIONS,            ///< Along two orthogonal directions
+        FRICTION_TWO_DIRECTIONS_CACHED,     ///< Along two orthogonal directions, kept
+                                            ///  between the steps
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Settings of the constraint solver
+    //-----------------------------------------------------------------------------------
+    struct tSolverSettings
+    {
+        unsigned int    nbIterations;           ///< Number of iterations
+        Math::Real      sor;                    ///< Successive over-relaxation factor
+        Math::Real      erp;                    ///< Fraction of the penetrations corrected at
+                                                ///  each step
+        Math::Real      erp2;                   ///< Same, with split impulse
+        bool            bSplitImpulse;          ///< Correct the deep penetrations without
+                                                ///  adding velocity to the bodies
+        Math::Real      splitImpulseThreshold;  ///< Penetration (negative) from which split
+                                                ///  impulse is used
+        bool            bWarmStarting;          ///< Start from the impulses of the previous
+                                                ///  step
+        Math::Real      warmStartingFactor;     ///< Fraction of the previous impulses used
+        bool            bSimd;                  ///< Use the SIMD version of the solver
+        bool            bRandomizeOrder;        ///< Solve the constraints in a random order
+        tFrictionMode   frictionMode;           ///< Computation of the friction
+        bool            bSeparateFriction;      ///< Solve the friction after all the contacts
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Number of iterations of the constraint solver for some kinds of
+    ///         simulation islands
+    ///
+    /// When an island belongs to both kinds, the smallest number of iterations is used.
+    //-----------------------------------------------------------------------------------
+    struct tIslandSolverSettings
+    {
+        unsigned int    smallIslandSize;        ///< Islands with at most that many bodies are
+                                                ///  small (0: disabled)
+        unsigned int    smallIslandIterations;  ///< Number of iterations of the small islands
+        unsigned int    backgroundIterations;   ///< Number of iterations of the islands
+                                                ///  without body in the first band of the
+                                                ///  simulation LOD (0: disabled)
+    };
+
+
     typedef std::vector<btManifoldPoint>                tContactPointsList;
     typedef Utils::VectorIterator<tContactPointsList>   tContactPointsIterator;
     typedef tContactPointsList::iterator                tContactPointsNativeIterator;
 
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  A ray, used by the spatial queries
+    //-----------------------------------------------------------------------------------
+    struct tRay
+    {
+        Math::Vector3   from;       ///< Start point of the ray
+        Math::Vector3   to;         ///< End point of the ray
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Result of a ray cast
+    //-----------------------------------------------------------------------------------
+    struct tRayHit
+    {
+        CollisionObject*    pObject;    ///< The object hit by the ray (0 if none)
+        Math::Vector3       position;   ///< Position of the hit
+        Math::Vector3       normal;     ///< Normal of the surface at the hit position
+        Math::Real          fraction;   ///< Position of the hit along the ray (from 0 to 1)
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Result of a shape sweep
+    //-----------------------------------------------------------------------------------
+    typedef tRayHit tSweepHit;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Position and orientation of a shape, used by the spatial queries
+    //-----------------------------------------------------------------------------------
+    struct tPose
+    {
+        Math::Vector3       position;       ///< Position of the shape
+        Math::Quaternion    orientation;    ///< Orientation of the shape
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Movement of a shape, used by the sweeps
+    //-----------------------------------------------------------------------------------
+    struct tSweep
+    {
+        Math::Vector3       from;           ///< Start position of the shape
+        Math::Vector3       to;             ///< End position of the shape
+        Math::Quaternion    orientation;    ///< Orientation of the shape
+    };
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Description of a primitive shape, used by the spatial queries when no
+    ///         CollisionShape component is available
+    ///
+    /// The meaning of the fields is the same than with the creation methods of
+    /// PrimitiveShape
+    //-----------------------------------------------------------------------------------
+    struct tPrimitive
+    {
+        PrimitiveShape::tShape  shape;      ///< Type of the shape
+        PrimitiveShape::tAxis   axis;       ///< Axis (capsule, cone, cylinder)
+        Math::Vector3           size;       ///< Dimensions (box)
+        Math::Real              radius;     ///< Radius (capsule, cone, cylinder, sphere)
+        Math::Real              height;     ///< Height (capsule, cone, cylinder)
+    };
+
+
     //_____ Construction / Destruction __________
 public:
     //-----------------------------------------------------------------------------------
@@ -113,6 +253,32 @@ public:
     //-----------------------------------------------------------------------------------
     Math::Vector3 getGravity();
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move the origin of the simulation
+    ///
+    /// The simulation is done relatively to an origin, to keep the precision of the
+    /// single-precision floating-point numbers in large worlds: the position of the
+    /// entities is unchanged, but everything inside the Bullet's world (the bodies, the
+    /// ghost objects, the bounding boxes in the broadphase, the contact points) is moved
+    /// by -offset. Usually called when the observer gets too far from the origin.
+    ///
+    /// The positions given to and returned by the methods of the world (like the
+    /// spatial queries) are in the coordinates of the entities. The Bullet's objects
+    /// (like btRigidBody, btManifoldPoint, ...) use the local coordinates: use
+    /// toBulletPosition() and fromBulletPosition() to convert them.
+    ///
+    /// @param  offset  Movement of the origin, in the coordinates of the entities
+    //-----------------------------------------------------------------------------------
+    void shiftOrigin(const Math::Vector3& offset);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the origin of the simulation, in the coordinates of the entities
+    //-----------------------------------------------------------------------------------
+    inline const Math::Vector3& getOrigin() const
+    {
+        return m_origin;
+    }
+
     //-----------------------------------------------------------------------------------
     /// @brief  Proceeds the simulation over 'timeStep' seconds
     ///
@@ -122,11 +288,59 @@ public:
     /// by passing nbMaxSubSteps=0 as second argument to stepSimulation, but in that case
     /// you have to keep the timeStep constant.
     ///
+    /// With a time budget (see getBudgetController()), the maximum number of substeps
+    /// can be lowered to stay inside the budget.
+    ///
     /// @return The number of substeps simulated
     //-----------------------------------------------------------------------------------
     unsigned int stepSimulation(Math::Real timeStep, unsigned int nbMaxSubSteps = 1,
                                 Math::Real fixedTimeStep = Math::Real(1.0 / 60.0));
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Starts to proceed the simulation over 'timeStep' seconds on a worker
+    ///         thread, and returns immediately
+    ///
+    /// The step is done by a task of the task scheduler (or immediately, if there isn't
+    /// any). waitStep() must be called before the next step, and before reading the
+    /// transforms of the entities (which are updated by the step).
+    ///
+    /// While the step is in flight (see isStepInProgress()):
+    ///   - the world and its components (Body, GhostObject, ...) must not be modified,
+    ///     and their state must not be read (except for getters of settings not changed
+    ///     by the simulation, like the mass or the collision shape)
+    ///   - the spatial queries must be done on the last snapshot (see getSnapshot()),
+    ///     not on the world itself
+    ///   - the transforms of the entities having a body must not be read or modified
+    ///
+    /// In debug builds, the methods of the world modifying it or querying it, and the
+    /// ones of Body and GhostObject modifying them, assert that no step is in flight.
+    /// The other rules (reading the state of the components, and the transforms of the
+    /// entities) aren't checked: they are only part of the contract.
+    ///
+    /// @see    stepSimulation()
+    //-----------------------------------------------------------------------------------
+    void stepSimulationAsync(Math::Real timeStep, unsigned int nbMaxSubSteps = 1,
+                             Math::Real fixedTimeStep = Math::Real(1.0 / 60.0));
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Waits for the end of the step started by stepSimulationAsync()
+    ///
+    /// The post-step work (triggers, snapshot, deferred queries) is done here, on the
+    /// calling thread.
+    ///
+    /// @return The number of substeps simulated (0 if no step was in progress)
+    //-----------------------------------------------------------------------------------
+    unsigned int waitStep();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if a step started by stepSimulationAsync() is in progress
+    ///         (waitStep() wasn't called yet)
+    //-----------------------------------------------------------------------------------
+    inline bool isStepInProgress() const
+    {
+        return m_bStepInProgress;
+    }
+
     //-----------------------------------------------------------------------------------
     /// @brief  Returns the Bullet's rigid body simulation world
     //-----------------------------------------------------------------------------------
@@ -155,6 +369,16 @@ public:
         return m_pCollisionManager;
     }
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the index of the static triggers of this world
+    ///
+    /// @see    GhostObject::setStatic()
+    //-----------------------------------------------------------------------------------
+    inline TriggerIndex* getTriggerIndex() const
+    {
+        return m_pTriggerIndex;
+    }
+
     //-----------------------------------------------------------------------------------
     /// @brief  Returns a list of all the contact points between two physical components
     ///
@@ -182,12 +406,609 @@ public:
     bool getContacts(PhysicalComponent* pComponent1, PhysicalComponent* pComponent2,
                      tContactPointsList &contactPoints);
 
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of body slots of the world (including the free ones)
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbBodySlots() const
+    {
+        return (unsigned int) m_bodies.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the body at the given index
+    ///
+    /// @param  index   Index of the body (see Body::getWorldIndex())
+    /// @return         The body, 0 if the slot is free (or its body suspended)
+    //-----------------------------------------------------------------------------------
+    inline Body* getBody(unsigned int index) const
+    {
+        return (index < m_bodies.size() ? m_bodies[index] : 0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove a set of bodies from the simulation, without destroying them
+    ///
+    /// The suspended bodies keep their state (transforms, velocities, activation
+    /// state), and aren't added back to the simulation when modified (see
+    /// Body::isSuspended()). They keep their index (see Body::getWorldIndex()), but
+    /// their slot is empty until they are resumed (see getBody()).
+    ///
+    /// Faster than removing the bodies one by one, since the lists maintained by the
+    /// world are updated once.
+    //-----------------------------------------------------------------------------------
+    void suspendBodies(Body* const* pBodies, unsigned int nbBodies);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Add back a set of suspended bodies to the simulation, in the state they
+    ///         were suspended
+    //-----------------------------------------------------------------------------------
+    void resumeBodies(Body* const* pBodies, unsigned int nbBodies);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the bodies that moved during the last simulation step
+    ///
+    /// The list contains, without duplicates:
+    ///   - the bodies moved by the simulation (the dynamic bodies that are awake)
+    ///   - the bodies moved by the user since the previous step (like the kinematic
+    ///     ones)
+    ///   - the bodies that fell asleep during the step
+    ///
+    /// It is rebuilt at each step, so the consumers (network replication,
+    /// synchronisation of the graphics, ...) don't need to iterate over all the bodies.
+    /// Valid until the next step.
+    ///
+    /// @return The bodies (getNbMovedBodies() of them)
+    //-----------------------------------------------------------------------------------
+    inline Body* const* getMovedBodies() const
+    {
+        return (m_nbMovedBodies > 0 ? &m_movedBodies[0] : 0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of bodies that moved during the last simulation step
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbMovedBodies() const
+    {
+        return m_nbMovedBodies;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Save the dynamic state of all the bodies of the world in a binary blob
+    ///
+    /// The state of each body (transforms, velocities, activation state) is stored at
+    /// a fixed offset depending on its index in the world (see Body::getWorldIndex()),
+    /// so two blobs can be compared cheaply.
+    ///
+    /// @retval buffer  The blob (resized as needed)
+    ///
+    /// @remark The contact manifolds aren't saved
+    //-----------------------------------------------------------------------------------
+    void saveState(std::vector<unsigned char> &buffer) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Restore the dynamic state of the bodies of the world from a blob created
+    ///         by saveState()
+    ///
+    /// Only the bodies still at the same index are restored, the other ones are left
+    /// untouched. The contact manifolds are cleared, so the next step doesn't use the
+    /// (now invalid) cached contacts.
+    ///
+    /// @param  buffer  The blob
+    /// @return         'false' if the blob is invalid
+    //-----------------------------------------------------------------------------------
+    bool restoreState(const std::vector<unsigned char>& buffer);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Enable or disable the deterministic mode
+    ///
+    /// In deterministic mode, the same sequence of steps and modifications produces
+    /// bit-identical results on every run (with the same binary and floating-point
+    /// settings), whatever the addresses of the objects or the order in which they were
+    /// created:
+    ///   - the collision objects are kept in the order of the indices of the bodies,
+    ///     followed by the other objects in the order in which they were added to the
+    ///     world (an object added to the world is inserted at its position, without
+    ///     touching the other ones. When the mode is enabled or a state is restored, all
+    ///     the objects are re-inserted in that order before the next step, which also
+    ///     resets the cached pairs and contacts)
+    ///   - the contact manifolds are sorted by the indices of their bodies before being
+    ///     given to the solver
+    ///   - the random seed of the solver is reset before each step
+    ///
+    /// The steps must use a fixed time step (timeStep equal to fixedTimeStep, or
+    /// nbMaxSubSteps equal to 0).
+    ///
+    /// @see    computeStateHash()
+    //-----------------------------------------------------------------------------------
+    void setDeterministic(bool bDeterministic);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the deterministic mode is enabled
+    //-----------------------------------------------------------------------------------
+    inline bool isDeterministic() const
+    {
+        return m_bDeterministic;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Computes a hash of the dynamic state of all the bodies of the world
+    ///
+    /// Two worlds with the same hash after a step are (very likely) in the same state.
+    /// Used to cheaply detect the divergence of simulations that should be identical.
+    ///
+    /// @remark The hash is computed on the same data than saveState()
+    //-----------------------------------------------------------------------------------
+    unsigned int computeStateHash() const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the buffer of commands applied to the bodies of this world before
+    ///         each simulation step
+    ///
+    /// Unlike the methods of the bodies, the command buffer can be used from any thread,
+    /// and while an asynchronous step is in progress.
+    //-----------------------------------------------------------------------------------
+    inline CommandBuffer* getCommandBuffer() const
+    {
+        return m_pCommandBuffer;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the level of detail of the simulation of this world (by default,
+    ///         all the bodies are simulated at full rate)
+    //-----------------------------------------------------------------------------------
+    inline SimulationLod* getSimulationLod() const
+    {
+        return m_pSimulationLod;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the queue of deferred spatial queries of this world
+    ///
+    /// The pending queries are processed after each simulation step
+    //-----------------------------------------------------------------------------------
+    inline QueryQueue* getQueryQueue() const
+    {
+        return m_pQueryQueue;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the table of the physical materials
+    ///
+    /// @remark The table must not be modified during a step
+    //-----------------------------------------------------------------------------------
+    inline MaterialTable* getMaterialTable() const
+    {
+        return m_pMaterialTable;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the controller keeping the cost of the steps inside a time budget
+    ///
+    /// Without budget (the default), the steps aren't degraded.
+    //-----------------------------------------------------------------------------------
+    inline BudgetController* getBudgetController() const
+    {
+        return m_pBudgetController;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the projectiles of this world (simulated after each step)
+    //-----------------------------------------------------------------------------------
+    inline ProjectileSystem* getProjectileSystem() const
+    {
+        return m_pProjectileSystem;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Enable or disable the publication of snapshots at the end of each
+    ///         simulation step
+    ///
+    /// Disabled by default, since building a snapshot has a cost proportional to the
+    /// number of objects in the world.
+    ///
+    /// @see    getSnapshot()
+    //-----------------------------------------------------------------------------------
+    void enableSnapshots(bool bEnabled = true);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the snapshots are published at the end of each simulation
+    ///         step
+    //-----------------------------------------------------------------------------------
+    inline bool areSnapshotsEnabled() const
+    {
+        return m_bSnapshotsEnabled;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the last snapshot published
+    ///
+    /// The snapshots are double-buffered: the one returned here stays valid (and
+    /// unchanged) at least until the end of the next call to stepSimulation(), so it
+    /// can be queried by other threads while the next step is simulated.
+    ///
+    /// The bodies removed from the world in the meantime are still found by the queries
+    /// of the snapshot: their collision shapes (and their components, if the results of
+    /// the queries are used) must stay alive until the end of the next step.
+    ///
+    /// @return The snapshot, 0 if the snapshots are disabled
+    //-----------------------------------------------------------------------------------
+    inline const WorldSnapshot* getSnapshot() const
+    {
+        return (m_bSnapshotsEnabled ? m_snapshots[m_frontSnapshot] : 0);
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns a snapshot containing only the static objects of the world
+    ///
+    /// The snapshot is rebuilt when a static object was added, removed or moved since
+    /// the last call, so it is cheap to retrieve at each step in a world whose static
+    /// geometry doesn't change much. Unlike the other snapshots, it doesn't need to be
+    /// enabled.
+    ///
+    /// The snapshot isn't modified when a static object is removed: it must be retrieved
+    /// again (and thus rebuilt) before being queried.
+    ///
+    /// @remark Can't be called during an asynchronous step if the static objects were
+    ///         modified since the last call
+    //-----------------------------------------------------------------------------------
+    const WorldSnapshot* getStaticSnapshot();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Enable or disable the specialized collision algorithms of the common
+    ///         pairs of primitive shapes (sphere - box, sphere - capsule and
+    ///         capsule - capsule)
+    ///
+    /// Enabled by default. When disabled, those pairs are handled by the generic
+    /// algorithm of Bullet, which allows to compare both paths. The existing contacts are
+    /// discarded.
+    ///
+    /// @see    CollisionConfiguration
+    //-----------------------------------------------------------------------------------
+    void enableFastCollisionAlgorithms(bool bEnabled = true);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the specialized collision algorithms are enabled
+    //-----------------------------------------------------------------------------------
+    inline bool areFastCollisionAlgorithmsEnabled() const
+    {
+        return m_bFastCollisionAlgorithms;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Sets the task scheduler used to parallelize the work of the world
+    ///
+    /// @param  pScheduler  The task scheduler, 0 to do everything on the calling thread
+    //-----------------------------------------------------------------------------------
+    inline void setTaskScheduler(ITaskScheduler* pScheduler)
+    {
+        m_pTaskScheduler = pScheduler;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the task scheduler used to parallelize the work of the world
+    //-----------------------------------------------------------------------------------
+    inline ITaskScheduler* getTaskScheduler() const
+    {
+        return m_pTaskScheduler;
+    }
+
+
+    //_____ Constraint solver __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Select the constraint solver
+    ///
+    /// Can be changed between two steps. With SOLVER_PARALLEL_ISLANDS, the islands are
+    /// postponed until all of them are known, then distributed between the threads of
+    /// the task scheduler (by decreasing cost). Without task scheduler, it behaves like
+    /// SOLVER_SEQUENTIAL_IMPULSE.
+    ///
+    /// @param  type    The solver
+    /// @return         'false' if SOLVER_PARALLEL_ISLANDS was selected but will fall back
+    ///                 to solving the islands one after the other (see
+    ///                 isParallelSolvingSupported())
+    ///
+    /// @remark Use setCustomSolver() to use SOLVER_CUSTOM
+    /// @remark The profiler of Bullet isn't thread-safe: the islands are only solved in
+    ///         parallel when Bullet is compiled with BT_NO_PROFILE (which is the case of
+    ///         the Bullet bundled with Athena-Physics)
+    //-----------------------------------------------------------------------------------
+    bool setSolverType(tSolverType type);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if SOLVER_PARALLEL_ISLANDS can solve several islands at once
+    ///
+    /// False when Bullet is compiled with its profiler (BT_NO_PROFILE not defined): the
+    /// islands are then solved one after the other, on the simulating thread.
+    //-----------------------------------------------------------------------------------
+    static bool isParallelSolvingSupported();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Use a constraint solver provided by the application
+    ///
+    /// The settings of the solver (see setSolverSettings()) are still given to the
+    /// solver by Bullet, but the iterations of the islands are only handled by the
+    /// solvers of the world.
+    ///
+    /// @param  pSolver     The solver (not owned by the world, must stay valid until
+    ///                     another solver is selected or the world is destroyed)
+    //-----------------------------------------------------------------------------------
+    void setCustomSolver(btConstraintSolver* pSolver);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the type of the constraint solver
+    //-----------------------------------------------------------------------------------
+    inline tSolverType getSolverType() const
+    {
+        return m_solverType;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the constraint solver
+    //-----------------------------------------------------------------------------------
+    inline btConstraintSolver* getConstraintSolver() const
+    {
+        return m_pConstraintSolver;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the settings of the constraint solver
+    //-----------------------------------------------------------------------------------
+    void setSolverSettings(const tSolverSettings& settings);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the settings of the constraint solver
+    //-----------------------------------------------------------------------------------
+    inline const tSolverSettings& getSolverSettings() const
+    {
+        return m_solverSettings;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Use predefined settings for the constraint solver
+    //-----------------------------------------------------------------------------------
+    inline void setSolverPreset(tSolverPreset preset)
+    {
+        setSolverSettings(getSolverPreset(preset));
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the settings of the constraint solver corresponding to a preset
+    //-----------------------------------------------------------------------------------
+    static tSolverSettings getSolverPreset(tSolverPreset preset);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the number of iterations of the constraint solver for some kinds of
+    ///         simulation islands
+    ///
+    /// Allows to spend less time on the islands which don't need as much precision:
+    /// isolated bodies or small piles, and the islands far from the observers (see
+    /// SimulationLod). The number of iterations of the other islands is the one of the
+    /// settings of the solver.
+    ///
+    /// @remark An island can only use less iterations than the other ones
+    //-----------------------------------------------------------------------------------
+    void setIslandSolverSettings(const tIslandSolverSettings& settings);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of iterations of the constraint solver for some kinds
+    ///         of simulation islands
+    //-----------------------------------------------------------------------------------
+    inline const tIslandSolverSettings& getIslandSolverSettings() const
+    {
+        return m_islandSolverSettings;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of iterations of the constraint solver for an island
+    ///
+    /// Used by the solver
+    //-----------------------------------------------------------------------------------
+    unsigned int getIslandIterations(btCollisionObject** pObjects, unsigned int nbObjects) const;
+
+
+    //_____ Spatial queries __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Cast a ray and retrieve the closest object hit
+    ///
+    /// @param  ray     The ray
+    /// @retval hit     The result
+    /// @param  group   Collision group of the ray: only the objects whose group can
+    ///                 collide with it are considered (255: all the objects)
+    /// @return         'true' if an object was hit
+    ///
+    /// @remark The ghost objects are ignored
+    //-----------------------------------------------------------------------------------
+    bool rayCast(const tRay& ray, tRayHit &hit, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Cast several rays and retrieve the closest object hit by each of them
+    ///
+    /// When a task scheduler is set, large batches are split between the worker threads,
+    /// which query a snapshot of the world (the queries of Bullet aren't thread-safe):
+    /// the one published by the last step if the world wasn't modified since then,
+    /// otherwise one built by the first batch following the modification. The world
+    /// must not be modified or simulated during the call.
+    ///
+    /// @param  pRays   The rays
+    /// @param  nbRays  Number of rays
+    /// @retval pHits   The results (one per ray)
+    /// @param  group   Collision group of the rays: only the objects whose group can
+    ///                 collide with it are considered (255: all the objects)
+    /// @return         The number of rays that hit an object
+    ///
+    /// @remark The ghost objects are ignored
+    //-----------------------------------------------------------------------------------
+    unsigned int rayCastBatch(const tRay* pRays, size_t nbRays, tRayHit* pHits,
+                              tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Cast several rays against a snapshot and retrieve the closest object hit
+    ///         by each of them
+    ///
+    /// The Bullet's world isn't touched, so unlike the other overload, this one can be
+    /// used while the world is simulated (as long as the snapshot stays valid, see
+    /// getSnapshot() and getStaticSnapshot()). The batch is split between the worker
+    /// threads of the task scheduler, if any.
+    ///
+    /// @param  pSnapshot   The snapshot
+    /// @param  pRays       The rays
+    /// @param  nbRays      Number of rays
+    /// @retval pHits       The results (one per ray)
+    /// @param  group       Collision group of the rays
+    /// @return             The number of rays that hit an object
+    //-----------------------------------------------------------------------------------
+    unsigned int rayCastBatch(const WorldSnapshot* pSnapshot, const tRay* pRays,
+                              size_t nbRays, tRayHit* pHits, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a convex shape and retrieve the first object hit
+    ///
+    /// @param  pShape  The shape (must be convex, the other shapes never hit anything)
+    /// @param  sweep   Movement of the shape
+    /// @retval hit     The result
+    /// @param  group   Collision group of the shape: only the objects whose group can
+    ///                 collide with it are considered (255: all the objects)
+    /// @return         'true' if an object was hit
+    ///
+    /// @remark The ghost objects are ignored
+    //-----------------------------------------------------------------------------------
+    bool sweep(CollisionShape* pShape, const tSweep& sweep, tSweepHit &hit,
+               tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a primitive shape and retrieve the first object hit
+    ///
+    /// @see    sweep(CollisionShape*, const tSweep&, tSweepHit&, tCollisionGroup)
+    //-----------------------------------------------------------------------------------
+    bool sweep(const tPrimitive& primitive, const tSweep& sweep, tSweepHit &hit,
+               tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a convex shape several times and retrieve the first object hit by
+    ///         each movement
+    ///
+    /// When a task scheduler is set, large batches are split between the worker threads,
+    /// which query a snapshot of the world (the queries of Bullet aren't thread-safe):
+    /// the one published by the last step if the world wasn't modified since then,
+    /// otherwise one built by the first batch following the modification. The world
+    /// must not be modified or simulated during the call.
+    ///
+    /// @param  pShape      The shape (must be convex, the other shapes never hit
+    ///                     anything)
+    /// @param  pSweeps     Movements of the shape
+    /// @param  nbSweeps    Number of movements
+    /// @retval pHits       The results (one per movement)
+    /// @param  group       Collision group of the shape: only the objects whose group
+    ///                     can collide with it are considered (255: all the objects)
+    /// @return             The number of movements that hit an object
+    //-----------------------------------------------------------------------------------
+    unsigned int sweepBatch(CollisionShape* pShape, const tSweep* pSweeps, size_t nbSweeps,
+                            tSweepHit* pHits, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a primitive shape several times and retrieve the first object hit
+    ///         by each movement
+    ///
+    /// @see    sweepBatch(CollisionShape*, const tSweep*, size_t, tSweepHit*, tCollisionGroup)
+    //-----------------------------------------------------------------------------------
+    unsigned int sweepBatch(const tPrimitive& primitive, const tSweep* pSweeps, size_t nbSweeps,
+                            tSweepHit* pHits, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the objects overlapping with a shape
+    ///
+    /// @param  pShape          The shape
+    /// @param  pose            Position and orientation of the shape
+    /// @retval pResults        The overlapping objects
+    /// @param  maxResults      Size of the pResults array
+    /// @param  group           Collision group of the shape: only the objects whose group
+    ///                         can collide with it are considered (255: all the objects)
+    /// @return                 The number of overlapping objects found (at most
+    ///                         maxResults)
+    ///
+    /// @remark The ghost objects are ignored
+    //-----------------------------------------------------------------------------------
+    unsigned int overlap(CollisionShape* pShape, const tPose& pose, CollisionObject** pResults,
+                         unsigned int maxResults, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the objects overlapping with a primitive shape
+    ///
+    /// @see    overlap(CollisionShape*, const tPose&, CollisionObject**, unsigned int, tCollisionGroup)
+    //-----------------------------------------------------------------------------------
+    unsigned int overlap(const tPrimitive& primitive, const tPose& pose, CollisionObject** pResults,
+                         unsigned int maxResults, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the objects overlapping with a shape at several poses
+    ///
+    /// The results of the query 'i' are stored at 'pResults + i * maxResultsPerPose'.
+    ///
+    /// @param  pShape              The shape
+    /// @param  pPoses              Positions and orientations of the shape
+    /// @param  nbPoses             Number of poses
+    /// @retval pResults            The overlapping objects
+    /// @param  maxResultsPerPose   Maximum number of results per pose
+    /// @retval pNbResults          Number of overlapping objects found for each pose
+    /// @param  group               Collision group of the shape: only the objects whose
+    ///                             group can collide with it are considered (255: all
+    ///                             the objects)
+    /// @return                     The number of poses overlapping at least one object
+    ///
+    /// @remark Unlike the other batches, the overlap tests are always done on the
+    ///         calling thread, because they use the collision dispatcher of the world
+    //-----------------------------------------------------------------------------------
+    unsigned int overlapBatch(CollisionShape* pShape, const tPose* pPoses, size_t nbPoses,
+                              CollisionObject** pResults, unsigned int maxResultsPerPose,
+                              unsigned int* pNbResults, tCollisionGroup group = 255);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the objects overlapping with a primitive shape at several poses
+    ///
+    /// @see    overlapBatch(CollisionShape*, const tPose*, size_t, CollisionObject**, unsigned int, unsigned int*, tCollisionGroup)
+    //-----------------------------------------------------------------------------------
+    unsigned int overlapBatch(const tPrimitive& primitive, const tPose* pPoses, size_t nbPoses,
+                              CollisionObject** pResults, unsigned int maxResultsPerPose,
+                              unsigned int* pNbResults, tCollisionGroup group = 255);
+
 protected:
+    class StepTask;
+
+    typedef std::map<const btCollisionObject*, unsigned int> tObjectKeysList;
+
     void createWorld();
+    void applySolverSettings();
+    void setConstraintSolver(btConstraintSolver* pSolver, tSolverType type);
+    bool beginStep();
+    unsigned int simulate(Math::Real timeStep, unsigned int nbMaxSubSteps,
+                          Math::Real fixedTimeStep);
+    void endStep(bool bAsynchronousQueries);
+    void sortCollisionObjects();
+    void insertInOrder(btCollisionObject* pObject);
+    void removeInOrder(btCollisionObject* pObject);
+    void addObjectKey(const btCollisionObject* pObject);
     void addRigidBody(Body* pBody);
     void removeRigidBody(Body* pBody);
+    void detachRigidBody(Body* pBody);
+    void releaseBodyIndex(Body* pBody);
+    void reinsertRigidBody(Body* pBody);
+    void addAggregate(Aggregate* pAggregate);
+    void removeAggregate(Aggregate* pAggregate);
+    void forgetRemovedBodies();
+    void notifyBodyMoved(Body* pBody);
     void addGhostObject(GhostObject* pGhostObject);
     void removeGhostObject(GhostObject* pGhostObject);
+    void runTasks(ITaskScheduler::ITask** pTasks, unsigned int nbTasks);
+    const WorldSnapshot* buildBatchSnapshot();
+    unsigned int castRays(const WorldSnapshot* pSnapshot, const tRay* pRays, size_t nbRays,
+                          tRayHit* pHits, tCollisionGroup group, unsigned int nbTasks);
+    unsigned int sweepBatch(const btConvexShape* pShape, const tSweep* pSweeps, size_t nbSweeps,
+                            tSweepHit* pHits, tCollisionGroup group);
+    unsigned int overlapBatch(btCollisionShape* pShape, const tPose* pPoses, size_t nbPoses,
+                              CollisionObject** pResults, unsigned int maxResultsPerPose,
+                              unsigned int* pNbResults, tCollisionGroup group);
 
 
     //_____ Management of the properties __________
@@ -237,16 +1058,57 @@ public:
     static const std::string TYPE;          ///< Name of the type of component
     static const std::string DEFAULT_NAME;  ///< Default name of the world
 
+    static const unsigned int QUERIES_PER_TASK = 256;   ///< Number of queries of a batch processed by each task
+
 
     //_____ Attributes __________
 protected:
     tType                       m_type;                     ///< Type of world
+    Math::Vector3               m_origin;                   ///< Origin of the simulation
     btDiscreteDynamicsWorld*    m_pWorld;                   ///< The world doing the simulation
     btDispatcher*               m_pDispatcher;
     btBroadphaseInterface*      m_pBroadphase;
     btConstraintSolver*         m_pConstraintSolver;
-    btCollisionConfiguration*   m_pCollisionConfiguration;
+    tSolverType                 m_solverType;               ///< Type of the constraint solver
+    CollisionConfiguration*     m_pCollisionConfiguration;
     CollisionManager*           m_pCollisionManager;
+    TriggerIndex*               m_pTriggerIndex;            ///< Index of the static triggers
+    ITaskScheduler*             m_pTaskScheduler;           ///< Task scheduler (optional)
+    QueryQueue*                 m_pQueryQueue;              ///< Queue of deferred spatial queries
+    CommandBuffer*              m_pCommandBuffer;           ///< Commands applied before each step
+    SimulationLod*              m_pSimulationLod;           ///< Level of detail of the simulation
+    BudgetController*           m_pBudgetController;        ///< Keeps the steps inside a time budget
+    MaterialTable*              m_pMaterialTable;           ///< The physical materials
+    ProjectileSystem*           m_pProjectileSystem;        ///< The projectiles
+    Math::Real                  m_lastStepCost;             ///< Duration of the last simulation (in seconds)
+    unsigned int                m_nbLastSubSteps;           ///< Number of substeps of the last simulation
+    Math::Real                  m_lastSimulatedTime;        ///< Time simulated by the last simulation (in seconds)
+    WorldSnapshot*              m_snapshots[2];             ///< Snapshots (double-buffered)
+    unsigned int                m_frontSnapshot;            ///< Index of the last published snapshot
+    bool                        m_bSnapshotsEnabled;        ///< Indicates if the snapshots are published
+    WorldSnapshot*              m_pBatchSnapshot;           ///< Snapshot used by the parallel batches of queries
+    WorldSnapshot*              m_pStaticSnapshot;          ///< Snapshot of the static objects
+    bool                        m_bStaticSnapshotDirty;     ///< Indicates if the snapshot of the static objects must be rebuilt
+    bool                        m_bBatchSnapshotDirty;      ///< Indicates if the snapshot of the parallel batches must be rebuilt
+    bool                        m_bFrontSnapshotCurrent;    ///< Indicates if the world wasn't modified since the last snapshot was published
+    btCollisionObjectArray      m_removedObjects;           ///< Bodies removed since the last snapshot was published
+    bool                        m_bFastCollisionAlgorithms; ///< Indicates if the specialized collision algorithms are enabled
+    tSolverSettings             m_solverSettings;           ///< Settings of the constraint solver
+    tIslandSolverSettings       m_islandSolverSettings;     ///< Iterations of the solver for some kinds of islands
+    StepTask*                   m_pStepTask;                ///< Task doing the asynchronous steps
+    bool                        m_bStepInProgress;          ///< Indicates if an asynchronous step is in progress
+    std::vector<Body*>          m_bodies;                   ///< The bodies, by index (0: free slot)
+    std::vector<Aggregate*>     m_aggregates;               ///< The aggregates
+    std::vector<unsigned int>   m_freeBodySlots;            ///< Indices of the free slots
+    bool                        m_bDeterministic;           ///< Indicates if the deterministic mode is enabled
+    bool                        m_bMustSortObjects;         ///< Indicates if the objects must be re-inserted in order
+    tObjectKeysList             m_objectKeys;               ///< Order keys of the collision objects that aren't bodies
+    unsigned int                m_nextObjectKey;            ///< Order key of the next collision object that isn't a body
+    std::vector<Body*>          m_movedBodies;              ///< The bodies that moved (the published ones first)
+    unsigned int                m_nbMovedBodies;            ///< Number of published moved bodies
+    unsigned int                m_movedBodiesStamp;         ///< Stamp of the bodies added to the list since the last step
+    std::vector<Body*>          m_awakeBodies;              ///< The dynamic bodies awake at the end of the last step
+    unsigned int                m_stampGeneration;          ///< Generation of the stamps of the cached filter decisions
 };
 
 }
@@ -0,0 +1,170 @@
+/** @file   WorldSnapshot.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::WorldSnapshot'
+*/
+
+#ifndef _ATHENA_PHYSICS_WORLDSNAPSHOT_H_
+#define _ATHENA_PHYSICS_WORLDSNAPSHOT_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/AabbTree.h>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Immutable copy of the state of the collision objects of a world, on which
+///         spatial queries can be performed concurrently with the simulation
+///
+/// The snapshot contains the transforms and bounding boxes of the objects at the time it
+/// was built, organised in a bounding volume hierarchy. The queries never touch the
+/// Bullet's world, so any number of threads can perform them at the same time, even
+/// while the world is simulated.
+///
+/// The collision shapes themselves aren't copied: they must not be modified or destroyed
+/// while a query is running. An object removed from the world stays in the snapshots
+/// published before its removal, until the world doesn't guarantee their validity
+/// anymore (see World::getSnapshot()).
+///
+/// @see    World::enableSnapshots()
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL WorldSnapshot
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    //-----------------------------------------------------------------------------------
+    WorldSnapshot();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    //-----------------------------------------------------------------------------------
+    ~WorldSnapshot();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Build the snapshot from the current state of a Bullet's world
+    ///
+    /// @param  pWorld              The Bullet's world
+    /// @param  pCollisionManager   The collision manager used to filter the objects
+    /// @param  origin              Origin of the Bullet's world (see World::getOrigin())
+    /// @param  bStaticOnly         Indicates if only the static objects must be copied
+    ///
+    /// @remark The ghost objects are ignored
+    //-----------------------------------------------------------------------------------
+    void build(btCollisionWorld* pWorld, CollisionManager* pCollisionManager,
+               const Math::Vector3& origin, bool bStaticOnly = false);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Remove all the objects from the snapshot
+    //-----------------------------------------------------------------------------------
+    void clear();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Called when an object removed from the world must be ignored by the
+    ///         queries
+    ///
+    /// @remark The snapshot must not be queried at the same time
+    //-----------------------------------------------------------------------------------
+    void onObjectRemoved(btCollisionObject* pObject);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of objects in the snapshot
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbObjects() const
+    {
+        return (unsigned int) m_entries.size();
+    }
+
+
+    //_____ Spatial queries __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Cast a ray and retrieve the closest object hit
+    ///
+    /// @see    World::rayCast()
+    //-----------------------------------------------------------------------------------
+    bool rayCast(const World::tRay& ray, World::tRayHit &hit, tCollisionGroup group = 255) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a convex shape and retrieve the first object hit
+    ///
+    /// @see    World::sweep()
+    //-----------------------------------------------------------------------------------
+    bool sweep(CollisionShape* pShape, const World::tSweep& sweep, World::tSweepHit &hit,
+               tCollisionGroup group = 255) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a primitive shape and retrieve the first object hit
+    ///
+    /// @see    World::sweep()
+    //-----------------------------------------------------------------------------------
+    bool sweep(const World::tPrimitive& primitive, const World::tSweep& sweep,
+               World::tSweepHit &hit, tCollisionGroup group = 255) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Move a convex shape of Bullet and retrieve the first object hit
+    ///
+    /// @see    World::sweep()
+    //-----------------------------------------------------------------------------------
+    bool sweep(const btConvexShape* pShape, const World::tSweep& sweep,
+               World::tSweepHit &hit, tCollisionGroup group = 255) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the objects overlapping with a shape
+    ///
+    /// @remark Concave shapes can't be used as the query shape
+    ///
+    /// @see    World::overlap()
+    //-----------------------------------------------------------------------------------
+    unsigned int overlap(CollisionShape* pShape, const World::tPose& pose,
+                         CollisionObject** pResults, unsigned int maxResults,
+                         tCollisionGroup group = 255) const;
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Retrieve the objects overlapping with a primitive shape
+    ///
+    /// @see    World::overlap()
+    //-----------------------------------------------------------------------------------
+    unsigned int overlap(const World::tPrimitive& primitive, const World::tPose& pose,
+                         CollisionObject** pResults, unsigned int maxResults,
+                         tCollisionGroup group = 255) const;
+
+
+    //_____ Internal types __________
+private:
+    struct tEntry
+    {
+        btTransform                 transform;  ///< Transform of the object
+        btCollisionObject*          pObject;    ///< The Bullet's object
+        const btCollisionShape*     pShape;     ///< Its collision shape (0 if removed)
+        CollisionObject*            pComponent; ///< The component
+        tCollisionGroup             group;      ///< Its collision group
+    };
+
+
+    //_____ Internal methods __________
+private:
+    unsigned int overlap(const btCollisionShape* pShape, const World::tPose& pose,
+                         CollisionObject** pResults, unsigned int maxResults,
+                         tCollisionGroup group) const;
+
+
+    //_____ Attributes __________
+private:
+    btAlignedObjectArray<tEntry>    m_entries;              ///< The objects, sorted by address
+    AabbTree                        m_tree;                 ///< Hierarchy of their bounding boxes
+    CollisionManager*               m_pCollisionManager;    ///< Used to filter the objects
+    Math::Vector3                   m_origin;               ///< Origin of the Bullet's world
+};
+
+}
+}
+
+#endif
@@ -0,0 +1,152 @@
+/** @file   WorldStreamer.h
+    @author Philip Abbet
+
+    Declaration of the class 'Athena::Physics::WorldStreamer'
+*/
+
+#ifndef _ATHENA_PHYSICS_WORLDSTREAMER_H_
+#define _ATHENA_PHYSICS_WORLDSTREAMER_H_
+
+#include <Athena-Physics/Prerequisites.h>
+#include <Athena-Math/Vector3.h>
+#include <map>
+#include <vector>
+
+namespace Athena {
+namespace Physics {
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Keeps in the simulation only the bodies close to a set of observers
+///
+/// The bodies registered to the streamer are grouped in the cells of a regular grid
+/// (on the X and Z axes). The cells near an observer are loaded: their bodies are in the
+/// simulation. The other ones are unloaded: their bodies are suspended (see
+/// World::suspendBodies()), and keep their state until the cell is loaded again. The
+/// cells are loaded and unloaded as a whole, through the bulk methods of the world.
+///
+/// The bodies moving from a cell to another one are tracked (using
+/// World::getMovedBodies()). A body entering an unloaded cell is suspended.
+///
+/// The cells are fixed in the coordinates of the entities, so they don't move when the
+/// origin of the world is shifted (see World::shiftOrigin()).
+///
+/// @remark The suspended bodies keep their index in the world (see World::suspendBodies())
+/// @remark A body destroyed while registered is removed from the streamer
+//---------------------------------------------------------------------------------------
+class ATHENA_PHYSICS_SYMBOL WorldStreamer
+{
+    //_____ Construction / Destruction __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Constructor
+    ///
+    /// @param  pWorld      The world
+    /// @param  cellSize    Size of the cells
+    //-----------------------------------------------------------------------------------
+    WorldStreamer(World* pWorld, Math::Real cellSize);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Destructor
+    ///
+    /// The suspended bodies are resumed
+    //-----------------------------------------------------------------------------------
+    ~WorldStreamer();
+
+
+    //_____ Methods __________
+public:
+    //-----------------------------------------------------------------------------------
+    /// @brief  Register a body (in the cell containing its current position)
+    ///
+    /// The body is suspended if its cell isn't loaded
+    //-----------------------------------------------------------------------------------
+    void addBody(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Unregister a body (resumed if it was suspended)
+    //-----------------------------------------------------------------------------------
+    void removeBody(Body* pBody);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the positions of the observers (usually once per step)
+    //-----------------------------------------------------------------------------------
+    void setObservers(const Math::Vector3* pPositions, unsigned int nbObservers);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Set the distances at which the cells are loaded and unloaded
+    ///
+    /// @param  loadRadius      The cells closer than this distance to an observer are
+    ///                         loaded
+    /// @param  unloadMargin    The cells are unloaded when they are farther than
+    ///                         loadRadius + unloadMargin from all the observers (so a
+    ///                         cell isn't loaded and unloaded repeatedly)
+    //-----------------------------------------------------------------------------------
+    void setRadius(Math::Real loadRadius, Math::Real unloadMargin);
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Load and unload the cells (must be called between the simulation steps)
+    //-----------------------------------------------------------------------------------
+    void update();
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of cells containing bodies
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbCells() const
+    {
+        return (unsigned int) m_cells.size();
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Returns the number of loaded cells
+    //-----------------------------------------------------------------------------------
+    inline unsigned int getNbLoadedCells() const
+    {
+        return m_nbLoadedCells;
+    }
+
+    //-----------------------------------------------------------------------------------
+    /// @brief  Indicates if the cell containing a position is loaded
+    //-----------------------------------------------------------------------------------
+    bool isLoaded(const Math::Vector3& position) const;
+
+
+    //_____ Internal types __________
+private:
+    typedef std::pair<int, int> tCellKey;
+
+    struct tCell
+    {
+        std::vector<Body*>  bodies;
+        bool                bLoaded;
+    };
+
+    typedef std::map<tCellKey, tCell>   tCellsList;
+    typedef std::map<Body*, tCellKey>   tBodiesList;
+
+
+    //_____ Internal methods __________
+private:
+    tCellKey getCellKey(const Math::Vector3& position) const;
+    tCellKey getCellKey(Body* pBody) const;
+    Math::Real getDistance2(const tCellKey& key, const Math::Vector3& position) const;
+    tCell& getCell(const tCellKey& key);
+    void moveBody(Body* pBody, const tCellKey& from, const tCellKey& to);
+
+
+    //_____ Attributes __________
+private:
+    World*                          m_pWorld;           ///< The world
+    Math::Real                      m_cellSize;         ///< Size of the cells
+    Math::Real                      m_loadRadius;       ///< Distance at which the cells are loaded
+    Math::Real                      m_unloadMargin;     ///< Additional distance at which they are unloaded
+    std::vector<Math::Vector3>      m_observers;        ///< Positions of the observers
+    tCellsList                      m_cells;            ///< The cells
+    tBodiesList                     m_bodies;           ///< Cell of each body
+    unsigned int                    m_nbLoadedCells;    ///< Number of loaded cells
+};
+
+}
+}
+
+#endif
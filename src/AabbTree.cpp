@@ -0,0 +1,173 @@
+/** @file   AabbTree.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::AabbTree'
+*/
+
+#include <Athena-Physics/AabbTree.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/************************************** FUNCTORS **************************************/
+
+namespace {
+
+    // Orders boxes by the position of their center along an axis
+    struct CenterComparator
+    {
+        CenterComparator(const btVector3* pMins, const btVector3* pMaxs, int axis)
+        : pMins(pMins), pMaxs(pMaxs), axis(axis)
+        {
+        }
+
+        bool operator()(unsigned int a, unsigned int b) const
+        {
+            return (pMins[a][axis] + pMaxs[a][axis]) < (pMins[b][axis] + pMaxs[b][axis]);
+        }
+
+        const btVector3*    pMins;
+        const btVector3*    pMaxs;
+        int                 axis;
+    };
+
+
+    // Appends the boxes found by a query to a list
+    struct ResultsCollector
+    {
+        ResultsCollector(std::vector<unsigned int>& results)
+        : results(results), nbFound(0)
+        {
+        }
+
+        bool operator()(unsigned int box)
+        {
+            results.push_back(box);
+            ++nbFound;
+            return true;
+        }
+
+        std::vector<unsigned int>&  results;
+        unsigned int                nbFound;
+    };
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+AabbTree::AabbTree()
+: m_nbBoxes(0)
+{
+}
+
+//-----------------------------------------------------------------------
+
+AabbTree::~AabbTree()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+void AabbTree::build(const btVector3* pMins, const btVector3* pMaxs, unsigned int nbBoxes)
+{
+    clear();
+
+    if (nbBoxes == 0)
+        return;
+
+    assert(pMins);
+    assert(pMaxs);
+
+    // A binary tree with one box per leaf has exactly 2n-1 nodes
+    m_nodes.reserve(2 * nbBoxes - 1);
+    m_nbBoxes = nbBoxes;
+
+    std::vector<unsigned int> indices(nbBoxes);
+    for (unsigned int i = 0; i < nbBoxes; ++i)
+        indices[i] = i;
+
+    buildSubtree(&indices[0], nbBoxes, pMins, pMaxs);
+}
+
+//-----------------------------------------------------------------------
+
+void AabbTree::clear()
+{
+    m_nodes.clear();
+    m_nbBoxes = 0;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int AabbTree::query(const btVector3& aabbMin, const btVector3& aabbMax,
+                             std::vector<unsigned int> &results) const
+{
+    ResultsCollector collector(results);
+    visit(aabbMin, aabbMax, collector);
+    return collector.nbFound;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int AabbTree::queryRay(const btVector3& from, const btVector3& to,
+                                std::vector<unsigned int> &results) const
+{
+    ResultsCollector collector(results);
+    visitRay(from, to, collector);
+    return collector.nbFound;
+}
+
+//-----------------------------------------------------------------------
+
+void AabbTree::buildSubtree(unsigned int* pIndices, unsigned int nbIndices,
+                            const btVector3* pMins, const btVector3* pMaxs)
+{
+    assert(nbIndices > 0);
+
+    int nodeIndex = m_nodes.size();
+    m_nodes.expand();
+
+    // Compute the bounds of the boxes and of their centers
+    btVector3 aabbMin = pMins[pIndices[0]];
+    btVector3 aabbMax = pMaxs[pIndices[0]];
+    btVector3 centersMin = (aabbMin + aabbMax) * btScalar(0.5);
+    btVector3 centersMax = centersMin;
+
+    for (unsigned int i = 1; i < nbIndices; ++i)
+    {
+        const btVector3& boxMin = pMins[pIndices[i]];
+        const btVector3& boxMax = pMaxs[pIndices[i]];
+        btVector3 center = (boxMin + boxMax) * btScalar(0.5);
+
+        aabbMin.setMin(boxMin);
+        aabbMax.setMax(boxMax);
+        centersMin.setMin(center);
+        centersMax.setMax(center);
+    }
+
+    m_nodes[nodeIndex].aabbMin = aabbMin;
+    m_nodes[nodeIndex].aabbMax = aabbMax;
+
+    if (nbIndices == 1)
+    {
+        m_nodes[nodeIndex].box      = (int) pIndices[0];
+        m_nodes[nodeIndex].escape   = nodeIndex + 1;
+        return;
+    }
+
+    // Split the boxes in two halves along the axis on which their centers are the
+    // most spread
+    unsigned int half = nbIndices / 2;
+    std::nth_element(pIndices, pIndices + half, pIndices + nbIndices,
+                     CenterComparator(pMins, pMaxs, (centersMax - centersMin).maxAxis()));
+
+    buildSubtree(pIndices, half, pMins, pMaxs);
+    buildSubtree(pIndices + half, nbIndices - half, pMins, pMaxs);
+
+    m_nodes[nodeIndex].box      = -1;
+    m_nodes[nodeIndex].escape   = m_nodes.size();
+}
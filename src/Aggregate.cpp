@@ -0,0 +1,354 @@
+/** @file   Aggregate.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::Aggregate'
+*/
+
+#include <Athena-Physics/Aggregate.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/CollisionManager.h>
+#include <BulletCollision/CollisionShapes/btEmptyShape.h>
+#include <BulletCollision/CollisionDispatch/btUnionFind.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Shape whose bounding box encloses the members of an aggregate
+    class MembersShape: public btEmptyShape
+    {
+    public:
+        MembersShape(const std::vector<Body*>* pBodies)
+        : m_pBodies(pBodies)
+        {
+        }
+
+        virtual void getAabb(const btTransform& t, btVector3& aabbMin, btVector3& aabbMax) const
+        {
+            aabbMin = t.getOrigin();
+            aabbMax = t.getOrigin();
+
+            bool bEmpty = true;
+            btVector3 memberMin, memberMax;
+
+            for (unsigned int i = 0; i < m_pBodies->size(); ++i)
+            {
+                // Ignore the members not in the broadphase (suspended, without shape)
+                btRigidBody* pRigidBody = (*m_pBodies)[i]->getRigidBody();
+                if (!pRigidBody->getBroadphaseHandle())
+                    continue;
+
+                pRigidBody->getCollisionShape()->getAabb(pRigidBody->getWorldTransform(),
+                                                         memberMin, memberMax);
+
+                if (bEmpty)
+                {
+                    aabbMin = memberMin;
+                    aabbMax = memberMax;
+                    bEmpty = false;
+                }
+                else
+                {
+                    aabbMin.setMin(memberMin);
+                    aabbMax.setMax(memberMax);
+                }
+            }
+        }
+
+    private:
+        const std::vector<Body*>* m_pBodies;
+    };
+
+
+    // Object representing an aggregate in the broadphase
+    class ProxyObject: public btCollisionObject
+    {
+    public:
+        ProxyObject(Aggregate* pAggregate)
+        : pAggregate(pAggregate)
+        {
+        }
+
+        Aggregate* pAggregate;
+    };
+
+
+    // Identifies a pair (like the pair caches of Bullet, using the identifiers of the
+    // proxies in increasing order)
+    inline std::pair<int, int> getPairKey(const btBroadphaseProxy* pProxy1,
+                                          const btBroadphaseProxy* pProxy2)
+    {
+        if (pProxy1->m_uniqueId <= pProxy2->m_uniqueId)
+            return std::pair<int, int>(pProxy1->m_uniqueId, pProxy2->m_uniqueId);
+
+        return std::pair<int, int>(pProxy2->m_uniqueId, pProxy1->m_uniqueId);
+    }
+
+
+    // Select the pairs not found during a collision detection (all of them if the list
+    // is empty)
+    class StalePairsCallback: public btOverlapCallback
+    {
+    public:
+        StalePairsCallback(const std::vector<std::pair<int, int> >& foundPairs)
+        : m_foundPairs(foundPairs)
+        {
+        }
+
+        virtual bool processOverlap(btBroadphasePair& pair)
+        {
+            return !std::binary_search(m_foundPairs.begin(), m_foundPairs.end(),
+                                       getPairKey(pair.m_pProxy0, pair.m_pProxy1));
+        }
+
+    private:
+        const std::vector<std::pair<int, int> >& m_foundPairs;
+    };
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+Aggregate::Aggregate(World* pWorld)
+: m_pWorld(pWorld), m_pShape(0), m_pProxy(0), m_pPairCache(0)
+{
+    assert(pWorld);
+
+    m_pShape = new MembersShape(&m_bodies);
+    m_pPairCache = new btHashedOverlappingPairCache();
+
+    // Static: the proxy isn't part of the simulation islands (see findUnions())
+    m_pProxy = new ProxyObject(this);
+    m_pProxy->setCollisionShape(m_pShape);
+
+    m_pWorld->addAggregate(this);
+}
+
+//-----------------------------------------------------------------------
+
+Aggregate::~Aggregate()
+{
+    while (!m_bodies.empty())
+        removeBody(m_bodies.back());
+
+    m_pWorld->removeAggregate(this);
+
+    delete m_pProxy;
+    delete m_pPairCache;
+    delete m_pShape;
+}
+
+
+/**************************************** METHODS **************************************/
+
+void Aggregate::addBody(Body* pBody)
+{
+    assert(pBody);
+    assert(!pBody->m_pAggregate);
+
+    m_bodies.push_back(pBody);
+    pBody->m_pAggregate = this;
+
+    // Put the body back in the broadphase, with the filter group of the members
+    m_pWorld->reinsertRigidBody(pBody);
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::removeBody(Body* pBody)
+{
+    assert(pBody);
+
+    std::vector<Body*>::iterator iter = std::find(m_bodies.begin(), m_bodies.end(), pBody);
+    if (iter == m_bodies.end())
+        return;
+
+    m_bodies.erase(iter);
+    pBody->m_pAggregate = 0;
+
+    m_pWorld->reinsertRigidBody(pBody);
+}
+
+
+/********************************* COLLISION DETECTION *********************************/
+
+void Aggregate::beginDispatch()
+{
+    m_foundPairs.clear();
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::endDispatch(btDispatcher* pDispatcher)
+{
+    if (m_pPairCache->getNumOverlappingPairs() == 0)
+        return;
+
+    std::sort(m_foundPairs.begin(), m_foundPairs.end());
+
+    StalePairsCallback callback(m_foundPairs);
+    m_pPairCache->processAllOverlappingPairs(&callback, pDispatcher);
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::removeProxy(btBroadphaseProxy* pProxy, btDispatcher* pDispatcher)
+{
+    assert(pProxy);
+
+    m_pPairCache->removeOverlappingPairsContainingProxy(pProxy, pDispatcher);
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::clearPairs(btDispatcher* pDispatcher)
+{
+    m_foundPairs.clear();
+
+    StalePairsCallback callback(m_foundPairs);
+    m_pPairCache->processAllOverlappingPairs(&callback, pDispatcher);
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::findUnions(btUnionFind& unionFind) const
+{
+    // Like Bullet does with the pairs of the broadphase
+    const int nbPairs = m_pPairCache->getNumOverlappingPairs();
+    const btBroadphasePair* pPairs = m_pPairCache->getOverlappingPairArrayPtr();
+
+    for (int i = 0; i < nbPairs; ++i)
+    {
+        const btCollisionObject* pObject1 = static_cast<const btCollisionObject*>(pPairs[i].m_pProxy0->m_clientObject);
+        const btCollisionObject* pObject2 = static_cast<const btCollisionObject*>(pPairs[i].m_pProxy1->m_clientObject);
+
+        if (pObject1->mergesSimulationIslands() && pObject2->mergesSimulationIslands())
+            unionFind.unite(pObject1->getIslandTag(), pObject2->getIslandTag());
+    }
+}
+
+//-----------------------------------------------------------------------
+
+Aggregate* Aggregate::fromProxy(const btBroadphaseProxy* pProxy)
+{
+    if (!(pProxy->m_collisionFilterGroup & PROXY_FILTER))
+        return 0;
+
+    return static_cast<const ProxyObject*>(pProxy->m_clientObject)->pAggregate;
+}
+
+//-----------------------------------------------------------------------
+
+Aggregate* Aggregate::fromMemberProxy(const btBroadphaseProxy* pProxy)
+{
+    if (!(pProxy->m_collisionFilterGroup & MEMBER_FILTER))
+        return 0;
+
+    const btCollisionObject* pObject = static_cast<const btCollisionObject*>(pProxy->m_clientObject);
+    return static_cast<Body*>(static_cast<CollisionObject*>(pObject->getUserPointer()))->getAggregate();
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::expandPair(btBroadphasePair& collisionPair, btCollisionDispatcher& dispatcher,
+                           const btDispatcherInfo& dispatchInfo)
+{
+    Aggregate* pAggregate1 = fromProxy(collisionPair.m_pProxy0);
+    Aggregate* pAggregate2 = fromProxy(collisionPair.m_pProxy1);
+
+    assert(pAggregate1 || pAggregate2);
+
+    // The pairs of the members are stored by the first aggregate
+    Aggregate* pOwner = (pAggregate1 ? pAggregate1 : pAggregate2);
+
+    std::vector<btBroadphaseProxy*>& proxies1 = pOwner->m_proxies1;
+    std::vector<btBroadphaseProxy*>& proxies2 = pOwner->m_proxies2;
+
+    if (pAggregate1)
+    {
+        pAggregate1->collectProxies(collisionPair.m_pProxy1, proxies1);
+    }
+    else
+    {
+        proxies1.clear();
+        proxies1.push_back(collisionPair.m_pProxy0);
+    }
+
+    if (pAggregate2)
+    {
+        pAggregate2->collectProxies(collisionPair.m_pProxy0, proxies2);
+    }
+    else
+    {
+        proxies2.clear();
+        proxies2.push_back(collisionPair.m_pProxy1);
+    }
+
+    for (unsigned int i = 0; i < proxies1.size(); ++i)
+    {
+        btBroadphaseProxy* pProxy1 = proxies1[i];
+
+        for (unsigned int j = 0; j < proxies2.size(); ++j)
+        {
+            btBroadphaseProxy* pProxy2 = proxies2[j];
+
+            if (TestAabbAgainstAabb2(pProxy1->m_aabbMin, pProxy1->m_aabbMax,
+                                     pProxy2->m_aabbMin, pProxy2->m_aabbMax))
+            {
+                pOwner->processPair(pProxy1, pProxy2, dispatcher, dispatchInfo);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::collectProxies(const btBroadphaseProxy* pOther,
+                               std::vector<btBroadphaseProxy*> &proxies) const
+{
+    proxies.clear();
+
+    for (unsigned int i = 0; i < m_bodies.size(); ++i)
+    {
+        btBroadphaseProxy* pProxy = m_bodies[i]->getRigidBody()->getBroadphaseHandle();
+
+        if (pProxy && TestAabbAgainstAabb2(pProxy->m_aabbMin, pProxy->m_aabbMax,
+                                           pOther->m_aabbMin, pOther->m_aabbMax))
+        {
+            proxies.push_back(pProxy);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void Aggregate::processPair(btBroadphaseProxy* pProxy1, btBroadphaseProxy* pProxy2,
+                            btCollisionDispatcher& dispatcher, const btDispatcherInfo& dispatchInfo)
+{
+    // Apply the filtering that the broadphase would have done
+    const btCollisionObject* pObject1 = static_cast<const btCollisionObject*>(pProxy1->m_clientObject);
+    const btCollisionObject* pObject2 = static_cast<const btCollisionObject*>(pProxy2->m_clientObject);
+
+    tCollisionGroup group1 = static_cast<CollisionObject*>(pObject1->getUserPointer())->getCollisionGroup();
+    tCollisionGroup group2 = static_cast<CollisionObject*>(pObject2->getUserPointer())->getCollisionGroup();
+
+    if (!m_pWorld->getCollisionManager()->isCollisionEnabled(group1, group2))
+        return;
+
+    btBroadphasePair* pPair = m_pPairCache->addOverlappingPair(pProxy1, pProxy2);
+    if (!pPair)
+        return;
+
+    m_foundPairs.push_back(getPairKey(pProxy1, pProxy2));
+
+    // The narrowphase (the collision algorithm is kept in the pair, like for the pairs
+    // of the broadphase)
+    dispatcher.getNearCallback()(*pPair, dispatcher, dispatchInfo);
+}
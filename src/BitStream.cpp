@@ -0,0 +1,147 @@
+/** @file   BitStream.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::BitStream'
+*/
+
+#include <Athena-Physics/BitStream.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/************************************** CONSTANTS **************************************/
+
+// Number of bits of data in each group written by writeVariable() (each group is
+// followed by a bit indicating if another one follows)
+static const unsigned int VARIABLE_GROUP_SIZE = 5;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+BitStream::BitStream()
+: m_nbBits(0), m_readPosition(0), m_bOverflow(false)
+{
+}
+
+//-----------------------------------------------------------------------
+
+BitStream::BitStream(const unsigned char* pData, unsigned int size)
+: m_data(pData, pData + size), m_nbBits(size * 8), m_readPosition(0), m_bOverflow(false)
+{
+    assert(pData || (size == 0));
+}
+
+//-----------------------------------------------------------------------
+
+BitStream::~BitStream()
+{
+}
+
+
+/**************************************** WRITING **************************************/
+
+void BitStream::write(unsigned int value, unsigned int nbBits)
+{
+    assert(nbBits > 0);
+    assert(nbBits <= 32);
+
+    m_data.resize((m_nbBits + nbBits + 7) / 8, 0);
+
+    // Fill the bytes, from the first one partially used
+    while (nbBits > 0)
+    {
+        unsigned int offset = m_nbBits & 7;
+        unsigned int nbWritten = std::min(nbBits, 8 - offset);
+        unsigned int mask = (1 << nbWritten) - 1;
+
+        m_data[m_nbBits >> 3] |= (unsigned char) ((value & mask) << offset);
+
+        value = (nbWritten < 32 ? value >> nbWritten : 0);
+        nbBits -= nbWritten;
+        m_nbBits += nbWritten;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void BitStream::writeVariable(unsigned int value)
+{
+    const unsigned int mask = (1 << VARIABLE_GROUP_SIZE) - 1;
+
+    while (value > mask)
+    {
+        write((value & mask) | (1 << VARIABLE_GROUP_SIZE), VARIABLE_GROUP_SIZE + 1);
+        value >>= VARIABLE_GROUP_SIZE;
+    }
+
+    write(value, VARIABLE_GROUP_SIZE + 1);
+}
+
+//-----------------------------------------------------------------------
+
+void BitStream::clear()
+{
+    m_data.clear();
+    m_nbBits = 0;
+    m_readPosition = 0;
+    m_bOverflow = false;
+}
+
+
+/**************************************** READING **************************************/
+
+unsigned int BitStream::read(unsigned int nbBits)
+{
+    assert(nbBits > 0);
+    assert(nbBits <= 32);
+
+    if (m_readPosition + nbBits > m_nbBits)
+    {
+        m_readPosition = m_nbBits;
+        m_bOverflow = true;
+        return 0;
+    }
+
+    unsigned int value = 0;
+    unsigned int shift = 0;
+
+    while (shift < nbBits)
+    {
+        unsigned int offset = m_readPosition & 7;
+        unsigned int nbRead = std::min(nbBits - shift, 8 - offset);
+        unsigned int mask = (1 << nbRead) - 1;
+
+        value |= ((m_data[m_readPosition >> 3] >> offset) & mask) << shift;
+
+        shift += nbRead;
+        m_readPosition += nbRead;
+    }
+
+    return value;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int BitStream::readVariable()
+{
+    const unsigned int mask = (1 << VARIABLE_GROUP_SIZE) - 1;
+
+    unsigned int value = 0;
+    unsigned int shift = 0;
+
+    while (shift < 32)
+    {
+        unsigned int group = read(VARIABLE_GROUP_SIZE + 1);
+
+        value |= (group & mask) << shift;
+        shift += VARIABLE_GROUP_SIZE;
+
+        if ((group & (1 << VARIABLE_GROUP_SIZE)) == 0)
+            break;
+    }
+
+    return value;
+}
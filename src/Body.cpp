@@ -6,7 +6,12 @@
 
 #include <Athena-Physics/Body.h>
 #include <Athena-Physics/World.h>
+#include <Athena-Physics/Aggregate.h>
+#include <Athena-Physics/BodyPool.h>
+#include <Athena-Physics/WorldStreamer.h>
+#include <Athena-Physics/CommandBuffer.h>
 #include <Athena-Physics/CollisionShape.h>
+#include <Athena-Physics/MaterialTable.h>
 #include <Athena-Physics/Conversions.h>
 #include <Athena-Entities/Transforms.h>
 #include <Athena-Entities/Signals.h>
@@ -32,7 +37,10 @@ const std::string Body::TYPE = "Athena/Physics/Body";
 
 Body::Body(const std::string& strName, ComponentsList* pList)
 : CollisionObject(strName, pList), m_pBody(0), m_mass(0.0f), m_pShape(0),
-  m_bRotationEnabled(true)
+  m_bRotationEnabled(true), m_worldIndex(INVALID_INDEX), m_movedStamp(0),
+  m_bSuspended(false), m_suspensionOrigin(Math::Vector3::ZERO), m_pAggregate(0), m_pPool(0),
+  m_poolArchetype(0), m_bParked(false), m_parkingOffset(0.0f), m_pStreamer(0), m_bCcdEnabled(false),
+  m_ccdMotionThreshold(0.0f), m_ccdSweptSphereRadius(0.0f)
 {
     btRigidBody::btRigidBodyConstructionInfo info(0.0f, this, 0);
     m_pBody = new btRigidBody(info);
@@ -48,6 +56,20 @@ Body::~Body()
 {
     assert(!m_pShape);
 
+    // Discard the pending commands concerning this body
+    World* pWorld = getWorld();
+    if (pWorld)
+        pWorld->getCommandBuffer()->discard(this);
+
+    if (m_pAggregate)
+        m_pAggregate->removeBody(this);
+
+    if (m_pPool)
+        m_pPool->onBodyDestroyed(this);
+
+    if (m_pStreamer)
+        m_pStreamer->removeBody(this);
+
     delete m_pBody;
 }
 
@@ -74,7 +96,7 @@ void Body::getWorldTransform(btTransform& worldTrans) const
     if (pTransforms)
     {
         worldTrans = btTransform(toBullet(pTransforms->getWorldOrientation()),
-                                 toBullet(pTransforms->getWorldPosition()));
+                                 toBulletPosition(pTransforms->getWorldPosition(), getWorldOrigin()));
     }
 }
 
@@ -85,11 +107,14 @@ void Body::setWorldTransform(const btTransform& worldTrans)
     Transforms* pTransforms = getTransforms();
     if (pTransforms)
     {
-        pTransforms->translate(fromBullet(worldTrans.getOrigin()) - pTransforms->getWorldPosition(), Transforms::TS_WORLD);
+        pTransforms->translate(fromBulletPosition(worldTrans.getOrigin(), getWorldOrigin()) - pTransforms->getWorldPosition(), Transforms::TS_WORLD);
 
         if (m_bRotationEnabled)
             pTransforms->rotate(pTransforms->getWorldOrientation().rotationTo(fromBullet(worldTrans.getRotation())), Transforms::TS_WORLD);
     }
+
+    if ((m_worldIndex != INVALID_INDEX) && !m_bSuspended)
+        getWorld()->notifyBodyMoved(this);
 }
 
 
@@ -97,6 +122,7 @@ void Body::setWorldTransform(const btTransform& worldTrans)
 
 void Body::setKinematic(bool bKinematic)
 {
+    assert(!isSimulationInProgress());
     assert(m_pBody);
 
     if (bKinematic == isKinematic())
@@ -121,6 +147,7 @@ void Body::setKinematic(bool bKinematic)
 
 void Body::setMass(Math::Real mass)
 {
+    assert(!isSimulationInProgress());
     assert(m_pBody);
 
     m_mass = mass;
@@ -135,6 +162,8 @@ void Body::setMass(Math::Real mass)
 
 void Body::setCollisionShape(CollisionShape* pShape)
 {
+    assert(!isSimulationInProgress());
+
     if (pShape == m_pShape)
         return;
 
@@ -156,6 +185,38 @@ void Body::setCollisionShape(CollisionShape* pShape)
 
 //-----------------------------------------------------------------------
 
+void Body::enableCcd(bool bEnabled)
+{
+    assert(!isSimulationInProgress());
+
+    m_bCcdEnabled = bEnabled;
+    updateCcd();
+}
+
+//-----------------------------------------------------------------------
+
+void Body::setCcdMotionThreshold(Math::Real threshold)
+{
+    assert(!isSimulationInProgress());
+    assert(threshold >= 0.0f);
+
+    m_ccdMotionThreshold = threshold;
+    updateCcd();
+}
+
+//-----------------------------------------------------------------------
+
+void Body::setCcdSweptSphereRadius(Math::Real radius)
+{
+    assert(!isSimulationInProgress());
+    assert(radius >= 0.0f);
+
+    m_ccdSweptSphereRadius = radius;
+    updateCcd();
+}
+
+//-----------------------------------------------------------------------
+
 void Body::onTransformsChanged()
 {
     PhysicalComponent::onTransformsChanged();
@@ -163,6 +224,21 @@ void Body::onTransformsChanged()
     // If we don't do that, the position of the body isn't changed
     if (isStatic())
         m_pBody->setMotionState(m_pBody->getMotionState());
+
+    if ((m_worldIndex != INVALID_INDEX) && !m_bSuspended)
+        getWorld()->notifyBodyMoved(this);
+}
+
+//-----------------------------------------------------------------------
+
+void Body::onMaterialChanged()
+{
+    // Only the contacts between two bodies using a material other than the default one
+    // get their friction and restitution from the material table
+    if (m_material != MaterialTable::DEFAULT_MATERIAL)
+        m_pBody->setCollisionFlags(m_pBody->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+    else
+        m_pBody->setCollisionFlags(m_pBody->getCollisionFlags() & ~btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
 }
 
 //-----------------------------------------------------------------------
@@ -190,8 +266,53 @@ void Body::updateBody()
         m_pBody->setMassProps(m_mass, inertia);
     }
 
-    if (m_pShape)
+    updateCcd();
+
+    if (m_pShape && !m_bSuspended)
         getWorld()->addRigidBody(this);
+
+    // A suspended body without shape can't be resumed: its index isn't reserved anymore
+    else if (!m_pShape && m_bSuspended)
+        getWorld()->releaseBodyIndex(this);
+}
+
+//-----------------------------------------------------------------------
+
+void Body::updateCcd()
+{
+    assert(m_pBody);
+
+    // A motion threshold of 0 disables the CCD
+    if (!m_bCcdEnabled || !m_pShape)
+    {
+        m_pBody->setCcdMotionThreshold(0.0f);
+        m_pBody->setCcdSweptSphereRadius(0.0f);
+        return;
+    }
+
+    Math::Real threshold = m_ccdMotionThreshold;
+    Math::Real radius = m_ccdSweptSphereRadius;
+
+    // Use the smallest dimension of the shape: a body can't go through an object when
+    // moving less than half its thickness during a step, and a sphere of that size is
+    // (nearly) contained in the shape
+    if ((threshold <= 0.0f) || (radius <= 0.0f))
+    {
+        btVector3 aabbMin, aabbMax;
+        m_pShape->getCollisionShape()->getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+
+        btVector3 halfExtents = (aabbMax - aabbMin) * btScalar(0.5);
+        Math::Real halfThickness = halfExtents[halfExtents.minAxis()];
+
+        if (threshold <= 0.0f)
+            threshold = halfThickness;
+
+        if (radius <= 0.0f)
+            radius = halfThickness * Math::Real(0.8);
+    }
+
+    m_pBody->setCcdMotionThreshold(threshold);
+    m_pBody->setCcdSweptSphereRadius(radius);
 }
 
 
@@ -242,6 +363,11 @@ Utils::PropertiesList* Body::getProperties() const
     if (m_pShape)
         pProperties->set("shape", new Variant(m_pShape->getID().toString()));
 
+    // Continuous collision detection
+    pProperties->set("ccd", new Variant(m_bCcdEnabled));
+    pProperties->set("ccd-motion-threshold", new Variant(m_ccdMotionThreshold));
+    pProperties->set("ccd-swept-sphere-radius", new Variant(m_ccdSweptSphereRadius));
+
     // Returns the list
     return pProperties;
 }
@@ -303,6 +429,22 @@ bool Body::setProperty(const std::string& strName, Utils::Variant* pValue)
         }
     }
 
+    // Continuous collision detection
+    else if (strName == "ccd")
+    {
+        enableCcd(pValue->toBool());
+    }
+
+    else if (strName == "ccd-motion-threshold")
+    {
+        setCcdMotionThreshold(pValue->toFloat());
+    }
+
+    else if (strName == "ccd-swept-sphere-radius")
+    {
+        setCcdSweptSphereRadius(pValue->toFloat());
+    }
+
     // Destroy the value
     delete pValue;
 
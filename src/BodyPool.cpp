@@ -0,0 +1,234 @@
+/** @file   BodyPool.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::BodyPool'
+*/
+
+#include <Athena-Physics/BodyPool.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Conversions.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Space left between two parking spots
+    const Real PARKING_MARGIN = 1.0f;
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+BodyPool::BodyPool(World* pWorld)
+: m_pWorld(pWorld), m_parkingPosition(0.0f, -100000.0f, 0.0f), m_parkingLength(0.0f)
+{
+    assert(pWorld);
+}
+
+//-----------------------------------------------------------------------
+
+BodyPool::~BodyPool()
+{
+    for (unsigned int i = 0; i < m_archetypes.size(); ++i)
+    {
+        tArchetype& archetype = m_archetypes[i];
+
+        for (unsigned int j = 0; j < archetype.bodies.size(); ++j)
+        {
+            archetype.bodies[j]->m_pPool    = 0;
+            archetype.bodies[j]->m_bParked  = false;
+        }
+
+        for (unsigned int j = 0; j < archetype.parked.size(); ++j)
+            archetype.pFactory->destroyBody(archetype.parked[j]);
+    }
+}
+
+
+/**************************************** METHODS **************************************/
+
+unsigned int BodyPool::addArchetype(IFactory* pFactory, unsigned int nbBodies)
+{
+    assert(pFactory);
+
+    tArchetype archetype;
+    archetype.pFactory = pFactory;
+
+    m_archetypes.push_back(archetype);
+
+    unsigned int id = (unsigned int) m_archetypes.size() - 1;
+
+    reserve(id, nbBodies);
+
+    return id;
+}
+
+//-----------------------------------------------------------------------
+
+void BodyPool::reserve(unsigned int archetype, unsigned int nbBodies)
+{
+    assert(archetype < m_archetypes.size());
+
+    tArchetype& entry = m_archetypes[archetype];
+
+    if (entry.parked.size() >= nbBodies)
+        return;
+
+    unsigned int nbNewBodies = nbBodies - (unsigned int) entry.parked.size();
+
+    entry.bodies.reserve(entry.bodies.size() + nbNewBodies);
+
+    for (unsigned int i = 0; i < nbNewBodies; ++i)
+        park(create(archetype));
+}
+
+//-----------------------------------------------------------------------
+
+Body* BodyPool::acquire(unsigned int archetype, const Vector3& position,
+                        const Quaternion& orientation, const Vector3& linearVelocity,
+                        const Vector3& angularVelocity)
+{
+    assert(archetype < m_archetypes.size());
+    assert(!m_pWorld->isSimulationInProgress());
+
+    tArchetype& entry = m_archetypes[archetype];
+
+    // Only allocate when no body is available
+    if (entry.parked.empty())
+        return initialize(create(archetype), position, orientation, linearVelocity, angularVelocity);
+
+    Body* pBody = entry.parked.back();
+    entry.parked.pop_back();
+
+    pBody->m_bParked = false;
+
+    btRigidBody* pRigidBody = pBody->getRigidBody();
+    pRigidBody->getBroadphaseHandle()->m_collisionFilterGroup &= ~PARKED_FILTER;
+    pRigidBody->setDeactivationTime(0.0f);
+    pRigidBody->forceActivationState(pBody->isKinematic() ? DISABLE_DEACTIVATION : ACTIVE_TAG);
+
+    return initialize(pBody, position, orientation, linearVelocity, angularVelocity);
+}
+
+//-----------------------------------------------------------------------
+
+void BodyPool::release(Body* pBody)
+{
+    assert(pBody);
+    assert(pBody->m_pPool == this);
+    assert(!pBody->m_bParked);
+    assert(!m_pWorld->isSimulationInProgress());
+
+    park(pBody);
+}
+
+//-----------------------------------------------------------------------
+
+void BodyPool::onBodyDestroyed(Body* pBody)
+{
+    assert(pBody);
+    assert(pBody->m_pPool == this);
+
+    tArchetype& entry = m_archetypes[pBody->m_poolArchetype];
+
+    std::vector<Body*>::iterator iter = std::find(entry.bodies.begin(), entry.bodies.end(), pBody);
+    if (iter != entry.bodies.end())
+        entry.bodies.erase(iter);
+
+    iter = std::find(entry.parked.begin(), entry.parked.end(), pBody);
+    if (iter != entry.parked.end())
+        entry.parked.erase(iter);
+
+    pBody->m_pPool = 0;
+}
+
+//-----------------------------------------------------------------------
+
+Body* BodyPool::create(unsigned int archetype)
+{
+    tArchetype& entry = m_archetypes[archetype];
+
+    Body* pBody = entry.pFactory->createBody();
+    assert(pBody);
+    assert(pBody->getWorld() == m_pWorld);
+    assert(pBody->getCollisionShape());
+    assert(!pBody->getAggregate());
+    assert(!pBody->getPool());
+
+    pBody->m_pPool          = this;
+    pBody->m_poolArchetype  = archetype;
+
+    // Reserve a parking spot large enough for the body, at the end of the row (the
+    // spots of the destroyed bodies aren't reused)
+    btVector3 center;
+    btScalar radius;
+    pBody->getRigidBody()->getCollisionShape()->getBoundingSphere(center, radius);
+
+    Real extent = Real(radius + center.length());
+
+    pBody->m_parkingOffset = m_parkingLength + extent;
+    m_parkingLength += extent * 2.0f + PARKING_MARGIN;
+
+    entry.bodies.push_back(pBody);
+
+    // All the bodies can be parked without allocation
+    if (entry.parked.capacity() < entry.bodies.capacity())
+        entry.parked.reserve(entry.bodies.capacity());
+
+    return pBody;
+}
+
+//-----------------------------------------------------------------------
+
+Body* BodyPool::initialize(Body* pBody, const Vector3& position, const Quaternion& orientation,
+                           const Vector3& linearVelocity, const Vector3& angularVelocity)
+{
+    btRigidBody* pRigidBody = pBody->getRigidBody();
+
+    btTransform transform(toBullet(orientation), toBulletPosition(position, m_pWorld->getOrigin()));
+
+    pRigidBody->setWorldTransform(transform);
+    pRigidBody->setInterpolationWorldTransform(transform);
+    pRigidBody->setLinearVelocity(toBullet(linearVelocity));
+    pRigidBody->setAngularVelocity(toBullet(angularVelocity));
+    pRigidBody->setInterpolationLinearVelocity(toBullet(linearVelocity));
+    pRigidBody->setInterpolationAngularVelocity(toBullet(angularVelocity));
+    pRigidBody->clearForces();
+
+    // Move the entity too (the static and kinematic bodies follow it)
+    pBody->setWorldTransform(transform);
+
+    if (pRigidBody->getBroadphaseHandle())
+        m_pWorld->getRigidBodyWorld()->updateSingleAabb(pRigidBody);
+
+    return pBody;
+}
+
+//-----------------------------------------------------------------------
+
+void BodyPool::park(Body* pBody)
+{
+    btRigidBody* pRigidBody = pBody->getRigidBody();
+    assert(pRigidBody->getBroadphaseHandle());
+
+    // Out of the simulation, and far from everything (on its own spot, so it doesn't
+    // overlap with the other parked bodies): its current pairs are removed by the
+    // broadphase, and the new ones are refused by the collision manager
+    pRigidBody->forceActivationState(DISABLE_SIMULATION);
+    pRigidBody->getBroadphaseHandle()->m_collisionFilterGroup |= PARKED_FILTER;
+
+    initialize(pBody, m_parkingPosition + Vector3(pBody->m_parkingOffset, 0.0f, 0.0f),
+               Quaternion::IDENTITY, Vector3::ZERO, Vector3::ZERO);
+
+    pBody->m_bParked = true;
+
+    m_archetypes[pBody->m_poolArchetype].parked.push_back(pBody);
+}
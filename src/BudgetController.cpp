@@ -0,0 +1,169 @@
+/** @file   BudgetController.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::BudgetController'
+*/
+
+#include <Athena-Physics/BudgetController.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/SimulationLod.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+/************************************** CONSTANTS **************************************/
+
+const Real BudgetController::RECOVER_THRESHOLD  = Real(0.6);
+const Real BudgetController::SMOOTHING          = Real(0.2);
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Scale applied to the number of iterations and to the distances of the LOD bands,
+    // by level of degradation
+    const Real LEVEL_SCALES[BudgetController::MAX_LEVEL + 1] = { Real(1.0), Real(0.75), Real(0.5), Real(0.25) };
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+BudgetController::BudgetController(World* pWorld)
+: m_pWorld(pWorld), m_budget(0.0f), m_level(0), m_appliedLevel(0), m_bLimitedSubSteps(false),
+  m_nbDegradedSteps(0), m_lastCost(0.0f), m_averageCost(0.0f), m_subStepCost(0.0f),
+  m_nbStepsOver(0), m_nbStepsUnder(0)
+{
+    assert(pWorld);
+}
+
+//-----------------------------------------------------------------------
+
+BudgetController::~BudgetController()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+void BudgetController::setBudget(Real budget)
+{
+    assert(budget >= 0.0f);
+
+    m_budget = budget;
+
+    // Start over from the full quality
+    m_level             = 0;
+    m_bLimitedSubSteps  = false;
+    m_nbDegradedSteps   = 0;
+    m_averageCost       = 0.0f;
+    m_subStepCost       = 0.0f;
+    m_nbStepsOver       = 0;
+    m_nbStepsUnder      = 0;
+
+    apply();
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int BudgetController::getIterations(unsigned int nbIterations) const
+{
+    if (m_level == 0)
+        return nbIterations;
+
+    return std::max((unsigned int) (Real(nbIterations) * LEVEL_SCALES[m_level] + Real(0.5)), 1u);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int BudgetController::beforeStep(unsigned int nbMaxSubSteps)
+{
+    if (m_level != m_appliedLevel)
+        apply();
+
+    m_bLimitedSubSteps = false;
+
+    // No substep (variable time step), or nothing known yet
+    if ((m_budget <= 0.0f) || (nbMaxSubSteps <= 1) || (m_subStepCost <= 0.0f))
+        return nbMaxSubSteps;
+
+    unsigned int nbAllowed = std::max((unsigned int) (m_budget / m_subStepCost), 1u);
+    if (nbAllowed >= nbMaxSubSteps)
+        return nbMaxSubSteps;
+
+    m_bLimitedSubSteps = true;
+
+    return nbAllowed;
+}
+
+//-----------------------------------------------------------------------
+
+void BudgetController::afterStep(Real cost, unsigned int nbSubSteps)
+{
+    m_lastCost = cost;
+
+    if (m_budget <= 0.0f)
+        return;
+
+    if (isDegraded())
+        ++m_nbDegradedSteps;
+
+    // Update the averages (the first step initializes them)
+    if (m_averageCost <= 0.0f)
+        m_averageCost = cost;
+    else
+        m_averageCost += (cost - m_averageCost) * SMOOTHING;
+
+    if (nbSubSteps > 0)
+    {
+        Real subStepCost = cost / Real(nbSubSteps);
+
+        if (m_subStepCost <= 0.0f)
+            m_subStepCost = subStepCost;
+        else
+            m_subStepCost += (subStepCost - m_subStepCost) * SMOOTHING;
+    }
+
+    // Change the level of degradation if needed
+    if (m_averageCost > m_budget)
+    {
+        m_nbStepsUnder = 0;
+
+        if ((++m_nbStepsOver >= DEGRADE_DELAY) && (m_level < MAX_LEVEL))
+        {
+            ++m_level;
+            m_nbStepsOver = 0;
+        }
+    }
+    else if (m_averageCost < m_budget * RECOVER_THRESHOLD)
+    {
+        m_nbStepsOver = 0;
+
+        if ((++m_nbStepsUnder >= RECOVER_DELAY) && (m_level > 0))
+        {
+            --m_level;
+            m_nbStepsUnder = 0;
+        }
+    }
+    else
+    {
+        m_nbStepsOver = 0;
+        m_nbStepsUnder = 0;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void BudgetController::apply()
+{
+    m_appliedLevel = m_level;
+
+    m_pWorld->getSimulationLod()->setDistanceScale(LEVEL_SCALES[m_level]);
+
+    if (m_pWorld->m_pWorld)
+        m_pWorld->applySolverSettings();
+}
@@ -0,0 +1,379 @@
+/** @file   CollisionConfiguration.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::CollisionConfiguration'
+*/
+
+#include <Athena-Physics/CollisionConfiguration.h>
+#include <BulletCollision/CollisionDispatch/btActivatingCollisionAlgorithm.h>
+#include <BulletCollision/CollisionDispatch/btManifoldResult.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Function computing the contacts between two objects (in the order expected by the
+    // algorithm)
+    typedef void (*tCollideFunction)(btCollisionObject* pObjectA, btCollisionObject* pObjectB,
+                                     btManifoldResult* resultOut);
+
+
+    // Report the contact between two spheres (normal on B, pointing towards A)
+    inline void addSpheresContact(btManifoldResult* resultOut, const btVector3& centerA,
+                                  btScalar radiusA, const btVector3& centerB, btScalar radiusB)
+    {
+        btVector3 diff = centerA - centerB;
+        btScalar length = diff.length();
+        btScalar distance = length - (radiusA + radiusB);
+
+        if (distance > resultOut->getPersistentManifold()->getContactBreakingThreshold())
+            return;
+
+        btVector3 normal(btScalar(1.0), btScalar(0.0), btScalar(0.0));
+        if (length > SIMD_EPSILON)
+            normal = diff / length;
+
+        resultOut->addContactPoint(normal, centerB + normal * radiusB, distance);
+    }
+
+
+    // Retrieve the segment of a capsule
+    inline void getCapsuleSegment(btCollisionObject* pObject, btVector3 &start, btVector3 &end,
+                                  btScalar &radius)
+    {
+        const btCapsuleShape* pCapsule = static_cast<const btCapsuleShape*>(pObject->getCollisionShape());
+        const btTransform& transform = pObject->getWorldTransform();
+
+        btVector3 axis = transform.getBasis().getColumn(pCapsule->getUpAxis()) * pCapsule->getHalfHeight();
+
+        start   = transform.getOrigin() - axis;
+        end     = transform.getOrigin() + axis;
+        radius  = pCapsule->getRadius();
+    }
+
+
+    // Closest point of a segment to a point
+    inline btVector3 closestPointOnSegment(const btVector3& start, const btVector3& end,
+                                           const btVector3& point)
+    {
+        btVector3 direction = end - start;
+        btScalar length2 = direction.length2();
+
+        if (length2 <= SIMD_EPSILON)
+            return start;
+
+        btScalar t = btMax(btScalar(0.0), btMin(btScalar(1.0), (point - start).dot(direction) / length2));
+        return start + direction * t;
+    }
+
+
+    // Sphere (A) - box (B)
+    void collideSphereBox(btCollisionObject* pObjectA, btCollisionObject* pObjectB,
+                          btManifoldResult* resultOut)
+    {
+        const btSphereShape* pSphere = static_cast<const btSphereShape*>(pObjectA->getCollisionShape());
+        const btBoxShape* pBox = static_cast<const btBoxShape*>(pObjectB->getCollisionShape());
+
+        const btTransform& boxTransform = pObjectB->getWorldTransform();
+        btVector3 halfExtents = pBox->getHalfExtentsWithMargin();
+        btScalar radius = pSphere->getRadius();
+
+        // Center of the sphere in the space of the box
+        btVector3 center = boxTransform.invXform(pObjectA->getWorldTransform().getOrigin());
+
+        btVector3 closest = center;
+        closest.setMax(-halfExtents);
+        closest.setMin(halfExtents);
+
+        btVector3 diff = center - closest;
+        btScalar length2 = diff.length2();
+
+        btVector3 normal;
+        btScalar distance;
+
+        if (length2 > SIMD_EPSILON * SIMD_EPSILON)
+        {
+            // Center outside of the box
+            btScalar length = btSqrt(length2);
+
+            distance = length - radius;
+            if (distance > resultOut->getPersistentManifold()->getContactBreakingThreshold())
+                return;
+
+            normal = diff / length;
+        }
+        else
+        {
+            // Center inside of the box: push it out through the closest face
+            int axis = 0;
+            btScalar faceDistance = halfExtents[0] - btFabs(center[0]);
+
+            for (int i = 1; i < 3; ++i)
+            {
+                btScalar d = halfExtents[i] - btFabs(center[i]);
+                if (d < faceDistance)
+                {
+                    faceDistance = d;
+                    axis = i;
+                }
+            }
+
+            btScalar sign = (center[axis] < btScalar(0.0) ? btScalar(-1.0) : btScalar(1.0));
+
+            normal.setValue(btScalar(0.0), btScalar(0.0), btScalar(0.0));
+            normal[axis] = sign;
+
+            closest[axis] = sign * halfExtents[axis];
+            distance = -(faceDistance + radius);
+        }
+
+        resultOut->addContactPoint(boxTransform.getBasis() * normal, boxTransform(closest), distance);
+    }
+
+
+    // Sphere (A) - capsule (B)
+    void collideSphereCapsule(btCollisionObject* pObjectA, btCollisionObject* pObjectB,
+                              btManifoldResult* resultOut)
+    {
+        const btSphereShape* pSphere = static_cast<const btSphereShape*>(pObjectA->getCollisionShape());
+
+        btVector3 start, end;
+        btScalar radius;
+        getCapsuleSegment(pObjectB, start, end, radius);
+
+        const btVector3& center = pObjectA->getWorldTransform().getOrigin();
+
+        addSpheresContact(resultOut, center, pSphere->getRadius(),
+                          closestPointOnSegment(start, end, center), radius);
+    }
+
+
+    // Capsule (A) - capsule (B)
+    void collideCapsuleCapsule(btCollisionObject* pObjectA, btCollisionObject* pObjectB,
+                               btManifoldResult* resultOut)
+    {
+        btVector3 startA, endA, startB, endB;
+        btScalar radiusA, radiusB;
+
+        getCapsuleSegment(pObjectA, startA, endA, radiusA);
+        getCapsuleSegment(pObjectB, startB, endB, radiusB);
+
+        // Closest points between the segments (from "Real-Time Collision Detection",
+        // Christer Ericson)
+        btVector3 directionA = endA - startA;
+        btVector3 directionB = endB - startB;
+        btVector3 r = startA - startB;
+
+        btScalar a = directionA.length2();
+        btScalar e = directionB.length2();
+        btScalar f = directionB.dot(r);
+
+        btScalar s = btScalar(0.0);
+        btScalar t = btScalar(0.0);
+
+        if ((a <= SIMD_EPSILON) && (e <= SIMD_EPSILON))
+        {
+            // Both capsules are spheres
+        }
+        else if (a <= SIMD_EPSILON)
+        {
+            t = btMax(btScalar(0.0), btMin(btScalar(1.0), f / e));
+        }
+        else
+        {
+            btScalar c = directionA.dot(r);
+
+            if (e <= SIMD_EPSILON)
+            {
+                s = btMax(btScalar(0.0), btMin(btScalar(1.0), -c / a));
+            }
+            else
+            {
+                btScalar b = directionA.dot(directionB);
+                btScalar denom = a * e - b * b;
+
+                if (denom <= SIMD_EPSILON * a * e)
+                {
+                    // Parallel segments: one contact at each end of their overlap (if
+                    // any), so the capsules lie stable at once
+                    btScalar s0 = -c / a;
+                    btScalar s1 = (endB - startA).dot(directionA) / a;
+
+                    btScalar minS = btMax(btScalar(0.0), btMin(s0, s1));
+                    btScalar maxS = btMin(btScalar(1.0), btMax(s0, s1));
+
+                    if (minS < maxS)
+                    {
+                        btVector3 pointA = startA + directionA * minS;
+                        addSpheresContact(resultOut, pointA, radiusA,
+                                          closestPointOnSegment(startB, endB, pointA), radiusB);
+
+                        pointA = startA + directionA * maxS;
+                        addSpheresContact(resultOut, pointA, radiusA,
+                                          closestPointOnSegment(startB, endB, pointA), radiusB);
+                        return;
+                    }
+                }
+                else
+                {
+                    s = btMax(btScalar(0.0), btMin(btScalar(1.0), (b * f - c * e) / denom));
+                }
+
+                t = (b * s + f) / e;
+
+                if (t < btScalar(0.0))
+                {
+                    t = btScalar(0.0);
+                    s = btMax(btScalar(0.0), btMin(btScalar(1.0), -c / a));
+                }
+                else if (t > btScalar(1.0))
+                {
+                    t = btScalar(1.0);
+                    s = btMax(btScalar(0.0), btMin(btScalar(1.0), (b - c) / a));
+                }
+            }
+        }
+
+        addSpheresContact(resultOut, startA + directionA * s, radiusA,
+                          startB + directionB * t, radiusB);
+    }
+
+
+    // Collision algorithm using one of the functions above
+    class PrimitiveAlgorithm: public btActivatingCollisionAlgorithm
+    {
+    public:
+        PrimitiveAlgorithm(const btCollisionAlgorithmConstructionInfo& ci,
+                           btCollisionObject* pObject0, btCollisionObject* pObject1,
+                           tCollideFunction function, bool bSwapped)
+        : btActivatingCollisionAlgorithm(ci, pObject0, pObject1), m_pManifold(0),
+          m_function(function), m_bSwapped(bSwapped)
+        {
+            // The manifold uses the order of the function
+            if (m_bSwapped)
+                m_pManifold = m_dispatcher->getNewManifold(pObject1, pObject0);
+            else
+                m_pManifold = m_dispatcher->getNewManifold(pObject0, pObject1);
+        }
+
+        virtual ~PrimitiveAlgorithm()
+        {
+            if (m_pManifold)
+                m_dispatcher->releaseManifold(m_pManifold);
+        }
+
+        virtual void processCollision(btCollisionObject* pObject0, btCollisionObject* pObject1,
+                                      const btDispatcherInfo& dispatchInfo,
+                                      btManifoldResult* resultOut)
+        {
+            if (!m_pManifold)
+                return;
+
+            resultOut->setPersistentManifold(m_pManifold);
+
+            if (m_bSwapped)
+                m_function(pObject1, pObject0, resultOut);
+            else
+                m_function(pObject0, pObject1, resultOut);
+
+            resultOut->refreshContactPoints();
+        }
+
+        virtual btScalar calculateTimeOfImpact(btCollisionObject* pObject0, btCollisionObject* pObject1,
+                                               const btDispatcherInfo& dispatchInfo,
+                                               btManifoldResult* resultOut)
+        {
+            return btScalar(1.0);
+        }
+
+        virtual void getAllContactManifolds(btManifoldArray& manifoldArray)
+        {
+            if (m_pManifold)
+                manifoldArray.push_back(m_pManifold);
+        }
+
+    private:
+        btPersistentManifold*   m_pManifold;
+        tCollideFunction        m_function;
+        bool                    m_bSwapped;
+    };
+
+
+    // Creation function of the algorithms
+    class PrimitiveCreateFunc: public btCollisionAlgorithmCreateFunc
+    {
+    public:
+        PrimitiveCreateFunc(tCollideFunction function, bool bSwapped)
+        : m_function(function)
+        {
+            m_swapped = bSwapped;
+        }
+
+        virtual btCollisionAlgorithm* CreateCollisionAlgorithm(btCollisionAlgorithmConstructionInfo& ci,
+                                                               btCollisionObject* pObject0,
+                                                               btCollisionObject* pObject1)
+        {
+            void* pMemory = ci.m_dispatcher1->allocateCollisionAlgorithm(sizeof(PrimitiveAlgorithm));
+            return new(pMemory) PrimitiveAlgorithm(ci, pObject0, pObject1, m_function, m_swapped);
+        }
+
+    private:
+        tCollideFunction m_function;
+    };
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+CollisionConfiguration::CollisionConfiguration()
+: m_bFastAlgorithms(true)
+{
+    m_pSphereBoxCreateFunc          = new PrimitiveCreateFunc(&collideSphereBox, false);
+    m_pBoxSphereCreateFunc          = new PrimitiveCreateFunc(&collideSphereBox, true);
+    m_pSphereCapsuleCreateFunc      = new PrimitiveCreateFunc(&collideSphereCapsule, false);
+    m_pCapsuleSphereCreateFunc      = new PrimitiveCreateFunc(&collideSphereCapsule, true);
+    m_pCapsuleCapsuleCreateFunc     = new PrimitiveCreateFunc(&collideCapsuleCapsule, false);
+}
+
+//-----------------------------------------------------------------------
+
+CollisionConfiguration::~CollisionConfiguration()
+{
+    delete m_pSphereBoxCreateFunc;
+    delete m_pBoxSphereCreateFunc;
+    delete m_pSphereCapsuleCreateFunc;
+    delete m_pCapsuleSphereCreateFunc;
+    delete m_pCapsuleCapsuleCreateFunc;
+}
+
+
+/******************** IMPLEMENTATION OF btCollisionConfiguration ***********************/
+
+btCollisionAlgorithmCreateFunc* CollisionConfiguration::getCollisionAlgorithmCreateFunc(int proxyType0,
+                                                                                        int proxyType1)
+{
+    if (m_bFastAlgorithms)
+    {
+        if ((proxyType0 == SPHERE_SHAPE_PROXYTYPE) && (proxyType1 == BOX_SHAPE_PROXYTYPE))
+            return m_pSphereBoxCreateFunc;
+
+        if ((proxyType0 == BOX_SHAPE_PROXYTYPE) && (proxyType1 == SPHERE_SHAPE_PROXYTYPE))
+            return m_pBoxSphereCreateFunc;
+
+        if ((proxyType0 == SPHERE_SHAPE_PROXYTYPE) && (proxyType1 == CAPSULE_SHAPE_PROXYTYPE))
+            return m_pSphereCapsuleCreateFunc;
+
+        if ((proxyType0 == CAPSULE_SHAPE_PROXYTYPE) && (proxyType1 == SPHERE_SHAPE_PROXYTYPE))
+            return m_pCapsuleSphereCreateFunc;
+
+        if ((proxyType0 == CAPSULE_SHAPE_PROXYTYPE) && (proxyType1 == CAPSULE_SHAPE_PROXYTYPE))
+            return m_pCapsuleCapsuleCreateFunc;
+    }
+
+    return btDefaultCollisionConfiguration::getCollisionAlgorithmCreateFunc(proxyType0, proxyType1);
+}
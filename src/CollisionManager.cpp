@@ -5,7 +5,9 @@
 */
 
 #include <Athena-Physics/CollisionManager.h>
+#include <Athena-Physics/Aggregate.h>
 #include <Athena-Physics/Body.h>
+#include <Athena-Physics/BodyPool.h>
 #include <Athena-Physics/CollisionObject.h>
 #include <Athena-Physics/GhostObject.h>
 #include <Athena-Physics/Conversions.h>
@@ -23,10 +25,55 @@ CollisionManager CollisionManager::DefaultManager;
 CollisionManager* CollisionManager::_CurrentManager = 0;
 
 
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Stamp of the last invalidation of cached decisions of the collision filter (shared
+    // by all the managers, since the collision objects can change of world)
+    unsigned int gFilterStamp = 0;
+
+    // Layout of the cached decisions (stored in the 'm_internalInfo1' field of the
+    // broadphase pairs, initialized to 0 by Bullet): stamp << 2 | flags
+    const size_t CACHE_VALID    = 0x1;
+    const size_t CACHE_COLLIDE  = 0x2;
+
+    // Maximum value of the stamps (so they always fit in the field)
+    const unsigned int MAX_STAMP = 0x3FFFFFFF;
+
+    // Number of times the stamps were reset after reaching MAX_STAMP
+    unsigned int gStampGeneration = 0;
+
+
+    // Returns the stamp of a new invalidation
+    unsigned int nextFilterStamp()
+    {
+        // Start again from 0: the worlds discard all their cached decisions when they
+        // see the new generation
+        if (gFilterStamp == MAX_STAMP)
+        {
+            gFilterStamp = 0;
+            ++gStampGeneration;
+        }
+
+        return ++gFilterStamp;
+    }
+
+
+    // Indicates if a cached decision is more recent than an invalidation (the
+    // invalidations done before the last reset of the stamps are older than any decision
+    // still cached)
+    inline bool isMoreRecent(unsigned int cacheStamp, unsigned int invalidationStamp)
+    {
+        return (cacheStamp >= invalidationStamp) || (invalidationStamp > gFilterStamp);
+    }
+}
+
+
 /***************************** CONSTRUCTION / DESTRUCTION ******************************/
 
 CollisionManager::CollisionManager()
-: m_pFilter(0)
+: m_pFilter(0), m_filterStamp(0)
 {
     unsigned int offset = 0;
     for (unsigned int i = 0; i < NB_GROUPS; ++i)
@@ -48,6 +95,36 @@ CollisionManager::~CollisionManager()
 bool CollisionManager::needBroadphaseCollision(btBroadphaseProxy* pProxy1,
                                                btBroadphaseProxy* pProxy2) const
 {
+    // The bodies parked in a pool aren't paired with anything
+    if ((pProxy1->m_collisionFilterGroup | pProxy2->m_collisionFilterGroup) & BodyPool::PARKED_FILTER)
+        return false;
+
+    // Aggregates: an aggregate is paired with the other objects (except the ghost
+    // objects and the members). The members are only paired with the ghost objects.
+    if ((pProxy1->m_collisionFilterGroup | pProxy2->m_collisionFilterGroup) &
+        (Aggregate::PROXY_FILTER | Aggregate::MEMBER_FILTER))
+    {
+        Aggregate* pAggregate1 = Aggregate::fromProxy(pProxy1);
+        Aggregate* pAggregate2 = Aggregate::fromProxy(pProxy2);
+
+        if (pAggregate1 && pAggregate2)
+            return true;
+
+        if (pAggregate1 || pAggregate2)
+        {
+            btBroadphaseProxy* pOther = (pAggregate1 ? pProxy2 : pProxy1);
+
+            if (pOther->m_collisionFilterGroup & Aggregate::MEMBER_FILTER)
+                return false;
+
+            return !btGhostObject::upcast((btCollisionObject*) pOther->m_clientObject);
+        }
+
+        btBroadphaseProxy* pOther = ((pProxy1->m_collisionFilterGroup & Aggregate::MEMBER_FILTER) ? pProxy2 : pProxy1);
+        if (!btGhostObject::upcast((btCollisionObject*) pOther->m_clientObject))
+            return false;
+    }
+
     tCollisionGroup group1 = getGroupOfCollisionObject((btCollisionObject*) pProxy1->m_clientObject);
     tCollisionGroup group2 = getGroupOfCollisionObject((btCollisionObject*) pProxy2->m_clientObject);
 
@@ -78,6 +155,37 @@ void CollisionManager::enableCollision(tCollisionGroup group1, tCollisionGroup g
         pState = &m_indexedPairs[group2][group1];
 
     *pState = (bEnableFilter ? PAIR_ENABLED_WITH_FILTER : PAIR_ENABLED);
+
+    invalidateAll();
+}
+
+//-----------------------------------------------------------------------
+
+bool CollisionManager::isCollisionEnabled(tCollisionGroup group1, tCollisionGroup group2) const
+{
+    if ((group1 == 255) || (group2 == 255))
+        return true;
+
+    if (group1 <= group2)
+        return (m_indexedPairs[group1][group2] != PAIR_DISABLED);
+
+    return (m_indexedPairs[group2][group1] != PAIR_DISABLED);
+}
+
+//-----------------------------------------------------------------------
+
+void CollisionManager::invalidate(CollisionObject* pComponent)
+{
+    assert(pComponent);
+
+    pComponent->m_filterStamp = nextFilterStamp();
+}
+
+//-----------------------------------------------------------------------
+
+void CollisionManager::invalidateAll()
+{
+    m_filterStamp = nextFilterStamp();
 }
 
 
@@ -89,6 +197,14 @@ void CollisionManager::customNearCallback(btBroadphasePair& collisionPair,
 {
     if (CollisionManager::_CurrentManager)
     {
+        // The pairs involving an aggregate are replaced by the pairs of its members
+        if ((collisionPair.m_pProxy0->m_collisionFilterGroup | collisionPair.m_pProxy1->m_collisionFilterGroup) &
+            Aggregate::PROXY_FILTER)
+        {
+            Aggregate::expandPair(collisionPair, dispatcher, dispatchInfo);
+            return;
+        }
+
         tCollisionGroup group1, group2;
 
         CollisionObject* pComponent1 = getComponentOfCollisionObject((btCollisionObject*) collisionPair.m_pProxy0->m_clientObject, group1);
@@ -110,7 +226,7 @@ void CollisionManager::customNearCallback(btBroadphasePair& collisionPair,
         assert(state != PAIR_DISABLED);
 
         bool bContinue = (state == PAIR_ENABLED) || !CollisionManager::_CurrentManager->m_pFilter ||
-                         CollisionManager::_CurrentManager->m_pFilter->needsCollision(pComponent1, pComponent2);
+                         CollisionManager::_CurrentManager->filterPair(collisionPair, pComponent1, pComponent2);
 
         if (bContinue)
             dispatcher.defaultNearCallback(collisionPair, dispatcher, dispatchInfo);
@@ -119,6 +235,63 @@ void CollisionManager::customNearCallback(btBroadphasePair& collisionPair,
 
 //-----------------------------------------------------------------------
 
+unsigned int CollisionManager::getStampGeneration()
+{
+    return gStampGeneration;
+}
+
+//-----------------------------------------------------------------------
+
+void CollisionManager::clearCachedDecisions(btOverlappingPairCache* pPairCache)
+{
+    assert(pPairCache);
+
+    const int nbPairs = pPairCache->getNumOverlappingPairs();
+    btBroadphasePair* pPairs = pPairCache->getOverlappingPairArrayPtr();
+
+    for (int i = 0; i < nbPairs; ++i)
+        pPairs[i].m_internalInfo1 = 0;
+}
+
+//-----------------------------------------------------------------------
+
+bool CollisionManager::filterPair(btBroadphasePair& collisionPair, CollisionObject* pComponent1,
+                                  CollisionObject* pComponent2)
+{
+    // Use the cached decision if it is more recent than the invalidations
+    size_t cache = (size_t) collisionPair.m_internalInfo1;
+    if (cache & CACHE_VALID)
+    {
+        unsigned int stamp = (unsigned int) (cache >> 2);
+        if (isMoreRecent(stamp, m_filterStamp) && isMoreRecent(stamp, pComponent1->m_filterStamp) &&
+            isMoreRecent(stamp, pComponent2->m_filterStamp))
+        {
+            return ((cache & CACHE_COLLIDE) != 0);
+        }
+    }
+
+    ICollisionFilter::tResult result = m_pFilter->filterCollision(pComponent1, pComponent2);
+
+    bool bCollide = (result == ICollisionFilter::RESULT_COLLIDE) ||
+                    (result == ICollisionFilter::RESULT_COLLIDE_CACHED);
+
+    if ((result == ICollisionFilter::RESULT_COLLIDE_CACHED) ||
+        (result == ICollisionFilter::RESULT_IGNORE_CACHED))
+    {
+        cache = ((size_t) gFilterStamp << 2) | CACHE_VALID | (bCollide ? CACHE_COLLIDE : 0);
+    }
+    else
+    {
+        cache = 0;
+    }
+
+    collisionPair.m_internalInfo1 = (void*) cache;
+
+    return bCollide;
+}
+
+//-----------------------------------------------------------------------
+
 tCollisionGroup CollisionManager::getGroupOfCollisionObject(btCollisionObject* pObject)
 {
     return static_cast<CollisionObject*>(pObject->getUserPointer())->getCollisionGroup();
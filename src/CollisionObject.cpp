@@ -25,7 +25,8 @@ const std::string CollisionObject::TYPE = "Athena/Physics/CollisionObject";
 /***************************** CONSTRUCTION / DESTRUCTION ******************************/
 
 CollisionObject::CollisionObject(const std::string& strName, ComponentsList* pList)
-: PhysicalComponent(strName, pList), m_collisionGroup(255)
+: PhysicalComponent(strName, pList), m_collisionGroup(255), m_filterStamp(0),
+  m_material(0)
 {
 }
 
@@ -50,6 +51,18 @@ CollisionObject* CollisionObject::cast(Component* pComponent)
 }
 
 
+/**************************************** METHODS **************************************/
+
+void CollisionObject::setMaterial(tMaterialID material)
+{
+    if (material == m_material)
+        return;
+
+    m_material = material;
+    onMaterialChanged();
+}
+
+
 /***************************** MANAGEMENT OF THE PROPERTIES ****************************/
 
 Utils::PropertiesList* CollisionObject::getProperties() const
@@ -63,6 +76,9 @@ Utils::PropertiesList* CollisionObject::getProperties() const
     // Group
     pProperties->set("collision-group", new Variant(m_collisionGroup));
 
+    // Material
+    pProperties->set("material", new Variant(m_material));
+
     // Returns the list
     return pProperties;
 }
@@ -94,6 +110,10 @@ bool CollisionObject::setProperty(const std::string& strName, Utils::Variant* pV
     if (strName == "collision-group")
         setCollisionGroup(pValue->toUChar());
 
+    // Material
+    else if (strName == "material")
+        setMaterial(pValue->toUChar());
+
     // Destroy the value
     delete pValue;
 
@@ -0,0 +1,299 @@
+/** @file   CommandBuffer.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::CommandBuffer'
+*/
+
+#include <Athena-Physics/CommandBuffer.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/Conversions.h>
+#include <algorithm>
+
+#if (ATHENA_PLATFORM == ATHENA_PLATFORM_WIN32)
+#   define WIN32_LEAN_AND_MEAN
+#   include <windows.h>
+#endif
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Atomically increments a value, and returns the new one
+    inline long atomicIncrement(volatile long* pValue)
+    {
+#if (ATHENA_PLATFORM == ATHENA_PLATFORM_WIN32)
+        return InterlockedIncrement(pValue);
+#else
+        return __sync_add_and_fetch(pValue, 1);
+#endif
+    }
+
+
+    // Atomically replaces a pointer if it is equal to 'comparand', and returns its
+    // previous value
+    inline void* atomicCompareAndSwap(void* volatile* pPointer, void* comparand, void* value)
+    {
+#if (ATHENA_PLATFORM == ATHENA_PLATFORM_WIN32)
+        return InterlockedCompareExchangePointer(pPointer, value, comparand);
+#else
+        return __sync_val_compare_and_swap(pPointer, comparand, value);
+#endif
+    }
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+CommandBuffer::CommandBuffer(World* pWorld)
+: m_pWorld(pWorld), m_pFirstBlock(0), m_pCurrentBlock(0)
+{
+    assert(pWorld);
+
+    m_pFirstBlock = new tBlock();
+    m_pFirstBlock->nbReserved = 0;
+    m_pFirstBlock->pNext = 0;
+
+    m_pCurrentBlock = m_pFirstBlock;
+}
+
+//-----------------------------------------------------------------------
+
+CommandBuffer::~CommandBuffer()
+{
+    tBlock* pBlock = m_pFirstBlock;
+    while (pBlock)
+    {
+        tBlock* pNext = pBlock->pNext;
+        delete pBlock;
+        pBlock = pNext;
+    }
+}
+
+
+/********************************* RECORDING OF COMMANDS *******************************/
+
+void CommandBuffer::addBody(Body* pBody)
+{
+    record(COMMAND_ADD_BODY, pBody);
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::removeBody(Body* pBody)
+{
+    record(COMMAND_REMOVE_BODY, pBody);
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::setCollisionShape(Body* pBody, CollisionShape* pShape)
+{
+    tCommand* pCommand = record(COMMAND_SET_COLLISION_SHAPE, pBody);
+    pCommand->pShape = pShape;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::setMass(Body* pBody, Math::Real mass)
+{
+    tCommand* pCommand = record(COMMAND_SET_MASS, pBody);
+    pCommand->value = mass;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::setKinematic(Body* pBody, bool bKinematic)
+{
+    tCommand* pCommand = record(COMMAND_SET_KINEMATIC, pBody);
+    pCommand->bFlag = bKinematic;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::applyImpulse(Body* pBody, const Math::Vector3& impulse,
+                                 const Math::Vector3& relativePosition)
+{
+    tCommand* pCommand = record(COMMAND_APPLY_IMPULSE, pBody);
+    pCommand->vector = impulse;
+    pCommand->position = relativePosition;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::setLinearVelocity(Body* pBody, const Math::Vector3& velocity)
+{
+    tCommand* pCommand = record(COMMAND_SET_LINEAR_VELOCITY, pBody);
+    pCommand->vector = velocity;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::setAngularVelocity(Body* pBody, const Math::Vector3& velocity)
+{
+    tCommand* pCommand = record(COMMAND_SET_ANGULAR_VELOCITY, pBody);
+    pCommand->vector = velocity;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::teleport(Body* pBody, const Math::Vector3& position,
+                             const Math::Quaternion& orientation)
+{
+    tCommand* pCommand = record(COMMAND_TELEPORT, pBody);
+    pCommand->position = position;
+    pCommand->orientation = orientation;
+}
+
+
+/**************************************** METHODS **************************************/
+
+void CommandBuffer::apply()
+{
+    // The blocks following the current one are empty
+    tBlock* pLastBlock = m_pCurrentBlock;
+
+    for (tBlock* pBlock = m_pFirstBlock; pBlock; pBlock = pBlock->pNext)
+    {
+        long nbReserved = pBlock->nbReserved;
+        long nbCommands = std::min(nbReserved, (long) BLOCK_SIZE);
+        for (long i = 0; i < nbCommands; ++i)
+            execute(pBlock->commands[i]);
+
+        pBlock->nbReserved = 0;
+
+        if (pBlock == pLastBlock)
+            break;
+    }
+
+    // The blocks are kept for the next commands
+    m_pCurrentBlock = m_pFirstBlock;
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::discard(Body* pBody)
+{
+    assert(pBody);
+
+    tBlock* pLastBlock = m_pCurrentBlock;
+
+    for (tBlock* pBlock = m_pFirstBlock; pBlock; pBlock = pBlock->pNext)
+    {
+        long nbReserved = pBlock->nbReserved;
+        long nbCommands = std::min(nbReserved, (long) BLOCK_SIZE);
+        for (long i = 0; i < nbCommands; ++i)
+        {
+            if (pBlock->commands[i].pBody == pBody)
+                pBlock->commands[i].type = COMMAND_NONE;
+        }
+
+        if (pBlock == pLastBlock)
+            break;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+CommandBuffer::tCommand* CommandBuffer::record(tCommandType type, Body* pBody)
+{
+    assert(pBody);
+
+    while (true)
+    {
+        tBlock* pBlock = m_pCurrentBlock;
+
+        long index = atomicIncrement(&pBlock->nbReserved) - 1;
+        if (index < (long) BLOCK_SIZE)
+        {
+            tCommand* pCommand = &pBlock->commands[index];
+            pCommand->type = type;
+            pCommand->pBody = pBody;
+            return pCommand;
+        }
+
+        // The block is full: the first thread getting here appends a new one (unless
+        // one is left from a previous frame), then everyone moves to the next block
+        if (!pBlock->pNext)
+        {
+            tBlock* pNewBlock = new tBlock();
+            pNewBlock->nbReserved = 0;
+            pNewBlock->pNext = 0;
+
+            if (atomicCompareAndSwap((void* volatile*) &pBlock->pNext, 0, pNewBlock) != 0)
+                delete pNewBlock;
+        }
+
+        atomicCompareAndSwap((void* volatile*) &m_pCurrentBlock, pBlock, pBlock->pNext);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void CommandBuffer::execute(const tCommand& command)
+{
+    Body* pBody = command.pBody;
+    btRigidBody* pRigidBody = (pBody ? pBody->getRigidBody() : 0);
+
+    switch (command.type)
+    {
+        case COMMAND_NONE:
+            break;
+
+        case COMMAND_ADD_BODY:
+            if (pRigidBody->getCollisionShape() && !pRigidBody->getBroadphaseHandle() &&
+                !pBody->isSuspended())
+                m_pWorld->addRigidBody(pBody);
+            break;
+
+        case COMMAND_REMOVE_BODY:
+            if (pRigidBody->getBroadphaseHandle())
+                m_pWorld->removeRigidBody(pBody);
+            break;
+
+        case COMMAND_SET_COLLISION_SHAPE:
+            pBody->setCollisionShape(command.pShape);
+            break;
+
+        case COMMAND_SET_MASS:
+            pBody->setMass(command.value);
+            break;
+
+        case COMMAND_SET_KINEMATIC:
+            pBody->setKinematic(command.bFlag);
+            break;
+
+        case COMMAND_APPLY_IMPULSE:
+            pRigidBody->activate(true);
+            pRigidBody->applyImpulse(toBullet(command.vector), toBullet(command.position));
+            break;
+
+        case COMMAND_SET_LINEAR_VELOCITY:
+            pRigidBody->activate(true);
+            pBody->setWorldLinearVelocity(command.vector);
+            break;
+
+        case COMMAND_SET_ANGULAR_VELOCITY:
+            pRigidBody->activate(true);
+            pBody->setAngularVelocity(command.vector);
+            break;
+
+        case COMMAND_TELEPORT:
+        {
+            btTransform transform(toBullet(command.orientation),
+                                  toBulletPosition(command.position, m_pWorld->getOrigin()));
+
+            pRigidBody->setCenterOfMassTransform(transform);
+            pRigidBody->activate(true);
+
+            // Move the entity too (the static and kinematic bodies follow it)
+            pBody->setWorldTransform(transform);
+            break;
+        }
+    }
+}
@@ -42,5 +42,20 @@ Math::Quaternion fromBullet(const btQuaternion& q)
     return Math::Quaternion(q.w(), q.x(), q.y(), q.z());
 }
 
+//-----------------------------------------------------------------------
+
+btVector3 toBulletPosition(const Math::Vector3& position, const Math::Vector3& origin)
+{
+    // The subtraction is done with the precision of the entities
+    return toBullet(position - origin);
+}
+
+//-----------------------------------------------------------------------
+
+Math::Vector3 fromBulletPosition(const btVector3& position, const Math::Vector3& origin)
+{
+    return fromBullet(position) + origin;
+}
+
 }
 }
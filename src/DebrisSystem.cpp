@@ -0,0 +1,559 @@
+/** @file   DebrisSystem.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::DebrisSystem'
+*/
+
+#include <Athena-Physics/DebrisSystem.h>
+#include <LinearMath/btQuickprof.h>
+#include <algorithm>
+
+#if !defined(BT_USE_DOUBLE_PRECISION) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 1)))
+    #define ATHENA_PHYSICS_DEBRIS_SSE
+    #include <xmmintrin.h>
+#endif
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+/************************************** CONSTANTS **************************************/
+
+const Real DebrisSystem::SLEEP_DELAY = Real(0.5);
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Lifetime used by the fragments that never expire
+    const btScalar INFINITE_LIFETIME = BT_LARGE_FLOAT;
+
+    // Minimal movement of a fragment that needs to be checked for collisions
+    const btScalar MIN_MOVEMENT = btScalar(1e-4);
+
+
+    // Distance between the center of a box and its surface along a direction (its half
+    // extents projected on the direction)
+    btScalar boxExtent(btScalar qx, btScalar qy, btScalar qz, btScalar qw,
+                       btScalar sx, btScalar sy, btScalar sz, const btVector3& direction)
+    {
+        btVector3 local = quatRotate(btQuaternion(qx, qy, qz, qw).inverse(), direction);
+
+        return btFabs(local.x()) * sx + btFabs(local.y()) * sy + btFabs(local.z()) * sz;
+    }
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+DebrisSystem::DebrisSystem(World* pWorld, unsigned int capacity)
+: m_pWorld(pWorld), m_capacity(capacity), m_nbFragments(0), m_nbAwake(0),
+  m_collisionGroup(255), m_friction(0.3f), m_restitution(0.3f), m_sleepThreshold(0.1f),
+  m_lastUpdateCost(0.0f)
+{
+    assert(pWorld);
+    assert(capacity > 0);
+
+    // Allocate everything once: no allocation is done during the updates, the queries
+    // of the static snapshot don't allocate anything either (one more slot is used as
+    // temporary storage when swapping fragments)
+    for (unsigned int i = 0; i < NB_CHANNELS; ++i)
+        m_channels[i].resize(capacity + 1, btScalar(0.0));
+
+    m_shapes.resize(capacity + 1, SHAPE_SPHERE);
+
+    m_rays.resize(capacity);
+    m_hits.resize(capacity);
+    m_rayFragments.resize(capacity);
+}
+
+//-----------------------------------------------------------------------
+
+DebrisSystem::~DebrisSystem()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+bool DebrisSystem::spawn(const tFragment& fragment)
+{
+    assert(fragment.size.x > 0.0f);
+    assert((fragment.shape == SHAPE_SPHERE) || ((fragment.size.y > 0.0f) && (fragment.size.z > 0.0f)));
+    assert(fragment.lifetime >= 0.0f);
+
+    if (m_nbFragments == m_capacity)
+        return false;
+
+    // The awake fragments are first: move the first sleeping one at the end
+    if (m_nbAwake < m_nbFragments)
+        copyFragment(m_nbFragments, m_nbAwake);
+
+    unsigned int index = m_nbAwake;
+
+    ++m_nbAwake;
+    ++m_nbFragments;
+
+    m_shapes[index] = (unsigned char) fragment.shape;
+
+    Vector3 size = fragment.size;
+    if (fragment.shape == SHAPE_SPHERE)
+        size = Vector3(fragment.size.x, fragment.size.x, fragment.size.x);
+
+    const Quaternion& orientation = fragment.orientation;
+
+    m_channels[POSITION_X][index]           = fragment.position.x;
+    m_channels[POSITION_Y][index]           = fragment.position.y;
+    m_channels[POSITION_Z][index]           = fragment.position.z;
+    m_channels[ORIENTATION_X][index]        = orientation.x;
+    m_channels[ORIENTATION_Y][index]        = orientation.y;
+    m_channels[ORIENTATION_Z][index]        = orientation.z;
+    m_channels[ORIENTATION_W][index]        = orientation.w;
+    m_channels[LINEAR_VELOCITY_X][index]    = fragment.linearVelocity.x;
+    m_channels[LINEAR_VELOCITY_Y][index]    = fragment.linearVelocity.y;
+    m_channels[LINEAR_VELOCITY_Z][index]    = fragment.linearVelocity.z;
+    m_channels[ANGULAR_VELOCITY_X][index]   = fragment.angularVelocity.x;
+    m_channels[ANGULAR_VELOCITY_Y][index]   = fragment.angularVelocity.y;
+    m_channels[ANGULAR_VELOCITY_Z][index]   = fragment.angularVelocity.z;
+    m_channels[SIZE_X][index]               = size.x;
+    m_channels[SIZE_Y][index]               = size.y;
+    m_channels[SIZE_Z][index]               = size.z;
+    m_channels[RADIUS][index]               = std::min(size.x, std::min(size.y, size.z));
+    m_channels[LIFETIME][index]             = (fragment.lifetime > 0.0f ? btScalar(fragment.lifetime) : INFINITE_LIFETIME);
+    m_channels[REST_TIME][index]            = btScalar(0.0);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::clear()
+{
+    m_nbFragments   = 0;
+    m_nbAwake       = 0;
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::wakeUp()
+{
+    btScalar* pRestTimes = channel(REST_TIME);
+
+    for (unsigned int i = m_nbAwake; i < m_nbFragments; ++i)
+        pRestTimes[i] = btScalar(0.0);
+
+    m_nbAwake = m_nbFragments;
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::update(Real timeStep)
+{
+    assert(timeStep >= 0.0f);
+
+    m_lastUpdateCost = 0.0f;
+
+    if ((timeStep <= 0.0f) || (m_nbFragments == 0))
+        return;
+
+    btClock clock;
+
+    integrate(timeStep);
+    collide(timeStep);
+    sleep(timeStep);
+    expire(timeStep);
+
+    m_lastUpdateCost = Real(clock.getTimeMicroseconds()) * Real(1e-6);
+}
+
+
+/******************************* MANAGEMENT OF THE FRAGMENTS ****************************/
+
+Vector3 DebrisSystem::getSize(unsigned int index) const
+{
+    assert(index < m_nbFragments);
+
+    if (m_shapes[index] == SHAPE_SPHERE)
+        return Vector3(value(SIZE_X, index), 0.0f, 0.0f);
+
+    return Vector3(value(SIZE_X, index), value(SIZE_Y, index), value(SIZE_Z, index));
+}
+
+//-----------------------------------------------------------------------
+
+Vector3 DebrisSystem::getPosition(unsigned int index) const
+{
+    assert(index < m_nbFragments);
+
+    return Vector3(value(POSITION_X, index), value(POSITION_Y, index), value(POSITION_Z, index));
+}
+
+//-----------------------------------------------------------------------
+
+Quaternion DebrisSystem::getOrientation(unsigned int index) const
+{
+    assert(index < m_nbFragments);
+
+    return Quaternion(value(ORIENTATION_W, index), value(ORIENTATION_X, index),
+                      value(ORIENTATION_Y, index), value(ORIENTATION_Z, index));
+}
+
+//-----------------------------------------------------------------------
+
+Vector3 DebrisSystem::getLinearVelocity(unsigned int index) const
+{
+    assert(index < m_nbFragments);
+
+    return Vector3(value(LINEAR_VELOCITY_X, index), value(LINEAR_VELOCITY_Y, index),
+                   value(LINEAR_VELOCITY_Z, index));
+}
+
+//-----------------------------------------------------------------------
+
+Real DebrisSystem::getLifetime(unsigned int index) const
+{
+    assert(index < m_nbFragments);
+
+    btScalar lifetime = value(LIFETIME, index);
+    return (lifetime > INFINITE_LIFETIME * btScalar(0.5) ? 0.0f : lifetime);
+}
+
+
+/************************************** PARAMETERS *************************************/
+
+void DebrisSystem::setFriction(Real friction)
+{
+    assert(friction >= 0.0f);
+    assert(friction <= 1.0f);
+
+    m_friction = friction;
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::setRestitution(Real restitution)
+{
+    assert(restitution >= 0.0f);
+
+    m_restitution = restitution;
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::setSleepThreshold(Real threshold)
+{
+    assert(threshold >= 0.0f);
+
+    m_sleepThreshold = threshold;
+}
+
+
+/*********************************** INTERNAL METHODS **********************************/
+
+void DebrisSystem::integrate(btScalar timeStep)
+{
+    const unsigned int nbAwake = m_nbAwake;
+    const Vector3 gravity = m_pWorld->getGravity();
+
+    const btScalar gx = gravity.x * timeStep;
+    const btScalar gy = gravity.y * timeStep;
+    const btScalar gz = gravity.z * timeStep;
+    const btScalar halfStep = btScalar(0.5) * timeStep;
+
+    btScalar* vx = channel(LINEAR_VELOCITY_X);
+    btScalar* vy = channel(LINEAR_VELOCITY_Y);
+    btScalar* vz = channel(LINEAR_VELOCITY_Z);
+    btScalar* wx = channel(ANGULAR_VELOCITY_X);
+    btScalar* wy = channel(ANGULAR_VELOCITY_Y);
+    btScalar* wz = channel(ANGULAR_VELOCITY_Z);
+    btScalar* qx = channel(ORIENTATION_X);
+    btScalar* qy = channel(ORIENTATION_Y);
+    btScalar* qz = channel(ORIENTATION_Z);
+    btScalar* qw = channel(ORIENTATION_W);
+
+    // The positions are updated by collide(), once the movements are checked. The
+    // quaternion loop needs a square root and a division per fragment, which the
+    // compilers don't vectorize without fast-math options: when SSE is available, both
+    // loops process four fragments at a time (the channels are 16-byte aligned), and
+    // the remaining ones are processed one by one.
+    unsigned int first = 0;
+
+#ifdef ATHENA_PHYSICS_DEBRIS_SSE
+    const unsigned int nbPacked = nbAwake & ~3u;
+
+    const __m128 gx4 = _mm_set1_ps(gx);
+    const __m128 gy4 = _mm_set1_ps(gy);
+    const __m128 gz4 = _mm_set1_ps(gz);
+    const __m128 halfStep4 = _mm_set1_ps(halfStep);
+    const __m128 one4 = _mm_set1_ps(1.0f);
+
+    for (unsigned int i = 0; i < nbPacked; i += 4)
+    {
+        _mm_store_ps(vx + i, _mm_add_ps(_mm_load_ps(vx + i), gx4));
+        _mm_store_ps(vy + i, _mm_add_ps(_mm_load_ps(vy + i), gy4));
+        _mm_store_ps(vz + i, _mm_add_ps(_mm_load_ps(vz + i), gz4));
+    }
+
+    for (unsigned int i = 0; i < nbPacked; i += 4)
+    {
+        __m128 ax = _mm_load_ps(wx + i);
+        __m128 ay = _mm_load_ps(wy + i);
+        __m128 az = _mm_load_ps(wz + i);
+        __m128 bx = _mm_load_ps(qx + i);
+        __m128 by = _mm_load_ps(qy + i);
+        __m128 bz = _mm_load_ps(qz + i);
+        __m128 bw = _mm_load_ps(qw + i);
+
+        // q' = q + 0.5 * dt * (w * q)
+        __m128 x = _mm_add_ps(bx, _mm_mul_ps(halfStep4,
+                        _mm_sub_ps(_mm_add_ps(_mm_mul_ps(ax, bw), _mm_mul_ps(ay, bz)), _mm_mul_ps(az, by))));
+        __m128 y = _mm_add_ps(by, _mm_mul_ps(halfStep4,
+                        _mm_sub_ps(_mm_add_ps(_mm_mul_ps(ay, bw), _mm_mul_ps(az, bx)), _mm_mul_ps(ax, bz))));
+        __m128 z = _mm_add_ps(bz, _mm_mul_ps(halfStep4,
+                        _mm_sub_ps(_mm_add_ps(_mm_mul_ps(az, bw), _mm_mul_ps(ax, by)), _mm_mul_ps(ay, bx))));
+        __m128 w = _mm_sub_ps(bw, _mm_mul_ps(halfStep4,
+                        _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz))));
+
+        // Full precision normalization (the approximated reciprocal square root would
+        // make the quaternions drift)
+        __m128 length2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                                    _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w)));
+        __m128 invLength = _mm_div_ps(one4, _mm_sqrt_ps(length2));
+
+        _mm_store_ps(qx + i, _mm_mul_ps(x, invLength));
+        _mm_store_ps(qy + i, _mm_mul_ps(y, invLength));
+        _mm_store_ps(qz + i, _mm_mul_ps(z, invLength));
+        _mm_store_ps(qw + i, _mm_mul_ps(w, invLength));
+    }
+
+    first = nbPacked;
+#endif
+
+    for (unsigned int i = first; i < nbAwake; ++i)
+    {
+        vx[i] += gx;
+        vy[i] += gy;
+        vz[i] += gz;
+    }
+
+    for (unsigned int i = first; i < nbAwake; ++i)
+    {
+        // q' = q + 0.5 * dt * (w * q)
+        btScalar x = qx[i] + halfStep * ( wx[i] * qw[i] + wy[i] * qz[i] - wz[i] * qy[i]);
+        btScalar y = qy[i] + halfStep * ( wy[i] * qw[i] + wz[i] * qx[i] - wx[i] * qz[i]);
+        btScalar z = qz[i] + halfStep * ( wz[i] * qw[i] + wx[i] * qy[i] - wy[i] * qx[i]);
+        btScalar w = qw[i] + halfStep * (-wx[i] * qx[i] - wy[i] * qy[i] - wz[i] * qz[i]);
+
+        btScalar invLength = btScalar(1.0) / btSqrt(x * x + y * y + z * z + w * w);
+
+        qx[i] = x * invLength;
+        qy[i] = y * invLength;
+        qz[i] = z * invLength;
+        qw[i] = w * invLength;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::collide(btScalar timeStep)
+{
+    const unsigned int nbAwake = m_nbAwake;
+
+    btScalar* px = channel(POSITION_X);
+    btScalar* py = channel(POSITION_Y);
+    btScalar* pz = channel(POSITION_Z);
+    btScalar* vx = channel(LINEAR_VELOCITY_X);
+    btScalar* vy = channel(LINEAR_VELOCITY_Y);
+    btScalar* vz = channel(LINEAR_VELOCITY_Z);
+    btScalar* wx = channel(ANGULAR_VELOCITY_X);
+    btScalar* wy = channel(ANGULAR_VELOCITY_Y);
+    btScalar* wz = channel(ANGULAR_VELOCITY_Z);
+    const btScalar* qx = channel(ORIENTATION_X);
+    const btScalar* qy = channel(ORIENTATION_Y);
+    const btScalar* qz = channel(ORIENTATION_Z);
+    const btScalar* qw = channel(ORIENTATION_W);
+    const btScalar* sx = channel(SIZE_X);
+    const btScalar* sy = channel(SIZE_Y);
+    const btScalar* sz = channel(SIZE_Z);
+    const btScalar* radii = channel(RADIUS);
+    const unsigned char* shapes = &m_shapes[0];
+
+    // One ray per moving fragment, from its center to the front of the shape at the
+    // end of the step
+    unsigned int nbRays = 0;
+    for (unsigned int i = 0; i < nbAwake; ++i)
+    {
+        btScalar dx = vx[i] * timeStep;
+        btScalar dy = vy[i] * timeStep;
+        btScalar dz = vz[i] * timeStep;
+
+        btScalar length = btSqrt(dx * dx + dy * dy + dz * dz);
+        if (length < MIN_MOVEMENT)
+            continue;
+
+        btScalar extent = radii[i];
+        if (shapes[i] == SHAPE_BOX)
+        {
+            extent = boxExtent(qx[i], qy[i], qz[i], qw[i], sx[i], sy[i], sz[i],
+                               btVector3(dx, dy, dz) / length);
+        }
+
+        btScalar scale = (length + extent) / length;
+
+        World::tRay& ray = m_rays[nbRays];
+        ray.from    = Vector3(px[i], py[i], pz[i]);
+        ray.to      = Vector3(px[i] + dx * scale, py[i] + dy * scale, pz[i] + dz * scale);
+
+        m_rayFragments[nbRays] = i;
+        ++nbRays;
+    }
+
+    // Only the static objects are considered: their snapshot is only rebuilt when they
+    // change, and can be queried by several threads without touching the Bullet's world
+    if (nbRays > 0)
+    {
+        m_pWorld->rayCastBatch(m_pWorld->getStaticSnapshot(), &m_rays[0], nbRays, &m_hits[0],
+                               m_collisionGroup);
+    }
+
+    // Move the fragments and bounce the ones that hit something
+    const btScalar restitution = m_restitution;
+    const btScalar tangentialScale = btScalar(1.0) - m_friction;
+
+    for (unsigned int r = 0; r < nbRays; ++r)
+    {
+        unsigned int i = m_rayFragments[r];
+        const World::tRayHit& hit = m_hits[r];
+
+        if (!hit.pObject)
+        {
+            px[i] += vx[i] * timeStep;
+            py[i] += vy[i] * timeStep;
+            pz[i] += vz[i] * timeStep;
+            continue;
+        }
+
+        const Vector3& n = hit.normal;
+
+        // The fragment is put against the surface hit
+        btScalar extent = radii[i];
+        if (shapes[i] == SHAPE_BOX)
+        {
+            extent = boxExtent(qx[i], qy[i], qz[i], qw[i], sx[i], sy[i], sz[i],
+                               btVector3(n.x, n.y, n.z));
+        }
+
+        px[i] = hit.position.x + n.x * extent;
+        py[i] = hit.position.y + n.y * extent;
+        pz[i] = hit.position.z + n.z * extent;
+
+        btScalar normalSpeed = vx[i] * n.x + vy[i] * n.y + vz[i] * n.z;
+        if (normalSpeed < btScalar(0.0))
+        {
+            // Remove the normal velocity, and apply the restitution and the friction
+            btScalar tx = vx[i] - n.x * normalSpeed;
+            btScalar ty = vy[i] - n.y * normalSpeed;
+            btScalar tz = vz[i] - n.z * normalSpeed;
+
+            normalSpeed *= -restitution;
+
+            vx[i] = tx * tangentialScale + n.x * normalSpeed;
+            vy[i] = ty * tangentialScale + n.y * normalSpeed;
+            vz[i] = tz * tangentialScale + n.z * normalSpeed;
+
+            wx[i] *= tangentialScale;
+            wy[i] *= tangentialScale;
+            wz[i] *= tangentialScale;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::sleep(btScalar timeStep)
+{
+    const btScalar threshold2 = m_sleepThreshold * m_sleepThreshold;
+
+    btScalar* vx = channel(LINEAR_VELOCITY_X);
+    btScalar* vy = channel(LINEAR_VELOCITY_Y);
+    btScalar* vz = channel(LINEAR_VELOCITY_Z);
+    btScalar* restTimes = channel(REST_TIME);
+
+    for (unsigned int i = 0; i < m_nbAwake; ++i)
+    {
+        btScalar speed2 = vx[i] * vx[i] + vy[i] * vy[i] + vz[i] * vz[i];
+        restTimes[i] = (speed2 < threshold2 ? restTimes[i] + timeStep : btScalar(0.0));
+    }
+
+    // The sleeping fragments are moved after the awake ones (the fragments swapped
+    // with them were already checked)
+    for (unsigned int i = m_nbAwake; i > 0; --i)
+    {
+        unsigned int index = i - 1;
+
+        if (restTimes[index] < SLEEP_DELAY)
+            continue;
+
+        m_channels[LINEAR_VELOCITY_X][index]    = btScalar(0.0);
+        m_channels[LINEAR_VELOCITY_Y][index]    = btScalar(0.0);
+        m_channels[LINEAR_VELOCITY_Z][index]    = btScalar(0.0);
+        m_channels[ANGULAR_VELOCITY_X][index]   = btScalar(0.0);
+        m_channels[ANGULAR_VELOCITY_Y][index]   = btScalar(0.0);
+        m_channels[ANGULAR_VELOCITY_Z][index]   = btScalar(0.0);
+
+        --m_nbAwake;
+
+        if (index != m_nbAwake)
+        {
+            copyFragment(m_capacity, index);
+            copyFragment(index, m_nbAwake);
+            copyFragment(m_nbAwake, m_capacity);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::expire(btScalar timeStep)
+{
+    btScalar* lifetimes = channel(LIFETIME);
+
+    for (unsigned int i = 0; i < m_nbFragments; ++i)
+        lifetimes[i] -= timeStep;
+
+    // Destroy the expired fragments, keeping the awake ones first (the fragments moved
+    // into the freed slots were already checked)
+    for (unsigned int i = m_nbFragments; i > 0; --i)
+    {
+        unsigned int index = i - 1;
+
+        if (lifetimes[index] > btScalar(0.0))
+            continue;
+
+        if (index < m_nbAwake)
+        {
+            --m_nbAwake;
+            copyFragment(index, m_nbAwake);
+            index = m_nbAwake;
+        }
+
+        --m_nbFragments;
+        copyFragment(index, m_nbFragments);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void DebrisSystem::copyFragment(unsigned int dest, unsigned int src)
+{
+    if (dest == src)
+        return;
+
+    for (unsigned int i = 0; i < NB_CHANNELS; ++i)
+        m_channels[i][dest] = m_channels[i][src];
+
+    m_shapes[dest] = m_shapes[src];
+}
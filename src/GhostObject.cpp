@@ -31,7 +31,7 @@ const std::string GhostObject::TYPE = "Athena/Physics/GhostObject";
 /***************************** CONSTRUCTION / DESTRUCTION ******************************/
 
 GhostObject::GhostObject(const std::string& strName, ComponentsList* pList)
-: CollisionObject(strName, pList), m_pGhostObject(0), m_pShape(0)
+: CollisionObject(strName, pList), m_pGhostObject(0), m_pShape(0), m_bStatic(false)
 {
     m_pGhostObject = new btGhostObject();
     m_pGhostObject->setCollisionFlags(m_pGhostObject->getCollisionFlags() | btCollisionObject::CF_NO_CONTACT_RESPONSE);
@@ -70,6 +70,7 @@ GhostObject* GhostObject::cast(Component* pComponent)
 
 void GhostObject::setCollisionShape(CollisionShape* pShape)
 {
+    assert(!isSimulationInProgress());
     assert(m_pGhostObject);
 
     if (pShape == m_pShape)
@@ -103,8 +104,31 @@ void GhostObject::setCollisionShape(CollisionShape* pShape)
 
 //-----------------------------------------------------------------------
 
+void GhostObject::setStatic(bool bStatic)
+{
+    assert(!isSimulationInProgress());
+    assert(m_pGhostObject);
+
+    if (bStatic == m_bStatic)
+        return;
+
+    if (m_pGhostObject->getCollisionShape())
+    {
+        getWorld()->removeGhostObject(this);
+        m_bStatic = bStatic;
+        getWorld()->addGhostObject(this);
+    }
+    else
+    {
+        m_bStatic = bStatic;
+    }
+}
+
+//-----------------------------------------------------------------------
+
 PhysicalComponent* GhostObject::getOverlappingObject(unsigned int index)
 {
+    assert(!isSimulationInProgress());
     assert(m_pGhostObject);
 
     btCollisionObject* pObject = m_pGhostObject->getOverlappingObject(index);
@@ -124,13 +148,16 @@ void GhostObject::onTransformsChanged()
     if (pTransforms)
     {
         m_pGhostObject->setWorldTransform(btTransform(toBullet(pTransforms->getWorldOrientation()),
-                                                      toBullet(pTransforms->getWorldPosition())));
+                                                      toBulletPosition(pTransforms->getWorldPosition(), getWorldOrigin())));
     }
     else
     {
         m_pGhostObject->setWorldTransform(btTransform(toBullet(Quaternion::IDENTITY),
-                                                      toBullet(Vector3::ZERO)));
+                                                      toBulletPosition(Vector3::ZERO, getWorldOrigin())));
     }
+
+    if (m_bStatic && m_pShape)
+        getWorld()->getTriggerIndex()->onTriggerMoved(this);
 }
 
 
@@ -170,6 +197,9 @@ Utils::PropertiesList* GhostObject::getProperties() const
     if (m_pShape)
         pProperties->set("shape", new Variant(m_pShape->getID().toString()));
 
+    // Static
+    pProperties->set("static", new Variant(m_bStatic));
+
     // Returns the list
     return pProperties;
 }
@@ -219,6 +249,12 @@ bool GhostObject::setProperty(const std::string& strName, Utils::Variant* pValue
         }
     }
 
+    // Static
+    else if (strName == "static")
+    {
+        setStatic(pValue->toBool());
+    }
+
     // Destroy the value
     delete pValue;
 
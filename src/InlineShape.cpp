@@ -0,0 +1,91 @@
+/** @file   InlineShape.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::InlineShape'
+*/
+
+#include <Athena-Physics/InlineShape.h>
+#include <Athena-Physics/Conversions.h>
+#include <new>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+InlineShape::InlineShape(const World::tPrimitive& primitive)
+: m_pShape(0)
+{
+    switch (primitive.shape)
+    {
+        case PrimitiveShape::SHAPE_BOX:
+            m_pShape = new(m_storage) btBoxShape(toBullet(primitive.size * 0.5f));
+            break;
+
+        case PrimitiveShape::SHAPE_CAPSULE:
+            switch (primitive.axis)
+            {
+                case PrimitiveShape::AXIS_X:
+                    m_pShape = new(m_storage) btCapsuleShapeX(primitive.radius, primitive.height);
+                    break;
+
+                case PrimitiveShape::AXIS_Y:
+                    m_pShape = new(m_storage) btCapsuleShape(primitive.radius, primitive.height);
+                    break;
+
+                case PrimitiveShape::AXIS_Z:
+                    m_pShape = new(m_storage) btCapsuleShapeZ(primitive.radius, primitive.height);
+                    break;
+            }
+            break;
+
+        case PrimitiveShape::SHAPE_CONE:
+            switch (primitive.axis)
+            {
+                case PrimitiveShape::AXIS_X:
+                    m_pShape = new(m_storage) btConeShapeX(primitive.radius, primitive.height);
+                    break;
+
+                case PrimitiveShape::AXIS_Y:
+                    m_pShape = new(m_storage) btConeShape(primitive.radius, primitive.height);
+                    break;
+
+                case PrimitiveShape::AXIS_Z:
+                    m_pShape = new(m_storage) btConeShapeZ(primitive.radius, primitive.height);
+                    break;
+            }
+            break;
+
+        case PrimitiveShape::SHAPE_CYLINDER:
+            switch (primitive.axis)
+            {
+                case PrimitiveShape::AXIS_X:
+                    m_pShape = new(m_storage) btCylinderShapeX(btVector3(primitive.height, primitive.radius, primitive.radius));
+                    break;
+
+                case PrimitiveShape::AXIS_Y:
+                    m_pShape = new(m_storage) btCylinderShape(btVector3(primitive.radius, primitive.height, primitive.radius));
+                    break;
+
+                case PrimitiveShape::AXIS_Z:
+                    m_pShape = new(m_storage) btCylinderShapeZ(btVector3(primitive.radius, primitive.radius, primitive.height));
+                    break;
+            }
+            break;
+
+        case PrimitiveShape::SHAPE_SPHERE:
+            m_pShape = new(m_storage) btSphereShape(primitive.radius);
+            break;
+    }
+
+    assert(m_pShape);
+}
+
+//-----------------------------------------------------------------------
+
+InlineShape::~InlineShape()
+{
+    m_pShape->~btConvexShape();
+}
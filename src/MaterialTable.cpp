@@ -0,0 +1,208 @@
+/** @file   MaterialTable.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::MaterialTable'
+*/
+
+#include <Athena-Physics/MaterialTable.h>
+#include <Athena-Physics/CollisionObject.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/************************************** CONSTANTS **************************************/
+
+MaterialTable* MaterialTable::_CurrentTable = 0;
+ContactAddedCallback MaterialTable::_PreviousCallback = 0;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+MaterialTable::MaterialTable()
+{
+    // The default material, combined like Bullet does
+    tMaterial material;
+    material.friction           = 0.5f;
+    material.restitution        = 0.0f;
+    material.frictionCombine    = COMBINE_MULTIPLY;
+    material.restitutionCombine = COMBINE_MULTIPLY;
+
+    m_materials.push_back(material);
+
+    updateCombinations();
+}
+
+//-----------------------------------------------------------------------
+
+MaterialTable::~MaterialTable()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+void MaterialTable::setMaterial(tMaterialID id, const tMaterial& material)
+{
+    assert(material.friction >= 0.0f);
+    assert(material.restitution >= 0.0f);
+
+    if (id >= m_materials.size())
+        m_materials.resize(id + 1, m_materials[DEFAULT_MATERIAL]);
+
+    m_materials[id] = material;
+
+    updateCombinations();
+}
+
+//-----------------------------------------------------------------------
+
+const MaterialTable::tMaterial& MaterialTable::getMaterial(tMaterialID id) const
+{
+    if (id >= m_materials.size())
+        return m_materials[DEFAULT_MATERIAL];
+
+    return m_materials[id];
+}
+
+//-----------------------------------------------------------------------
+
+void MaterialTable::setCombination(tMaterialID id1, tMaterialID id2, Math::Real friction,
+                                   Math::Real restitution)
+{
+    assert(friction >= 0.0f);
+    assert(restitution >= 0.0f);
+
+    tOverride entry;
+    entry.id1                       = id1;
+    entry.id2                       = id2;
+    entry.combination.friction      = friction;
+    entry.combination.restitution   = restitution;
+
+    // Replace the previous value if any
+    std::vector<tOverride>::iterator iter, iterEnd;
+    for (iter = m_overrides.begin(), iterEnd = m_overrides.end(); iter != iterEnd; ++iter)
+    {
+        if (((iter->id1 == id1) && (iter->id2 == id2)) || ((iter->id1 == id2) && (iter->id2 == id1)))
+        {
+            *iter = entry;
+            break;
+        }
+    }
+
+    if (iter == iterEnd)
+        m_overrides.push_back(entry);
+
+    // The materials must exist to be part of the table
+    tMaterialID maxId = std::max(id1, id2);
+    if (maxId >= m_materials.size())
+        m_materials.resize(maxId + 1, m_materials[DEFAULT_MATERIAL]);
+
+    updateCombinations();
+}
+
+//-----------------------------------------------------------------------
+
+void MaterialTable::resetCombinations()
+{
+    m_overrides.clear();
+    updateCombinations();
+}
+
+//-----------------------------------------------------------------------
+
+void MaterialTable::updateCombinations()
+{
+    unsigned int nbMaterials = (unsigned int) m_materials.size();
+
+    m_combinations.resize(nbMaterials * nbMaterials);
+
+    for (unsigned int i = 0; i < nbMaterials; ++i)
+    {
+        const tMaterial& material1 = m_materials[i];
+
+        for (unsigned int j = i; j < nbMaterials; ++j)
+        {
+            const tMaterial& material2 = m_materials[j];
+
+            tCombination combination;
+            combination.friction = combine(material1.friction, material2.friction,
+                                           std::max(material1.frictionCombine, material2.frictionCombine));
+            combination.restitution = combine(material1.restitution, material2.restitution,
+                                              std::max(material1.restitutionCombine, material2.restitutionCombine));
+
+            m_combinations[i * nbMaterials + j] = combination;
+            m_combinations[j * nbMaterials + i] = combination;
+        }
+    }
+
+    for (unsigned int i = 0; i < m_overrides.size(); ++i)
+    {
+        const tOverride& entry = m_overrides[i];
+
+        m_combinations[entry.id1 * nbMaterials + entry.id2] = entry.combination;
+        m_combinations[entry.id2 * nbMaterials + entry.id1] = entry.combination;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+btScalar MaterialTable::combine(btScalar value1, btScalar value2, tCombineMode mode)
+{
+    switch (mode)
+    {
+        case COMBINE_AVERAGE:   return (value1 + value2) * btScalar(0.5);
+        case COMBINE_MIN:       return btMin(value1, value2);
+        case COMBINE_MULTIPLY:  return value1 * value2;
+        case COMBINE_MAX:       return btMax(value1, value2);
+    }
+
+    return value1 * value2;
+}
+
+//-----------------------------------------------------------------------
+
+bool MaterialTable::contactAddedCallback(btManifoldPoint& cp,
+                                         const btCollisionObject* pObject0, int partId0, int index0,
+                                         const btCollisionObject* pObject1, int partId1, int index1)
+{
+    const CollisionObject* pComponent0 = static_cast<const CollisionObject*>(pObject0->getUserPointer());
+    const CollisionObject* pComponent1 = static_cast<const CollisionObject*>(pObject1->getUserPointer());
+
+    tMaterialID material0 = (pComponent0 ? pComponent0->getMaterial() : DEFAULT_MATERIAL);
+    tMaterialID material1 = (pComponent1 ? pComponent1->getMaterial() : DEFAULT_MATERIAL);
+
+    // When one of the objects uses the default material, the values combined by Bullet
+    // (from the ones of the Bullet's objects) are kept
+    if (MaterialTable::_CurrentTable && (material0 != DEFAULT_MATERIAL) &&
+        (material1 != DEFAULT_MATERIAL))
+    {
+        const tCombination& combination = MaterialTable::_CurrentTable->getCombination(material0, material1);
+
+        cp.m_combinedFriction       = combination.friction;
+        cp.m_combinedRestitution    = combination.restitution;
+    }
+
+    // The callback of the application might need to modify the contact too
+    if (MaterialTable::_PreviousCallback)
+    {
+        return MaterialTable::_PreviousCallback(cp, pObject0, partId0, index0,
+                                                pObject1, partId1, index1);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+void MaterialTable::installContactAddedCallback()
+{
+    // Already installed by another world?
+    if (gContactAddedCallback == &MaterialTable::contactAddedCallback)
+        return;
+
+    MaterialTable::_PreviousCallback = gContactAddedCallback;
+    gContactAddedCallback = &MaterialTable::contactAddedCallback;
+}
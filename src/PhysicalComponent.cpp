@@ -61,6 +61,22 @@ World* PhysicalComponent::getWorld() const
     return 0;
 }
 
+//-----------------------------------------------------------------------
+
+bool PhysicalComponent::isSimulationInProgress() const
+{
+    World* pWorld = getWorld();
+    return pWorld && pWorld->isStepInProgress();
+}
+
+//-----------------------------------------------------------------------
+
+Math::Vector3 PhysicalComponent::getWorldOrigin() const
+{
+    World* pWorld = getWorld();
+    return (pWorld ? pWorld->getOrigin() : Math::Vector3::ZERO);
+}
+
 
 /***************************** MANAGEMENT OF THE PROPERTIES ****************************/
 
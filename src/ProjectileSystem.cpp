@@ -0,0 +1,223 @@
+/** @file   ProjectileSystem.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::ProjectileSystem'
+*/
+
+#include <Athena-Physics/ProjectileSystem.h>
+#include <Athena-Physics/WorldSnapshot.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+ProjectileSystem::ProjectileSystem(World* pWorld)
+: m_pWorld(pWorld), m_nextID(0), m_collisionGroup(255), m_pListener(0)
+{
+    assert(pWorld);
+}
+
+//-----------------------------------------------------------------------
+
+ProjectileSystem::~ProjectileSystem()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+ProjectileSystem::tProjectileID ProjectileSystem::fire(const tProjectile& projectile)
+{
+    assert(projectile.drag >= 0.0f);
+    assert(projectile.lifetime > 0.0f);
+
+    m_channels[POSITION_X].push_back(projectile.position.x);
+    m_channels[POSITION_Y].push_back(projectile.position.y);
+    m_channels[POSITION_Z].push_back(projectile.position.z);
+    m_channels[VELOCITY_X].push_back(projectile.velocity.x);
+    m_channels[VELOCITY_Y].push_back(projectile.velocity.y);
+    m_channels[VELOCITY_Z].push_back(projectile.velocity.z);
+    m_channels[DRAG].push_back(projectile.drag);
+    m_channels[LIFETIME].push_back(projectile.lifetime);
+
+    m_ids.push_back(m_nextID);
+
+    return m_nextID++;
+}
+
+//-----------------------------------------------------------------------
+
+void ProjectileSystem::clear()
+{
+    for (unsigned int i = 0; i < NB_CHANNELS; ++i)
+        m_channels[i].resize(0);
+
+    m_ids.clear();
+}
+
+//-----------------------------------------------------------------------
+
+void ProjectileSystem::update(Real timeStep)
+{
+    assert(timeStep >= 0.0f);
+
+    const unsigned int nbProjectiles = (unsigned int) m_ids.size();
+
+    if ((timeStep <= 0.0f) || (nbProjectiles == 0))
+        return;
+
+    const Vector3 gravity = m_pWorld->getGravity();
+
+    const btScalar dt = timeStep;
+    const btScalar gx = gravity.x * dt;
+    const btScalar gy = gravity.y * dt;
+    const btScalar gz = gravity.z * dt;
+
+    btScalar* px = channel(POSITION_X);
+    btScalar* py = channel(POSITION_Y);
+    btScalar* pz = channel(POSITION_Z);
+    btScalar* vx = channel(VELOCITY_X);
+    btScalar* vy = channel(VELOCITY_Y);
+    btScalar* vz = channel(VELOCITY_Z);
+    btScalar* drags = channel(DRAG);
+    btScalar* lifetimes = channel(LIFETIME);
+
+    // Integration (the loops only contain arithmetic on the arrays, so they are
+    // vectorized by the compiler). The drag is applied implicitly, to stay stable with
+    // fast projectiles and large steps.
+    for (unsigned int i = 0; i < nbProjectiles; ++i)
+    {
+        btScalar x = vx[i] + gx;
+        btScalar y = vy[i] + gy;
+        btScalar z = vz[i] + gz;
+
+        btScalar scale = btScalar(1.0) / (btScalar(1.0) + drags[i] * btSqrt(x * x + y * y + z * z) * dt);
+
+        vx[i] = x * scale;
+        vy[i] = y * scale;
+        vz[i] = z * scale;
+
+        lifetimes[i] -= dt;
+    }
+
+    // Cast the segments travelled during the step
+    m_rays.resize(nbProjectiles);
+    m_rayHits.resize(nbProjectiles);
+
+    for (unsigned int i = 0; i < nbProjectiles; ++i)
+    {
+        World::tRay& ray = m_rays[i];
+
+        ray.from = Vector3(px[i], py[i], pz[i]);
+
+        px[i] += vx[i] * dt;
+        py[i] += vy[i] * dt;
+        pz[i] += vz[i] * dt;
+
+        ray.to = Vector3(px[i], py[i], pz[i]);
+    }
+
+    // The snapshot published at the end of the step is used when available: the rays
+    // are then split between the worker threads without building another one
+    const WorldSnapshot* pSnapshot = m_pWorld->getSnapshot();
+    if (pSnapshot)
+        m_pWorld->rayCastBatch(pSnapshot, &m_rays[0], nbProjectiles, &m_rayHits[0], m_collisionGroup);
+    else
+        m_pWorld->rayCastBatch(&m_rays[0], nbProjectiles, &m_rayHits[0], m_collisionGroup);
+
+    // Collect the impacts (in the order of the projectiles)
+    m_hits.clear();
+
+    for (unsigned int i = 0; i < nbProjectiles; ++i)
+    {
+        const World::tRayHit& rayHit = m_rayHits[i];
+        if (!rayHit.pObject)
+            continue;
+
+        tHit hit;
+        hit.id          = m_ids[i];
+        hit.pObject     = rayHit.pObject;
+        hit.position    = rayHit.position;
+        hit.normal      = rayHit.normal;
+        hit.velocity    = Vector3(vx[i], vy[i], vz[i]);
+
+        m_hits.push_back(hit);
+    }
+
+    // Destroy the projectiles that hit something or expired (the ones moved into the
+    // freed slots were already checked)
+    for (unsigned int i = nbProjectiles; i > 0; --i)
+    {
+        unsigned int index = i - 1;
+
+        if (m_rayHits[index].pObject || (lifetimes[index] <= btScalar(0.0)))
+            remove(index);
+    }
+
+    // Notify the listener last, so it can fire new projectiles. The impacts with the
+    // objects it removes from the world are discarded (see onObjectRemoved()).
+    if (m_pListener)
+    {
+        for (unsigned int i = 0; i < m_hits.size(); ++i)
+        {
+            if (m_hits[i].pObject)
+                m_pListener->onProjectileHit(m_hits[i]);
+        }
+    }
+
+    m_hits.clear();
+}
+
+//-----------------------------------------------------------------------
+
+void ProjectileSystem::onObjectRemoved(CollisionObject* pObject)
+{
+    assert(pObject);
+
+    for (unsigned int i = 0; i < m_hits.size(); ++i)
+    {
+        if (m_hits[i].pObject == pObject)
+            m_hits[i].pObject = 0;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+Vector3 ProjectileSystem::getPosition(unsigned int index) const
+{
+    assert(index < m_ids.size());
+
+    return Vector3(m_channels[POSITION_X][index], m_channels[POSITION_Y][index],
+                   m_channels[POSITION_Z][index]);
+}
+
+//-----------------------------------------------------------------------
+
+Vector3 ProjectileSystem::getVelocity(unsigned int index) const
+{
+    assert(index < m_ids.size());
+
+    return Vector3(m_channels[VELOCITY_X][index], m_channels[VELOCITY_Y][index],
+                   m_channels[VELOCITY_Z][index]);
+}
+
+
+/*********************************** INTERNAL METHODS **********************************/
+
+void ProjectileSystem::remove(unsigned int index)
+{
+    unsigned int last = (unsigned int) m_ids.size() - 1;
+
+    for (unsigned int i = 0; i < NB_CHANNELS; ++i)
+    {
+        m_channels[i][index] = m_channels[i][last];
+        m_channels[i].pop_back();
+    }
+
+    m_ids[index] = m_ids[last];
+    m_ids.pop_back();
+}
@@ -0,0 +1,484 @@
+/** @file   QueryQueue.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::QueryQueue'
+*/
+
+#include <Athena-Physics/QueryQueue.h>
+#include <Athena-Physics/WorldSnapshot.h>
+#include <LinearMath/btQuickprof.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/************************************** CONSTANTS **************************************/
+
+// Number of queries processed between two checks of the time budget (without task
+// scheduler)
+static const unsigned int QUERIES_PER_CHECK = 32;
+
+
+/************************************* INTERNAL TYPES **********************************/
+
+// Task processing a range of the pending rays and sweeps (on a snapshot of the world if
+// several tasks are running concurrently: the queries of Bullet aren't thread-safe)
+class QueryQueue::ProcessTask: public ITaskScheduler::ITask
+{
+public:
+    ProcessTask()
+    : pQueue(0), pSnapshot(0), pHandles(0), nbHandles(0)
+    {
+    }
+
+    virtual void execute()
+    {
+        for (size_t i = 0; i < nbHandles; ++i)
+        {
+            tQuery& query = pQueue->m_queries[pHandles[i].slot];
+            if ((query.state == STATE_PENDING) && (query.serial == pHandles[i].serial) &&
+                (query.type != QUERY_OVERLAP))
+            {
+                pQueue->execute(query, pSnapshot);
+            }
+        }
+    }
+
+    QueryQueue*             pQueue;
+    const WorldSnapshot*    pSnapshot;
+    const tQueryHandle*     pHandles;
+    size_t                  nbHandles;
+};
+
+
+// Task processing the pending queries on a snapshot of the world
+class QueryQueue::AsynchronousTask: public ITaskScheduler::ITask
+{
+public:
+    AsynchronousTask()
+    : pQueue(0), pSnapshot(0), budget(0.0f), nbProcessed(0)
+    {
+    }
+
+    virtual void execute()
+    {
+        nbProcessed = pQueue->process(pSnapshot, budget);
+    }
+
+    QueryQueue*             pQueue;
+    const WorldSnapshot*    pSnapshot;
+    Math::Real              budget;
+    unsigned int            nbProcessed;
+};
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+QueryQueue::QueryQueue(World* pWorld)
+: m_pWorld(pWorld), m_firstPending(0), m_nextSerial(1), m_budget(0.0f),
+  m_bAsynchronous(false), m_pAsynchronousTask(0), m_asynchronousHandle(0), m_bRunning(false)
+{
+    assert(pWorld);
+
+    m_pAsynchronousTask = new AsynchronousTask();
+    m_pAsynchronousTask->pQueue = this;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::~QueryQueue()
+{
+    assert(!m_bRunning);
+
+    delete m_pAsynchronousTask;
+}
+
+
+/**************************************** METHODS **************************************/
+
+QueryQueue::tQueryHandle QueryQueue::submitRayCast(const World::tRay& ray, tCollisionGroup group)
+{
+    tQueryHandle handle = allocate(QUERY_RAY, group);
+    m_queries[handle.slot].ray = ray;
+    return handle;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tQueryHandle QueryQueue::submitSweep(const World::tPrimitive& primitive,
+                                                 const World::tSweep& sweep,
+                                                 tCollisionGroup group)
+{
+    tQueryHandle handle = allocate(QUERY_SWEEP, group);
+    m_queries[handle.slot].primitive = primitive;
+    m_queries[handle.slot].sweep = sweep;
+    return handle;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tQueryHandle QueryQueue::submitOverlap(const World::tPrimitive& primitive,
+                                                   const World::tPose& pose,
+                                                   tCollisionGroup group)
+{
+    tQueryHandle handle = allocate(QUERY_OVERLAP, group);
+    m_queries[handle.slot].primitive = primitive;
+    m_queries[handle.slot].pose = pose;
+    return handle;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tStatus QueryQueue::getRayCastResult(const tQueryHandle& handle, World::tRayHit &hit)
+{
+    tQuery* pQuery = getQuery(handle, QUERY_RAY);
+    if (!pQuery)
+        return STATUS_INVALID;
+
+    if (pQuery->state == STATE_PENDING)
+        return STATUS_PENDING;
+
+    hit = pQuery->hit;
+    release(handle.slot);
+
+    return STATUS_DONE;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tStatus QueryQueue::getSweepResult(const tQueryHandle& handle, World::tSweepHit &hit)
+{
+    tQuery* pQuery = getQuery(handle, QUERY_SWEEP);
+    if (!pQuery)
+        return STATUS_INVALID;
+
+    if (pQuery->state == STATE_PENDING)
+        return STATUS_PENDING;
+
+    hit = pQuery->hit;
+    release(handle.slot);
+
+    return STATUS_DONE;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tStatus QueryQueue::getOverlapResult(const tQueryHandle& handle, CollisionObject** pResults,
+                                                 unsigned int maxResults, unsigned int &nbResults)
+{
+    assert(pResults || (maxResults == 0));
+
+    nbResults = 0;
+
+    tQuery* pQuery = getQuery(handle, QUERY_OVERLAP);
+    if (!pQuery)
+        return STATUS_INVALID;
+
+    if (pQuery->state == STATE_PENDING)
+        return STATUS_PENDING;
+
+    nbResults = std::min(maxResults, pQuery->nbResults);
+    for (unsigned int i = 0; i < nbResults; ++i)
+        pResults[i] = pQuery->results[i];
+
+    release(handle.slot);
+
+    return STATUS_DONE;
+}
+
+//-----------------------------------------------------------------------
+
+void QueryQueue::cancel(const tQueryHandle& handle)
+{
+    assert(!m_bRunning);
+
+    if ((handle.slot < m_queries.size()) && (m_queries[handle.slot].serial == handle.serial) &&
+        (m_queries[handle.slot].state != STATE_FREE))
+    {
+        // A cancelled query isn't pending anymore
+        if (m_queries[handle.slot].state == STATE_PENDING)
+        {
+            for (size_t i = m_firstPending; i < m_pending.size(); ++i)
+            {
+                if ((m_pending[i].slot == handle.slot) && (m_pending[i].serial == handle.serial))
+                {
+                    m_pending.erase(m_pending.begin() + i);
+                    break;
+                }
+            }
+        }
+
+        release(handle.slot);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int QueryQueue::process(Math::Real budget)
+{
+    assert(!m_bRunning);
+
+    btClock clock;
+
+    ITaskScheduler* pScheduler = m_pWorld->getTaskScheduler();
+
+    size_t queriesPerChunk = QUERIES_PER_CHECK;
+    if (pScheduler)
+        queriesPerChunk = World::QUERIES_PER_TASK * std::max(pScheduler->getNbThreads(), 1u);
+
+    unsigned long maxMicroseconds = (unsigned long) (budget * 1e6f);
+    unsigned int nbProcessed = 0;
+
+    std::vector<ProcessTask> tasks;
+    std::vector<ITaskScheduler::ITask*> taskPtrs;
+
+    // The snapshot used by the worker threads is only retrieved when needed (it is built
+    // at most once per step)
+    const WorldSnapshot* pSnapshot = 0;
+
+    while (m_firstPending < m_pending.size())
+    {
+        if ((budget > 0.0f) && (clock.getTimeMicroseconds() >= maxMicroseconds))
+            break;
+
+        size_t nbQueries = std::min(queriesPerChunk, m_pending.size() - m_firstPending);
+        const tQueryHandle* pHandles = &m_pending[m_firstPending];
+
+        // Rays and sweeps can be processed by the worker threads
+        if (pScheduler)
+        {
+            unsigned int nbTasks = (unsigned int) ((nbQueries + World::QUERIES_PER_TASK - 1) / World::QUERIES_PER_TASK);
+
+            tasks.resize(nbTasks);
+            taskPtrs.resize(nbTasks);
+
+            if ((nbTasks > 1) && !pSnapshot)
+                pSnapshot = m_pWorld->buildBatchSnapshot();
+
+            for (unsigned int i = 0; i < nbTasks; ++i)
+            {
+                size_t first = i * World::QUERIES_PER_TASK;
+
+                tasks[i].pQueue     = this;
+                tasks[i].pSnapshot  = (nbTasks > 1 ? pSnapshot : 0);
+                tasks[i].pHandles   = pHandles + first;
+                tasks[i].nbHandles  = std::min((size_t) World::QUERIES_PER_TASK, nbQueries - first);
+                taskPtrs[i]         = &tasks[i];
+            }
+
+            m_pWorld->runTasks(&taskPtrs[0], nbTasks);
+        }
+
+        // The remaining ones (overlaps use the collision dispatcher, which isn't
+        // thread-safe) are processed on this thread
+        for (size_t i = 0; i < nbQueries; ++i)
+        {
+            tQuery& query = m_queries[pHandles[i].slot];
+            if (query.serial != pHandles[i].serial)
+                continue;
+
+            if (query.state == STATE_PENDING)
+                execute(query);
+
+            ++nbProcessed;
+        }
+
+        m_firstPending += nbQueries;
+    }
+
+    if (m_firstPending == m_pending.size())
+    {
+        m_pending.clear();
+        m_firstPending = 0;
+    }
+
+    return nbProcessed;
+}
+
+//-----------------------------------------------------------------------
+
+bool QueryQueue::launch()
+{
+    assert(!m_bRunning);
+
+    ITaskScheduler* pScheduler = m_pWorld->getTaskScheduler();
+    const WorldSnapshot* pSnapshot = m_pWorld->getSnapshot();
+
+    if (!m_bAsynchronous || !pScheduler || !pSnapshot)
+        return false;
+
+    m_pAsynchronousTask->pSnapshot      = pSnapshot;
+    m_pAsynchronousTask->budget         = m_budget;
+    m_pAsynchronousTask->nbProcessed    = 0;
+
+    m_asynchronousHandle = pScheduler->submit(m_pAsynchronousTask);
+    m_bRunning = true;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int QueryQueue::wait()
+{
+    if (!m_bRunning)
+        return 0;
+
+    m_pWorld->getTaskScheduler()->wait(m_asynchronousHandle);
+    m_bRunning = false;
+
+    return m_pAsynchronousTask->nbProcessed;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int QueryQueue::process(const WorldSnapshot* pSnapshot, Math::Real budget)
+{
+    assert(pSnapshot);
+
+    btClock clock;
+
+    unsigned long maxMicroseconds = (unsigned long) (budget * 1e6f);
+    unsigned int nbProcessed = 0;
+
+    // The snapshot can be used by this thread for any kind of query
+    while (m_firstPending < m_pending.size())
+    {
+        if ((budget > 0.0f) && (clock.getTimeMicroseconds() >= maxMicroseconds))
+            break;
+
+        size_t nbQueries = std::min((size_t) QUERIES_PER_CHECK, m_pending.size() - m_firstPending);
+        const tQueryHandle* pHandles = &m_pending[m_firstPending];
+
+        for (size_t i = 0; i < nbQueries; ++i)
+        {
+            tQuery& query = m_queries[pHandles[i].slot];
+            if (query.serial != pHandles[i].serial)
+                continue;
+
+            if (query.state == STATE_PENDING)
+                execute(query, pSnapshot);
+
+            ++nbProcessed;
+        }
+
+        m_firstPending += nbQueries;
+    }
+
+    if (m_firstPending == m_pending.size())
+    {
+        m_pending.clear();
+        m_firstPending = 0;
+    }
+
+    return nbProcessed;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tQueryHandle QueryQueue::allocate(tQueryType type, tCollisionGroup group)
+{
+    assert(!m_bRunning);
+
+    tQueryHandle handle;
+
+    if (!m_freeSlots.empty())
+    {
+        handle.slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    }
+    else
+    {
+        handle.slot = (unsigned int) m_queries.size();
+        m_queries.push_back(tQuery());
+    }
+
+    handle.serial = m_nextSerial++;
+    if (m_nextSerial == 0)
+        m_nextSerial = 1;
+
+    tQuery& query = m_queries[handle.slot];
+    query.type      = type;
+    query.state     = STATE_PENDING;
+    query.serial    = handle.serial;
+    query.group     = group;
+    query.nbResults = 0;
+
+    m_pending.push_back(handle);
+
+    return handle;
+}
+
+//-----------------------------------------------------------------------
+
+QueryQueue::tQuery* QueryQueue::getQuery(const tQueryHandle& handle, tQueryType type)
+{
+    assert(!m_bRunning);
+
+    if ((handle.slot >= m_queries.size()) || (handle.serial == 0))
+        return 0;
+
+    tQuery& query = m_queries[handle.slot];
+    if ((query.serial != handle.serial) || (query.state == STATE_FREE) || (query.type != type))
+        return 0;
+
+    return &query;
+}
+
+//-----------------------------------------------------------------------
+
+void QueryQueue::release(unsigned int slot)
+{
+    assert(slot < m_queries.size());
+
+    m_queries[slot].state = STATE_FREE;
+    m_queries[slot].serial = 0;
+    m_freeSlots.push_back(slot);
+}
+
+//-----------------------------------------------------------------------
+
+void QueryQueue::execute(tQuery& query, const WorldSnapshot* pSnapshot)
+{
+    if (pSnapshot)
+    {
+        switch (query.type)
+        {
+            case QUERY_RAY:
+                pSnapshot->rayCast(query.ray, query.hit, query.group);
+                break;
+
+            case QUERY_SWEEP:
+                pSnapshot->sweep(query.primitive, query.sweep, query.hit, query.group);
+                break;
+
+            case QUERY_OVERLAP:
+                query.nbResults = pSnapshot->overlap(query.primitive, query.pose, query.results,
+                                                     MAX_OVERLAP_RESULTS, query.group);
+                break;
+        }
+
+        query.state = STATE_DONE;
+        return;
+    }
+
+    switch (query.type)
+    {
+        case QUERY_RAY:
+            m_pWorld->rayCast(query.ray, query.hit, query.group);
+            break;
+
+        case QUERY_SWEEP:
+            m_pWorld->sweep(query.primitive, query.sweep, query.hit, query.group);
+            break;
+
+        case QUERY_OVERLAP:
+            query.nbResults = m_pWorld->overlap(query.primitive, query.pose, query.results,
+                                                MAX_OVERLAP_RESULTS, query.group);
+            break;
+    }
+
+    query.state = STATE_DONE;
+}
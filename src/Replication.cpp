@@ -0,0 +1,285 @@
+/** @file   Replication.cpp
+    @author Philip Abbet
+
+    Implementation of the functions shared by the encoder and the decoder of the network
+    replication of the bodies
+*/
+
+#include <Athena-Physics/Replication.h>
+#include <Athena-Physics/BitStream.h>
+#include <Athena-Physics/Conversions.h>
+#include <math.h>
+#include <string.h>
+
+
+using namespace Athena;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    enum tField
+    {
+        FIELD_POSITION          = 1,
+        FIELD_ORIENTATION       = 2,
+        FIELD_LINEAR_VELOCITY   = 4,
+        FIELD_ANGULAR_VELOCITY  = 8,
+    };
+
+    const unsigned int NB_FIELDS = 4;
+
+
+    inline int quantize(btScalar value, btScalar precision)
+    {
+        return (int) floor(value / precision + btScalar(0.5));
+    }
+
+
+    inline void quantize(const btVector3& v, btScalar precision, int* pDest)
+    {
+        pDest[0] = quantize(v.getX(), precision);
+        pDest[1] = quantize(v.getY(), precision);
+        pDest[2] = quantize(v.getZ(), precision);
+    }
+
+
+    inline void quantize(const Math::Vector3& v, btScalar precision, int* pDest)
+    {
+        pDest[0] = quantize(btScalar(v.x), precision);
+        pDest[1] = quantize(btScalar(v.y), precision);
+        pDest[2] = quantize(btScalar(v.z), precision);
+    }
+
+
+    inline btVector3 dequantize(const int* pSrc, btScalar precision)
+    {
+        return btVector3(pSrc[0] * precision, pSrc[1] * precision, pSrc[2] * precision);
+    }
+
+
+    inline bool isSame(const int* pValues1, const int* pValues2)
+    {
+        return (pValues1[0] == pValues2[0]) && (pValues1[1] == pValues2[1]) &&
+               (pValues1[2] == pValues2[2]);
+    }
+
+
+    // "Smallest three" encoding: the largest component (in absolute value) is dropped,
+    // and retrieved from the others since the quaternion is normalized. Its index is
+    // stored in the two first bits, followed by the other components, which are in the
+    // range [-1/sqrt(2), 1/sqrt(2)].
+    unsigned int quantizeOrientation(const btQuaternion& orientation, unsigned int nbBits)
+    {
+        btQuaternion q = orientation.normalized();
+
+        int largest = 0;
+        for (int i = 1; i < 4; ++i)
+        {
+            if (btFabs(q[i]) > btFabs(q[largest]))
+                largest = i;
+        }
+
+        // q and -q are the same orientation: make the dropped component positive
+        btScalar sign = (q[largest] < btScalar(0.0) ? btScalar(-1.0) : btScalar(1.0));
+        btScalar max = btScalar((1 << nbBits) - 1);
+
+        unsigned int result = (unsigned int) largest;
+        unsigned int shift = 2;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i == largest)
+                continue;
+
+            btScalar normalized = (q[i] * sign * SIMDSQRT12 * btScalar(2.0) + btScalar(1.0)) * btScalar(0.5);
+            int value = (int) floor(normalized * max + btScalar(0.5));
+            value = btMax(0, btMin(value, (int) max));
+
+            result |= (unsigned int) value << shift;
+            shift += nbBits;
+        }
+
+        return result;
+    }
+
+
+    btQuaternion dequantizeOrientation(unsigned int orientation, unsigned int nbBits)
+    {
+        int largest = (int) (orientation & 3);
+        unsigned int mask = (1 << nbBits) - 1;
+        btScalar max = btScalar(mask);
+
+        btScalar components[4];
+        btScalar sum = btScalar(0.0);
+        unsigned int shift = 2;
+
+        for (int i = 0; i < 4; ++i)
+        {
+            if (i == largest)
+                continue;
+
+            btScalar normalized = btScalar((orientation >> shift) & mask) / max;
+            components[i] = (normalized * btScalar(2.0) - btScalar(1.0)) * SIMDSQRT12;
+            sum += components[i] * components[i];
+            shift += nbBits;
+        }
+
+        components[largest] = btSqrt(btMax(btScalar(0.0), btScalar(1.0) - sum));
+
+        btQuaternion q(components[0], components[1], components[2], components[3]);
+        return q.normalized();
+    }
+
+
+    inline void writeDelta(BitStream &stream, const int* pValues, const int* pBaseline)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+            stream.writeVariableSigned(pValues[i] - pBaseline[i]);
+    }
+
+
+    inline void readDelta(BitStream &stream, const int* pBaseline, int* pValues)
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+            pValues[i] = pBaseline[i] + stream.readVariableSigned();
+    }
+}
+
+
+namespace Athena {
+namespace Physics {
+
+/************************************ QUANTIZATION *************************************/
+
+void quantizeBodyState(const btRigidBody* pRigidBody, const Math::Vector3& origin,
+                       const tReplicationSettings& settings, tQuantizedBodyState &state)
+{
+    assert(pRigidBody);
+    assert(settings.orientationBits >= 2);
+    assert(settings.orientationBits <= 10);
+
+    const btTransform& transform = pRigidBody->getCenterOfMassTransform();
+
+    quantize(fromBulletPosition(transform.getOrigin(), origin), settings.positionPrecision,
+             state.position);
+    state.orientation = quantizeOrientation(transform.getRotation(), settings.orientationBits);
+
+    if (settings.bVelocities)
+    {
+        quantize(pRigidBody->getLinearVelocity(), settings.velocityPrecision, state.linearVelocity);
+        quantize(pRigidBody->getAngularVelocity(), settings.velocityPrecision, state.angularVelocity);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            state.linearVelocity[i] = 0;
+            state.angularVelocity[i] = 0;
+        }
+    }
+
+    state.bPresent = true;
+}
+
+//-----------------------------------------------------------------------
+
+void dequantizeBodyState(const tQuantizedBodyState& state, const Math::Vector3& origin,
+                         const tReplicationSettings& settings, btTransform &transform,
+                         btVector3 &linearVelocity, btVector3 &angularVelocity)
+{
+    Math::Vector3 position(state.position[0] * settings.positionPrecision,
+                           state.position[1] * settings.positionPrecision,
+                           state.position[2] * settings.positionPrecision);
+
+    transform.setOrigin(toBulletPosition(position, origin));
+    transform.setRotation(dequantizeOrientation(state.orientation, settings.orientationBits));
+
+    linearVelocity = dequantize(state.linearVelocity, settings.velocityPrecision);
+    angularVelocity = dequantize(state.angularVelocity, settings.velocityPrecision);
+}
+
+//-----------------------------------------------------------------------
+
+bool isSameBodyState(const tQuantizedBodyState& state1, const tQuantizedBodyState& state2)
+{
+    if (state1.bPresent != state2.bPresent)
+        return false;
+
+    if (!state1.bPresent)
+        return true;
+
+    return isSame(state1.position, state2.position) &&
+           (state1.orientation == state2.orientation) &&
+           isSame(state1.linearVelocity, state2.linearVelocity) &&
+           isSame(state1.angularVelocity, state2.angularVelocity);
+}
+
+
+/************************************* SERIALIZATION ***********************************/
+
+void writeBodyState(BitStream &stream, const tQuantizedBodyState& state,
+                    const tQuantizedBodyState& baseline, const tReplicationSettings& settings)
+{
+    unsigned int fields = 0;
+
+    if (!isSame(state.position, baseline.position))
+        fields |= FIELD_POSITION;
+
+    if (state.orientation != baseline.orientation)
+        fields |= FIELD_ORIENTATION;
+
+    if (!isSame(state.linearVelocity, baseline.linearVelocity))
+        fields |= FIELD_LINEAR_VELOCITY;
+
+    if (!isSame(state.angularVelocity, baseline.angularVelocity))
+        fields |= FIELD_ANGULAR_VELOCITY;
+
+    stream.write(fields, NB_FIELDS);
+
+    if (fields & FIELD_POSITION)
+        writeDelta(stream, state.position, baseline.position);
+
+    // The orientations don't change smoothly enough in their encoded form to benefit from
+    // a delta
+    if (fields & FIELD_ORIENTATION)
+        stream.write(state.orientation, 2 + 3 * settings.orientationBits);
+
+    if (fields & FIELD_LINEAR_VELOCITY)
+        writeDelta(stream, state.linearVelocity, baseline.linearVelocity);
+
+    if (fields & FIELD_ANGULAR_VELOCITY)
+        writeDelta(stream, state.angularVelocity, baseline.angularVelocity);
+}
+
+//-----------------------------------------------------------------------
+
+void readBodyState(BitStream &stream, const tQuantizedBodyState& baseline,
+                   const tReplicationSettings& settings, tQuantizedBodyState &state)
+{
+    unsigned int fields = stream.read(NB_FIELDS);
+
+    if (fields & FIELD_POSITION)
+        readDelta(stream, baseline.position, state.position);
+    else
+        memcpy(state.position, baseline.position, sizeof(state.position));
+
+    if (fields & FIELD_ORIENTATION)
+        state.orientation = stream.read(2 + 3 * settings.orientationBits);
+    else
+        state.orientation = baseline.orientation;
+
+    if (fields & FIELD_LINEAR_VELOCITY)
+        readDelta(stream, baseline.linearVelocity, state.linearVelocity);
+    else
+        memcpy(state.linearVelocity, baseline.linearVelocity, sizeof(state.linearVelocity));
+
+    if (fields & FIELD_ANGULAR_VELOCITY)
+        readDelta(stream, baseline.angularVelocity, state.angularVelocity);
+    else
+        memcpy(state.angularVelocity, baseline.angularVelocity, sizeof(state.angularVelocity));
+}
+
+}
+}
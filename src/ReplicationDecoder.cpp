@@ -0,0 +1,174 @@
+/** @file   ReplicationDecoder.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::ReplicationDecoder'
+*/
+
+#include <Athena-Physics/ReplicationDecoder.h>
+#include <Athena-Physics/BitStream.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <string.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+ReplicationDecoder::ReplicationDecoder(World* pWorld, const tReplicationSettings& settings)
+: m_pWorld(pWorld), m_settings(settings), m_lastFrame(0), m_bHasLastFrame(false)
+{
+    assert(pWorld);
+
+    for (unsigned int i = 0; i < NB_FRAMES; ++i)
+    {
+        m_frames[i].id = 0;
+        m_frames[i].bValid = false;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+ReplicationDecoder::~ReplicationDecoder()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+bool ReplicationDecoder::decode(BitStream &stream, unsigned short &frame)
+{
+    assert(!m_pWorld->isStepInProgress());
+
+    tQuantizedBodyState empty;
+    memset(&empty, 0, sizeof(tQuantizedBodyState));
+
+    // Header
+    frame = (unsigned short) stream.read(16);
+
+    const tFrame* pBaseline = 0;
+    if (stream.readBool())
+    {
+        unsigned short baseline = (unsigned short) stream.read(16);
+
+        const tFrame& baselineFrame = m_frames[baseline % NB_FRAMES];
+        if (!baselineFrame.bValid || (baselineFrame.id != baseline) || (baseline == frame))
+            return false;
+
+        pBaseline = &baselineFrame;
+    }
+
+    if (stream.hasOverflowed())
+        return false;
+
+    // Start from the baseline, and read the bodies that changed (decoded in a temporary
+    // frame, since the baseline might use the same slot)
+    tFrame decoded;
+    decoded.id = frame;
+    decoded.bValid = true;
+
+    if (pBaseline)
+        decoded.states = pBaseline->states;
+
+    unsigned int index = 0;
+    while (stream.readBool())
+    {
+        index += stream.readVariable();
+
+        // Protection against corrupted data
+        if (stream.hasOverflowed() || (index > 0xFFFFF))
+            return false;
+
+        if (index >= decoded.states.size())
+            decoded.states.resize(index + 1, empty);
+
+        tQuantizedBodyState& state = decoded.states[index];
+
+        if (stream.readBool())
+        {
+            tQuantizedBodyState base = (state.bPresent ? state : empty);
+            readBodyState(stream, base, m_settings, state);
+            state.bPresent = true;
+        }
+        else
+        {
+            state = empty;
+        }
+
+        ++index;
+    }
+
+    if (stream.hasOverflowed())
+        return false;
+
+    m_frames[frame % NB_FRAMES] = decoded;
+
+    // Only apply the frames more recent than the last one (comparison robust to the
+    // wrap-around of the identifiers)
+    if (!m_bHasLastFrame || ((short) (frame - m_lastFrame) > 0))
+    {
+        apply(decoded);
+
+        m_lastFrame = frame;
+        m_bHasLastFrame = true;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+void ReplicationDecoder::reset()
+{
+    for (unsigned int i = 0; i < NB_FRAMES; ++i)
+        m_frames[i].bValid = false;
+
+    m_applied.clear();
+    m_bHasLastFrame = false;
+}
+
+//-----------------------------------------------------------------------
+
+void ReplicationDecoder::apply(const tFrame& frame)
+{
+    m_applied.resize(frame.states.size());
+
+    btTransform transform;
+    btVector3 linearVelocity;
+    btVector3 angularVelocity;
+
+    for (unsigned int i = 0; i < frame.states.size(); ++i)
+    {
+        const tQuantizedBodyState& state = frame.states[i];
+
+        // Only touch the bodies whose state changed since the last frame applied
+        if (!state.bPresent || isSameBodyState(state, m_applied[i]))
+            continue;
+
+        m_applied[i] = state;
+
+        Body* pBody = m_pWorld->getBody(i);
+        if (!pBody)
+            continue;
+
+        dequantizeBodyState(state, m_pWorld->getOrigin(), m_settings, transform,
+                            linearVelocity, angularVelocity);
+
+        btRigidBody* pRigidBody = pBody->getRigidBody();
+
+        pRigidBody->setCenterOfMassTransform(transform);
+
+        if (m_settings.bVelocities)
+        {
+            pRigidBody->setLinearVelocity(linearVelocity);
+            pRigidBody->setAngularVelocity(angularVelocity);
+        }
+
+        pRigidBody->activate(true);
+
+        // Move the entity too (the static and kinematic bodies follow it)
+        pBody->setWorldTransform(transform);
+    }
+}
@@ -0,0 +1,146 @@
+/** @file   ReplicationEncoder.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::ReplicationEncoder'
+*/
+
+#include <Athena-Physics/ReplicationEncoder.h>
+#include <Athena-Physics/BitStream.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <algorithm>
+#include <string.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+ReplicationEncoder::ReplicationEncoder(World* pWorld, const tReplicationSettings& settings)
+: m_pWorld(pWorld), m_settings(settings), m_nextFrame(0), m_baseline(0),
+  m_bHasBaseline(false), m_nbEncodedBodies(0)
+{
+    assert(pWorld);
+
+    for (unsigned int i = 0; i < NB_FRAMES; ++i)
+    {
+        m_frames[i].id = 0;
+        m_frames[i].bValid = false;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+ReplicationEncoder::~ReplicationEncoder()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+unsigned short ReplicationEncoder::encode(BitStream &stream)
+{
+    assert(!m_pWorld->isStepInProgress());
+
+    tQuantizedBodyState empty;
+    memset(&empty, 0, sizeof(tQuantizedBodyState));
+
+    // Quantize the state of the bodies
+    tFrame& frame = m_frames[m_nextFrame % NB_FRAMES];
+    frame.id = m_nextFrame;
+    frame.bValid = true;
+    frame.states.resize(m_pWorld->getNbBodySlots());
+
+    for (unsigned int i = 0; i < frame.states.size(); ++i)
+    {
+        Body* pBody = m_pWorld->getBody(i);
+        if (pBody)
+            quantizeBodyState(pBody->getRigidBody(), m_pWorld->getOrigin(), m_settings,
+                              frame.states[i]);
+        else
+            frame.states[i] = empty;
+    }
+
+    // The baseline might have been overwritten since it was acknowledged
+    const tFrame* pBaseline = 0;
+    if (m_bHasBaseline)
+    {
+        const tFrame& baseline = m_frames[m_baseline % NB_FRAMES];
+        if (baseline.bValid && (baseline.id == m_baseline) && (m_baseline != m_nextFrame))
+            pBaseline = &baseline;
+        else
+            m_bHasBaseline = false;
+    }
+
+    // Header
+    stream.write(frame.id, 16);
+    stream.writeBool(pBaseline != 0);
+    if (pBaseline)
+        stream.write(pBaseline->id, 16);
+
+    // Write the bodies that changed since the baseline
+    unsigned int nbStates = (unsigned int) frame.states.size();
+    if (pBaseline)
+        nbStates = std::max(nbStates, (unsigned int) pBaseline->states.size());
+
+    unsigned int nextIndex = 0;
+    m_nbEncodedBodies = 0;
+
+    for (unsigned int i = 0; i < nbStates; ++i)
+    {
+        const tQuantizedBodyState& state = (i < frame.states.size() ? frame.states[i] : empty);
+        const tQuantizedBodyState& base = ((pBaseline && (i < pBaseline->states.size()) &&
+                                            pBaseline->states[i].bPresent) ?
+                                                pBaseline->states[i] : empty);
+
+        if (pBaseline && isSameBodyState(state, base))
+            continue;
+
+        if (!pBaseline && !state.bPresent)
+            continue;
+
+        stream.writeBool(true);
+        stream.writeVariable(i - nextIndex);
+        stream.writeBool(state.bPresent);
+
+        if (state.bPresent)
+        {
+            writeBodyState(stream, state, base, m_settings);
+            ++m_nbEncodedBodies;
+        }
+
+        nextIndex = i + 1;
+    }
+
+    stream.writeBool(false);
+
+    ++m_nextFrame;
+
+    return frame.id;
+}
+
+//-----------------------------------------------------------------------
+
+void ReplicationEncoder::acknowledge(unsigned short frame)
+{
+    // Ignore the acknowledgements of frames older than the baseline (comparison
+    // robust to the wrap-around of the identifiers)
+    if (m_bHasBaseline && ((short) (frame - m_baseline) <= 0))
+        return;
+
+    // Ignore the frames not encoded yet
+    if ((short) (m_nextFrame - frame) <= 0)
+        return;
+
+    m_baseline = frame;
+    m_bHasBaseline = true;
+}
+
+//-----------------------------------------------------------------------
+
+void ReplicationEncoder::reset()
+{
+    m_bHasBaseline = false;
+}
@@ -0,0 +1,465 @@
+/** @file   SimulationLod.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::SimulationLod'
+*/
+
+#include <Athena-Physics/SimulationLod.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/Conversions.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Scale of the objects compatible with all the others (the static ones)
+    const unsigned int ANY_SCALE = 0xFFFFFFFF;
+
+    // Phase of the simulation islands without reduced body
+    const unsigned int NO_PHASE = 0xFFFFFFFF;
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+SimulationLod::SimulationLod(World* pWorld)
+: m_pWorld(pWorld), m_hysteresis(Real(2.0)), m_distanceScale(Real(1.0)), m_nbSkippedBodies(0),
+  m_step(0)
+{
+    assert(pWorld);
+}
+
+//-----------------------------------------------------------------------
+
+SimulationLod::~SimulationLod()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+void SimulationLod::setBands(const tBand* pBands, unsigned int nbBands)
+{
+    assert(pBands || (nbBands == 0));
+    assert(m_modifiedBodies.size() == 0);
+
+    m_bands.assign(pBands, pBands + nbBands);
+
+#ifndef NDEBUG
+    for (unsigned int i = 1; i < nbBands; ++i)
+        assert(m_bands[i].distance > m_bands[i - 1].distance);
+#endif
+
+    // Start over from the full rate
+    m_bodies.clear();
+}
+
+//-----------------------------------------------------------------------
+
+void SimulationLod::setObservers(const Vector3* pPositions, unsigned int nbObservers)
+{
+    assert(pPositions || (nbObservers == 0));
+
+    m_observers.assign(pPositions, pPositions + nbObservers);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int SimulationLod::getBand(Body* pBody) const
+{
+    assert(pBody);
+
+    unsigned int index = pBody->getWorldIndex();
+    if ((index == Body::INVALID_INDEX) || (index >= m_bodies.size()))
+        return 0;
+
+    return m_bodies[index].band;
+}
+
+//-----------------------------------------------------------------------
+
+void SimulationLod::beforeStep()
+{
+    assert(m_modifiedBodies.size() == 0);
+    assert(m_reducedBodies.empty());
+
+    if (m_bands.empty() || m_observers.empty())
+        return;
+
+    // The observers are in the coordinates of the entities
+    m_localObservers.resize((int) m_observers.size());
+    for (unsigned int i = 0; i < m_observers.size(); ++i)
+        m_localObservers[i] = toBulletPosition(m_observers[i], m_pWorld->getOrigin());
+
+    unsigned int nbBodies = m_pWorld->getNbBodySlots();
+    unsigned int nbBands = (unsigned int) m_bands.size();
+
+    if (m_bodies.size() < nbBodies)
+    {
+        tBodyLod lod;
+        lod.band        = 0;
+        lod.skipped     = 0;
+        lod.scale       = 1;
+        lod.bReduced    = false;
+
+        m_bodies.resize(nbBodies, lod);
+    }
+
+    for (unsigned int i = 0; i < nbBodies; ++i)
+    {
+        Body* pBody = m_pWorld->getBody(i);
+        if (!pBody || !pBody->isDynamic())
+            continue;
+
+        // The bodies already asleep are cheap enough
+        btRigidBody* pRigidBody = pBody->getRigidBody();
+        int activationState = pRigidBody->getActivationState();
+        if ((activationState == ISLAND_SLEEPING) || (activationState == DISABLE_SIMULATION))
+            continue;
+
+        // Distance to the closest observer
+        const btVector3& position = pRigidBody->getCenterOfMassPosition();
+
+        btScalar distance2 = position.distance2(m_localObservers[0]);
+        for (int j = 1; j < m_localObservers.size(); ++j)
+            distance2 = btMin(distance2, position.distance2(m_localObservers[j]));
+
+        btScalar distance = btSqrt(distance2) / m_distanceScale;
+
+        // Select the band: closer immediately, farther only past the margin
+        unsigned int nearBand = 0;
+        while ((nearBand < nbBands) && (m_bands[nearBand].distance <= distance))
+            ++nearBand;
+
+        unsigned int farBand = 0;
+        while ((farBand < nbBands) && (m_bands[farBand].distance + m_hysteresis <= distance))
+            ++farBand;
+
+        tBodyLod& lod = m_bodies[i];
+        if (lod.band > nearBand)
+            lod.band = nearBand;
+        else if (lod.band < farBand)
+            lod.band = farBand;
+
+        if ((lod.band == 0) || (m_bands[lod.band - 1].interval == 1))
+        {
+            lod.skipped = 0;
+            continue;
+        }
+
+        lod.bReduced = true;
+        m_reducedBodies.push_back(i);
+    }
+
+    if (!m_reducedBodies.empty())
+        prepareSubStep();
+}
+
+//-----------------------------------------------------------------------
+
+void SimulationLod::afterSubStep(btScalar timeStep)
+{
+    // The counter only advances when a substep is done (no substep is done by the
+    // steps shorter than the fixed time step)
+    ++m_step;
+
+    m_nbSkippedBodies = 0;
+
+    if (m_reducedBodies.empty())
+        return;
+
+    restore(true, timeStep);
+    prepareSubStep();
+}
+
+//-----------------------------------------------------------------------
+
+void SimulationLod::afterStep()
+{
+    // The bodies were prepared for a substep that wasn't done
+    restore(false, btScalar(0.0));
+
+    for (unsigned int i = 0; i < m_reducedBodies.size(); ++i)
+        m_bodies[m_reducedBodies[i]].bReduced = false;
+
+    m_reducedBodies.clear();
+}
+
+
+/*********************************** INTERNAL METHODS **********************************/
+
+void SimulationLod::prepareSubStep()
+{
+    assert(m_modifiedBodies.size() == 0);
+
+    // The bodies of a simulation island (as found by the last substep) share the same
+    // phase: the ones resting on each other are simulated together, instead of being
+    // promoted to the full rate because their neighbours are skipped
+    btDiscreteDynamicsWorld* pWorld = m_pWorld->getRigidBodyWorld();
+
+    m_islandPhases.assign(pWorld->getNumCollisionObjects(), NO_PHASE);
+
+    for (unsigned int i = 0; i < m_reducedBodies.size(); ++i)
+    {
+        unsigned int index = m_reducedBodies[i];
+        int island = m_pWorld->getBody(index)->getRigidBody()->getIslandTag();
+
+        if ((island >= 0) && (island < (int) m_islandPhases.size()))
+            m_islandPhases[island] = std::min(m_islandPhases[island], index);
+    }
+
+    // Scale of each body during the substep
+    for (unsigned int i = 0; i < m_reducedBodies.size(); ++i)
+    {
+        unsigned int index = m_reducedBodies[i];
+        tBodyLod& lod = m_bodies[index];
+
+        // The bodies that fell asleep don't need to catch up
+        int activationState = m_pWorld->getBody(index)->getRigidBody()->getActivationState();
+        if ((activationState == ISLAND_SLEEPING) || (activationState == DISABLE_SIMULATION))
+        {
+            lod.skipped = 0;
+            lod.scale = 0;
+            continue;
+        }
+
+        unsigned int interval = m_bands[lod.band - 1].interval;
+
+        unsigned int phase = index;
+        int island = m_pWorld->getBody(index)->getRigidBody()->getIslandTag();
+        if ((island >= 0) && (island < (int) m_islandPhases.size()))
+            phase = m_islandPhases[island];
+
+        if ((interval == 0) || ((m_step + phase) % interval != 0))
+            lod.scale = 0;
+        else
+            lod.scale = lod.skipped + 1;
+    }
+
+    // The bodies that might touch (or are constrained to) a body simulated at another
+    // rate are simulated at full rate (which can propagate to their other neighbours)
+    btDispatcher* pDispatcher = pWorld->getDispatcher();
+
+    bool bChanged = true;
+    while (bChanged)
+    {
+        bChanged = false;
+
+        for (int i = 0; i < pDispatcher->getNumManifolds(); ++i)
+        {
+            btPersistentManifold* pManifold = pDispatcher->getManifoldByIndexInternal(i);
+            bChanged |= makeConsistent(static_cast<const btCollisionObject*>(pManifold->getBody0()),
+                                       static_cast<const btCollisionObject*>(pManifold->getBody1()));
+        }
+
+        for (int i = 0; i < pWorld->getNumConstraints(); ++i)
+        {
+            btTypedConstraint* pConstraint = pWorld->getConstraint(i);
+            bChanged |= makeConsistent(&pConstraint->getRigidBodyA(), &pConstraint->getRigidBodyB());
+        }
+    }
+
+    // Modify the bodies
+    for (unsigned int i = 0; i < m_reducedBodies.size(); ++i)
+    {
+        unsigned int index = m_reducedBodies[i];
+        const tBodyLod& lod = m_bodies[index];
+
+        if (lod.scale == 1)
+            continue;
+
+        btRigidBody* pRigidBody = m_pWorld->getBody(index)->getRigidBody();
+
+        int activationState = pRigidBody->getActivationState();
+        if ((lod.scale == 0) &&
+            ((activationState == ISLAND_SLEEPING) || (activationState == DISABLE_SIMULATION)))
+        {
+            continue;
+        }
+
+        tModifiedBody& modified = m_modifiedBodies.expand();
+        modified.pRigidBody                 = pRigidBody;
+        modified.index                      = index;
+        modified.scale                      = lod.scale;
+        modified.gravity                    = pRigidBody->getGravity();
+        modified.linearVelocity             = pRigidBody->getLinearVelocity();
+        modified.angularVelocity            = pRigidBody->getAngularVelocity();
+        modified.linearDamping              = pRigidBody->getLinearDamping();
+        modified.angularDamping             = pRigidBody->getAngularDamping();
+        modified.linearSleepingThreshold    = pRigidBody->getLinearSleepingThreshold();
+        modified.angularSleepingThreshold   = pRigidBody->getAngularSleepingThreshold();
+        modified.activationState            = activationState;
+
+        if (lod.scale == 0)
+        {
+            // Skipped substep (Bullet clears the velocities of the sleeping bodies)
+            pRigidBody->forceActivationState(ISLAND_SLEEPING);
+            continue;
+        }
+
+        // Simulated substep, covering the time of the skipped ones: the velocities are
+        // multiplied by the scale, the accelerations by its square, the damping is
+        // applied 'scale' times and the thresholds are compared with the real velocities
+        btScalar scale = btScalar(lod.scale);
+
+        pRigidBody->setLinearVelocity(modified.linearVelocity * scale);
+        pRigidBody->setAngularVelocity(modified.angularVelocity * scale);
+        pRigidBody->setGravity(modified.gravity * scale * scale);
+        pRigidBody->setDamping(btScalar(1.0) - btPow(btScalar(1.0) - modified.linearDamping, scale),
+                               btScalar(1.0) - btPow(btScalar(1.0) - modified.angularDamping, scale));
+        pRigidBody->setSleepingThresholds(modified.linearSleepingThreshold * scale,
+                                          modified.angularSleepingThreshold * scale);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void SimulationLod::restore(bool bSimulated, btScalar timeStep)
+{
+    for (int i = 0; i < m_modifiedBodies.size(); ++i)
+    {
+        const tModifiedBody& modified = m_modifiedBodies[i];
+        btRigidBody* pRigidBody = modified.pRigidBody;
+        tBodyLod& lod = m_bodies[modified.index];
+
+        if (modified.scale == 0)
+        {
+            // A body woken up by an awake one touching it was simulated at full rate:
+            // that substep must not be covered again later
+            if (pRigidBody->getActivationState() == ISLAND_SLEEPING)
+            {
+                pRigidBody->setLinearVelocity(modified.linearVelocity);
+                pRigidBody->setAngularVelocity(modified.angularVelocity);
+                pRigidBody->forceActivationState(modified.activationState);
+
+                if (bSimulated && (m_bands[lod.band - 1].interval > 0))
+                    ++lod.skipped;
+
+                if (bSimulated)
+                    ++m_nbSkippedBodies;
+            }
+            else
+            {
+                if (modified.activationState == DISABLE_DEACTIVATION)
+                    pRigidBody->forceActivationState(modified.activationState);
+
+                lod.skipped = 0;
+            }
+        }
+        else
+        {
+            btScalar invScale = btScalar(1.0) / btScalar(modified.scale);
+
+            if (bSimulated)
+            {
+                pRigidBody->setLinearVelocity(pRigidBody->getLinearVelocity() * invScale);
+                pRigidBody->setAngularVelocity(pRigidBody->getAngularVelocity() * invScale);
+            }
+            else
+            {
+                pRigidBody->setLinearVelocity(modified.linearVelocity);
+                pRigidBody->setAngularVelocity(modified.angularVelocity);
+            }
+
+            pRigidBody->setGravity(modified.gravity);
+            pRigidBody->setDamping(modified.linearDamping, modified.angularDamping);
+            pRigidBody->setSleepingThresholds(modified.linearSleepingThreshold,
+                                              modified.angularSleepingThreshold);
+
+            if (bSimulated)
+            {
+                // Used to interpolate the motion states
+                pRigidBody->setInterpolationLinearVelocity(pRigidBody->getInterpolationLinearVelocity() * invScale);
+                pRigidBody->setInterpolationAngularVelocity(pRigidBody->getInterpolationAngularVelocity() * invScale);
+
+                // Bullet only counted the duration of one substep
+                if (pRigidBody->getDeactivationTime() > btScalar(0.0))
+                {
+                    pRigidBody->setDeactivationTime(pRigidBody->getDeactivationTime() +
+                                                    btScalar(modified.scale - 1) * timeStep);
+                }
+
+                lod.skipped = 0;
+            }
+        }
+    }
+
+    // The bodies simulated at full rate during the substep are up-to-date
+    if (bSimulated)
+    {
+        for (unsigned int i = 0; i < m_reducedBodies.size(); ++i)
+        {
+            tBodyLod& lod = m_bodies[m_reducedBodies[i]];
+            if (lod.scale == 1)
+                lod.skipped = 0;
+        }
+    }
+
+    m_modifiedBodies.resize(0);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int SimulationLod::getScale(const btCollisionObject* pObject) const
+{
+    const btRigidBody* pRigidBody = btRigidBody::upcast(pObject);
+    if (!pRigidBody || pRigidBody->isStaticObject())
+        return ANY_SCALE;
+
+    if (pRigidBody->getUserPointer())
+    {
+        const Body* pBody = static_cast<const Body*>(static_cast<const CollisionObject*>(pRigidBody->getUserPointer()));
+
+        unsigned int index = pBody->getWorldIndex();
+        if ((index < m_bodies.size()) && m_bodies[index].bReduced)
+            return m_bodies[index].scale;
+    }
+
+    // The sleeping bodies don't move, the other ones are simulated at full rate
+    int activationState = pRigidBody->getActivationState();
+    return ((activationState == ISLAND_SLEEPING) || (activationState == DISABLE_SIMULATION) ? 0 : 1);
+}
+
+//-----------------------------------------------------------------------
+
+bool SimulationLod::makeConsistent(const btCollisionObject* pObject1, const btCollisionObject* pObject2)
+{
+    unsigned int scale1 = getScale(pObject1);
+    unsigned int scale2 = getScale(pObject2);
+
+    if ((scale1 == scale2) || (scale1 == ANY_SCALE) || (scale2 == ANY_SCALE))
+        return false;
+
+    bool bPromoted1 = promote(pObject1);
+    bool bPromoted2 = promote(pObject2);
+
+    return (bPromoted1 || bPromoted2);
+}
+
+//-----------------------------------------------------------------------
+
+bool SimulationLod::promote(const btCollisionObject* pObject)
+{
+    if (!pObject->getUserPointer())
+        return false;
+
+    const Body* pBody = static_cast<const Body*>(static_cast<const CollisionObject*>(pObject->getUserPointer()));
+
+    unsigned int index = pBody->getWorldIndex();
+    if ((index >= m_bodies.size()) || !m_bodies[index].bReduced || (m_bodies[index].scale == 1))
+        return false;
+
+    // The time skipped by the body is lost
+    m_bodies[index].scale = 1;
+    m_bodies[index].skipped = 0;
+
+    return true;
+}
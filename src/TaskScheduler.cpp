@@ -0,0 +1,33 @@
+/** @file   TaskScheduler.cpp
+    @author Philip Abbet
+
+    Implementation of the interface 'Athena::Physics::ITaskScheduler'
+*/
+
+#include <Athena-Physics/TaskScheduler.h>
+#include <vector>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/**************************************** METHODS **************************************/
+
+void ITaskScheduler::run(ITask** pTasks, unsigned int nbTasks)
+{
+    if (nbTasks == 0)
+        return;
+
+    assert(pTasks);
+
+    std::vector<tTaskHandle> handles(nbTasks - 1);
+
+    for (unsigned int i = 0; i < nbTasks - 1; ++i)
+        handles[i] = submit(pTasks[i]);
+
+    pTasks[nbTasks - 1]->execute();
+
+    for (unsigned int i = 0; i < nbTasks - 1; ++i)
+        wait(handles[i]);
+}
@@ -0,0 +1,234 @@
+/** @file   TriggerIndex.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::TriggerIndex'
+*/
+
+#include <Athena-Physics/TriggerIndex.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/GhostObject.h>
+#include <Athena-Physics/CollisionManager.h>
+#include <algorithm>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+TriggerIndex::TriggerIndex(World* pWorld)
+: m_pWorld(pWorld), m_bDirty(false), m_pListener(0)
+{
+    assert(pWorld);
+}
+
+//-----------------------------------------------------------------------
+
+TriggerIndex::~TriggerIndex()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+void TriggerIndex::addTrigger(GhostObject* pTrigger)
+{
+    assert(pTrigger);
+    assert(std::find(m_triggers.begin(), m_triggers.end(), pTrigger) == m_triggers.end());
+
+    m_triggers.push_back(pTrigger);
+    m_bDirty = true;
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::removeTrigger(GhostObject* pTrigger)
+{
+    assert(pTrigger);
+
+    tTriggersList::iterator iter = std::find(m_triggers.begin(), m_triggers.end(), pTrigger);
+    if (iter == m_triggers.end())
+        return;
+
+    m_triggers.erase(iter);
+    m_bDirty = true;
+
+    // All the objects overlapping with the trigger leave it
+    tOverlapsMap::iterator iterObject = m_overlaps.begin();
+    while (iterObject != m_overlaps.end())
+    {
+        tTriggersList& triggers = iterObject->second;
+
+        tTriggersList::iterator iterTrigger = std::lower_bound(triggers.begin(), triggers.end(), pTrigger);
+        if ((iterTrigger != triggers.end()) && (*iterTrigger == pTrigger))
+        {
+            triggers.erase(iterTrigger);
+            leave(pTrigger, iterObject->first);
+        }
+
+        if (triggers.empty())
+            m_overlaps.erase(iterObject++);
+        else
+            ++iterObject;
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::onObjectRemoved(btCollisionObject* pObject)
+{
+    assert(pObject);
+
+    tOverlapsMap::iterator iter = m_overlaps.find(pObject);
+    if (iter == m_overlaps.end())
+        return;
+
+    tTriggersList& triggers = iter->second;
+    for (unsigned int i = 0; i < triggers.size(); ++i)
+        leave(triggers[i], pObject);
+
+    m_overlaps.erase(iter);
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::shiftOrigin(const btVector3& offset)
+{
+    for (unsigned int i = 0; i < m_triggers.size(); ++i)
+    {
+        btGhostObject* pGhostObject = m_triggers[i]->getGhostObject();
+        pGhostObject->getWorldTransform().getOrigin() -= offset;
+        pGhostObject->getInterpolationWorldTransform().getOrigin() -= offset;
+    }
+
+    m_bDirty = true;
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::update(Body* const* pBodies, unsigned int nbBodies)
+{
+    assert(pBodies || (nbBodies == 0));
+
+    if (m_triggers.empty() && m_overlaps.empty())
+        return;
+
+    if (m_bDirty)
+        rebuild();
+
+    CollisionManager* pCollisionManager = m_pWorld->getCollisionManager();
+
+    for (unsigned int i = 0; i < nbBodies; ++i)
+    {
+        // The static bodies don't detect the triggers, and the ones removed from the
+        // world already left them
+        btRigidBody* pBody = pBodies[i]->getRigidBody();
+        if (pBody->isStaticObject() || !pBody->getBroadphaseHandle())
+            continue;
+
+        tCollisionGroup group = pBodies[i]->getCollisionGroup();
+
+        btVector3 aabbMin, aabbMax;
+        pBody->getCollisionShape()->getAabb(pBody->getWorldTransform(), aabbMin, aabbMax);
+
+        m_candidates.clear();
+        m_tree.query(aabbMin, aabbMax, m_candidates);
+
+        m_current.clear();
+        for (unsigned int j = 0; j < m_candidates.size(); ++j)
+        {
+            GhostObject* pTrigger = m_triggers[m_candidates[j]];
+            if (pCollisionManager->isCollisionEnabled(group, pTrigger->getCollisionGroup()))
+                m_current.push_back(pTrigger);
+        }
+
+        std::sort(m_current.begin(), m_current.end());
+
+        // Compare with the triggers overlapped during the previous step
+        tOverlapsMap::iterator iter = m_overlaps.find(pBody);
+        if (iter == m_overlaps.end())
+        {
+            if (m_current.empty())
+                continue;
+
+            iter = m_overlaps.insert(tOverlapsMap::value_type(pBody, tTriggersList())).first;
+        }
+
+        tTriggersList& previous = iter->second;
+
+        tTriggersList::iterator iterPrevious = previous.begin();
+        tTriggersList::iterator iterCurrent = m_current.begin();
+
+        while ((iterPrevious != previous.end()) || (iterCurrent != m_current.end()))
+        {
+            if ((iterCurrent == m_current.end()) ||
+                ((iterPrevious != previous.end()) && (*iterPrevious < *iterCurrent)))
+            {
+                leave(*iterPrevious, pBody);
+                ++iterPrevious;
+            }
+            else if ((iterPrevious == previous.end()) || (*iterCurrent < *iterPrevious))
+            {
+                enter(*iterCurrent, pBody);
+                ++iterCurrent;
+            }
+            else
+            {
+                ++iterPrevious;
+                ++iterCurrent;
+            }
+        }
+
+        if (m_current.empty())
+            m_overlaps.erase(iter);
+        else
+            previous.swap(m_current);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::rebuild()
+{
+    btAlignedObjectArray<btVector3> mins;
+    btAlignedObjectArray<btVector3> maxs;
+
+    mins.resize((int) m_triggers.size());
+    maxs.resize((int) m_triggers.size());
+
+    for (unsigned int i = 0; i < m_triggers.size(); ++i)
+    {
+        btGhostObject* pGhostObject = m_triggers[i]->getGhostObject();
+        pGhostObject->getCollisionShape()->getAabb(pGhostObject->getWorldTransform(), mins[i], maxs[i]);
+    }
+
+    if (m_triggers.empty())
+        m_tree.clear();
+    else
+        m_tree.build(&mins[0], &maxs[0], (unsigned int) m_triggers.size());
+
+    m_bDirty = false;
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::enter(GhostObject* pTrigger, btCollisionObject* pObject)
+{
+    pTrigger->getGhostObject()->addOverlappingObjectInternal(pObject->getBroadphaseHandle());
+
+    if (m_pListener)
+        m_pListener->onTriggerEnter(pTrigger, static_cast<CollisionObject*>(pObject->getUserPointer()));
+}
+
+//-----------------------------------------------------------------------
+
+void TriggerIndex::leave(GhostObject* pTrigger, btCollisionObject* pObject)
+{
+    pTrigger->getGhostObject()->removeOverlappingObjectInternal(pObject->getBroadphaseHandle(),
+                                                                m_pWorld->getRigidBodyWorld()->getDispatcher());
+
+    if (m_pListener)
+        m_pListener->onTriggerExit(pTrigger, static_cast<CollisionObject*>(pObject->getUserPointer()));
+}
@@ -5,11 +5,29 @@
 */
 
 #include <Athena-Physics/World.h>
+#include <Athena-Physics/Aggregate.h>
 #include <Athena-Physics/Body.h>
+#include <Athena-Physics/BodyPool.h>
+#include <Athena-Physics/BudgetController.h>
+#include <Athena-Physics/CollisionConfiguration.h>
 #include <Athena-Physics/GhostObject.h>
 #include <Athena-Physics/Conversions.h>
 #include <Athena-Physics/CollisionManager.h>
+#include <Athena-Physics/TriggerIndex.h>
+#include <Athena-Physics/QueryQueue.h>
+#include <Athena-Physics/InlineShape.h>
+#include <Athena-Physics/MaterialTable.h>
+#include <Athena-Physics/ProjectileSystem.h>
+#include <Athena-Physics/WorldSnapshot.h>
+#include <Athena-Physics/CommandBuffer.h>
+#include <Athena-Physics/SimulationLod.h>
 #include <BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <BulletCollision/CollisionDispatch/btManifoldResult.h>
+#include <BulletCollision/CollisionDispatch/btSimulationIslandManager.h>
+#include <LinearMath/btQuickprof.h>
+#include <algorithm>
+#include <sstream>
+#include <string.h>
 
 using namespace Athena;
 using namespace Athena::Physics;
@@ -24,235 +42,2714 @@ using namespace std;
 const std::string World::TYPE           = "Athena/Physics/World";
 const std::string World::DEFAULT_NAME   = "PhysicalWorld";
 
+// Maximum number of tasks of a batch run at the same time (they are stored on the stack,
+// bigger batches are processed in several runs)
+static const unsigned int MAX_TASKS_PER_RUN = 32;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Indicates if an object must be considered by a spatial query
+    bool acceptObject(const btBroadphaseProxy* pProxy, CollisionManager* pCollisionManager,
+                      tCollisionGroup group)
+    {
+        const btCollisionObject* pObject = static_cast<const btCollisionObject*>(pProxy->m_clientObject);
+        if (pObject->getCollisionFlags() & btCollisionObject::CF_NO_CONTACT_RESPONSE)
+            return false;
+
+        const CollisionObject* pComponent = static_cast<const CollisionObject*>(pObject->getUserPointer());
+        if (!pComponent)
+            return false;
+
+        return pCollisionManager->isCollisionEnabled(group, pComponent->getCollisionGroup());
+    }
+
+
+    // Retrieve the closest object hit by a ray, taking the collision groups into account
+    class ClosestRayCallback: public btCollisionWorld::ClosestRayResultCallback
+    {
+    public:
+        ClosestRayCallback(const btVector3& from, const btVector3& to,
+                           CollisionManager* pCollisionManager, tCollisionGroup group)
+        : btCollisionWorld::ClosestRayResultCallback(from, to),
+          m_pCollisionManager(pCollisionManager), m_group(group)
+        {
+        }
+
+        virtual bool needsCollision(btBroadphaseProxy* pProxy) const
+        {
+            return acceptObject(pProxy, m_pCollisionManager, m_group);
+        }
+
+    private:
+        CollisionManager*   m_pCollisionManager;
+        tCollisionGroup     m_group;
+    };
+
+
+    // Retrieve the first object hit by a convex shape, taking the collision groups into
+    // account
+    class ClosestSweepCallback: public btCollisionWorld::ClosestConvexResultCallback
+    {
+    public:
+        ClosestSweepCallback(const btVector3& from, const btVector3& to,
+                             CollisionManager* pCollisionManager, tCollisionGroup group)
+        : btCollisionWorld::ClosestConvexResultCallback(from, to),
+          m_pCollisionManager(pCollisionManager), m_group(group)
+        {
+        }
+
+        virtual bool needsCollision(btBroadphaseProxy* pProxy) const
+        {
+            return acceptObject(pProxy, m_pCollisionManager, m_group);
+        }
+
+    private:
+        CollisionManager*   m_pCollisionManager;
+        tCollisionGroup     m_group;
+    };
+
+
+    // Collect the objects overlapping with a shape (without duplicates) in a fixed-size
+    // array, taking the collision groups into account
+    class OverlapCallback: public btCollisionWorld::ContactResultCallback
+    {
+    public:
+        OverlapCallback(const btCollisionObject* pQueryObject, CollisionObject** pResults,
+                        unsigned int maxResults, CollisionManager* pCollisionManager,
+                        tCollisionGroup group)
+        : nbResults(0), m_pQueryObject(pQueryObject), m_pResults(pResults),
+          m_maxResults(maxResults), m_pCollisionManager(pCollisionManager), m_group(group)
+        {
+        }
+
+        virtual bool needsCollision(btBroadphaseProxy* pProxy) const
+        {
+            return (nbResults < m_maxResults) && acceptObject(pProxy, m_pCollisionManager, m_group);
+        }
+
+        virtual btScalar addSingleResult(btManifoldPoint& cp,
+                                         const btCollisionObject* colObj0, int partId0, int index0,
+                                         const btCollisionObject* colObj1, int partId1, int index1)
+        {
+            if ((cp.getDistance() > btScalar(0.0)) || (nbResults == m_maxResults))
+                return 0;
+
+            const btCollisionObject* pOther = (colObj0 == m_pQueryObject ? colObj1 : colObj0);
+            CollisionObject* pComponent = static_cast<CollisionObject*>(pOther->getUserPointer());
+
+            for (unsigned int i = 0; i < nbResults; ++i)
+            {
+                if (m_pResults[i] == pComponent)
+                    return 0;
+            }
+
+            m_pResults[nbResults] = pComponent;
+            ++nbResults;
+
+            return 0;
+        }
+
+        unsigned int nbResults;
+
+    private:
+        const btCollisionObject*    m_pQueryObject;
+        CollisionObject**           m_pResults;
+        unsigned int                m_maxResults;
+        CollisionManager*           m_pCollisionManager;
+        tCollisionGroup             m_group;
+    };
+
+
+    // Cast one ray in a world
+    bool castRay(const btCollisionWorld* pWorld, CollisionManager* pCollisionManager,
+                 const Math::Vector3& origin, const World::tRay& ray, World::tRayHit &hit,
+                 tCollisionGroup group)
+    {
+        btVector3 from = toBulletPosition(ray.from, origin);
+        btVector3 to = toBulletPosition(ray.to, origin);
+
+        ClosestRayCallback callback(from, to, pCollisionManager, group);
+        pWorld->rayTest(from, to, callback);
+
+        if (!callback.hasHit())
+        {
+            hit.pObject     = 0;
+            hit.position    = ray.to;
+            hit.normal      = Math::Vector3::ZERO;
+            hit.fraction    = 1.0f;
+            return false;
+        }
+
+        hit.pObject     = static_cast<CollisionObject*>(callback.m_collisionObject->getUserPointer());
+        hit.position    = fromBulletPosition(callback.m_hitPointWorld, origin);
+        hit.normal      = fromBullet(callback.m_hitNormalWorld);
+        hit.fraction    = callback.m_closestHitFraction;
+        return true;
+    }
+
+
+    // Move one convex shape in a world
+    bool castShape(const btCollisionWorld* pWorld, CollisionManager* pCollisionManager,
+                   const Math::Vector3& origin, const btConvexShape* pShape,
+                   const World::tSweep& sweep, World::tSweepHit &hit, tCollisionGroup group)
+    {
+        btQuaternion orientation = toBullet(sweep.orientation);
+        btTransform from(orientation, toBulletPosition(sweep.from, origin));
+        btTransform to(orientation, toBulletPosition(sweep.to, origin));
+
+        ClosestSweepCallback callback(from.getOrigin(), to.getOrigin(), pCollisionManager, group);
+        pWorld->convexSweepTest(pShape, from, to, callback);
+
+        if (!callback.hasHit())
+        {
+            hit.pObject     = 0;
+            hit.position    = sweep.to;
+            hit.normal      = Math::Vector3::ZERO;
+            hit.fraction    = 1.0f;
+            return false;
+        }
+
+        hit.pObject     = static_cast<CollisionObject*>(callback.m_hitCollisionObject->getUserPointer());
+        hit.position    = fromBulletPosition(callback.m_hitPointWorld, origin);
+        hit.normal      = fromBullet(callback.m_hitNormalWorld);
+        hit.fraction    = callback.m_closestHitFraction;
+        return true;
+    }
+
+
+    // Task moving a convex shape for a range of movements of a batch (on a snapshot of
+    // the world if several tasks are running concurrently)
+    class SweepTask: public ITaskScheduler::ITask
+    {
+    public:
+        SweepTask()
+        : pWorld(0), pSnapshot(0), pCollisionManager(0), pShape(0), pSweeps(0), pHits(0),
+          nbSweeps(0), group(255), nbHits(0)
+        {
+        }
+
+        virtual void execute()
+        {
+            nbHits = 0;
+            for (size_t i = 0; i < nbSweeps; ++i)
+            {
+                bool bHit;
+                if (pSnapshot)
+                    bHit = pSnapshot->sweep(pShape, pSweeps[i], pHits[i], group);
+                else
+                    bHit = castShape(pWorld, pCollisionManager, origin, pShape, pSweeps[i], pHits[i], group);
+
+                if (bHit)
+                    ++nbHits;
+            }
+        }
+
+        const btCollisionWorld* pWorld;
+        const WorldSnapshot*    pSnapshot;
+        CollisionManager*       pCollisionManager;
+        Math::Vector3           origin;
+        const btConvexShape*    pShape;
+        const World::tSweep*    pSweeps;
+        World::tSweepHit*       pHits;
+        size_t                  nbSweeps;
+        tCollisionGroup         group;
+        unsigned int            nbHits;
+    };
+
+
+    // Called by Bullet after each substep of the simulation
+    void internalTickCallback(btDynamicsWorld* pWorld, btScalar timeStep)
+    {
+        static_cast<SimulationLod*>(pWorld->getWorldUserInfo())->afterSubStep(timeStep);
+    }
+
+
+    // Task casting a range of rays of a batch (on a snapshot of the world if several
+    // tasks are running concurrently: the queries of Bullet aren't thread-safe)
+    class RayCastTask: public ITaskScheduler::ITask
+    {
+    public:
+        RayCastTask()
+        : pWorld(0), pSnapshot(0), pCollisionManager(0), pRays(0), pHits(0), nbRays(0),
+          group(255), nbHits(0)
+        {
+        }
+
+        virtual void execute()
+        {
+            nbHits = 0;
+            for (size_t i = 0; i < nbRays; ++i)
+            {
+                bool bHit;
+                if (pSnapshot)
+                    bHit = pSnapshot->rayCast(pRays[i], pHits[i], group);
+                else
+                    bHit = castRay(pWorld, pCollisionManager, origin, pRays[i], pHits[i], group);
+
+                if (bHit)
+                    ++nbHits;
+            }
+        }
+
+        const btCollisionWorld* pWorld;
+        const WorldSnapshot*    pSnapshot;
+        CollisionManager*       pCollisionManager;
+        Math::Vector3           origin;
+        const World::tRay*      pRays;
+        World::tRayHit*         pHits;
+        size_t                  nbRays;
+        tCollisionGroup         group;
+        unsigned int            nbHits;
+    };
+}
+
+
+/********************************** STATE BLOBS ***************************************/
+
+namespace {
+
+    // Header of the blobs created by World::saveState()
+    struct tStateHeader
+    {
+        unsigned int    magic;
+        unsigned int    bodyStateSize;
+        unsigned int    nbBodies;
+    };
+
+
+    // Dynamic state of a body, in a blob created by World::saveState()
+    struct tBodyState
+    {
+        btScalar        transform[12];                      ///< Basis (row-major) + origin
+        btScalar        interpolationTransform[12];
+        btScalar        linearVelocity[3];
+        btScalar        angularVelocity[3];
+        btScalar        interpolationLinearVelocity[3];
+        btScalar        interpolationAngularVelocity[3];
+        btScalar        deactivationTime;
+        int             activationState;
+        int             bUsed;                              ///< 0 if the slot was free
+    };
+
+
+    const unsigned int STATE_MAGIC = 0x41505331;    // 'APS1'
+
+
+    inline void store(const btTransform& transform, btScalar* pDest)
+    {
+        const btMatrix3x3& basis = transform.getBasis();
+        for (int i = 0; i < 3; ++i)
+        {
+            pDest[i * 3]     = basis[i].x();
+            pDest[i * 3 + 1] = basis[i].y();
+            pDest[i * 3 + 2] = basis[i].z();
+        }
+
+        pDest[9]  = transform.getOrigin().x();
+        pDest[10] = transform.getOrigin().y();
+        pDest[11] = transform.getOrigin().z();
+    }
+
+
+    inline btTransform loadTransform(const btScalar* pSrc)
+    {
+        return btTransform(btMatrix3x3(pSrc[0], pSrc[1], pSrc[2],
+                                       pSrc[3], pSrc[4], pSrc[5],
+                                       pSrc[6], pSrc[7], pSrc[8]),
+                           btVector3(pSrc[9], pSrc[10], pSrc[11]));
+    }
+
+
+    inline void store(const btVector3& v, btScalar* pDest)
+    {
+        pDest[0] = v.x();
+        pDest[1] = v.y();
+        pDest[2] = v.z();
+    }
+
+
+    inline btVector3 loadVector(const btScalar* pSrc)
+    {
+        return btVector3(pSrc[0], pSrc[1], pSrc[2]);
+    }
+
+
+    void saveBodyState(const btRigidBody* pRigidBody, tBodyState &state)
+    {
+        store(pRigidBody->getWorldTransform(), state.transform);
+        store(pRigidBody->getInterpolationWorldTransform(), state.interpolationTransform);
+        store(pRigidBody->getLinearVelocity(), state.linearVelocity);
+        store(pRigidBody->getAngularVelocity(), state.angularVelocity);
+        store(pRigidBody->getInterpolationLinearVelocity(), state.interpolationLinearVelocity);
+        store(pRigidBody->getInterpolationAngularVelocity(), state.interpolationAngularVelocity);
+
+        state.deactivationTime  = pRigidBody->getDeactivationTime();
+        state.activationState   = pRigidBody->getActivationState();
+        state.bUsed             = 1;
+    }
+}
+
+
+/********************************* DETERMINISTIC MODE **********************************/
+
+namespace {
+
+    typedef std::map<const btCollisionObject*, unsigned int> tObjectKeys;
+
+
+    // Order key of the first collision object that isn't a body (the indices of the
+    // bodies are far below)
+    const unsigned int FIRST_OBJECT_KEY = 0x80000000u;
+
+
+    // Key used to order the collision objects in deterministic mode: the bodies by
+    // index, then the other objects in the order in which they were added to the world
+    inline unsigned int getOrderKey(const btCollisionObject* pObject, const tObjectKeys& keys)
+    {
+        const btRigidBody* pRigidBody = btRigidBody::upcast(pObject);
+        if (pRigidBody && pRigidBody->getUserPointer())
+        {
+            const CollisionObject* pComponent = static_cast<const CollisionObject*>(pRigidBody->getUserPointer());
+            return static_cast<const Body*>(pComponent)->getWorldIndex();
+        }
+
+        tObjectKeys::const_iterator iter = keys.find(pObject);
+        if (iter != keys.end())
+            return iter->second;
+
+        return Body::INVALID_INDEX;
+    }
+
+
+    // Move the last object of a sorted list to its position, given by the order keys
+    template <class T>
+    void moveLastInOrder(btAlignedObjectArray<T*>& objects, const tObjectKeys& keys)
+    {
+        int last = objects.size() - 1;
+        T* pObject = objects[last];
+        unsigned int key = getOrderKey(pObject, keys);
+
+        // Binary search of the first object with a greater key
+        int first = 0;
+        int count = last;
+        while (count > 0)
+        {
+            int step = count / 2;
+            if (getOrderKey(objects[first + step], keys) <= key)
+            {
+                first += step + 1;
+                count -= step + 1;
+            }
+            else
+            {
+                count = step;
+            }
+        }
+
+        for (int i = last; i > first; --i)
+            objects[i] = objects[i - 1];
+
+        objects[first] = pObject;
+    }
+
+
+    // Remove an object from a list, keeping the order of the other ones (Bullet replaces
+    // it by the last one)
+    template <class T>
+    void eraseInOrder(btAlignedObjectArray<T*>& objects, T* pObject)
+    {
+        int index = objects.findLinearSearch(pObject);
+        if (index == objects.size())
+            return;
+
+        for (int i = index + 1; i < objects.size(); ++i)
+            objects[i - 1] = objects[i];
+
+        objects.pop_back();
+    }
+
+
+    // Gives access to the list of non-static bodies of a Bullet's world (simulated in
+    // that order)
+    struct NonStaticBodiesAccessor: public btDiscreteDynamicsWorld
+    {
+        static btAlignedObjectArray<btRigidBody*>& get(btDiscreteDynamicsWorld* pWorld)
+        {
+            return pWorld->*(&NonStaticBodiesAccessor::m_nonStaticRigidBodies);
+        }
+    };
+
+
+    struct tOrderedObject
+    {
+        unsigned int        key;
+        btCollisionObject*  pObject;
+        short               group;
+        short               mask;
+
+        bool operator<(const tOrderedObject& other) const
+        {
+            return key < other.key;
+        }
+    };
+
+
+    struct tOrderedManifold
+    {
+        unsigned int            key0;
+        unsigned int            key1;
+        btPersistentManifold*   pManifold;
+
+        bool operator<(const tOrderedManifold& other) const
+        {
+            return (key0 < other.key0) || ((key0 == other.key0) && (key1 < other.key1));
+        }
+    };
+
+
+    // Names of the combine modes of the materials, used by the properties
+    const char* COMBINE_MODE_NAMES[] = { "AVERAGE", "MIN", "MULTIPLY", "MAX" };
+
+    MaterialTable::tCombineMode combineModeFromName(const std::string& strName)
+    {
+        for (unsigned int i = 0; i <= MaterialTable::COMBINE_MAX; ++i)
+        {
+            if (strName == COMBINE_MODE_NAMES[i])
+                return (MaterialTable::tCombineMode) i;
+        }
+
+        return MaterialTable::COMBINE_MULTIPLY;
+    }
+
+
+    // Destroy the collision algorithms of all the pairs (keeping the pairs)
+    class CleanPairsCallback: public btOverlapCallback
+    {
+    public:
+        CleanPairsCallback(btOverlappingPairCache* pPairCache, btDispatcher* pDispatcher)
+        : m_pPairCache(pPairCache), m_pDispatcher(pDispatcher)
+        {
+        }
+
+        virtual bool processOverlap(btBroadphasePair& pair)
+        {
+            m_pPairCache->cleanOverlappingPair(pair, m_pDispatcher);
+            return false;
+        }
+
+    private:
+        btOverlappingPairCache* m_pPairCache;
+        btDispatcher*           m_pDispatcher;
+    };
+
+
+    // Constraint solver asking the world how many iterations each island needs
+    class IslandSolver: public btSequentialImpulseConstraintSolver
+    {
+    public:
+        IslandSolver(const World* pWorld)
+        : m_pWorld(pWorld)
+        {
+        }
+
+        virtual btScalar solveGroup(btCollisionObject** pBodies, int nbBodies,
+                                    btPersistentManifold** pManifolds, int nbManifolds,
+                                    btTypedConstraint** pConstraints, int nbConstraints,
+                                    const btContactSolverInfo& info, btIDebugDraw* pDebugDrawer,
+                                    btStackAlloc* pStackAlloc, btDispatcher* pDispatcher)
+        {
+            int nbIterations = (int) m_pWorld->getIslandIterations(pBodies, (unsigned int) nbBodies);
+
+            if (nbIterations >= info.m_numIterations)
+            {
+                return btSequentialImpulseConstraintSolver::solveGroup(pBodies, nbBodies, pManifolds, nbManifolds,
+                                                                       pConstraints, nbConstraints, info,
+                                                                       pDebugDrawer, pStackAlloc, pDispatcher);
+            }
+
+            btContactSolverInfo islandInfo(info);
+            islandInfo.m_numIterations = nbIterations;
+
+            return btSequentialImpulseConstraintSolver::solveGroup(pBodies, nbBodies, pManifolds, nbManifolds,
+                                                                   pConstraints, nbConstraints, islandInfo,
+                                                                   pDebugDrawer, pStackAlloc, pDispatcher);
+        }
+
+    protected:
+        const World* m_pWorld;
+    };
+
+
+    // An island postponed by a ParallelIslandSolver
+    struct tPostponedIsland
+    {
+        unsigned int            firstBody;      // Index of the first body in the list of the solver
+        int                     nbBodies;
+        btPersistentManifold**  pManifolds;
+        int                     nbManifolds;
+        btTypedConstraint**     pConstraints;
+        int                     nbConstraints;
+        int                     nbIterations;
+        unsigned int            cost;           // Estimation of the time needed to solve it
+    };
+
+
+    // Task solving some of the islands postponed by a ParallelIslandSolver, using its
+    // own solver (the solvers keep data about the bodies they are solving)
+    class IslandsTask: public ITaskScheduler::ITask
+    {
+    public:
+        IslandsTask()
+        : pSolver(0), pIslands(0), pBodies(0), pInfo(0), pDispatcher(0), seed(0), cost(0)
+        {
+            pSolver = new btSequentialImpulseConstraintSolver();
+        }
+
+        virtual ~IslandsTask()
+        {
+            delete pSolver;
+        }
+
+        virtual void execute()
+        {
+            for (unsigned int i = 0; i < islands.size(); ++i)
+            {
+                const tPostponedIsland& island = (*pIslands)[islands[i]];
+
+                btContactSolverInfo info(*pInfo);
+                info.m_numIterations = island.nbIterations;
+
+                // Same sequence of random numbers for each island, whatever the task
+                // solving it
+                pSolver->setRandSeed(seed);
+
+                pSolver->solveGroup(&(*pBodies)[island.firstBody], island.nbBodies,
+                                    island.pManifolds, island.nbManifolds,
+                                    island.pConstraints, island.nbConstraints,
+                                    info, 0, 0, pDispatcher);
+            }
+        }
+
+        btSequentialImpulseConstraintSolver*    pSolver;
+        std::vector<unsigned int>               islands;    // Indices of the islands to solve
+        std::vector<tPostponedIsland>*          pIslands;
+        std::vector<btCollisionObject*>*        pBodies;
+        const btContactSolverInfo*              pInfo;
+        btDispatcher*                           pDispatcher;
+        unsigned long                           seed;
+        unsigned int                            cost;       // Sum of the costs of the islands
+    };
+
+
+    // Sort the islands by decreasing cost
+    struct IslandCostComparator
+    {
+        IslandCostComparator(const std::vector<tPostponedIsland>* pIslands)
+        : pIslands(pIslands)
+        {
+        }
+
+        bool operator()(unsigned int index1, unsigned int index2) const
+        {
+            unsigned int cost1 = (*pIslands)[index1].cost;
+            unsigned int cost2 = (*pIslands)[index2].cost;
+
+            return (cost1 > cost2) || ((cost1 == cost2) && (index1 < index2));
+        }
+
+        const std::vector<tPostponedIsland>* pIslands;
+    };
+
+
+    // Indicates if the islands can be solved by several threads at once: the profiler of
+    // Bullet (used by the sequential impulse solver) isn't thread-safe, and can only be
+    // disabled when Bullet is compiled
+#ifdef BT_NO_PROFILE
+    const bool PARALLEL_SOLVING_SUPPORTED = true;
+#else
+    const bool PARALLEL_SOLVING_SUPPORTED = false;
+#endif
+
+
+    // Constraint solver postponing the islands until all of them are known, then
+    // solving them in parallel with the task scheduler of the world (the islands don't
+    // share any dynamic body). Without scheduler (or when Bullet is compiled with its
+    // profiler), the islands are solved immediately.
+    class ParallelIslandSolver: public IslandSolver
+    {
+    public:
+        ParallelIslandSolver(const World* pWorld)
+        : IslandSolver(pWorld), m_pDispatcher(0)
+        {
+        }
+
+        virtual ~ParallelIslandSolver()
+        {
+            for (unsigned int i = 0; i < m_tasks.size(); ++i)
+                delete m_tasks[i];
+        }
+
+        virtual void prepareSolve(int nbBodies, int nbManifolds)
+        {
+            m_islands.clear();
+            m_bodies.clear();
+            m_bodies.reserve(nbBodies);
+        }
+
+        virtual btScalar solveGroup(btCollisionObject** pBodies, int nbBodies,
+                                    btPersistentManifold** pManifolds, int nbManifolds,
+                                    btTypedConstraint** pConstraints, int nbConstraints,
+                                    const btContactSolverInfo& info, btIDebugDraw* pDebugDrawer,
+                                    btStackAlloc* pStackAlloc, btDispatcher* pDispatcher)
+        {
+            ITaskScheduler* pScheduler = m_pWorld->getTaskScheduler();
+            if (!PARALLEL_SOLVING_SUPPORTED || !pScheduler || (pScheduler->getNbThreads() <= 1))
+            {
+                return IslandSolver::solveGroup(pBodies, nbBodies, pManifolds, nbManifolds,
+                                                pConstraints, nbConstraints, info,
+                                                pDebugDrawer, pStackAlloc, pDispatcher);
+            }
+
+            if ((nbManifolds == 0) && (nbConstraints == 0))
+                return btScalar(0.0);
+
+            // The list of bodies is reused by the island manager: copy it. The manifolds
+            // and constraints stay in place until the end of the solving.
+            tPostponedIsland island;
+            island.firstBody        = (unsigned int) m_bodies.size();
+            island.nbBodies         = nbBodies;
+            island.pManifolds       = pManifolds;
+            island.nbManifolds      = nbManifolds;
+            island.pConstraints     = pConstraints;
+            island.nbConstraints    = nbConstraints;
+            island.nbIterations     = btMin(info.m_numIterations,
+                                            (int) m_pWorld->getIslandIterations(pBodies, (unsigned int) nbBodies));
+            island.cost             = (unsigned int) (nbManifolds + nbConstraints) * island.nbIterations;
+
+            m_bodies.insert(m_bodies.end(), pBodies, pBodies + nbBodies);
+            m_islands.push_back(island);
+
+            m_pDispatcher = pDispatcher;
+
+            return btScalar(0.0);
+        }
+
+        virtual void allSolved(const btContactSolverInfo& info, btIDebugDraw* pDebugDrawer,
+                               btStackAlloc* pStackAlloc)
+        {
+            if (m_islands.empty())
+                return;
+
+            ITaskScheduler* pScheduler = m_pWorld->getTaskScheduler();
+            assert(pScheduler);
+
+            unsigned int nbTasks = btMin(pScheduler->getNbThreads(), (unsigned int) m_islands.size());
+
+            while (m_tasks.size() < nbTasks)
+                m_tasks.push_back(new IslandsTask());
+
+            m_taskPtrs.resize(nbTasks);
+
+            for (unsigned int i = 0; i < nbTasks; ++i)
+            {
+                IslandsTask* pTask = m_tasks[i];
+
+                pTask->islands.clear();
+                pTask->pIslands     = &m_islands;
+                pTask->pBodies      = &m_bodies;
+                pTask->pInfo        = &info;
+                pTask->pDispatcher  = m_pDispatcher;
+                pTask->seed         = getRandSeed();
+                pTask->cost         = 0;
+
+                m_taskPtrs[i] = pTask;
+            }
+
+            // Give the most expensive islands first, each one to the least loaded task
+            m_order.resize(m_islands.size());
+            for (unsigned int i = 0; i < m_order.size(); ++i)
+                m_order[i] = i;
+
+            std::sort(m_order.begin(), m_order.end(), IslandCostComparator(&m_islands));
+
+            for (unsigned int i = 0; i < m_order.size(); ++i)
+            {
+                IslandsTask* pTask = m_tasks[0];
+                for (unsigned int j = 1; j < nbTasks; ++j)
+                {
+                    if (m_tasks[j]->cost < pTask->cost)
+                        pTask = m_tasks[j];
+                }
+
+                pTask->islands.push_back(m_order[i]);
+                pTask->cost += m_islands[m_order[i]].cost + 1;
+            }
+
+            pScheduler->run(&m_taskPtrs[0], nbTasks);
+
+            m_islands.clear();
+            m_bodies.clear();
+        }
+
+    private:
+        std::vector<tPostponedIsland>       m_islands;
+        std::vector<btCollisionObject*>     m_bodies;
+        std::vector<unsigned int>           m_order;
+        std::vector<IslandsTask*>           m_tasks;
+        std::vector<ITaskScheduler::ITask*> m_taskPtrs;
+        btDispatcher*                       m_pDispatcher;
+    };
+
+
+    // Collision dispatcher able to sort the contact manifolds after the narrowphase,
+    // so the solver doesn't depend on the order in which the pairs were found. It also
+    // lets the aggregates destroy the pairs of their members that weren't found.
+    class SortingDispatcher: public btCollisionDispatcher
+    {
+    public:
+        SortingDispatcher(btCollisionConfiguration* pCollisionConfiguration,
+                          const std::vector<Aggregate*>* pAggregates,
+                          const tObjectKeys* pObjectKeys)
+        : btCollisionDispatcher(pCollisionConfiguration), bSortManifolds(false),
+          m_pAggregates(pAggregates), m_pObjectKeys(pObjectKeys)
+        {
+        }
+
+        virtual void dispatchAllCollisionPairs(btOverlappingPairCache* pPairCache,
+                                               const btDispatcherInfo& dispatchInfo,
+                                               btDispatcher* pDispatcher)
+        {
+            for (unsigned int i = 0; i < m_pAggregates->size(); ++i)
+                (*m_pAggregates)[i]->beginDispatch();
+
+            btCollisionDispatcher::dispatchAllCollisionPairs(pPairCache, dispatchInfo, pDispatcher);
+
+            for (unsigned int i = 0; i < m_pAggregates->size(); ++i)
+                (*m_pAggregates)[i]->endDispatch(this);
+
+            if (bSortManifolds)
+                sortManifolds();
+        }
+
+        bool bSortManifolds;
+
+    private:
+        void sortManifolds()
+        {
+            int nbManifolds = m_manifoldsPtr.size();
+
+            m_sorted.resize(nbManifolds);
+            for (int i = 0; i < nbManifolds; ++i)
+            {
+                btPersistentManifold* pManifold = m_manifoldsPtr[i];
+
+                m_sorted[i].key0        = getOrderKey(static_cast<const btCollisionObject*>(pManifold->getBody0()), *m_pObjectKeys);
+                m_sorted[i].key1        = getOrderKey(static_cast<const btCollisionObject*>(pManifold->getBody1()), *m_pObjectKeys);
+                m_sorted[i].pManifold   = pManifold;
+            }
+
+            // Stable, because the manifolds of the compound shapes share the same key
+            std::stable_sort(m_sorted.begin(), m_sorted.end());
+
+            for (int i = 0; i < nbManifolds; ++i)
+            {
+                m_manifoldsPtr[i] = m_sorted[i].pManifold;
+                m_manifoldsPtr[i]->m_index1a = i;
+            }
+        }
+
+        std::vector<tOrderedManifold>   m_sorted;
+        const std::vector<Aggregate*>*  m_pAggregates;
+        const tObjectKeys*              m_pObjectKeys;
+    };
+
+
+    // Island manager merging the simulation islands of the members of the aggregates
+    // with the ones of the objects they touch (their pairs aren't in the broadphase, so
+    // Bullet doesn't know about them)
+    class AggregateIslandManager: public btSimulationIslandManager
+    {
+    public:
+        AggregateIslandManager(const std::vector<Aggregate*>* pAggregates)
+        : m_pAggregates(pAggregates)
+        {
+        }
+
+        virtual void updateActivationState(btCollisionWorld* pWorld, btDispatcher* pDispatcher)
+        {
+            btSimulationIslandManager::updateActivationState(pWorld, pDispatcher);
+
+            for (unsigned int i = 0; i < m_pAggregates->size(); ++i)
+                (*m_pAggregates)[i]->findUnions(getUnionFind());
+        }
+
+    private:
+        const std::vector<Aggregate*>* m_pAggregates;
+    };
+
+
+    // Dynamics world using the island manager above
+    template <class T>
+    class AggregateWorld: public T
+    {
+    public:
+        AggregateWorld(btDispatcher* pDispatcher, btBroadphaseInterface* pBroadphase,
+                       btConstraintSolver* pConstraintSolver,
+                       btCollisionConfiguration* pCollisionConfiguration,
+                       const std::vector<Aggregate*>* pAggregates)
+        : T(pDispatcher, pBroadphase, pConstraintSolver, pCollisionConfiguration)
+        {
+            // Allocated like the default one, since the world destroys it the same way
+            this->m_islandManager->~btSimulationIslandManager();
+            btAlignedFree(this->m_islandManager);
+
+            void* pMemory = btAlignedAlloc(sizeof(AggregateIslandManager), 16);
+            this->m_islandManager = new (pMemory) AggregateIslandManager(pAggregates);
+        }
+    };
+
+
+    // Broadphase filter group of the ghost objects (the only objects paired with the
+    // members of the aggregates)
+    const short GHOST_FILTER = short(btBroadphaseProxy::SensorTrigger);
+
+
+    // Pair cache rejecting the pairs involving a parked body or a member of an aggregate
+    // using the filter groups and masks, before calling the filter callback
+    class FilteringPairCache: public btHashedOverlappingPairCache
+    {
+    public:
+        virtual btBroadphasePair* addOverlappingPair(btBroadphaseProxy* pProxy1,
+                                                     btBroadphaseProxy* pProxy2)
+        {
+            if ((pProxy1->m_collisionFilterGroup | pProxy2->m_collisionFilterGroup) & BodyPool::PARKED_FILTER)
+                return 0;
+
+            if (((pProxy1->m_collisionFilterGroup | pProxy2->m_collisionFilterGroup) & Aggregate::MEMBER_FILTER) &&
+                (!(pProxy1->m_collisionFilterGroup & pProxy2->m_collisionFilterMask) ||
+                 !(pProxy2->m_collisionFilterGroup & pProxy1->m_collisionFilterMask)))
+            {
+                return 0;
+            }
+
+            return btHashedOverlappingPairCache::addOverlappingPair(pProxy1, pProxy2);
+        }
+    };
+
+
+    // DBVT broadphase using (and owning) the pair cache above
+    class FilteringBroadphase: public btDbvtBroadphase
+    {
+    public:
+        FilteringBroadphase()
+        : btDbvtBroadphase(new (btAlignedAlloc(sizeof(FilteringPairCache), 16)) FilteringPairCache())
+        {
+            // Destroyed by btDbvtBroadphase, like its default pair cache
+            m_releasepaircache = true;
+        }
+    };
+
+
+    // Add a rigid body to a Bullet's world, with the filters used by Bullet. The members
+    // of an aggregate only accept the ghost objects: the broadphase never pairs them
+    // with the other objects (the aggregate itself is paired instead).
+    void insertRigidBody(btDiscreteDynamicsWorld* pWorld, Body* pBody)
+    {
+        btRigidBody* pRigidBody = pBody->getRigidBody();
+
+        if (!pBody->getAggregate())
+        {
+            pWorld->addRigidBody(pRigidBody);
+            return;
+        }
+
+        pWorld->addRigidBody(pRigidBody, Aggregate::MEMBER_FILTER, GHOST_FILTER);
+    }
+
+
+    // FNV-1a hash
+    inline unsigned int hash(const void* pData, size_t size, unsigned int value)
+    {
+        const unsigned char* pBytes = static_cast<const unsigned char*>(pData);
+        for (size_t i = 0; i < size; ++i)
+        {
+            value ^= pBytes[i];
+            value *= 16777619u;
+        }
+
+        return value;
+    }
+}
+
+
+/************************************* INTERNAL TYPES **********************************/
+
+// Task doing a simulation step on a worker thread
+class World::StepTask: public ITaskScheduler::ITask
+{
+public:
+    StepTask()
+    : pWorld(0), timeStep(0.0f), nbMaxSubSteps(1), fixedTimeStep(0.0f), nbSubSteps(0),
+      bAsynchronousQueries(false), pScheduler(0), handle(0)
+    {
+    }
+
+    virtual void execute()
+    {
+        nbSubSteps = pWorld->simulate(timeStep, nbMaxSubSteps, fixedTimeStep);
+    }
+
+    World*                      pWorld;
+    Math::Real                  timeStep;
+    unsigned int                nbMaxSubSteps;
+    Math::Real                  fixedTimeStep;
+    unsigned int                nbSubSteps;
+    bool                        bAsynchronousQueries;
+    ITaskScheduler*             pScheduler;     ///< Scheduler running the task (0: none)
+    ITaskScheduler::tTaskHandle handle;
+};
+
 
 /***************************** CONSTRUCTION / DESTRUCTION ******************************/
 
-World::World(const std::string& strName, ComponentsList* pList)
-: PhysicalComponent(DEFAULT_NAME, pList), m_type(WORLD_RIGID_BODY), m_pWorld(0),
-  m_pDispatcher(0), m_pBroadphase(0), m_pConstraintSolver(0), m_pCollisionConfiguration(0),
-  m_pCollisionManager(&CollisionManager::DefaultManager)
+World::World(const std::string& strName, ComponentsList* pList)
+: PhysicalComponent(DEFAULT_NAME, pList), m_type(WORLD_RIGID_BODY),
+  m_origin(Math::Vector3::ZERO), m_pWorld(0),
+  m_pDispatcher(0), m_pBroadphase(0), m_pConstraintSolver(0),
+  m_solverType(SOLVER_SEQUENTIAL_IMPULSE), m_pCollisionConfiguration(0),
+  m_pCollisionManager(&CollisionManager::DefaultManager), m_pTriggerIndex(0),
+  m_pTaskScheduler(0), m_pQueryQueue(0), m_pCommandBuffer(0), m_pSimulationLod(0),
+  m_pBudgetController(0), m_pMaterialTable(0), m_pProjectileSystem(0), m_lastStepCost(0.0f),
+  m_nbLastSubSteps(0), m_lastSimulatedTime(0.0f),
+  m_frontSnapshot(0), m_bSnapshotsEnabled(false), m_pBatchSnapshot(0), m_pStaticSnapshot(0),
+  m_bStaticSnapshotDirty(true), m_bBatchSnapshotDirty(true), m_bFrontSnapshotCurrent(false),
+  m_bFastCollisionAlgorithms(true),
+  m_pStepTask(0), m_bStepInProgress(false), m_bDeterministic(false), m_bMustSortObjects(false),
+  m_nextObjectKey(FIRST_OBJECT_KEY),
+  m_nbMovedBodies(0), m_movedBodiesStamp(1), m_stampGeneration(CollisionManager::getStampGeneration())
+{
+    assert(pList);
+    assert(pList->getScene());
+    assert(!pList->getEntity());
+
+    pList->getScene()->_setMainComponent(this);
+
+    m_pTriggerIndex = new TriggerIndex(this);
+    m_pQueryQueue = new QueryQueue(this);
+    m_pCommandBuffer = new CommandBuffer(this);
+    m_pSimulationLod = new SimulationLod(this);
+    m_pBudgetController = new BudgetController(this);
+    m_pMaterialTable = new MaterialTable();
+    m_pProjectileSystem = new ProjectileSystem(this);
+
+    m_snapshots[0] = new WorldSnapshot();
+    m_snapshots[1] = new WorldSnapshot();
+    m_pBatchSnapshot = new WorldSnapshot();
+    m_pStaticSnapshot = new WorldSnapshot();
+
+    m_pStepTask = new StepTask();
+    m_pStepTask->pWorld = this;
+
+    m_solverSettings = getSolverPreset(SOLVER_BALANCED);
+
+    m_islandSolverSettings.smallIslandSize          = 0;
+    m_islandSolverSettings.smallIslandIterations    = m_solverSettings.nbIterations;
+    m_islandSolverSettings.backgroundIterations     = 0;
+}
+
+//-----------------------------------------------------------------------
+
+World::~World()
+{
+    // Never destroy the Bullet's world while it is simulated
+    if (m_bStepInProgress)
+    {
+        if (m_pStepTask->pScheduler)
+            m_pStepTask->pScheduler->wait(m_pStepTask->handle);
+
+        if (m_pStepTask->bAsynchronousQueries)
+            m_pQueryQueue->wait();
+    }
+
+    delete m_pStepTask;
+    delete m_snapshots[0];
+    delete m_snapshots[1];
+    delete m_pBatchSnapshot;
+    delete m_pStaticSnapshot;
+    delete m_pProjectileSystem;
+    delete m_pMaterialTable;
+    delete m_pBudgetController;
+    delete m_pSimulationLod;
+    delete m_pCommandBuffer;
+    delete m_pQueryQueue;
+    delete m_pTriggerIndex;
+    delete m_pWorld;
+
+    if (m_solverType != SOLVER_CUSTOM)
+        delete m_pConstraintSolver;
+
+    delete m_pBroadphase;
+    delete m_pDispatcher;
+    delete m_pCollisionConfiguration;
+
+    m_pList->getScene()->_resetMainComponent(COMP_PHYSICAL);
+}
+
+//-----------------------------------------------------------------------
+
+World* World::create(const std::string& strName, ComponentsList* pList)
+{
+    return new World(strName, pList);
+}
+
+//-----------------------------------------------------------------------
+
+World* World::cast(Component* pComponent)
+{
+    return dynamic_cast<World*>(pComponent);
+}
+
+
+/**************************************** METHODS **************************************/
+
+void World::setWorldType(tType type)
+{
+    assert(!m_bStepInProgress);
+    assert(!m_pWorld);
+
+    m_type = type;
+    createWorld();
+}
+
+
+//-----------------------------------------------------------------------
+
+void World::setGravity(const Math::Vector3& gravity)
+{
+    assert(!m_bStepInProgress);
+
+    if (!m_pWorld)
+        createWorld();
+
+    m_pWorld->setGravity(toBullet(gravity));
+}
+
+//-----------------------------------------------------------------------
+
+Math::Vector3 World::getGravity()
+{
+    assert(!m_bStepInProgress);
+
+    if (!m_pWorld)
+        createWorld();
+
+    return fromBullet(m_pWorld->getGravity());
+}
+
+//-----------------------------------------------------------------------
+
+void World::shiftOrigin(const Math::Vector3& offset)
+{
+    assert(!m_bStepInProgress);
+
+    m_origin += offset;
+
+    if (!m_pWorld)
+        return;
+
+    btVector3 shift = toBullet(offset);
+
+    // Collision objects (and their bounding boxes in the broadphase)
+    btCollisionObjectArray& objects = m_pWorld->getCollisionObjectArray();
+    for (int i = 0; i < objects.size(); ++i)
+    {
+        btCollisionObject* pObject = objects[i];
+
+        pObject->getWorldTransform().getOrigin() -= shift;
+        pObject->getInterpolationWorldTransform().getOrigin() -= shift;
+
+        m_pWorld->updateSingleAabb(pObject);
+    }
+
+    // Cached contact points
+    for (int i = 0; i < m_pDispatcher->getNumManifolds(); ++i)
+    {
+        btPersistentManifold* pManifold = m_pDispatcher->getManifoldByIndexInternal(i);
+
+        for (int j = 0; j < pManifold->getNumContacts(); ++j)
+        {
+            btManifoldPoint& point = pManifold->getContactPoint(j);
+            point.m_positionWorldOnA -= shift;
+            point.m_positionWorldOnB -= shift;
+        }
+    }
+
+    // Static triggers (not in the Bullet's world)
+    m_pTriggerIndex->shiftOrigin(shift);
+
+    // The last snapshot must use the new origin too
+    if (m_bSnapshotsEnabled)
+        m_snapshots[m_frontSnapshot]->build(m_pWorld, m_pCollisionManager, m_origin);
+
+    m_bBatchSnapshotDirty = true;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int World::stepSimulation(Math::Real timeStep, unsigned int nbMaxSubSteps,
+                                   Math::Real fixedTimeStep)
+{
+    assert(!m_bStepInProgress);
+
+    bool bAsynchronousQueries = beginStep();
+
+    nbMaxSubSteps = m_pBudgetController->beforeStep(nbMaxSubSteps);
+
+    unsigned int nbSubSteps = simulate(timeStep, nbMaxSubSteps, fixedTimeStep);
+
+    endStep(bAsynchronousQueries);
+
+    return nbSubSteps;
+}
+
+//-----------------------------------------------------------------------
+
+void World::stepSimulationAsync(Math::Real timeStep, unsigned int nbMaxSubSteps,
+                                Math::Real fixedTimeStep)
+{
+    assert(!m_bStepInProgress);
+
+    m_pStepTask->bAsynchronousQueries   = beginStep();
+    m_pStepTask->timeStep               = timeStep;
+    m_pStepTask->nbMaxSubSteps          = m_pBudgetController->beforeStep(nbMaxSubSteps);
+    m_pStepTask->fixedTimeStep          = fixedTimeStep;
+    m_pStepTask->nbSubSteps             = 0;
+    m_pStepTask->pScheduler             = m_pTaskScheduler;
+
+    m_bStepInProgress = true;
+
+    if (m_pTaskScheduler)
+        m_pStepTask->handle = m_pTaskScheduler->submit(m_pStepTask);
+    else
+        m_pStepTask->execute();
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int World::waitStep()
+{
+    if (!m_bStepInProgress)
+        return 0;
+
+    if (m_pStepTask->pScheduler)
+        m_pStepTask->pScheduler->wait(m_pStepTask->handle);
+
+    m_bStepInProgress = false;
+
+    endStep(m_pStepTask->bAsynchronousQueries);
+
+    return m_pStepTask->nbSubSteps;
+}
+
+//-----------------------------------------------------------------------
+
+void World::enableSnapshots(bool bEnabled)
+{
+    assert(!m_bStepInProgress);
+
+    if (bEnabled == m_bSnapshotsEnabled)
+        return;
+
+    m_bSnapshotsEnabled = bEnabled;
+
+    if (m_bSnapshotsEnabled)
+    {
+        if (!m_pWorld)
+            createWorld();
+
+        m_snapshots[m_frontSnapshot]->build(m_pWorld, m_pCollisionManager, m_origin);
+        m_bFrontSnapshotCurrent = true;
+    }
+    else
+    {
+        m_snapshots[0]->clear();
+        m_snapshots[1]->clear();
+        m_removedObjects.clear();
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void World::enableFastCollisionAlgorithms(bool bEnabled)
+{
+    assert(!m_bStepInProgress);
+
+    if (bEnabled == m_bFastCollisionAlgorithms)
+        return;
+
+    m_bFastCollisionAlgorithms = bEnabled;
+
+    if (!m_pWorld)
+        return;
+
+    m_pCollisionConfiguration->enableFastAlgorithms(bEnabled);
+
+    // Register the creation functions of the algorithms again
+    btCollisionDispatcher* pDispatcher = static_cast<btCollisionDispatcher*>(m_pDispatcher);
+
+    for (int i = 0; i < MAX_BROADPHASE_COLLISION_TYPES; ++i)
+    {
+        for (int j = 0; j < MAX_BROADPHASE_COLLISION_TYPES; ++j)
+        {
+            pDispatcher->registerCollisionCreateFunc(i, j,
+                    m_pCollisionConfiguration->getCollisionAlgorithmCreateFunc(i, j));
+        }
+    }
+
+    // Destroy the algorithms of the existing pairs, so they are created again
+    CleanPairsCallback callback(m_pWorld->getPairCache(), m_pDispatcher);
+    m_pWorld->getPairCache()->processAllOverlappingPairs(&callback, m_pDispatcher);
+
+    for (unsigned int i = 0; i < m_aggregates.size(); ++i)
+        m_aggregates[i]->clearPairs(m_pDispatcher);
+}
+
+//-----------------------------------------------------------------------
+
+bool World::getContacts(PhysicalComponent* pComponent1, PhysicalComponent* pComponent2,
+                        tContactPointsList &contactPoints)
+{
+    assert(!m_bStepInProgress);
+    assert(pComponent1);
+    assert(pComponent2);
+
+    contactPoints.clear();
+
+    btCollisionObject* pObject1;
+    btCollisionObject* pObject2;
+
+    if (Body::cast(pComponent1))
+        pObject1 = Body::cast(pComponent1)->getRigidBody();
+    else if (GhostObject::cast(pComponent1))
+        pObject1 = GhostObject::cast(pComponent1)->getGhostObject();
+    else
+        return false;
+
+    if (Body::cast(pComponent2))
+        pObject2 = Body::cast(pComponent2)->getRigidBody();
+    else if (GhostObject::cast(pComponent2))
+        pObject2 = GhostObject::cast(pComponent2)->getGhostObject();
+    else
+        return false;
+
+    btBroadphasePair* pPairs = m_pWorld->getPairCache()->getOverlappingPairArrayPtr();
+    unsigned int nbPairs = m_pWorld->getPairCache()->getNumOverlappingPairs();
+    btBroadphasePair* pPair = pPairs;
+    unsigned int i;
+    for (i = 0; i < nbPairs; ++i)
+    {
+        if (((pPair->m_pProxy0->m_clientObject == pObject1) && (pPair->m_pProxy1->m_clientObject == pObject2)) ||
+            ((pPair->m_pProxy0->m_clientObject == pObject2) && (pPair->m_pProxy1->m_clientObject == pObject1)))
+            break;
+
+        ++pPair;
+    }
+
+    if (i == nbPairs)
+        return false;
+
+    if (!pPair->m_algorithm)
+        return false;
+
+    btManifoldArray manifolds;
+    pPair->m_algorithm->getAllContactManifolds(manifolds);
+
+    for (int j = 0; j < manifolds.size(); ++j)
+    {
+        btPersistentManifold* pManifold = manifolds[j];
+        for (int p = 0; p < pManifold->getNumContacts(); ++p)
+            contactPoints.push_back(pManifold->getContactPoint(p));
+    }
+
+    return (pPair->m_pProxy0->m_clientObject == pObject1);
+}
+
+//-----------------------------------------------------------------------
+
+void World::suspendBodies(Body* const* pBodies, unsigned int nbBodies)
+{
+    assert(!m_bStepInProgress);
+    assert(pBodies || (nbBodies == 0));
+
+    bool bMustForget = false;
+
+    for (unsigned int i = 0; i < nbBodies; ++i)
+    {
+        Body* pBody = pBodies[i];
+        assert(pBody);
+
+        if (pBody->m_bSuspended)
+            continue;
+
+        pBody->m_bSuspended = true;
+        pBody->m_suspensionOrigin = m_origin;
+
+        if (pBody->getRigidBody()->getBroadphaseHandle())
+        {
+            detachRigidBody(pBody);
+            bMustForget = bMustForget || (pBody->m_movedStamp != 0);
+        }
+    }
+
+    if (bMustForget)
+        forgetRemovedBodies();
+}
+
+//-----------------------------------------------------------------------
+
+void World::resumeBodies(Body* const* pBodies, unsigned int nbBodies)
+{
+    assert(!m_bStepInProgress);
+    assert(pBodies || (nbBodies == 0));
+
+    for (unsigned int i = 0; i < nbBodies; ++i)
+    {
+        Body* pBody = pBodies[i];
+        assert(pBody);
+
+        if (!pBody->m_bSuspended)
+            continue;
+
+        pBody->m_bSuspended = false;
+
+        // The origin of the world might have been shifted in the meantime
+        btRigidBody* pRigidBody = pBody->getRigidBody();
+        btVector3 shift = toBullet(pBody->m_suspensionOrigin - m_origin);
+
+        pRigidBody->getWorldTransform().getOrigin() += shift;
+        pRigidBody->getInterpolationWorldTransform().getOrigin() += shift;
+
+        if (pRigidBody->getCollisionShape())
+            addRigidBody(pBody);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void World::saveState(std::vector<unsigned char> &buffer) const
+{
+    assert(!m_bStepInProgress);
+
+    buffer.resize(sizeof(tStateHeader) + m_bodies.size() * sizeof(tBodyState));
+
+    tStateHeader header;
+    header.magic            = STATE_MAGIC;
+    header.bodyStateSize    = sizeof(tBodyState);
+    header.nbBodies         = (unsigned int) m_bodies.size();
+
+    memcpy(&buffer[0], &header, sizeof(tStateHeader));
+
+    unsigned char* pDest = &buffer[0] + sizeof(tStateHeader);
+
+    tBodyState state;
+
+    for (size_t i = 0; i < m_bodies.size(); ++i)
+    {
+        Body* pBody = m_bodies[i];
+
+        if (pBody)
+            saveBodyState(pBody->getRigidBody(), state);
+        else
+            memset(&state, 0, sizeof(tBodyState));
+
+        memcpy(pDest, &state, sizeof(tBodyState));
+        pDest += sizeof(tBodyState);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+bool World::restoreState(const std::vector<unsigned char>& buffer)
+{
+    assert(!m_bStepInProgress);
+
+    if (buffer.size() < sizeof(tStateHeader))
+        return false;
+
+    tStateHeader header;
+    memcpy(&header, &buffer[0], sizeof(tStateHeader));
+
+    if ((header.magic != STATE_MAGIC) || (header.bodyStateSize != sizeof(tBodyState)) ||
+        (buffer.size() != sizeof(tStateHeader) + header.nbBodies * sizeof(tBodyState)))
+    {
+        return false;
+    }
+
+    const unsigned char* pSrc = &buffer[0] + sizeof(tStateHeader);
+    size_t nbBodies = std::min((size_t) header.nbBodies, m_bodies.size());
+
+    tBodyState state;
+
+    for (size_t i = 0; i < nbBodies; ++i, pSrc += sizeof(tBodyState))
+    {
+        Body* pBody = m_bodies[i];
+        if (!pBody)
+            continue;
+
+        memcpy(&state, pSrc, sizeof(tBodyState));
+        if (!state.bUsed)
+            continue;
+
+        btRigidBody* pRigidBody = pBody->getRigidBody();
+        btTransform transform = loadTransform(state.transform);
+
+        pRigidBody->setWorldTransform(transform);
+        pRigidBody->setInterpolationWorldTransform(loadTransform(state.interpolationTransform));
+        pRigidBody->setLinearVelocity(loadVector(state.linearVelocity));
+        pRigidBody->setAngularVelocity(loadVector(state.angularVelocity));
+        pRigidBody->setInterpolationLinearVelocity(loadVector(state.interpolationLinearVelocity));
+        pRigidBody->setInterpolationAngularVelocity(loadVector(state.interpolationAngularVelocity));
+        pRigidBody->setDeactivationTime(state.deactivationTime);
+        pRigidBody->forceActivationState(state.activationState);
+        pRigidBody->clearForces();
+
+        // Move the entity too (the static and kinematic bodies follow it)
+        pBody->setWorldTransform(transform);
+
+        if (m_pWorld && pRigidBody->getBroadphaseHandle())
+            m_pWorld->updateSingleAabb(pRigidBody);
+    }
+
+    // The cached contacts don't match the restored state anymore
+    if (m_bDeterministic)
+    {
+        m_bMustSortObjects = true;
+    }
+    else if (m_pWorld)
+    {
+        btBroadphasePairArray& pairs = m_pWorld->getPairCache()->getOverlappingPairArray();
+        btManifoldArray manifolds;
+
+        for (int i = 0; i < pairs.size(); ++i)
+        {
+            if (!pairs[i].m_algorithm)
+                continue;
+
+            manifolds.resize(0);
+            pairs[i].m_algorithm->getAllContactManifolds(manifolds);
+
+            for (int j = 0; j < manifolds.size(); ++j)
+                manifolds[j]->clearManifold();
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+void World::setDeterministic(bool bDeterministic)
+{
+    assert(!m_bStepInProgress);
+
+    if (bDeterministic == m_bDeterministic)
+        return;
+
+    if (!m_pWorld)
+        createWorld();
+
+    m_bDeterministic = bDeterministic;
+    m_bMustSortObjects = bDeterministic;
+
+    static_cast<SortingDispatcher*>(m_pDispatcher)->bSortManifolds = bDeterministic;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int World::computeStateHash() const
+{
+    assert(!m_bStepInProgress);
+
+    unsigned int value = 2166136261u;
+
+    tBodyState state;
+
+    for (size_t i = 0; i < m_bodies.size(); ++i)
+    {
+        memset(&state, 0, sizeof(tBodyState));
+
+        if (m_bodies[i])
+            saveBodyState(m_bodies[i]->getRigidBody(), state);
+
+        value = hash(&state, sizeof(tBodyState), value);
+    }
+
+    return value;
+}
+
+//-----------------------------------------------------------------------
+
+void World::runTasks(ITaskScheduler::ITask** pTasks, unsigned int nbTasks)
+{
+    assert(pTasks || (nbTasks == 0));
+
+    if (m_pTaskScheduler && (nbTasks > 1))
+    {
+        m_pTaskScheduler->run(pTasks, nbTasks);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < nbTasks; ++i)
+            pTasks[i]->execute();
+    }
+}
+
+//-----------------------------------------------------------------------
+
+const WorldSnapshot* World::buildBatchSnapshot()
+{
+    assert(!m_bStepInProgress);
+
+    if (!m_pWorld)
+        createWorld();
+
+    // The queries of the Bullet's world can't be performed by several threads at the
+    // same time (the traversal stack of the broadphase is shared, and the compound
+    // shapes are modified during the tests), but the ones of a snapshot can. The one
+    // published by the last step is used if the world wasn't modified since then.
+    if (m_bSnapshotsEnabled && m_bFrontSnapshotCurrent)
+        return m_snapshots[m_frontSnapshot];
+
+    if (m_bBatchSnapshotDirty)
+    {
+        m_pBatchSnapshot->build(m_pWorld, m_pCollisionManager, m_origin);
+        m_bBatchSnapshotDirty = false;
+    }
+
+    return m_pBatchSnapshot;
+}
+
+//-----------------------------------------------------------------------
+
+const WorldSnapshot* World::getStaticSnapshot()
+{
+    assert(!m_bStepInProgress || !m_bStaticSnapshotDirty);
+
+    if (!m_pWorld)
+        createWorld();
+
+    if (m_bStaticSnapshotDirty)
+    {
+        m_pStaticSnapshot->build(m_pWorld, m_pCollisionManager, m_origin, true);
+        m_bStaticSnapshotDirty = false;
+    }
+
+    return m_pStaticSnapshot;
+}
+
+//-----------------------------------------------------------------------
+
+bool World::beginStep()
+{
+    if (!m_pWorld)
+        createWorld();
+
+    // Forget the bodies published by the previous step (but not the ones moved since)
+    m_movedBodies.erase(m_movedBodies.begin(), m_movedBodies.begin() + m_nbMovedBodies);
+    m_nbMovedBodies = 0;
+
+    m_pCommandBuffer->apply();
+
+    // The stamps of the decisions cached by the collision filter were reset
+    if (m_stampGeneration != CollisionManager::getStampGeneration())
+    {
+        CollisionManager::clearCachedDecisions(m_pWorld->getPairCache());
+
+        for (unsigned int i = 0; i < m_aggregates.size(); ++i)
+            CollisionManager::clearCachedDecisions(m_aggregates[i]->m_pPairCache);
+
+        m_stampGeneration = CollisionManager::getStampGeneration();
+    }
+
+    if (m_bDeterministic)
+    {
+        if (m_bMustSortObjects)
+            sortCollisionObjects();
+
+        btSequentialImpulseConstraintSolver* pSolver = dynamic_cast<btSequentialImpulseConstraintSolver*>(m_pConstraintSolver);
+        if (pSolver)
+            pSolver->setRandSeed(0);
+    }
+
+    m_pSimulationLod->beforeStep();
+
+    // The deferred queries can be processed on the last snapshot during the step
+    return m_pQueryQueue->launch();
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int World::simulate(Math::Real timeStep, unsigned int nbMaxSubSteps,
+                             Math::Real fixedTimeStep)
+{
+    CollisionManager::_CurrentManager = m_pCollisionManager;
+    MaterialTable::_CurrentTable = m_pMaterialTable;
+
+    btClock clock;
+
+    int nbSubSteps = m_pWorld->stepSimulation(timeStep, nbMaxSubSteps, fixedTimeStep);
+
+    m_lastStepCost = Math::Real(clock.getTimeMicroseconds()) * Math::Real(1e-6);
+
+    // Bullet reports the number of substeps needed, not the (clamped) number done
+    if (nbMaxSubSteps > 0)
+    {
+        m_nbLastSubSteps = std::min((unsigned int) nbSubSteps, nbMaxSubSteps);
+        m_lastSimulatedTime = Math::Real(m_nbLastSubSteps) * fixedTimeStep;
+    }
+    else
+    {
+        m_nbLastSubSteps = (unsigned int) nbSubSteps;
+        m_lastSimulatedTime = (nbSubSteps > 0 ? timeStep : 0.0f);
+    }
+
+    CollisionManager::_CurrentManager = 0;
+    MaterialTable::_CurrentTable = 0;
+
+    return (unsigned int) nbSubSteps;
+}
+
+//-----------------------------------------------------------------------
+
+void World::endStep(bool bAsynchronousQueries)
+{
+    if (bAsynchronousQueries)
+        m_pQueryQueue->wait();
+
+    m_pSimulationLod->afterStep();
+    m_pBudgetController->afterStep(m_lastStepCost, m_nbLastSubSteps);
+    m_pTriggerIndex->update(m_movedBodies.empty() ? 0 : &m_movedBodies[0],
+                            (unsigned int) m_movedBodies.size());
+
+    // The bodies that fell asleep aren't moved by the simulation anymore, but their
+    // change of state is reported too
+    for (size_t i = 0; i < m_awakeBodies.size(); ++i)
+    {
+        if (!m_awakeBodies[i]->getRigidBody()->isActive())
+            notifyBodyMoved(m_awakeBodies[i]);
+    }
+
+    m_awakeBodies.clear();
+    for (size_t i = 0; i < m_movedBodies.size(); ++i)
+    {
+        Body* pBody = m_movedBodies[i];
+        if (pBody->isDynamic() && pBody->getRigidBody()->isActive())
+            m_awakeBodies.push_back(pBody);
+    }
+
+    m_nbMovedBodies = (unsigned int) m_movedBodies.size();
+    ++m_movedBodiesStamp;
+
+    // Publish the new state (in the buffer not used by the previous snapshot)
+    m_bBatchSnapshotDirty = true;
+
+    if (m_bSnapshotsEnabled)
+    {
+        unsigned int backSnapshot = 1 - m_frontSnapshot;
+        m_snapshots[backSnapshot]->build(m_pWorld, m_pCollisionManager, m_origin);
+
+        // The previous snapshot isn't guaranteed to be valid from now on, so the bodies
+        // removed since its publication can be removed from it
+        for (int i = 0; i < m_removedObjects.size(); ++i)
+            m_snapshots[m_frontSnapshot]->onObjectRemoved(m_removedObjects[i]);
+
+        m_frontSnapshot = backSnapshot;
+        m_bFrontSnapshotCurrent = true;
+    }
+
+    m_removedObjects.clear();
+
+    // The projectiles are tested against the new snapshot
+    m_pProjectileSystem->update(m_lastSimulatedTime);
+
+    if (!bAsynchronousQueries)
+        m_pQueryQueue->process();
+}
+
+//-----------------------------------------------------------------------
+
+void World::sortCollisionObjects()
+{
+    assert(m_pWorld);
+
+    btCollisionObjectArray& objects = m_pWorld->getCollisionObjectArray();
+    int nbObjects = objects.size();
+
+    std::vector<tOrderedObject> sorted(nbObjects);
+    for (int i = 0; i < nbObjects; ++i)
+    {
+        btCollisionObject* pObject = objects[i];
+
+        sorted[i].key       = getOrderKey(pObject, m_objectKeys);
+        sorted[i].pObject   = pObject;
+        sorted[i].group     = pObject->getBroadphaseHandle()->m_collisionFilterGroup;
+        sorted[i].mask      = pObject->getBroadphaseHandle()->m_collisionFilterMask;
+    }
+
+    // The other objects keep their relative order
+    std::stable_sort(sorted.begin(), sorted.end());
+
+    // Re-insert all the objects, so the broadphase assigns them identifiers in that
+    // order, and all the pairs and contacts are discarded
+    for (unsigned int i = 0; i < m_aggregates.size(); ++i)
+        m_aggregates[i]->clearPairs(m_pDispatcher);
+
+    for (int i = 0; i < nbObjects; ++i)
+    {
+        btRigidBody* pRigidBody = btRigidBody::upcast(sorted[i].pObject);
+        if (pRigidBody)
+            m_pWorld->removeRigidBody(pRigidBody);
+        else
+            m_pWorld->removeCollisionObject(sorted[i].pObject);
+    }
+
+    for (int i = 0; i < nbObjects; ++i)
+    {
+        btRigidBody* pRigidBody = btRigidBody::upcast(sorted[i].pObject);
+        if (pRigidBody)
+            m_pWorld->addRigidBody(pRigidBody, sorted[i].group, sorted[i].mask);
+        else
+            m_pWorld->addCollisionObject(sorted[i].pObject, sorted[i].group, sorted[i].mask);
+    }
+
+    m_bMustSortObjects = false;
+}
+
+//-----------------------------------------------------------------------
+
+void World::insertInOrder(btCollisionObject* pObject)
+{
+    assert(pObject);
+    assert(m_pWorld);
+
+    // Outside the deterministic mode, or when all the objects will be sorted before the
+    // next step anyway, the objects stay where Bullet puts them
+    if (!m_bDeterministic || m_bMustSortObjects)
+        return;
+
+    btCollisionObjectArray& objects = m_pWorld->getCollisionObjectArray();
+    assert(objects[objects.size() - 1] == pObject);
+
+    moveLastInOrder(objects, m_objectKeys);
+
+    btRigidBody* pRigidBody = btRigidBody::upcast(pObject);
+    if (pRigidBody)
+    {
+        btAlignedObjectArray<btRigidBody*>& bodies = NonStaticBodiesAccessor::get(m_pWorld);
+        if ((bodies.size() > 0) && (bodies[bodies.size() - 1] == pRigidBody))
+            moveLastInOrder(bodies, m_objectKeys);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void World::removeInOrder(btCollisionObject* pObject)
+{
+    assert(pObject);
+    assert(m_pWorld);
+
+    if (!m_bDeterministic || m_bMustSortObjects)
+        return;
+
+    // Bullet doesn't complain about the objects already removed from its lists
+    eraseInOrder(m_pWorld->getCollisionObjectArray(), pObject);
+
+    btRigidBody* pRigidBody = btRigidBody::upcast(pObject);
+    if (pRigidBody)
+        eraseInOrder(NonStaticBodiesAccessor::get(m_pWorld), pRigidBody);
+}
+
+//-----------------------------------------------------------------------
+
+void World::addObjectKey(const btCollisionObject* pObject)
+{
+    assert(pObject);
+
+    m_objectKeys[pObject] = m_nextObjectKey;
+    ++m_nextObjectKey;
+}
+
+//-----------------------------------------------------------------------
+
+void World::createWorld()
+{
+    assert(!m_pWorld);
+
+    // Collision configuration contains default setup for memory, collision setup
+    m_pCollisionConfiguration = new CollisionConfiguration();
+    m_pCollisionConfiguration->enableFastAlgorithms(m_bFastCollisionAlgorithms);
+
+    // Use the default collision dispatcher (able to sort the manifolds in deterministic
+    // mode)
+    m_pDispatcher = new SortingDispatcher(m_pCollisionConfiguration, &m_aggregates, &m_objectKeys);
+    dynamic_cast<btCollisionDispatcher*>(m_pDispatcher)->setNearCallback(&CollisionManager::customNearCallback);
+
+    m_pBroadphase = new FilteringBroadphase();
+    m_pBroadphase->getOverlappingPairCache()->setInternalGhostPairCallback(new btGhostPairCallback());
+
+    // The constraint solver, if not already selected (the ones of the world use less
+    // iterations on some islands)
+    if (!m_pConstraintSolver)
+    {
+        if (m_solverType == SOLVER_PARALLEL_ISLANDS)
+            m_pConstraintSolver = new ParallelIslandSolver(this);
+        else
+            m_pConstraintSolver = new IslandSolver(this);
+    }
+
+    switch (m_type)
+    {
+        case WORLD_RIGID_BODY:
+            m_pWorld = new AggregateWorld<btDiscreteDynamicsWorld>(m_pDispatcher, m_pBroadphase, m_pConstraintSolver,
+                                                                   m_pCollisionConfiguration, &m_aggregates);
+            break;
+
+        case WORLD_SOFT_BODY:
+            m_pWorld = new AggregateWorld<btSoftRigidDynamicsWorld>(m_pDispatcher, m_pBroadphase, m_pConstraintSolver,
+                                                                    m_pCollisionConfiguration, &m_aggregates);
+            break;
+    }
+
+    m_pWorld->getPairCache()->setOverlapFilterCallback(m_pCollisionManager);
+
+    // The level of detail is updated at each substep
+    m_pWorld->setInternalTickCallback(&internalTickCallback, m_pSimulationLod);
+
+    // The contacts involving a material get their values from the material table
+    MaterialTable::installContactAddedCallback();
+
+    applySolverSettings();
+}
+
+//-----------------------------------------------------------------------
+
+void World::applySolverSettings()
+{
+    assert(m_pWorld);
+
+    btContactSolverInfo& info = m_pWorld->getSolverInfo();
+
+    info.m_numIterations                    = (int) m_pBudgetController->getIterations(m_solverSettings.nbIterations);
+    info.m_sor                              = m_solverSettings.sor;
+    info.m_erp                              = m_solverSettings.erp;
+    info.m_erp2                             = m_solverSettings.erp2;
+    info.m_splitImpulse                     = (m_solverSettings.bSplitImpulse ? 1 : 0);
+    info.m_splitImpulsePenetrationThreshold = m_solverSettings.splitImpulseThreshold;
+    info.m_warmstartingFactor               = m_solverSettings.warmStartingFactor;
+
+    // Only change the flags corresponding to the settings
+    int mode = info.m_solverMode & ~(SOLVER_RANDMIZE_ORDER | SOLVER_FRICTION_SEPARATE |
+                                     SOLVER_USE_WARMSTARTING | SOLVER_USE_2_FRICTION_DIRECTIONS |
+                                     SOLVER_ENABLE_FRICTION_DIRECTION_CACHING | SOLVER_SIMD);
+
+    if (m_solverSettings.bRandomizeOrder)
+        mode |= SOLVER_RANDMIZE_ORDER;
+
+    if (m_solverSettings.bSeparateFriction)
+        mode |= SOLVER_FRICTION_SEPARATE;
+
+    if (m_solverSettings.bWarmStarting)
+        mode |= SOLVER_USE_WARMSTARTING;
+
+    if (m_solverSettings.bSimd)
+        mode |= SOLVER_SIMD;
+
+    switch (m_solverSettings.frictionMode)
+    {
+        case FRICTION_ONE_DIRECTION:
+            break;
+
+        case FRICTION_TWO_DIRECTIONS:
+            mode |= SOLVER_USE_2_FRICTION_DIRECTIONS;
+            break;
+
+        case FRICTION_TWO_DIRECTIONS_CACHED:
+            mode |= SOLVER_USE_2_FRICTION_DIRECTIONS | SOLVER_ENABLE_FRICTION_DIRECTION_CACHING;
+            break;
+    }
+
+    info.m_solverMode = mode;
+}
+
+//-----------------------------------------------------------------------
+
+void World::addRigidBody(Body* pBody)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pBody);
+
+    if (!m_pWorld)
+        createWorld();
+
+    insertRigidBody(m_pWorld, pBody);
+
+    if (pBody->isStatic())
+        m_bStaticSnapshotDirty = true;
+
+    m_bBatchSnapshotDirty = true;
+    m_bFrontSnapshotCurrent = false;
+
+    // Assign an index to the body (the last freed one, so a body removed and added
+    // back immediately keeps its index). A resumed body already has one.
+    if (pBody->m_worldIndex != Body::INVALID_INDEX)
+    {
+        m_bodies[pBody->m_worldIndex] = pBody;
+    }
+    else
+    {
+        if (!m_freeBodySlots.empty())
+        {
+            pBody->m_worldIndex = m_freeBodySlots.back();
+            m_freeBodySlots.pop_back();
+            m_bodies[pBody->m_worldIndex] = pBody;
+        }
+        else
+        {
+            pBody->m_worldIndex = (unsigned int) m_bodies.size();
+            m_bodies.push_back(pBody);
+        }
+    }
+
+    insertInOrder(pBody->getRigidBody());
+}
+
+//-----------------------------------------------------------------------
+
+void World::removeRigidBody(Body* pBody)
+{
+    detachRigidBody(pBody);
+
+    // Forget the body in the lists of moved bodies
+    if (pBody->m_movedStamp != 0)
+        forgetRemovedBodies();
+}
+
+//-----------------------------------------------------------------------
+
+void World::detachRigidBody(Body* pBody)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pBody);
+    assert(m_pWorld);
+
+    m_pTriggerIndex->onObjectRemoved(pBody->getRigidBody());
+    m_pProjectileSystem->onObjectRemoved(pBody);
+
+    // The published snapshots might be queried by other threads: the body is only
+    // removed from them once they aren't guaranteed to be valid anymore
+    if (m_bSnapshotsEnabled)
+        m_removedObjects.push_back(pBody->getRigidBody());
+
+    if (pBody->isStatic())
+        m_bStaticSnapshotDirty = true;
+
+    m_bBatchSnapshotDirty = true;
+    m_bFrontSnapshotCurrent = false;
+
+    btBroadphaseProxy* pProxy = pBody->getRigidBody()->getBroadphaseHandle();
+    if (pProxy)
+    {
+        for (unsigned int i = 0; i < m_aggregates.size(); ++i)
+            m_aggregates[i]->removeProxy(pProxy, m_pDispatcher);
+    }
+
+    removeInOrder(pBody->getRigidBody());
+    m_pWorld->removeRigidBody(pBody->getRigidBody());
+
+    // The index of a suspended body stays reserved until it is really removed
+    if (pBody->m_bSuspended)
+    {
+        if (pBody->m_worldIndex != Body::INVALID_INDEX)
+            m_bodies[pBody->m_worldIndex] = 0;
+    }
+    else
+    {
+        releaseBodyIndex(pBody);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void World::releaseBodyIndex(Body* pBody)
+{
+    assert(pBody);
+
+    if (pBody->m_worldIndex == Body::INVALID_INDEX)
+        return;
+
+    m_bodies[pBody->m_worldIndex] = 0;
+    m_freeBodySlots.push_back(pBody->m_worldIndex);
+    pBody->m_worldIndex = Body::INVALID_INDEX;
+}
+
+//-----------------------------------------------------------------------
+
+void World::reinsertRigidBody(Body* pBody)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pBody);
+
+    // Nothing to do for the bodies not in the broadphase (the filter group is set when
+    // they are added)
+    btRigidBody* pRigidBody = pBody->getRigidBody();
+    if (!m_pWorld || !pRigidBody->getBroadphaseHandle())
+        return;
+
+    for (unsigned int i = 0; i < m_aggregates.size(); ++i)
+        m_aggregates[i]->removeProxy(pRigidBody->getBroadphaseHandle(), m_pDispatcher);
+
+    // A new proxy is created, so the pairs of the body are filtered again
+    removeInOrder(pRigidBody);
+    m_pWorld->removeRigidBody(pRigidBody);
+    insertRigidBody(m_pWorld, pBody);
+    insertInOrder(pRigidBody);
+
+    // The collision group of the body might have changed
+    if (pBody->isStatic())
+        m_bStaticSnapshotDirty = true;
+
+    m_bBatchSnapshotDirty = true;
+    m_bFrontSnapshotCurrent = false;
+}
+
+//-----------------------------------------------------------------------
+
+void World::addAggregate(Aggregate* pAggregate)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pAggregate);
+
+    if (!m_pWorld)
+        createWorld();
+
+    m_aggregates.push_back(pAggregate);
+
+    addObjectKey(pAggregate->m_pProxy);
+    m_pWorld->addCollisionObject(pAggregate->m_pProxy, Aggregate::PROXY_FILTER,
+                                 short(btBroadphaseProxy::AllFilter));
+    insertInOrder(pAggregate->m_pProxy);
+}
+
+//-----------------------------------------------------------------------
+
+void World::removeAggregate(Aggregate* pAggregate)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pAggregate);
+    assert(m_pWorld);
+
+    std::vector<Aggregate*>::iterator iter = std::find(m_aggregates.begin(), m_aggregates.end(), pAggregate);
+    assert(iter != m_aggregates.end());
+
+    m_aggregates.erase(iter);
+
+    pAggregate->clearPairs(m_pDispatcher);
+
+    removeInOrder(pAggregate->m_pProxy);
+    m_pWorld->removeCollisionObject(pAggregate->m_pProxy);
+    m_objectKeys.erase(pAggregate->m_pProxy);
+}
+
+//-----------------------------------------------------------------------
+
+void World::forgetRemovedBodies()
+{
+    // Remove the bodies without index (or suspended) from the lists, in one pass
+    size_t nbKept = 0;
+    unsigned int nbPublished = 0;
+
+    for (size_t i = 0; i < m_movedBodies.size(); ++i)
+    {
+        Body* pBody = m_movedBodies[i];
+
+        if ((pBody->m_worldIndex == Body::INVALID_INDEX) || pBody->m_bSuspended)
+        {
+            pBody->m_movedStamp = 0;
+            continue;
+        }
+
+        if (i < m_nbMovedBodies)
+            ++nbPublished;
+
+        m_movedBodies[nbKept] = pBody;
+        ++nbKept;
+    }
+
+    m_movedBodies.resize(nbKept);
+    m_nbMovedBodies = nbPublished;
+
+    nbKept = 0;
+    for (size_t i = 0; i < m_awakeBodies.size(); ++i)
+    {
+        Body* pBody = m_awakeBodies[i];
+
+        if ((pBody->m_worldIndex == Body::INVALID_INDEX) || pBody->m_bSuspended)
+        {
+            pBody->m_movedStamp = 0;
+            continue;
+        }
+
+        m_awakeBodies[nbKept] = pBody;
+        ++nbKept;
+    }
+
+    m_awakeBodies.resize(nbKept);
+}
+
+//-----------------------------------------------------------------------
+
+void World::notifyBodyMoved(Body* pBody)
+{
+    assert(pBody);
+
+    if (pBody->isStatic())
+        m_bStaticSnapshotDirty = true;
+
+    m_bBatchSnapshotDirty = true;
+    m_bFrontSnapshotCurrent = false;
+
+    // Already in the list?
+    if (pBody->m_movedStamp == m_movedBodiesStamp)
+        return;
+
+    pBody->m_movedStamp = m_movedBodiesStamp;
+    m_movedBodies.push_back(pBody);
+}
+
+//-----------------------------------------------------------------------
+
+void World::addGhostObject(GhostObject* pGhostObject)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pGhostObject);
+
+    if (!m_pWorld)
+        createWorld();
+
+    if (pGhostObject->isStatic())
+    {
+        m_pTriggerIndex->addTrigger(pGhostObject);
+    }
+    else
+    {
+        btCollisionObject* pObject = pGhostObject->getGhostObject();
+
+        addObjectKey(pObject);
+        m_pWorld->addCollisionObject(pObject, short(btBroadphaseProxy::DefaultFilter) | GHOST_FILTER,
+                                     short(btBroadphaseProxy::AllFilter));
+        insertInOrder(pObject);
+    }
+}
+
+//-----------------------------------------------------------------------
+
+void World::removeGhostObject(GhostObject* pGhostObject)
+{
+    // Assertions
+    assert(!m_bStepInProgress);
+    assert(pGhostObject);
+    assert(m_pWorld);
+
+    if (pGhostObject->isStatic())
+    {
+        m_pTriggerIndex->removeTrigger(pGhostObject);
+    }
+    else
+    {
+        btCollisionObject* pObject = pGhostObject->getGhostObject();
+
+        removeInOrder(pObject);
+        m_pWorld->removeCollisionObject(pObject);
+        m_objectKeys.erase(pObject);
+    }
+}
+
+
+/*********************************** SPATIAL QUERIES ***********************************/
+
+bool World::rayCast(const tRay& ray, tRayHit &hit, tCollisionGroup group)
+{
+    assert(!m_bStepInProgress);
+
+    if (!m_pWorld)
+        createWorld();
+
+    return castRay(m_pWorld, m_pCollisionManager, m_origin, ray, hit, group);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int World::rayCastBatch(const tRay* pRays, size_t nbRays, tRayHit* pHits,
+                                 tCollisionGroup group)
+{
+    assert(!m_bStepInProgress);
+    assert(pRays || (nbRays == 0));
+    assert(pHits || (nbRays == 0));
+
+    if (!m_pWorld)
+        createWorld();
+
+    // Split the batch in tasks
+    unsigned int nbTasks = (unsigned int) ((nbRays + QUERIES_PER_TASK - 1) / QUERIES_PER_TASK);
+    if (!m_pTaskScheduler)
+        nbTasks = (nbRays > 0 ? 1 : 0);
+
+    if (nbTasks == 0)
+        return 0;
+
+    const WorldSnapshot* pSnapshot = (nbTasks > 1 ? buildBatchSnapshot() : 0);
+
+    return castRays(pSnapshot, pRays, nbRays, pHits, group, nbTasks);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int World::rayCastBatch(const WorldSnapshot* pSnapshot, const tRay* pRays,
+                                 size_t nbRays, tRayHit* pHits, tCollisionGroup group)
 {
-    assert(pList);
-    assert(pList->getScene());
-    assert(!pList->getEntity());
+    assert(pSnapshot);
+    assert(pRays || (nbRays == 0));
+    assert(pHits || (nbRays == 0));
 
-    pList->getScene()->_setMainComponent(this);
+    unsigned int nbTasks = (unsigned int) ((nbRays + QUERIES_PER_TASK - 1) / QUERIES_PER_TASK);
+    if (!m_pTaskScheduler)
+        nbTasks = (nbRays > 0 ? 1 : 0);
+
+    if (nbTasks == 0)
+        return 0;
+
+    return castRays(pSnapshot, pRays, nbRays, pHits, group, nbTasks);
 }
 
 //-----------------------------------------------------------------------
 
-World::~World()
+unsigned int World::castRays(const WorldSnapshot* pSnapshot, const tRay* pRays, size_t nbRays,
+                             tRayHit* pHits, tCollisionGroup group, unsigned int nbTasks)
 {
-    delete m_pWorld;
-    delete m_pConstraintSolver;
-    delete m_pBroadphase;
-    delete m_pDispatcher;
-    delete m_pCollisionConfiguration;
+    assert(nbTasks > 0);
 
-    m_pList->getScene()->_resetMainComponent(COMP_PHYSICAL);
+    RayCastTask tasks[MAX_TASKS_PER_RUN];
+    ITaskScheduler::ITask* taskPtrs[MAX_TASKS_PER_RUN];
+
+    size_t raysPerTask = (nbRays + nbTasks - 1) / nbTasks;
+    size_t first = 0;
+    unsigned int nbHits = 0;
+
+    while (first < nbRays)
+    {
+        unsigned int nbRunTasks = 0;
+
+        while ((nbRunTasks < MAX_TASKS_PER_RUN) && (first < nbRays))
+        {
+            RayCastTask& task = tasks[nbRunTasks];
+
+            task.pWorld             = m_pWorld;
+            task.pSnapshot          = pSnapshot;
+            task.pCollisionManager  = m_pCollisionManager;
+            task.origin             = m_origin;
+            task.pRays              = pRays + first;
+            task.pHits              = pHits + first;
+            task.nbRays             = std::min(raysPerTask, nbRays - first);
+            task.group              = group;
+
+            taskPtrs[nbRunTasks] = &task;
+            ++nbRunTasks;
+
+            first += task.nbRays;
+        }
+
+        runTasks(taskPtrs, nbRunTasks);
+
+        for (unsigned int i = 0; i < nbRunTasks; ++i)
+            nbHits += tasks[i].nbHits;
+    }
+
+    return nbHits;
 }
 
 //-----------------------------------------------------------------------
 
-World* World::create(const std::string& strName, ComponentsList* pList)
+bool World::sweep(CollisionShape* pShape, const tSweep& sweep, tSweepHit &hit,
+                  tCollisionGroup group)
 {
-    return new World(strName, pList);
+    return (sweepBatch(pShape, &sweep, 1, &hit, group) == 1);
 }
 
 //-----------------------------------------------------------------------
 
-World* World::cast(Component* pComponent)
+bool World::sweep(const tPrimitive& primitive, const tSweep& sweep, tSweepHit &hit,
+                  tCollisionGroup group)
 {
-    return dynamic_cast<World*>(pComponent);
+    InlineShape shape(primitive);
+    return (sweepBatch(shape.get(), &sweep, 1, &hit, group) == 1);
 }
 
+//-----------------------------------------------------------------------
 
-/**************************************** METHODS **************************************/
-
-void World::setWorldType(tType type)
+unsigned int World::sweepBatch(CollisionShape* pShape, const tSweep* pSweeps, size_t nbSweeps,
+                               tSweepHit* pHits, tCollisionGroup group)
 {
-    assert(!m_pWorld);
+    assert(pShape);
+    assert(pShape->getCollisionShape());
+    assert(pSweeps || (nbSweeps == 0));
+    assert(pHits || (nbSweeps == 0));
 
-    m_type = type;
-    createWorld();
+    // Only the convex shapes can be moved, the other ones never hit anything
+    if (!pShape->getCollisionShape() || !pShape->getCollisionShape()->isConvex())
+    {
+        for (size_t i = 0; i < nbSweeps; ++i)
+        {
+            pHits[i].pObject    = 0;
+            pHits[i].position   = pSweeps[i].to;
+            pHits[i].normal     = Math::Vector3::ZERO;
+            pHits[i].fraction   = 1.0f;
+        }
+
+        return 0;
+    }
+
+    return sweepBatch(static_cast<const btConvexShape*>(pShape->getCollisionShape()),
+                      pSweeps, nbSweeps, pHits, group);
 }
 
+//-----------------------------------------------------------------------
+
+unsigned int World::sweepBatch(const tPrimitive& primitive, const tSweep* pSweeps, size_t nbSweeps,
+                               tSweepHit* pHits, tCollisionGroup group)
+{
+    InlineShape shape(primitive);
+    return sweepBatch(shape.get(), pSweeps, nbSweeps, pHits, group);
+}
 
 //-----------------------------------------------------------------------
 
-void World::setGravity(const Math::Vector3& gravity)
+unsigned int World::sweepBatch(const btConvexShape* pShape, const tSweep* pSweeps, size_t nbSweeps,
+                               tSweepHit* pHits, tCollisionGroup group)
 {
+    assert(!m_bStepInProgress);
+    assert(pShape);
+    assert(pSweeps || (nbSweeps == 0));
+    assert(pHits || (nbSweeps == 0));
+
     if (!m_pWorld)
         createWorld();
 
-    m_pWorld->setGravity(toBullet(gravity));
+    // Split the batch in tasks
+    unsigned int nbTasks = (unsigned int) ((nbSweeps + QUERIES_PER_TASK - 1) / QUERIES_PER_TASK);
+    if (!m_pTaskScheduler)
+        nbTasks = (nbSweeps > 0 ? 1 : 0);
+
+    if (nbTasks == 0)
+        return 0;
+
+    const WorldSnapshot* pSnapshot = (nbTasks > 1 ? buildBatchSnapshot() : 0);
+
+    SweepTask tasks[MAX_TASKS_PER_RUN];
+    ITaskScheduler::ITask* taskPtrs[MAX_TASKS_PER_RUN];
+
+    size_t sweepsPerTask = (nbSweeps + nbTasks - 1) / nbTasks;
+    size_t first = 0;
+    unsigned int nbHits = 0;
+
+    while (first < nbSweeps)
+    {
+        unsigned int nbRunTasks = 0;
+
+        while ((nbRunTasks < MAX_TASKS_PER_RUN) && (first < nbSweeps))
+        {
+            SweepTask& task = tasks[nbRunTasks];
+
+            task.pWorld             = m_pWorld;
+            task.pSnapshot          = pSnapshot;
+            task.pCollisionManager  = m_pCollisionManager;
+            task.origin             = m_origin;
+            task.pShape             = pShape;
+            task.pSweeps            = pSweeps + first;
+            task.pHits              = pHits + first;
+            task.nbSweeps           = std::min(sweepsPerTask, nbSweeps - first);
+            task.group              = group;
+
+            taskPtrs[nbRunTasks] = &task;
+            ++nbRunTasks;
+
+            first += task.nbSweeps;
+        }
+
+        runTasks(taskPtrs, nbRunTasks);
+
+        for (unsigned int i = 0; i < nbRunTasks; ++i)
+            nbHits += tasks[i].nbHits;
+    }
+
+    return nbHits;
 }
 
 //-----------------------------------------------------------------------
 
-Math::Vector3 World::getGravity()
+unsigned int World::overlap(CollisionShape* pShape, const tPose& pose, CollisionObject** pResults,
+                            unsigned int maxResults, tCollisionGroup group)
 {
-    if (!m_pWorld)
-        createWorld();
+    assert(pShape);
+    assert(pShape->getCollisionShape());
 
-    return fromBullet(m_pWorld->getGravity());
+    if (!pShape || !pShape->getCollisionShape())
+        return 0;
+
+    unsigned int nbResults = 0;
+    overlapBatch(pShape->getCollisionShape(), &pose, 1, pResults, maxResults, &nbResults, group);
+    return nbResults;
 }
 
 //-----------------------------------------------------------------------
 
-unsigned int World::stepSimulation(Math::Real timeStep, unsigned int nbMaxSubSteps,
-                                   Math::Real fixedTimeStep)
+unsigned int World::overlap(const tPrimitive& primitive, const tPose& pose, CollisionObject** pResults,
+                            unsigned int maxResults, tCollisionGroup group)
 {
-    if (!m_pWorld)
-        createWorld();
+    InlineShape shape(primitive);
 
-    CollisionManager::_CurrentManager = m_pCollisionManager;
+    unsigned int nbResults = 0;
+    overlapBatch(shape.get(), &pose, 1, pResults, maxResults, &nbResults, group);
+    return nbResults;
+}
 
-    bool bResult = m_pWorld->stepSimulation(timeStep, nbMaxSubSteps, fixedTimeStep);
+//-----------------------------------------------------------------------
 
-    CollisionManager::_CurrentManager = 0;
+unsigned int World::overlapBatch(CollisionShape* pShape, const tPose* pPoses, size_t nbPoses,
+                                 CollisionObject** pResults, unsigned int maxResultsPerPose,
+                                 unsigned int* pNbResults, tCollisionGroup group)
+{
+    assert(pShape);
+    assert(pShape->getCollisionShape());
+
+    if (!pShape || !pShape->getCollisionShape())
+    {
+        for (size_t i = 0; i < nbPoses; ++i)
+            pNbResults[i] = 0;
+
+        return 0;
+    }
 
-    return bResult;
+    return overlapBatch(pShape->getCollisionShape(), pPoses, nbPoses, pResults,
+                        maxResultsPerPose, pNbResults, group);
 }
 
 //-----------------------------------------------------------------------
 
-bool World::getContacts(PhysicalComponent* pComponent1, PhysicalComponent* pComponent2,
-                        tContactPointsList &contactPoints)
+unsigned int World::overlapBatch(const tPrimitive& primitive, const tPose* pPoses, size_t nbPoses,
+                                 CollisionObject** pResults, unsigned int maxResultsPerPose,
+                                 unsigned int* pNbResults, tCollisionGroup group)
 {
-    assert(pComponent1);
-    assert(pComponent2);
+    InlineShape shape(primitive);
 
-    contactPoints.clear();
+    return overlapBatch(shape.get(), pPoses, nbPoses, pResults, maxResultsPerPose,
+                        pNbResults, group);
+}
 
-    btCollisionObject* pObject1;
-    btCollisionObject* pObject2;
+//-----------------------------------------------------------------------
 
-    if (Body::cast(pComponent1))
-        pObject1 = Body::cast(pComponent1)->getRigidBody();
-    else if (GhostObject::cast(pComponent1))
-        pObject1 = GhostObject::cast(pComponent1)->getGhostObject();
-    else
-        return false;
+unsigned int World::overlapBatch(btCollisionShape* pShape, const tPose* pPoses, size_t nbPoses,
+                                 CollisionObject** pResults, unsigned int maxResultsPerPose,
+                                 unsigned int* pNbResults, tCollisionGroup group)
+{
+    assert(!m_bStepInProgress);
+    assert(pShape);
+    assert(pPoses || (nbPoses == 0));
+    assert(pResults || (nbPoses == 0) || (maxResultsPerPose == 0));
+    assert(pNbResults || (nbPoses == 0));
 
-    if (Body::cast(pComponent2))
-        pObject2 = Body::cast(pComponent2)->getRigidBody();
-    else if (GhostObject::cast(pComponent2))
-        pObject2 = GhostObject::cast(pComponent2)->getGhostObject();
-    else
-        return false;
+    if (!m_pWorld)
+        createWorld();
 
-    btBroadphasePair* pPairs = m_pWorld->getPairCache()->getOverlappingPairArrayPtr();
-    unsigned int nbPairs = m_pWorld->getPairCache()->getNumOverlappingPairs();
-    btBroadphasePair* pPair = pPairs;
-    unsigned int i;
-    for (i = 0; i < nbPairs; ++i)
+    // Temporary collision object, never added to the world
+    btCollisionObject queryObject;
+    queryObject.setCollisionShape(pShape);
+
+    unsigned int nbOverlapping = 0;
+
+    for (size_t i = 0; i < nbPoses; ++i)
     {
-        if (((pPair->m_pProxy0->m_clientObject == pObject1) && (pPair->m_pProxy1->m_clientObject == pObject2)) ||
-            ((pPair->m_pProxy0->m_clientObject == pObject2) && (pPair->m_pProxy1->m_clientObject == pObject1)))
-            break;
+        queryObject.setWorldTransform(btTransform(toBullet(pPoses[i].orientation),
+                                                  toBulletPosition(pPoses[i].position, m_origin)));
 
-        ++pPair;
+        OverlapCallback callback(&queryObject, pResults + i * maxResultsPerPose,
+                                 maxResultsPerPose, m_pCollisionManager, group);
+
+        if (maxResultsPerPose > 0)
+            m_pWorld->contactTest(&queryObject, callback);
+
+        pNbResults[i] = callback.nbResults;
+
+        if (callback.nbResults > 0)
+            ++nbOverlapping;
     }
 
-    if (i == nbPairs)
-        return false;
+    return nbOverlapping;
+}
 
-    if (!pPair->m_algorithm)
-        return false;
 
-    btManifoldArray manifolds;
-    pPair->m_algorithm->getAllContactManifolds(manifolds);
+/*********************************** CONSTRAINT SOLVER *********************************/
 
-    for (int j = 0; j < manifolds.size(); ++j)
+bool World::setSolverType(tSolverType type)
+{
+    assert(type != SOLVER_CUSTOM);
+
+    if ((type != m_solverType) || !m_pConstraintSolver)
     {
-        btPersistentManifold* pManifold = manifolds[j];
-        for (int p = 0; p < pManifold->getNumContacts(); ++p)
-            contactPoints.push_back(pManifold->getContactPoint(p));
+        if (type == SOLVER_PARALLEL_ISLANDS)
+            setConstraintSolver(new ParallelIslandSolver(this), type);
+        else
+            setConstraintSolver(new IslandSolver(this), type);
     }
 
-    return (pPair->m_pProxy0->m_clientObject == pObject1);
+    // Without parallel solving, the islands are solved one after the other
+    return (type != SOLVER_PARALLEL_ISLANDS) || PARALLEL_SOLVING_SUPPORTED;
 }
 
 //-----------------------------------------------------------------------
 
-void World::createWorld()
+bool World::isParallelSolvingSupported()
 {
-    assert(!m_pWorld);
+    return PARALLEL_SOLVING_SUPPORTED;
+}
 
-    // Collision configuration contains default setup for memory, collision setup
-    m_pCollisionConfiguration = new btDefaultCollisionConfiguration();
+//-----------------------------------------------------------------------
 
-    // Use the default collision dispatcher
-    m_pDispatcher = new btCollisionDispatcher(m_pCollisionConfiguration);
-    dynamic_cast<btCollisionDispatcher*>(m_pDispatcher)->setNearCallback(&CollisionManager::customNearCallback);
+void World::setCustomSolver(btConstraintSolver* pSolver)
+{
+    assert(pSolver);
 
-    m_pBroadphase = new btDbvtBroadphase();
-    m_pBroadphase->getOverlappingPairCache()->setInternalGhostPairCallback(new btGhostPairCallback());
+    setConstraintSolver(pSolver, SOLVER_CUSTOM);
+}
 
-    // The default constraint solver
-    m_pConstraintSolver = new btSequentialImpulseConstraintSolver();
+//-----------------------------------------------------------------------
 
-    switch (m_type)
-    {
-        case WORLD_RIGID_BODY:
-            m_pWorld = new btDiscreteDynamicsWorld(m_pDispatcher, m_pBroadphase, m_pConstraintSolver, m_pCollisionConfiguration);
-            break;
+void World::setConstraintSolver(btConstraintSolver* pSolver, tSolverType type)
+{
+    assert(!m_bStepInProgress);
+    assert(pSolver);
 
-        case WORLD_SOFT_BODY:
-            m_pWorld = new btSoftRigidDynamicsWorld(m_pDispatcher, m_pBroadphase, m_pConstraintSolver, m_pCollisionConfiguration);
-            break;
-    }
+    if (m_pWorld)
+        m_pWorld->setConstraintSolver(pSolver);
 
-    m_pWorld->getPairCache()->setOverlapFilterCallback(m_pCollisionManager);
+    if (m_solverType != SOLVER_CUSTOM)
+        delete m_pConstraintSolver;
+
+    m_pConstraintSolver = pSolver;
+    m_solverType = type;
 }
 
 //-----------------------------------------------------------------------
 
-void World::addRigidBody(Body* pBody)
+void World::setSolverSettings(const tSolverSettings& settings)
 {
-    // Assertions
-    assert(pBody);
+    assert(!m_bStepInProgress);
+    assert(settings.nbIterations > 0);
 
-    if (!m_pWorld)
-        createWorld();
+    m_solverSettings = settings;
 
-    m_pWorld->addRigidBody(pBody->getRigidBody());
+    if (m_pWorld)
+        applySolverSettings();
 }
 
 //-----------------------------------------------------------------------
 
-void World::removeRigidBody(Body* pBody)
+World::tSolverSettings World::getSolverPreset(tSolverPreset preset)
 {
-    // Assertions
-    assert(pBody);
-    assert(m_pWorld);
+    // The default settings of Bullet
+    tSolverSettings settings;
+    settings.nbIterations           = 10;
+    settings.sor                    = 1.0f;
+    settings.erp                    = 0.2f;
+    settings.erp2                   = 0.1f;
+    settings.bSplitImpulse          = false;
+    settings.splitImpulseThreshold  = -0.02f;
+    settings.bWarmStarting          = true;
+    settings.warmStartingFactor     = 0.85f;
+    settings.bSimd                  = true;
+    settings.bRandomizeOrder        = false;
+    settings.frictionMode           = FRICTION_ONE_DIRECTION;
+    settings.bSeparateFriction      = false;
+
+    switch (preset)
+    {
+        case SOLVER_FAST:
+            settings.nbIterations = 4;
+            break;
 
-    m_pWorld->removeRigidBody(pBody->getRigidBody());
+        case SOLVER_BALANCED:
+            break;
+
+        case SOLVER_ACCURATE:
+            settings.nbIterations   = 20;
+            settings.bSplitImpulse  = true;
+            settings.frictionMode   = FRICTION_TWO_DIRECTIONS_CACHED;
+            break;
+    }
+
+    return settings;
 }
 
 //-----------------------------------------------------------------------
 
-void World::addGhostObject(GhostObject* pGhostObject)
+void World::setIslandSolverSettings(const tIslandSolverSettings& settings)
 {
-    // Assertions
-    assert(pGhostObject);
-
-    if (!m_pWorld)
-        createWorld();
+    assert(!m_bStepInProgress);
 
-    m_pWorld->addCollisionObject(pGhostObject->getGhostObject());
+    m_islandSolverSettings = settings;
 }
 
 //-----------------------------------------------------------------------
 
-void World::removeGhostObject(GhostObject* pGhostObject)
+unsigned int World::getIslandIterations(btCollisionObject** pObjects, unsigned int nbObjects) const
 {
-    // Assertions
-    assert(pGhostObject);
-    assert(m_pWorld);
+    unsigned int nbIterations = m_solverSettings.nbIterations;
+
+    if ((m_islandSolverSettings.smallIslandSize > 0) &&
+        (nbObjects <= m_islandSolverSettings.smallIslandSize))
+    {
+        nbIterations = std::min(nbIterations, m_islandSolverSettings.smallIslandIterations);
+    }
 
-    m_pWorld->removeCollisionObject(pGhostObject->getGhostObject());
+    // The islands without body simulated at full rate are in the background
+    if ((m_islandSolverSettings.backgroundIterations > 0) &&
+        (m_islandSolverSettings.backgroundIterations < nbIterations))
+    {
+        bool bBackground = true;
+
+        for (unsigned int i = 0; bBackground && (i < nbObjects); ++i)
+        {
+            btRigidBody* pRigidBody = btRigidBody::upcast(pObjects[i]);
+            if (!pRigidBody || !pRigidBody->getUserPointer())
+                continue;
+
+            Body* pBody = static_cast<Body*>(static_cast<CollisionObject*>(pRigidBody->getUserPointer()));
+            bBackground = (m_pSimulationLod->getBand(pBody) > 0);
+        }
+
+        if (bBackground)
+            nbIterations = m_islandSolverSettings.backgroundIterations;
+    }
+
+    return std::max(nbIterations, 1u);
 }
 
 
@@ -282,6 +2779,93 @@ Utils::PropertiesList* World::getProperties() const
     if (m_pWorld)
         pProperties->set("gravity", new Variant(fromBullet(m_pWorld->getGravity())));
 
+    // Constraint solver (a custom one can't be saved)
+    switch (m_solverType)
+    {
+        case SOLVER_SEQUENTIAL_IMPULSE:
+        case SOLVER_CUSTOM:
+            pProperties->set("solver-type", new Variant("SEQUENTIAL_IMPULSE"));
+            break;
+
+        case SOLVER_PARALLEL_ISLANDS:
+            pProperties->set("solver-type", new Variant("PARALLEL_ISLANDS"));
+            break;
+    }
+
+    Variant* pStruct = new Variant(Variant::STRUCT);
+
+    pStruct->setField("iterations", new Variant(m_solverSettings.nbIterations));
+    pStruct->setField("sor", new Variant(m_solverSettings.sor));
+    pStruct->setField("erp", new Variant(m_solverSettings.erp));
+    pStruct->setField("erp2", new Variant(m_solverSettings.erp2));
+    pStruct->setField("split-impulse", new Variant(m_solverSettings.bSplitImpulse));
+    pStruct->setField("split-impulse-threshold", new Variant(m_solverSettings.splitImpulseThreshold));
+    pStruct->setField("warm-starting", new Variant(m_solverSettings.bWarmStarting));
+    pStruct->setField("warm-starting-factor", new Variant(m_solverSettings.warmStartingFactor));
+    pStruct->setField("simd", new Variant(m_solverSettings.bSimd));
+    pStruct->setField("randomize-order", new Variant(m_solverSettings.bRandomizeOrder));
+    pStruct->setField("separate-friction", new Variant(m_solverSettings.bSeparateFriction));
+
+    switch (m_solverSettings.frictionMode)
+    {
+        case FRICTION_ONE_DIRECTION:
+            pStruct->setField("friction", new Variant("ONE_DIRECTION"));
+            break;
+
+        case FRICTION_TWO_DIRECTIONS:
+            pStruct->setField("friction", new Variant("TWO_DIRECTIONS"));
+            break;
+
+        case FRICTION_TWO_DIRECTIONS_CACHED:
+            pStruct->setField("friction", new Variant("TWO_DIRECTIONS_CACHED"));
+            break;
+    }
+
+    pProperties->set("solver", pStruct);
+
+    // Iterations of the solver for some kinds of islands
+    pStruct = new Variant(Variant::STRUCT);
+
+    pStruct->setField("small-island-size", new Variant(m_islandSolverSettings.smallIslandSize));
+    pStruct->setField("small-island-iterations", new Variant(m_islandSolverSettings.smallIslandIterations));
+    pStruct->setField("background-iterations", new Variant(m_islandSolverSettings.backgroundIterations));
+
+    pProperties->set("island-solver", pStruct);
+
+    // Materials
+    for (unsigned int i = 0; i < m_pMaterialTable->getNbMaterials(); ++i)
+    {
+        const MaterialTable::tMaterial& material = m_pMaterialTable->getMaterial((tMaterialID) i);
+
+        pStruct = new Variant(Variant::STRUCT);
+
+        pStruct->setField("friction", new Variant(material.friction));
+        pStruct->setField("restitution", new Variant(material.restitution));
+        pStruct->setField("friction-combine", new Variant(COMBINE_MODE_NAMES[material.frictionCombine]));
+        pStruct->setField("restitution-combine", new Variant(COMBINE_MODE_NAMES[material.restitutionCombine]));
+
+        std::ostringstream name;
+        name << "material-" << i;
+
+        pProperties->set(name.str(), pStruct);
+    }
+
+    for (unsigned int i = 0; i < m_pMaterialTable->getNbOverriddenCombinations(); ++i)
+    {
+        tMaterialID id1, id2;
+        const MaterialTable::tCombination& combination = m_pMaterialTable->getOverriddenCombination(i, id1, id2);
+
+        pStruct = new Variant(Variant::STRUCT);
+
+        pStruct->setField("friction", new Variant(Math::Real(combination.friction)));
+        pStruct->setField("restitution", new Variant(Math::Real(combination.restitution)));
+
+        std::ostringstream name;
+        name << "material-combination-" << (unsigned int) id1 << "-" << (unsigned int) id2;
+
+        pProperties->set(name.str(), pStruct);
+    }
+
     // Returns the list
     return pProperties;
 }
@@ -323,6 +2907,164 @@ bool World::setProperty(const std::string& strName, Utils::Variant* pValue)
         setGravity(pValue->toVector3());
     }
 
+    // Constraint solver (the missing fields keep their current value)
+    else if (strName == "solver-type")
+    {
+        if (pValue->toString() == "SEQUENTIAL_IMPULSE")
+            setSolverType(SOLVER_SEQUENTIAL_IMPULSE);
+        else if (pValue->toString() == "PARALLEL_ISLANDS")
+            setSolverType(SOLVER_PARALLEL_ISLANDS);
+    }
+
+    else if (strName == "solver-preset")
+    {
+        if (pValue->toString() == "FAST")
+            setSolverPreset(SOLVER_FAST);
+        else if (pValue->toString() == "BALANCED")
+            setSolverPreset(SOLVER_BALANCED);
+        else if (pValue->toString() == "ACCURATE")
+            setSolverPreset(SOLVER_ACCURATE);
+    }
+
+    else if (strName == "solver")
+    {
+        tSolverSettings settings = m_solverSettings;
+
+        Variant* pField = pValue->getField("iterations");
+        if (pField)
+            settings.nbIterations = pField->toUInt();
+
+        pField = pValue->getField("sor");
+        if (pField)
+            settings.sor = pField->toFloat();
+
+        pField = pValue->getField("erp");
+        if (pField)
+            settings.erp = pField->toFloat();
+
+        pField = pValue->getField("erp2");
+        if (pField)
+            settings.erp2 = pField->toFloat();
+
+        pField = pValue->getField("split-impulse");
+        if (pField)
+            settings.bSplitImpulse = pField->toBool();
+
+        pField = pValue->getField("split-impulse-threshold");
+        if (pField)
+            settings.splitImpulseThreshold = pField->toFloat();
+
+        pField = pValue->getField("warm-starting");
+        if (pField)
+            settings.bWarmStarting = pField->toBool();
+
+        pField = pValue->getField("warm-starting-factor");
+        if (pField)
+            settings.warmStartingFactor = pField->toFloat();
+
+        pField = pValue->getField("simd");
+        if (pField)
+            settings.bSimd = pField->toBool();
+
+        pField = pValue->getField("randomize-order");
+        if (pField)
+            settings.bRandomizeOrder = pField->toBool();
+
+        pField = pValue->getField("separate-friction");
+        if (pField)
+            settings.bSeparateFriction = pField->toBool();
+
+        pField = pValue->getField("friction");
+        if (pField)
+        {
+            if (pField->toString() == "ONE_DIRECTION")
+                settings.frictionMode = FRICTION_ONE_DIRECTION;
+            else if (pField->toString() == "TWO_DIRECTIONS")
+                settings.frictionMode = FRICTION_TWO_DIRECTIONS;
+            else if (pField->toString() == "TWO_DIRECTIONS_CACHED")
+                settings.frictionMode = FRICTION_TWO_DIRECTIONS_CACHED;
+        }
+
+        setSolverSettings(settings);
+    }
+
+    else if (strName == "island-solver")
+    {
+        tIslandSolverSettings settings = m_islandSolverSettings;
+
+        Variant* pField = pValue->getField("small-island-size");
+        if (pField)
+            settings.smallIslandSize = pField->toUInt();
+
+        pField = pValue->getField("small-island-iterations");
+        if (pField)
+            settings.smallIslandIterations = pField->toUInt();
+
+        pField = pValue->getField("background-iterations");
+        if (pField)
+            settings.backgroundIterations = pField->toUInt();
+
+        setIslandSolverSettings(settings);
+    }
+
+    // Materials (the missing fields keep their current value)
+    else if (strName.compare(0, 21, "material-combination-") == 0)
+    {
+        unsigned int id1 = 0, id2 = 0;
+        char separator = 0;
+
+        std::istringstream name(strName.substr(21));
+        name >> id1 >> separator >> id2;
+
+        if (!name.fail() && (separator == '-') && (id1 <= 255) && (id2 <= 255))
+        {
+            MaterialTable::tCombination combination = m_pMaterialTable->getCombination(
+                    (tMaterialID) id1, (tMaterialID) id2);
+
+            Variant* pField = pValue->getField("friction");
+            if (pField)
+                combination.friction = pField->toFloat();
+
+            pField = pValue->getField("restitution");
+            if (pField)
+                combination.restitution = pField->toFloat();
+
+            m_pMaterialTable->setCombination((tMaterialID) id1, (tMaterialID) id2,
+                                             combination.friction, combination.restitution);
+        }
+    }
+
+    else if (strName.compare(0, 9, "material-") == 0)
+    {
+        unsigned int id = 0;
+
+        std::istringstream name(strName.substr(9));
+        name >> id;
+
+        if (!name.fail() && (id <= 255))
+        {
+            MaterialTable::tMaterial material = m_pMaterialTable->getMaterial((tMaterialID) id);
+
+            Variant* pField = pValue->getField("friction");
+            if (pField)
+                material.friction = pField->toFloat();
+
+            pField = pValue->getField("restitution");
+            if (pField)
+                material.restitution = pField->toFloat();
+
+            pField = pValue->getField("friction-combine");
+            if (pField)
+                material.frictionCombine = combineModeFromName(pField->toString());
+
+            pField = pValue->getField("restitution-combine");
+            if (pField)
+                material.restitutionCombine = combineModeFromName(pField->toString());
+
+            m_pMaterialTable->setMaterial((tMaterialID) id, material);
+        }
+    }
+
     // Destroy the value
     delete pValue;
 
@@ -0,0 +1,583 @@
+/** @file   WorldSnapshot.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::WorldSnapshot'
+*/
+
+#include <Athena-Physics/WorldSnapshot.h>
+#include <Athena-Physics/CollisionManager.h>
+#include <Athena-Physics/CollisionObject.h>
+#include <Athena-Physics/CollisionShape.h>
+#include <Athena-Physics/InlineShape.h>
+#include <Athena-Physics/Conversions.h>
+#include <BulletCollision/CollisionShapes/btTriangleShape.h>
+#include <BulletCollision/NarrowPhaseCollision/btGjkPairDetector.h>
+#include <BulletCollision/NarrowPhaseCollision/btGjkEpaPenetrationDepthSolver.h>
+#include <BulletCollision/NarrowPhaseCollision/btPointCollector.h>
+#include <BulletCollision/NarrowPhaseCollision/btVoronoiSimplexSolver.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace std;
+
+
+/*************************************** HELPERS ***************************************/
+
+namespace {
+
+    // Orders the entries by address of their Bullet's object
+    struct EntryComparator
+    {
+        template <typename T>
+        bool operator()(const T& a, const T& b) const
+        {
+            return a.pObject < b.pObject;
+        }
+    };
+
+
+    // Cast a ray against a shape. The compound shapes are handled here because Bullet
+    // temporarily modifies the collision object when it does it itself, which isn't
+    // acceptable when several threads share the object.
+    void rayTestShape(const btTransform& from, const btTransform& to, btCollisionObject* pObject,
+                      const btCollisionShape* pShape, const btTransform& transform,
+                      btCollisionWorld::RayResultCallback& callback)
+    {
+        if (pShape->isCompound())
+        {
+            const btCompoundShape* pCompound = static_cast<const btCompoundShape*>(pShape);
+            for (int i = 0; i < pCompound->getNumChildShapes(); ++i)
+            {
+                rayTestShape(from, to, pObject, pCompound->getChildShape(i),
+                             transform * pCompound->getChildTransform(i), callback);
+            }
+        }
+        else
+        {
+            btCollisionWorld::rayTestSingle(from, to, pObject, pShape, transform, callback);
+        }
+    }
+
+
+    // Move a convex shape against a shape (see rayTestShape() for the compound shapes)
+    void sweepTestShape(const btConvexShape* pCastShape, const btTransform& from,
+                        const btTransform& to, btCollisionObject* pObject,
+                        const btCollisionShape* pShape, const btTransform& transform,
+                        btCollisionWorld::ConvexResultCallback& callback)
+    {
+        if (pShape->isCompound())
+        {
+            const btCompoundShape* pCompound = static_cast<const btCompoundShape*>(pShape);
+            for (int i = 0; i < pCompound->getNumChildShapes(); ++i)
+            {
+                sweepTestShape(pCastShape, from, to, pObject, pCompound->getChildShape(i),
+                               transform * pCompound->getChildTransform(i), callback);
+            }
+        }
+        else
+        {
+            btCollisionWorld::objectQuerySingle(pCastShape, from, to, pObject, pShape,
+                                                transform, callback, btScalar(0.0));
+        }
+    }
+
+
+    // Indicates if two convex shapes overlap
+    bool convexOverlap(const btConvexShape* pShapeA, const btTransform& transformA,
+                       const btConvexShape* pShapeB, const btTransform& transformB)
+    {
+        btVoronoiSimplexSolver simplexSolver;
+        btGjkEpaPenetrationDepthSolver penetrationSolver;
+        btGjkPairDetector detector(pShapeA, pShapeB, &simplexSolver, &penetrationSolver);
+
+        btGjkPairDetector::ClosestPointInput input;
+        input.m_transformA = transformA;
+        input.m_transformB = transformB;
+
+        btPointCollector output;
+        detector.getClosestPoints(input, output, 0);
+
+        return output.m_hasResult && (output.m_distance <= btScalar(0.0));
+    }
+
+
+    // Tests the triangles of a concave shape against a convex one, until one overlaps
+    class TriangleOverlapCallback: public btTriangleCallback
+    {
+    public:
+        TriangleOverlapCallback(const btConvexShape* pShape, const btTransform& transform)
+        : bOverlap(false), m_pShape(pShape), m_transform(transform)
+        {
+        }
+
+        virtual void processTriangle(btVector3* triangle, int partId, int triangleIndex)
+        {
+            if (bOverlap)
+                return;
+
+            btTriangleShape triangleShape(triangle[0], triangle[1], triangle[2]);
+            bOverlap = convexOverlap(m_pShape, m_transform, &triangleShape, btTransform::getIdentity());
+        }
+
+        bool bOverlap;
+
+    private:
+        const btConvexShape*    m_pShape;
+        btTransform             m_transform;    ///< Transform of the shape, in the space of the triangles
+    };
+
+
+    // Indicates if a convex shape overlaps with any other shape
+    bool shapeOverlap(const btConvexShape* pShapeA, const btTransform& transformA,
+                      const btCollisionShape* pShapeB, const btTransform& transformB)
+    {
+        if (pShapeB->isCompound())
+        {
+            const btCompoundShape* pCompound = static_cast<const btCompoundShape*>(pShapeB);
+            for (int i = 0; i < pCompound->getNumChildShapes(); ++i)
+            {
+                if (shapeOverlap(pShapeA, transformA, pCompound->getChildShape(i),
+                                 transformB * pCompound->getChildTransform(i)))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+        else if (pShapeB->isConvex())
+        {
+            return convexOverlap(pShapeA, transformA, static_cast<const btConvexShape*>(pShapeB),
+                                 transformB);
+        }
+        else if (pShapeB->isConcave())
+        {
+            btTransform localTransform = transformB.inverse() * transformA;
+
+            btVector3 aabbMin, aabbMax;
+            pShapeA->getAabb(localTransform, aabbMin, aabbMax);
+
+            TriangleOverlapCallback callback(pShapeA, localTransform);
+            static_cast<const btConcaveShape*>(pShapeB)->processAllTriangles(&callback, aabbMin, aabbMax);
+
+            return callback.bOverlap;
+        }
+
+        return false;
+    }
+
+
+    // Indicates if a shape (convex or compound) overlaps with any other shape
+    bool overlapTest(const btCollisionShape* pShapeA, const btTransform& transformA,
+                     const btCollisionShape* pShapeB, const btTransform& transformB)
+    {
+        if (pShapeA->isCompound())
+        {
+            const btCompoundShape* pCompound = static_cast<const btCompoundShape*>(pShapeA);
+            for (int i = 0; i < pCompound->getNumChildShapes(); ++i)
+            {
+                if (overlapTest(pCompound->getChildShape(i), transformA * pCompound->getChildTransform(i),
+                                pShapeB, transformB))
+                {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+        else if (pShapeA->isConvex())
+        {
+            return shapeOverlap(static_cast<const btConvexShape*>(pShapeA), transformA,
+                                pShapeB, transformB);
+        }
+
+        return false;
+    }
+
+
+    // Indicates if an entry of a snapshot must be considered by a spatial query
+    template <typename T>
+    bool acceptEntry(const T& entry, CollisionManager* pCollisionManager, tCollisionGroup group)
+    {
+        if (!entry.pShape)
+            return false;
+
+        return pCollisionManager->isCollisionEnabled(group, entry.group);
+    }
+
+
+    // Cast a ray against the entries found in the tree, remembering the component of
+    // the closest one hit (it isn't retrieved from the Bullet's object, which could have
+    // been modified since the snapshot was built)
+    template <typename T>
+    struct RayCastVisitor
+    {
+        RayCastVisitor(const btAlignedObjectArray<T>& entries, CollisionManager* pCollisionManager,
+                       tCollisionGroup group, const btTransform& from, const btTransform& to,
+                       btCollisionWorld::RayResultCallback& callback)
+        : entries(entries), pCollisionManager(pCollisionManager), group(group), from(from),
+          to(to), callback(callback), pComponent(0)
+        {
+        }
+
+        bool operator()(unsigned int index)
+        {
+            const T& entry = entries[index];
+            if (!acceptEntry(entry, pCollisionManager, group))
+                return true;
+
+            btScalar fraction = callback.m_closestHitFraction;
+            rayTestShape(from, to, entry.pObject, entry.pShape, entry.transform, callback);
+
+            if (callback.m_closestHitFraction < fraction)
+                pComponent = entry.pComponent;
+
+            return true;
+        }
+
+        const btAlignedObjectArray<T>&          entries;
+        CollisionManager*                       pCollisionManager;
+        tCollisionGroup                         group;
+        const btTransform&                      from;
+        const btTransform&                      to;
+        btCollisionWorld::RayResultCallback&    callback;
+        CollisionObject*                        pComponent;
+    };
+
+
+    // Move a convex shape against the entries found in the tree (see RayCastVisitor)
+    template <typename T>
+    struct SweepVisitor
+    {
+        SweepVisitor(const btAlignedObjectArray<T>& entries, CollisionManager* pCollisionManager,
+                     tCollisionGroup group, const btConvexShape* pShape, const btTransform& from,
+                     const btTransform& to, btCollisionWorld::ConvexResultCallback& callback)
+        : entries(entries), pCollisionManager(pCollisionManager), group(group), pShape(pShape),
+          from(from), to(to), callback(callback), pComponent(0)
+        {
+        }
+
+        bool operator()(unsigned int index)
+        {
+            const T& entry = entries[index];
+            if (!acceptEntry(entry, pCollisionManager, group))
+                return true;
+
+            btScalar fraction = callback.m_closestHitFraction;
+            sweepTestShape(pShape, from, to, entry.pObject, entry.pShape, entry.transform, callback);
+
+            if (callback.m_closestHitFraction < fraction)
+                pComponent = entry.pComponent;
+
+            return true;
+        }
+
+        const btAlignedObjectArray<T>&          entries;
+        CollisionManager*                       pCollisionManager;
+        tCollisionGroup                         group;
+        const btConvexShape*                    pShape;
+        const btTransform&                      from;
+        const btTransform&                      to;
+        btCollisionWorld::ConvexResultCallback& callback;
+        CollisionObject*                        pComponent;
+    };
+
+
+    // Collect the entries found in the tree overlapping with a shape, until the array of
+    // results is full
+    template <typename T>
+    struct OverlapVisitor
+    {
+        OverlapVisitor(const btAlignedObjectArray<T>& entries, CollisionManager* pCollisionManager,
+                       tCollisionGroup group, const btCollisionShape* pShape,
+                       const btTransform& transform, CollisionObject** pResults,
+                       unsigned int maxResults)
+        : entries(entries), pCollisionManager(pCollisionManager), group(group), pShape(pShape),
+          transform(transform), pResults(pResults), maxResults(maxResults), nbResults(0)
+        {
+        }
+
+        bool operator()(unsigned int index)
+        {
+            const T& entry = entries[index];
+            if (acceptEntry(entry, pCollisionManager, group) &&
+                overlapTest(pShape, transform, entry.pShape, entry.transform))
+            {
+                pResults[nbResults] = entry.pComponent;
+                ++nbResults;
+            }
+
+            return (nbResults < maxResults);
+        }
+
+        const btAlignedObjectArray<T>&  entries;
+        CollisionManager*               pCollisionManager;
+        tCollisionGroup                 group;
+        const btCollisionShape*         pShape;
+        const btTransform&              transform;
+        CollisionObject**               pResults;
+        unsigned int                    maxResults;
+        unsigned int                    nbResults;
+    };
+}
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+WorldSnapshot::WorldSnapshot()
+: m_pCollisionManager(0), m_origin(Math::Vector3::ZERO)
+{
+}
+
+//-----------------------------------------------------------------------
+
+WorldSnapshot::~WorldSnapshot()
+{
+}
+
+
+/**************************************** METHODS **************************************/
+
+void WorldSnapshot::build(btCollisionWorld* pWorld, CollisionManager* pCollisionManager,
+                          const Math::Vector3& origin, bool bStaticOnly)
+{
+    assert(pWorld);
+    assert(pCollisionManager);
+
+    clear();
+
+    m_pCollisionManager = pCollisionManager;
+    m_origin = origin;
+
+    btCollisionObjectArray& objects = pWorld->getCollisionObjectArray();
+    m_entries.reserve(objects.size());
+
+    for (int i = 0; i < objects.size(); ++i)
+    {
+        btCollisionObject* pObject = objects[i];
+
+        if (!pObject->getBroadphaseHandle() || !pObject->getCollisionShape() ||
+            (pObject->getCollisionFlags() & btCollisionObject::CF_NO_CONTACT_RESPONSE) ||
+            (bStaticOnly && !pObject->isStaticObject()))
+        {
+            continue;
+        }
+
+        CollisionObject* pComponent = static_cast<CollisionObject*>(pObject->getUserPointer());
+        if (!pComponent)
+            continue;
+
+        tEntry& entry = m_entries.expand();
+        entry.transform     = pObject->getWorldTransform();
+        entry.pObject       = pObject;
+        entry.pShape        = pObject->getCollisionShape();
+        entry.pComponent    = pComponent;
+        entry.group         = pComponent->getCollisionGroup();
+    }
+
+    if (m_entries.size() == 0)
+        return;
+
+    m_entries.quickSort(EntryComparator());
+
+    // The bounding boxes were already computed by the broadphase
+    btAlignedObjectArray<btVector3> mins;
+    btAlignedObjectArray<btVector3> maxs;
+    mins.resize(m_entries.size());
+    maxs.resize(m_entries.size());
+
+    for (int i = 0; i < m_entries.size(); ++i)
+    {
+        btBroadphaseProxy* pProxy = m_entries[i].pObject->getBroadphaseHandle();
+        mins[i] = pProxy->m_aabbMin;
+        maxs[i] = pProxy->m_aabbMax;
+    }
+
+    m_tree.build(&mins[0], &maxs[0], (unsigned int) m_entries.size());
+}
+
+//-----------------------------------------------------------------------
+
+void WorldSnapshot::clear()
+{
+    m_entries.clear();
+    m_tree.clear();
+}
+
+//-----------------------------------------------------------------------
+
+void WorldSnapshot::onObjectRemoved(btCollisionObject* pObject)
+{
+    assert(pObject);
+
+    // Binary search of the object
+    int first = 0;
+    int last = m_entries.size();
+
+    while (first < last)
+    {
+        int middle = (first + last) / 2;
+        if (m_entries[middle].pObject < pObject)
+            first = middle + 1;
+        else
+            last = middle;
+    }
+
+    if ((first < m_entries.size()) && (m_entries[first].pObject == pObject))
+    {
+        // The entry stays in the tree (and sorted), but will be ignored by the queries
+        m_entries[first].pShape     = 0;
+        m_entries[first].pComponent = 0;
+    }
+}
+
+
+/*********************************** SPATIAL QUERIES ***********************************/
+
+bool WorldSnapshot::rayCast(const World::tRay& ray, World::tRayHit &hit, tCollisionGroup group) const
+{
+    btVector3 from = toBulletPosition(ray.from, m_origin);
+    btVector3 to = toBulletPosition(ray.to, m_origin);
+
+    btTransform fromTransform(btQuaternion::getIdentity(), from);
+    btTransform toTransform(btQuaternion::getIdentity(), to);
+
+    btCollisionWorld::ClosestRayResultCallback callback(from, to);
+
+    RayCastVisitor<tEntry> visitor(m_entries, m_pCollisionManager, group, fromTransform,
+                                   toTransform, callback);
+    m_tree.visitRay(from, to, visitor);
+
+    if (!callback.hasHit())
+    {
+        hit.pObject     = 0;
+        hit.position    = ray.to;
+        hit.normal      = Math::Vector3::ZERO;
+        hit.fraction    = 1.0f;
+        return false;
+    }
+
+    hit.pObject     = visitor.pComponent;
+    hit.position    = fromBulletPosition(callback.m_hitPointWorld, m_origin);
+    hit.normal      = fromBullet(callback.m_hitNormalWorld);
+    hit.fraction    = callback.m_closestHitFraction;
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+bool WorldSnapshot::sweep(CollisionShape* pShape, const World::tSweep& sweep,
+                          World::tSweepHit &hit, tCollisionGroup group) const
+{
+    assert(pShape);
+    assert(pShape->getCollisionShape());
+
+    // Only the convex shapes can be moved, the other ones never hit anything
+    if (!pShape->getCollisionShape() || !pShape->getCollisionShape()->isConvex())
+    {
+        hit.pObject     = 0;
+        hit.position    = sweep.to;
+        hit.normal      = Math::Vector3::ZERO;
+        hit.fraction    = 1.0f;
+        return false;
+    }
+
+    return WorldSnapshot::sweep(static_cast<const btConvexShape*>(pShape->getCollisionShape()),
+                                sweep, hit, group);
+}
+
+//-----------------------------------------------------------------------
+
+bool WorldSnapshot::sweep(const World::tPrimitive& primitive, const World::tSweep& sweep,
+                          World::tSweepHit &hit, tCollisionGroup group) const
+{
+    InlineShape shape(primitive);
+    return WorldSnapshot::sweep(shape.get(), sweep, hit, group);
+}
+
+//-----------------------------------------------------------------------
+
+bool WorldSnapshot::sweep(const btConvexShape* pShape, const World::tSweep& sweep,
+                          World::tSweepHit &hit, tCollisionGroup group) const
+{
+    assert(pShape);
+
+    btQuaternion orientation = toBullet(sweep.orientation);
+    btTransform from(orientation, toBulletPosition(sweep.from, m_origin));
+    btTransform to(orientation, toBulletPosition(sweep.to, m_origin));
+
+    // Bounding box of the whole movement
+    btVector3 aabbMin, aabbMax, endMin, endMax;
+    pShape->getAabb(from, aabbMin, aabbMax);
+    pShape->getAabb(to, endMin, endMax);
+    aabbMin.setMin(endMin);
+    aabbMax.setMax(endMax);
+
+    btCollisionWorld::ClosestConvexResultCallback callback(from.getOrigin(), to.getOrigin());
+
+    SweepVisitor<tEntry> visitor(m_entries, m_pCollisionManager, group, pShape, from, to, callback);
+    m_tree.visit(aabbMin, aabbMax, visitor);
+
+    if (!callback.hasHit())
+    {
+        hit.pObject     = 0;
+        hit.position    = sweep.to;
+        hit.normal      = Math::Vector3::ZERO;
+        hit.fraction    = 1.0f;
+        return false;
+    }
+
+    hit.pObject     = visitor.pComponent;
+    hit.position    = fromBulletPosition(callback.m_hitPointWorld, m_origin);
+    hit.normal      = fromBullet(callback.m_hitNormalWorld);
+    hit.fraction    = callback.m_closestHitFraction;
+    return true;
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int WorldSnapshot::overlap(CollisionShape* pShape, const World::tPose& pose,
+                                    CollisionObject** pResults, unsigned int maxResults,
+                                    tCollisionGroup group) const
+{
+    assert(pShape);
+    assert(pShape->getCollisionShape());
+
+    return overlap(static_cast<const btCollisionShape*>(pShape->getCollisionShape()), pose,
+                   pResults, maxResults, group);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int WorldSnapshot::overlap(const World::tPrimitive& primitive, const World::tPose& pose,
+                                    CollisionObject** pResults, unsigned int maxResults,
+                                    tCollisionGroup group) const
+{
+    InlineShape shape(primitive);
+    return overlap(static_cast<const btCollisionShape*>(shape.get()), pose, pResults,
+                   maxResults, group);
+}
+
+//-----------------------------------------------------------------------
+
+unsigned int WorldSnapshot::overlap(const btCollisionShape* pShape, const World::tPose& pose,
+                                    CollisionObject** pResults, unsigned int maxResults,
+                                    tCollisionGroup group) const
+{
+    assert(pShape);
+    assert(pResults || (maxResults == 0));
+
+    if (maxResults == 0)
+        return 0;
+
+    btTransform transform(toBullet(pose.orientation), toBulletPosition(pose.position, m_origin));
+
+    btVector3 aabbMin, aabbMax;
+    pShape->getAabb(transform, aabbMin, aabbMax);
+
+    OverlapVisitor<tEntry> visitor(m_entries, m_pCollisionManager, group, pShape, transform,
+                                   pResults, maxResults);
+    m_tree.visit(aabbMin, aabbMax, visitor);
+
+    return visitor.nbResults;
+}
@@ -0,0 +1,257 @@
+/** @file   WorldStreamer.cpp
+    @author Philip Abbet
+
+    Implementation of the class 'Athena::Physics::WorldStreamer'
+*/
+
+#include <Athena-Physics/WorldStreamer.h>
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/Conversions.h>
+#include <algorithm>
+#include <math.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+using namespace std;
+
+
+/***************************** CONSTRUCTION / DESTRUCTION ******************************/
+
+WorldStreamer::WorldStreamer(World* pWorld, Real cellSize)
+: m_pWorld(pWorld), m_cellSize(cellSize), m_loadRadius(cellSize * 2),
+  m_unloadMargin(cellSize * Real(0.5)), m_nbLoadedCells(0)
+{
+    assert(pWorld);
+    assert(cellSize > Real(0.0));
+}
+
+//-----------------------------------------------------------------------
+
+WorldStreamer::~WorldStreamer()
+{
+    std::vector<Body*> bodies;
+
+    for (tBodiesList::iterator iter = m_bodies.begin(); iter != m_bodies.end(); ++iter)
+        iter->first->m_pStreamer = 0;
+
+    for (tCellsList::iterator iter = m_cells.begin(); iter != m_cells.end(); ++iter)
+    {
+        if (!iter->second.bLoaded)
+            bodies.insert(bodies.end(), iter->second.bodies.begin(), iter->second.bodies.end());
+    }
+
+    if (!bodies.empty())
+        m_pWorld->resumeBodies(&bodies[0], (unsigned int) bodies.size());
+}
+
+
+/**************************************** METHODS **************************************/
+
+void WorldStreamer::addBody(Body* pBody)
+{
+    assert(pBody);
+    assert(m_bodies.find(pBody) == m_bodies.end());
+    assert(!pBody->m_pStreamer);
+
+    tCellKey key = getCellKey(pBody);
+    tCell& cell = getCell(key);
+
+    cell.bodies.push_back(pBody);
+    m_bodies[pBody] = key;
+    pBody->m_pStreamer = this;
+
+    if (!cell.bLoaded)
+        m_pWorld->suspendBodies(&pBody, 1);
+}
+
+//-----------------------------------------------------------------------
+
+void WorldStreamer::removeBody(Body* pBody)
+{
+    assert(pBody);
+
+    tBodiesList::iterator iter = m_bodies.find(pBody);
+    if (iter == m_bodies.end())
+        return;
+
+    tCell& cell = m_cells[iter->second];
+    cell.bodies.erase(std::find(cell.bodies.begin(), cell.bodies.end(), pBody));
+
+    m_bodies.erase(iter);
+    pBody->m_pStreamer = 0;
+
+    if (pBody->isSuspended())
+        m_pWorld->resumeBodies(&pBody, 1);
+}
+
+//-----------------------------------------------------------------------
+
+void WorldStreamer::setObservers(const Vector3* pPositions, unsigned int nbObservers)
+{
+    assert(pPositions || (nbObservers == 0));
+
+    m_observers.assign(pPositions, pPositions + nbObservers);
+}
+
+//-----------------------------------------------------------------------
+
+void WorldStreamer::setRadius(Real loadRadius, Real unloadMargin)
+{
+    assert(loadRadius > Real(0.0));
+    assert(unloadMargin >= Real(0.0));
+
+    m_loadRadius = loadRadius;
+    m_unloadMargin = unloadMargin;
+}
+
+//-----------------------------------------------------------------------
+
+void WorldStreamer::update()
+{
+    assert(!m_pWorld->isStepInProgress());
+
+    // Without observer, everything stays as it is
+    if (m_observers.empty())
+        return;
+
+    std::vector<Body*> toSuspend;
+    std::vector<Body*> toResume;
+
+    // Track the bodies changing of cell
+    Body* const* pMovedBodies = m_pWorld->getMovedBodies();
+    unsigned int nbMovedBodies = m_pWorld->getNbMovedBodies();
+
+    for (unsigned int i = 0; i < nbMovedBodies; ++i)
+    {
+        Body* pBody = pMovedBodies[i];
+
+        tBodiesList::iterator iter = m_bodies.find(pBody);
+        if (iter == m_bodies.end())
+            continue;
+
+        tCellKey key = getCellKey(pBody);
+        if (key == iter->second)
+            continue;
+
+        tCellKey previous = iter->second;
+        iter->second = key;
+        moveBody(pBody, previous, key);
+
+        if (!m_cells[key].bLoaded)
+            toSuspend.push_back(pBody);
+    }
+
+    Real unloadRadius = m_loadRadius + m_unloadMargin;
+    Real loadRadius2 = m_loadRadius * m_loadRadius;
+    Real unloadRadius2 = unloadRadius * unloadRadius;
+
+    m_nbLoadedCells = 0;
+
+    for (tCellsList::iterator iter = m_cells.begin(); iter != m_cells.end(); ++iter)
+    {
+        tCell& cell = iter->second;
+
+        // Distance to the closest observer
+        Real distance2 = getDistance2(iter->first, m_observers[0]);
+        for (unsigned int j = 1; j < m_observers.size(); ++j)
+            distance2 = std::min(distance2, getDistance2(iter->first, m_observers[j]));
+
+        if (cell.bLoaded && (distance2 > unloadRadius2))
+        {
+            cell.bLoaded = false;
+            toSuspend.insert(toSuspend.end(), cell.bodies.begin(), cell.bodies.end());
+        }
+        else if (!cell.bLoaded && (distance2 <= loadRadius2))
+        {
+            cell.bLoaded = true;
+            toResume.insert(toResume.end(), cell.bodies.begin(), cell.bodies.end());
+        }
+
+        if (cell.bLoaded)
+            ++m_nbLoadedCells;
+    }
+
+    // Use the bulk methods of the world
+    if (!toSuspend.empty())
+        m_pWorld->suspendBodies(&toSuspend[0], (unsigned int) toSuspend.size());
+
+    if (!toResume.empty())
+        m_pWorld->resumeBodies(&toResume[0], (unsigned int) toResume.size());
+}
+
+//-----------------------------------------------------------------------
+
+bool WorldStreamer::isLoaded(const Vector3& position) const
+{
+    tCellsList::const_iterator iter = m_cells.find(getCellKey(position));
+    if (iter == m_cells.end())
+        return false;
+
+    return iter->second.bLoaded;
+}
+
+//-----------------------------------------------------------------------
+
+WorldStreamer::tCellKey WorldStreamer::getCellKey(const Vector3& position) const
+{
+    return tCellKey((int) floor(position.x / m_cellSize),
+                    (int) floor(position.z / m_cellSize));
+}
+
+//-----------------------------------------------------------------------
+
+WorldStreamer::tCellKey WorldStreamer::getCellKey(Body* pBody) const
+{
+    return getCellKey(fromBulletPosition(pBody->getRigidBody()->getCenterOfMassPosition(),
+                                         m_pWorld->getOrigin()));
+}
+
+//-----------------------------------------------------------------------
+
+Real WorldStreamer::getDistance2(const tCellKey& key, const Vector3& position) const
+{
+    // Distance to the closest point of the cell (on the X and Z axes)
+    Real minX = key.first * m_cellSize;
+    Real minZ = key.second * m_cellSize;
+
+    Real dx = std::max(std::max(minX - position.x, position.x - (minX + m_cellSize)), Real(0.0));
+    Real dz = std::max(std::max(minZ - position.z, position.z - (minZ + m_cellSize)), Real(0.0));
+
+    return dx * dx + dz * dz;
+}
+
+//-----------------------------------------------------------------------
+
+WorldStreamer::tCell& WorldStreamer::getCell(const tCellKey& key)
+{
+    tCellsList::iterator iter = m_cells.find(key);
+    if (iter != m_cells.end())
+        return iter->second;
+
+    tCell& cell = m_cells[key];
+
+    // A new cell is loaded if it wouldn't be unloaded right away (or if there is no
+    // observer yet)
+    cell.bLoaded = m_observers.empty();
+
+    Real unloadRadius = m_loadRadius + m_unloadMargin;
+    for (unsigned int i = 0; (i < m_observers.size()) && !cell.bLoaded; ++i)
+        cell.bLoaded = (getDistance2(key, m_observers[i]) <= unloadRadius * unloadRadius);
+
+    if (cell.bLoaded)
+        ++m_nbLoadedCells;
+
+    return cell;
+}
+
+//-----------------------------------------------------------------------
+
+void WorldStreamer::moveBody(Body* pBody, const tCellKey& from, const tCellKey& to)
+{
+    tCell& source = m_cells[from];
+    source.bodies.erase(std::find(source.bodies.begin(), source.bodies.end(), pBody));
+
+    getCell(to).bodies.push_back(pBody);
+}
@@ -0,0 +1,161 @@
+/** @file   PhysicsEnvironment.h
+    @author Philip Abbet
+
+    Declaration of the fixture 'PhysicsEnvironment', used by the unit tests and the
+    benchmarks
+*/
+
+#ifndef _ATHENA_PHYSICS_UNITTESTS_PHYSICSENVIRONMENT_H_
+#define _ATHENA_PHYSICS_UNITTESTS_PHYSICSENVIRONMENT_H_
+
+#include <Athena-Physics/World.h>
+#include <Athena-Physics/Body.h>
+#include <Athena-Physics/PrimitiveShape.h>
+#include <Athena-Entities/ComponentsManager.h>
+#include <Athena-Entities/EntitiesManager.h>
+#include <Athena-Entities/ScenesManager.h>
+#include <Athena-Entities/Scene.h>
+#include <Athena-Entities/Entity.h>
+#include <Athena-Entities/Transforms.h>
+#include <sstream>
+#include <vector>
+
+
+//---------------------------------------------------------------------------------------
+/// @brief  Fixture creating a scene with a physical world, and helpers to fill it
+//---------------------------------------------------------------------------------------
+struct PhysicsEnvironment
+{
+    PhysicsEnvironment()
+    : nbEntities(0)
+    {
+        pComponentsManager  = new Athena::Entities::ComponentsManager();
+        pEntitiesManager    = new Athena::Entities::EntitiesManager();
+        pScenesManager      = new Athena::Entities::ScenesManager();
+
+        Athena::Physics::initialize();
+
+        pScene = pScenesManager->create("Scene");
+        pWorld = Athena::Physics::World::create("World", pScene->getComponentsList());
+    }
+
+    ~PhysicsEnvironment()
+    {
+        // The constraints reference the bodies
+        btDiscreteDynamicsWorld* pDynamicsWorld = pWorld->getRigidBodyWorld();
+        for (unsigned int i = 0; i < constraints.size(); ++i)
+        {
+            pDynamicsWorld->removeConstraint(constraints[i]);
+            delete constraints[i];
+        }
+
+        // The bodies must not have a shape when destroyed
+        for (unsigned int i = 0; i < bodies.size(); ++i)
+            bodies[i]->setCollisionShape(0);
+
+        delete pScenesManager;
+        delete pEntitiesManager;
+        delete pComponentsManager;
+    }
+
+    // Create a body with a box shape (static if its mass is 0)
+    Athena::Physics::Body* createBox(const Athena::Math::Vector3& size, Athena::Math::Real mass,
+                                     const Athena::Math::Vector3& position,
+                                     const Athena::Math::Quaternion& orientation = Athena::Math::Quaternion::IDENTITY)
+    {
+        Athena::Entities::Entity* pEntity = createEntity(position, orientation);
+
+        Athena::Physics::PrimitiveShape* pShape = Athena::Physics::PrimitiveShape::create("Shape", pEntity->getComponentsList());
+        pShape->createBox(size);
+
+        return createBody(pEntity, pShape, mass);
+    }
+
+    // Create a body with a capsule shape
+    Athena::Physics::Body* createCapsule(Athena::Math::Real radius, Athena::Math::Real height,
+                                         Athena::Physics::PrimitiveShape::tAxis axis,
+                                         Athena::Math::Real mass, const Athena::Math::Vector3& position)
+    {
+        Athena::Entities::Entity* pEntity = createEntity(position, Athena::Math::Quaternion::IDENTITY);
+
+        Athena::Physics::PrimitiveShape* pShape = Athena::Physics::PrimitiveShape::create("Shape", pEntity->getComponentsList());
+        pShape->createCapsule(radius, height, axis);
+
+        return createBody(pEntity, pShape, mass);
+    }
+
+    // Create a body with a cylinder shape
+    Athena::Physics::Body* createCylinder(Athena::Math::Real radius, Athena::Math::Real height,
+                                          Athena::Physics::PrimitiveShape::tAxis axis,
+                                          Athena::Math::Real mass, const Athena::Math::Vector3& position)
+    {
+        Athena::Entities::Entity* pEntity = createEntity(position, Athena::Math::Quaternion::IDENTITY);
+
+        Athena::Physics::PrimitiveShape* pShape = Athena::Physics::PrimitiveShape::create("Shape", pEntity->getComponentsList());
+        pShape->createCylinder(radius, height, axis);
+
+        return createBody(pEntity, pShape, mass);
+    }
+
+    // Add a large static box to the world, its top face at the given height
+    Athena::Physics::Body* createGround(Athena::Math::Real height = 0.0f)
+    {
+        return createBox(Athena::Math::Vector3(400.0f, 2.0f, 400.0f), 0.0f,
+                         Athena::Math::Vector3(0.0f, height - 1.0f, 0.0f));
+    }
+
+    // Add a constraint to the world (destroyed with the environment)
+    void addConstraint(btTypedConstraint* pConstraint)
+    {
+        pWorld->getRigidBodyWorld()->addConstraint(pConstraint, true);
+        constraints.push_back(pConstraint);
+    }
+
+    Athena::Entities::Entity* createEntity(const Athena::Math::Vector3& position,
+                                           const Athena::Math::Quaternion& orientation)
+    {
+        std::ostringstream str;
+        str << "Entity" << nbEntities++;
+
+        Athena::Entities::Entity* pEntity = pScene->create(str.str());
+        pEntity->getTransforms()->setPosition(position);
+        pEntity->getTransforms()->setOrientation(orientation);
+
+        return pEntity;
+    }
+
+    Athena::Physics::Body* createBody(Athena::Entities::Entity* pEntity,
+                                      Athena::Physics::CollisionShape* pShape,
+                                      Athena::Math::Real mass)
+    {
+        Athena::Physics::Body* pBody = Athena::Physics::Body::create("Body", pEntity->getComponentsList());
+        pBody->setCollisionShape(pShape);
+        pBody->setMass(mass);
+
+        // Make sure that the rigid body starts where the entity is (the origin of the
+        // world is never moved by the fixture)
+        const Athena::Math::Vector3& position = pEntity->getTransforms()->getWorldPosition();
+        const Athena::Math::Quaternion& orientation = pEntity->getTransforms()->getWorldOrientation();
+
+        btTransform transform(btQuaternion(orientation.x, orientation.y, orientation.z, orientation.w),
+                              btVector3(position.x, position.y, position.z));
+
+        pBody->getRigidBody()->setWorldTransform(transform);
+        pBody->getRigidBody()->setInterpolationWorldTransform(transform);
+
+        bodies.push_back(pBody);
+
+        return pBody;
+    }
+
+    Athena::Entities::ComponentsManager*    pComponentsManager;
+    Athena::Entities::EntitiesManager*      pEntitiesManager;
+    Athena::Entities::ScenesManager*        pScenesManager;
+    Athena::Entities::Scene*                pScene;
+    Athena::Physics::World*                 pWorld;
+    std::vector<Athena::Physics::Body*>     bodies;
+    std::vector<btTypedConstraint*>         constraints;
+    unsigned int                            nbEntities;
+};
+
+#endif
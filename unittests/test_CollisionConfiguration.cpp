@@ -0,0 +1,280 @@
+/** @file   test_CollisionConfiguration.cpp
+    @author Philip Abbet
+
+    Unit tests of the class 'Athena::Physics::CollisionConfiguration'
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/CollisionConfiguration.h>
+
+using namespace Athena::Physics;
+
+
+// Contact reported by a collision algorithm
+struct tContact
+{
+    bool        bFound;     // Indicates if a contact was found
+    btScalar    distance;   // Distance of the deepest contact point
+    btVector3   normal;     // Normal of the deepest contact point (on B, towards A)
+};
+
+
+// Compares the specialized algorithms of the collision configuration with the generic
+// (GJK/EPA) ones of Bullet
+struct CollisionConfigurationFixture
+{
+    CollisionConfigurationFixture()
+    {
+        genericConfiguration.enableFastAlgorithms(false);
+
+        pFastDispatcher = new btCollisionDispatcher(&fastConfiguration);
+        pGenericDispatcher = new btCollisionDispatcher(&genericConfiguration);
+    }
+
+    ~CollisionConfigurationFixture()
+    {
+        delete pFastDispatcher;
+        delete pGenericDispatcher;
+    }
+
+    void collide(btCollisionShape* pShapeA, const btTransform& transformA,
+                 btCollisionShape* pShapeB, const btTransform& transformB)
+    {
+        objectA.setCollisionShape(pShapeA);
+        objectA.setWorldTransform(transformA);
+        objectB.setCollisionShape(pShapeB);
+        objectB.setWorldTransform(transformB);
+
+        fast = collide(pFastDispatcher);
+        generic = collide(pGenericDispatcher);
+    }
+
+    tContact collide(btCollisionDispatcher* pDispatcher)
+    {
+        tContact contact;
+        contact.bFound = false;
+        contact.distance = BT_LARGE_FLOAT;
+        contact.normal.setValue(btScalar(0.0), btScalar(0.0), btScalar(0.0));
+
+        btCollisionAlgorithm* pAlgorithm = pDispatcher->findAlgorithm(&objectA, &objectB);
+
+        btDispatcherInfo dispatchInfo;
+        btManifoldResult result(&objectA, &objectB);
+
+        pAlgorithm->processCollision(&objectA, &objectB, dispatchInfo, &result);
+
+        btPersistentManifold* pManifold = result.getPersistentManifold();
+        if (pManifold)
+        {
+            for (int i = 0; i < pManifold->getNumContacts(); ++i)
+            {
+                const btManifoldPoint& point = pManifold->getContactPoint(i);
+                if (point.getDistance() >= contact.distance)
+                    continue;
+
+                contact.bFound = true;
+                contact.distance = point.getDistance();
+                contact.normal = (pManifold->getBody0() == &objectA ? point.m_normalWorldOnB :
+                                                                      -point.m_normalWorldOnB);
+            }
+        }
+
+        pAlgorithm->~btCollisionAlgorithm();
+        pDispatcher->freeCollisionAlgorithm(pAlgorithm);
+
+        return contact;
+    }
+
+    CollisionConfiguration  fastConfiguration;
+    CollisionConfiguration  genericConfiguration;
+    btCollisionDispatcher*  pFastDispatcher;
+    btCollisionDispatcher*  pGenericDispatcher;
+    btCollisionObject       objectA;
+    btCollisionObject       objectB;
+    tContact                fast;
+    tContact                generic;
+};
+
+
+// Both algorithms must report the same deepest contact
+#define CHECK_SAME_CONTACT()                                                \
+    CHECK(fast.bFound);                                                     \
+    CHECK(generic.bFound);                                                  \
+    CHECK_CLOSE(generic.distance, fast.distance, 1e-3f);                    \
+    CHECK_CLOSE(1.0f, fast.normal.dot(generic.normal), 1e-3f)
+
+
+SUITE(CollisionConfigurationTests)
+{
+    TEST_FIXTURE(CollisionConfigurationFixture, FastAlgorithmsEnabledByDefault)
+    {
+        CHECK(fastConfiguration.areFastAlgorithmsEnabled());
+        CHECK(!genericConfiguration.areFastAlgorithmsEnabled());
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SphereOnBoxFace)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btBoxShape box(btVector3(1.0f, 1.0f, 1.0f));
+
+        collide(&sphere, btTransform(btQuaternion::getIdentity(), btVector3(0.2f, 1.45f, 0.3f)),
+                &box, btTransform::getIdentity());
+
+        CHECK_SAME_CONTACT();
+        CHECK_CLOSE(-0.05f, fast.distance, 1e-4f);
+        CHECK_CLOSE(1.0f, fast.normal.y(), 1e-4f);
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SphereOnBoxEdge)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btBoxShape box(btVector3(1.0f, 1.0f, 1.0f));
+
+        // The generic algorithm rounds the edges of the box by its margin
+        box.setMargin(btScalar(0.0));
+
+        collide(&sphere, btTransform(btQuaternion::getIdentity(), btVector3(1.3f, 1.3f, 0.0f)),
+                &box, btTransform::getIdentity());
+
+        CHECK_SAME_CONTACT();
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SphereOnRotatedBoxCorner)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btBoxShape box(btVector3(1.0f, 0.5f, 2.0f));
+
+        box.setMargin(btScalar(0.0));
+
+        collide(&sphere, btTransform(btQuaternion::getIdentity(), btVector3(1.0f, 0.58f, 2.4f)),
+                &box, btTransform(btQuaternion(btVector3(1.0f, 0.0f, 1.0f).normalized(), btScalar(0.7)),
+                                  btVector3(0.0f, 0.5f, 0.0f)));
+
+        CHECK_SAME_CONTACT();
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, BoxUnderSphere)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btBoxShape box(btVector3(1.0f, 1.0f, 1.0f));
+
+        collide(&box, btTransform::getIdentity(),
+                &sphere, btTransform(btQuaternion::getIdentity(), btVector3(0.0f, 1.45f, 0.0f)));
+
+        CHECK_SAME_CONTACT();
+        CHECK_CLOSE(-1.0f, fast.normal.y(), 1e-4f);
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SphereAwayFromBox)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btBoxShape box(btVector3(1.0f, 1.0f, 1.0f));
+
+        collide(&sphere, btTransform(btQuaternion::getIdentity(), btVector3(0.0f, 2.0f, 0.0f)),
+                &box, btTransform::getIdentity());
+
+        CHECK(!fast.bFound);
+        CHECK(!generic.bFound);
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SphereOnCapsuleSide)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btCapsuleShape capsule(btScalar(0.5), btScalar(2.0));
+
+        collide(&sphere, btTransform(btQuaternion::getIdentity(), btVector3(0.95f, 0.3f, 0.0f)),
+                &capsule, btTransform::getIdentity());
+
+        CHECK_SAME_CONTACT();
+        CHECK_CLOSE(-0.05f, fast.distance, 1e-4f);
+        CHECK_CLOSE(1.0f, fast.normal.x(), 1e-4f);
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SphereOnRotatedCapsuleCap)
+    {
+        btSphereShape sphere(btScalar(0.3));
+        btCapsuleShape capsule(btScalar(0.5), btScalar(2.0));
+
+        collide(&sphere, btTransform(btQuaternion::getIdentity(), btVector3(1.5f, 0.9f, 0.2f)),
+                &capsule, btTransform(btQuaternion(btVector3(0.0f, 0.0f, 1.0f), btScalar(-1.0)),
+                                      btVector3(0.0f, 0.0f, 0.0f)));
+
+        CHECK_SAME_CONTACT();
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, CapsuleOnSphere)
+    {
+        btSphereShape sphere(btScalar(0.5));
+        btCapsuleShape capsule(btScalar(0.5), btScalar(2.0));
+
+        collide(&capsule, btTransform(btQuaternion::getIdentity(), btVector3(0.0f, 1.95f, 0.0f)),
+                &sphere, btTransform::getIdentity());
+
+        CHECK_SAME_CONTACT();
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, CrossedCapsules)
+    {
+        btCapsuleShape capsuleA(btScalar(0.5), btScalar(2.0));
+        btCapsuleShape capsuleB(btScalar(0.4), btScalar(3.0));
+
+        collide(&capsuleA, btTransform(btQuaternion(btVector3(0.0f, 0.0f, 1.0f), SIMD_HALF_PI),
+                                       btVector3(0.0f, 0.0f, 0.0f)),
+                &capsuleB, btTransform(btQuaternion(btVector3(1.0f, 0.0f, 0.0f), SIMD_HALF_PI),
+                                       btVector3(0.3f, 0.85f, 0.2f)));
+
+        CHECK_SAME_CONTACT();
+        CHECK_CLOSE(-0.05f, fast.distance, 1e-4f);
+        CHECK_CLOSE(-1.0f, fast.normal.y(), 1e-4f);
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, SkewedCapsules)
+    {
+        btCapsuleShape capsuleA(btScalar(0.5), btScalar(2.0));
+        btCapsuleShape capsuleB(btScalar(0.5), btScalar(2.0));
+
+        collide(&capsuleA, btTransform(btQuaternion(btVector3(1.0f, 0.0f, 1.0f).normalized(), btScalar(0.4)),
+                                       btVector3(0.2f, 0.0f, 0.1f)),
+                &capsuleB, btTransform(btQuaternion(btVector3(0.0f, 1.0f, 1.0f).normalized(), btScalar(1.2)),
+                                       btVector3(1.4f, 0.4f, -0.3f)));
+
+        CHECK_SAME_CONTACT();
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, ParallelCapsules)
+    {
+        btCapsuleShape capsuleA(btScalar(0.5), btScalar(2.0));
+        btCapsuleShape capsuleB(btScalar(0.5), btScalar(2.0));
+
+        collide(&capsuleA, btTransform::getIdentity(),
+                &capsuleB, btTransform(btQuaternion::getIdentity(), btVector3(0.95f, 0.5f, 0.0f)));
+
+        CHECK_SAME_CONTACT();
+        CHECK_CLOSE(-0.05f, fast.distance, 1e-4f);
+        CHECK_CLOSE(-1.0f, fast.normal.x(), 1e-4f);
+    }
+
+
+    TEST_FIXTURE(CollisionConfigurationFixture, AlignedCapsules)
+    {
+        btCapsuleShape capsuleA(btScalar(0.5), btScalar(2.0));
+        btCapsuleShape capsuleB(btScalar(0.5), btScalar(2.0));
+
+        collide(&capsuleA, btTransform::getIdentity(),
+                &capsuleB, btTransform(btQuaternion::getIdentity(), btVector3(0.0f, 2.95f, 0.0f)));
+
+        CHECK_SAME_CONTACT();
+        CHECK_CLOSE(-0.05f, fast.distance, 1e-4f);
+    }
+}
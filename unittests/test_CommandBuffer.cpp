@@ -0,0 +1,138 @@
+/** @file   test_CommandBuffer.cpp
+    @author Philip Abbet
+
+    Unit tests of the class 'Athena::Physics::CommandBuffer'
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/CommandBuffer.h>
+#include "PhysicsEnvironment.h"
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+
+
+// Environment with two boxes floating in the air, and the command buffer of the world
+struct CommandBufferFixture: public PhysicsEnvironment
+{
+    CommandBufferFixture()
+    {
+        pBox1 = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(0.0f, 10.0f, 0.0f));
+        pBox2 = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(5.0f, 10.0f, 0.0f));
+
+        pCommands = pWorld->getCommandBuffer();
+    }
+
+    bool isInWorld(Body* pBody)
+    {
+        return (pBody->getRigidBody()->getBroadphaseHandle() != 0);
+    }
+
+    Body*           pBox1;
+    Body*           pBox2;
+    CommandBuffer*  pCommands;
+};
+
+
+SUITE(CommandBufferTests)
+{
+    TEST_FIXTURE(CommandBufferFixture, CommandsAreAppliedAtTheNextStep)
+    {
+        CHECK(pCommands->isEmpty());
+
+        pCommands->setLinearVelocity(pBox1, Vector3(3.0f, 0.0f, 0.0f));
+        pCommands->removeBody(pBox2);
+
+        // Nothing happens until the step
+        CHECK(!pCommands->isEmpty());
+        CHECK_CLOSE(0.0, (double) pBox1->getLinearVelocity().x, 1e-6);
+        CHECK(isInWorld(pBox2));
+
+        pWorld->stepSimulation(Real(1.0 / 60.0));
+
+        CHECK(pCommands->isEmpty());
+        CHECK_CLOSE(3.0, (double) pBox1->getLinearVelocity().x, 1e-6);
+        CHECK(!isInWorld(pBox2));
+    }
+
+
+    TEST_FIXTURE(CommandBufferFixture, CommandsAreAppliedInRecordingOrder)
+    {
+        pCommands->setLinearVelocity(pBox1, Vector3(1.0f, 0.0f, 0.0f));
+        pCommands->setLinearVelocity(pBox1, Vector3(2.0f, 0.0f, 0.0f));
+
+        pCommands->teleport(pBox2, Vector3(20.0f, 10.0f, 0.0f), Quaternion::IDENTITY);
+        pCommands->teleport(pBox2, Vector3(30.0f, 10.0f, 0.0f), Quaternion::IDENTITY);
+
+        pCommands->apply();
+
+        CHECK_CLOSE(2.0, (double) pBox1->getLinearVelocity().x, 1e-6);
+        CHECK_CLOSE(30.0, (double) pBox2->getRigidBody()->getCenterOfMassPosition().x(), 1e-6);
+
+        // Removal then addition, and the opposite
+        pCommands->removeBody(pBox1);
+        pCommands->addBody(pBox1);
+        pCommands->addBody(pBox2);
+        pCommands->removeBody(pBox2);
+
+        pCommands->apply();
+
+        CHECK(isInWorld(pBox1));
+        CHECK(!isInWorld(pBox2));
+    }
+
+
+    TEST_FIXTURE(CommandBufferFixture, ApplyEmptiesTheBuffer)
+    {
+        pCommands->setLinearVelocity(pBox1, Vector3(1.0f, 0.0f, 0.0f));
+        pCommands->apply();
+
+        CHECK(pCommands->isEmpty());
+
+        // Applied only once
+        pBox1->setWorldLinearVelocity(Vector3::ZERO);
+        pCommands->apply();
+
+        CHECK_CLOSE(0.0, (double) pBox1->getLinearVelocity().x, 1e-6);
+    }
+
+
+    TEST_FIXTURE(CommandBufferFixture, CommandsSpanningSeveralBlocks)
+    {
+        const unsigned int NB_COMMANDS = CommandBuffer::BLOCK_SIZE * 2 + 10;
+
+        // Twice, to reuse the blocks allocated the first time
+        for (unsigned int n = 0; n < 2; ++n)
+        {
+            for (unsigned int i = 0; i < NB_COMMANDS; ++i)
+            {
+                pCommands->setLinearVelocity(pBox1, Vector3(Real(i), 0.0f, 0.0f));
+                pCommands->applyImpulse(pBox2, Vector3(1.0f, 0.0f, 0.0f));
+            }
+
+            pBox2->setWorldLinearVelocity(Vector3::ZERO);
+
+            pCommands->apply();
+
+            CHECK(pCommands->isEmpty());
+            CHECK_CLOSE((double) NB_COMMANDS - 1, (double) pBox1->getLinearVelocity().x, 1e-6);
+            CHECK_CLOSE((double) NB_COMMANDS, (double) pBox2->getLinearVelocity().x, 1e-3);
+        }
+    }
+
+
+    TEST_FIXTURE(CommandBufferFixture, DiscardedCommandsAreIgnored)
+    {
+        pCommands->setLinearVelocity(pBox1, Vector3(1.0f, 0.0f, 0.0f));
+        pCommands->setLinearVelocity(pBox2, Vector3(2.0f, 0.0f, 0.0f));
+        pCommands->removeBody(pBox1);
+
+        pCommands->discard(pBox1);
+        pCommands->apply();
+
+        CHECK_CLOSE(0.0, (double) pBox1->getLinearVelocity().x, 1e-6);
+        CHECK(isInWorld(pBox1));
+        CHECK_CLOSE(2.0, (double) pBox2->getLinearVelocity().x, 1e-6);
+    }
+}
@@ -0,0 +1,394 @@
+/** @file   test_Replication.cpp
+    @author Philip Abbet
+
+    Unit tests of the bit packing, quantization and delta encoding used by the network
+    replication of the bodies
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/BitStream.h>
+#include <Athena-Physics/Replication.h>
+#include <limits.h>
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+
+
+// A rigid body outside of any world, used to produce quantized states
+struct ReplicationFixture
+{
+    ReplicationFixture()
+    : pShape(0), pRigidBody(0)
+    {
+        pShape = new btSphereShape(0.5f);
+
+        btRigidBody::btRigidBodyConstructionInfo info(1.0f, 0, pShape);
+        pRigidBody = new btRigidBody(info);
+    }
+
+    ~ReplicationFixture()
+    {
+        delete pRigidBody;
+        delete pShape;
+    }
+
+    void setState(const btVector3& position, const btQuaternion& orientation,
+                  const btVector3& linearVelocity, const btVector3& angularVelocity)
+    {
+        pRigidBody->setCenterOfMassTransform(btTransform(orientation, position));
+        pRigidBody->setLinearVelocity(linearVelocity);
+        pRigidBody->setAngularVelocity(angularVelocity);
+    }
+
+    btSphereShape*          pShape;
+    btRigidBody*            pRigidBody;
+    tReplicationSettings    settings;
+};
+
+
+SUITE(BitStreamTests)
+{
+    TEST(ValuesOfAllSizesRoundTrip)
+    {
+        BitStream stream;
+        unsigned int nbBits = 0;
+
+        for (unsigned int size = 1; size <= 32; ++size)
+        {
+            unsigned int mask = (size == 32 ? 0xFFFFFFFFu : (1u << size) - 1);
+            stream.write(0xA5C3E1F7u & mask, size);
+            nbBits += size;
+        }
+
+        CHECK_EQUAL(nbBits, stream.getNbBits());
+        CHECK_EQUAL((nbBits + 7) / 8, stream.getSize());
+
+        for (unsigned int size = 1; size <= 32; ++size)
+        {
+            unsigned int mask = (size == 32 ? 0xFFFFFFFFu : (1u << size) - 1);
+            CHECK_EQUAL(0xA5C3E1F7u & mask, stream.read(size));
+        }
+
+        CHECK(!stream.hasOverflowed());
+    }
+
+
+    TEST(BooleansRoundTrip)
+    {
+        BitStream stream;
+
+        for (unsigned int i = 0; i < 19; ++i)
+            stream.writeBool(i % 3 == 0);
+
+        CHECK_EQUAL(19u, stream.getNbBits());
+
+        for (unsigned int i = 0; i < 19; ++i)
+            CHECK_EQUAL(i % 3 == 0, stream.readBool());
+
+        CHECK(!stream.hasOverflowed());
+    }
+
+
+    TEST(VariableValuesRoundTrip)
+    {
+        const unsigned int values[] = { 0, 1, 31, 32, 255, 1000, 65535, 1u << 31, UINT_MAX };
+        const int signedValues[] = { 0, -1, 1, -16, 16, -1000, 123456, INT_MAX, INT_MIN };
+
+        BitStream stream;
+
+        for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+            stream.writeVariable(values[i]);
+
+        for (unsigned int i = 0; i < sizeof(signedValues) / sizeof(signedValues[0]); ++i)
+            stream.writeVariableSigned(signedValues[i]);
+
+        for (unsigned int i = 0; i < sizeof(values) / sizeof(values[0]); ++i)
+            CHECK_EQUAL(values[i], stream.readVariable());
+
+        for (unsigned int i = 0; i < sizeof(signedValues) / sizeof(signedValues[0]); ++i)
+            CHECK_EQUAL(signedValues[i], stream.readVariableSigned());
+
+        CHECK(!stream.hasOverflowed());
+    }
+
+
+    TEST(SmallVariableValuesTakeLessSpace)
+    {
+        BitStream small;
+        small.writeVariableSigned(-3);
+
+        BitStream large;
+        large.writeVariableSigned(-30000);
+
+        CHECK(small.getNbBits() < large.getNbBits());
+    }
+
+
+    TEST(ReadPastTheEndOverflows)
+    {
+        BitStream stream;
+        stream.write(5, 3);
+
+        CHECK_EQUAL(5u, stream.read(3));
+        CHECK(!stream.hasOverflowed());
+
+        CHECK_EQUAL(0u, stream.read(1));
+        CHECK(stream.hasOverflowed());
+
+        stream.rewind();
+        CHECK(!stream.hasOverflowed());
+        CHECK_EQUAL(5u, stream.read(3));
+    }
+
+
+    TEST(StreamBuiltFromReceivedData)
+    {
+        BitStream sent;
+        sent.write(0x1234, 13);
+        sent.writeVariableSigned(-77);
+        sent.writeBool(true);
+
+        BitStream received(sent.getData(), sent.getSize());
+
+        CHECK_EQUAL(0x1234u, received.read(13));
+        CHECK_EQUAL(-77, received.readVariableSigned());
+        CHECK(received.readBool());
+        CHECK(!received.hasOverflowed());
+    }
+}
+
+
+SUITE(ReplicationTests)
+{
+    TEST_FIXTURE(ReplicationFixture, QuantizationRoundTrip)
+    {
+        btQuaternion orientation(btVector3(1.0f, 2.0f, -0.5f).normalized(), 2.3f);
+
+        setState(btVector3(12.3456f, -7.891f, 100.5f), orientation,
+                 btVector3(3.21f, -0.5f, 9.87f), btVector3(-1.5f, 0.25f, 4.0f));
+
+        tQuantizedBodyState state;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state);
+        CHECK(state.bPresent);
+
+        btTransform transform;
+        btVector3 linearVelocity, angularVelocity;
+        dequantizeBodyState(state, Vector3::ZERO, settings, transform, linearVelocity, angularVelocity);
+
+        double positionError = (double) settings.positionPrecision * 0.5 + 1e-5;
+        CHECK_CLOSE(12.3456, (double) transform.getOrigin().x(), positionError);
+        CHECK_CLOSE(-7.891, (double) transform.getOrigin().y(), positionError);
+        CHECK_CLOSE(100.5, (double) transform.getOrigin().z(), positionError);
+
+        double velocityError = (double) settings.velocityPrecision * 0.5 + 1e-5;
+        CHECK_CLOSE(3.21, (double) linearVelocity.x(), velocityError);
+        CHECK_CLOSE(-0.5, (double) linearVelocity.y(), velocityError);
+        CHECK_CLOSE(9.87, (double) linearVelocity.z(), velocityError);
+        CHECK_CLOSE(-1.5, (double) angularVelocity.x(), velocityError);
+        CHECK_CLOSE(0.25, (double) angularVelocity.y(), velocityError);
+        CHECK_CLOSE(4.0, (double) angularVelocity.z(), velocityError);
+
+        // q and -q are the same orientation
+        CHECK_CLOSE(1.0, (double) btFabs(transform.getRotation().dot(orientation)), 1e-5);
+
+        // Quantizing the dequantized state gives the same state
+        setState(transform.getOrigin(), transform.getRotation(), linearVelocity, angularVelocity);
+
+        tQuantizedBodyState state2;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state2);
+        CHECK(isSameBodyState(state, state2));
+    }
+
+
+    TEST_FIXTURE(ReplicationFixture, QuantizationIgnoresTheOrigin)
+    {
+        setState(btVector3(5.0f, 1.0f, -2.0f), btQuaternion::getIdentity(),
+                 btVector3(0.0f, 0.0f, 0.0f), btVector3(0.0f, 0.0f, 0.0f));
+
+        // The same position in the coordinates of the entities, seen from two origins
+        tQuantizedBodyState state1;
+        quantizeBodyState(pRigidBody, Vector3(100.0f, 0.0f, 0.0f), settings, state1);
+
+        setState(btVector3(105.0f, 1.0f, -2.0f), btQuaternion::getIdentity(),
+                 btVector3(0.0f, 0.0f, 0.0f), btVector3(0.0f, 0.0f, 0.0f));
+
+        tQuantizedBodyState state2;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state2);
+
+        CHECK(isSameBodyState(state1, state2));
+
+        btTransform transform;
+        btVector3 linearVelocity, angularVelocity;
+        dequantizeBodyState(state2, Vector3(100.0f, 0.0f, 0.0f), settings, transform,
+                            linearVelocity, angularVelocity);
+
+        CHECK_CLOSE(5.0, (double) transform.getOrigin().x(), 1e-3);
+        CHECK_CLOSE(1.0, (double) transform.getOrigin().y(), 1e-3);
+        CHECK_CLOSE(-2.0, (double) transform.getOrigin().z(), 1e-3);
+    }
+
+
+    TEST_FIXTURE(ReplicationFixture, OrientationsOfAllPrecisionsRoundTrip)
+    {
+        const btQuaternion orientations[] = {
+            btQuaternion::getIdentity(),
+            btQuaternion(0.0f, 0.0f, 0.0f, -1.0f),
+            btQuaternion(btVector3(0.0f, 1.0f, 0.0f), SIMD_HALF_PI),
+            btQuaternion(btVector3(1.0f, 0.0f, 0.0f), SIMD_PI),
+            btQuaternion(btVector3(-0.3f, 0.4f, 0.8f).normalized(), -1.2f),
+        };
+
+        const unsigned int nbOrientations = sizeof(orientations) / sizeof(orientations[0]);
+
+        for (unsigned int nbBits = 2; nbBits <= 10; ++nbBits)
+        {
+            settings.orientationBits = nbBits;
+
+            // Maximal error on each encoded component
+            double error = 0.71 / double((1 << nbBits) - 1) * 4.0;
+
+            for (unsigned int i = 0; i < nbOrientations; ++i)
+            {
+                setState(btVector3(0.0f, 0.0f, 0.0f), orientations[i],
+                         btVector3(0.0f, 0.0f, 0.0f), btVector3(0.0f, 0.0f, 0.0f));
+
+                tQuantizedBodyState state;
+                quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state);
+
+                if (2 + 3 * nbBits < 32)
+                    CHECK(state.orientation < (1u << (2 + 3 * nbBits)));
+
+                btTransform transform;
+                btVector3 linearVelocity, angularVelocity;
+                dequantizeBodyState(state, Vector3::ZERO, settings, transform,
+                                    linearVelocity, angularVelocity);
+
+                CHECK_CLOSE(1.0, (double) btFabs(transform.getRotation().dot(orientations[i].normalized())),
+                            error);
+            }
+        }
+    }
+
+
+    TEST_FIXTURE(ReplicationFixture, VelocitiesCanBeIgnored)
+    {
+        settings.bVelocities = false;
+
+        setState(btVector3(1.0f, 2.0f, 3.0f), btQuaternion::getIdentity(),
+                 btVector3(4.0f, 5.0f, 6.0f), btVector3(7.0f, 8.0f, 9.0f));
+
+        tQuantizedBodyState state;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state);
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            CHECK_EQUAL(0, state.linearVelocity[i]);
+            CHECK_EQUAL(0, state.angularVelocity[i]);
+        }
+    }
+
+
+    TEST_FIXTURE(ReplicationFixture, DeltaRoundTrip)
+    {
+        setState(btVector3(1.0f, 2.0f, 3.0f), btQuaternion::getIdentity(),
+                 btVector3(0.0f, -9.81f, 0.0f), btVector3(0.0f, 0.0f, 0.0f));
+
+        tQuantizedBodyState baseline;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, baseline);
+
+        // Every field changed
+        setState(btVector3(1.5f, 1.8f, -3.0f), btQuaternion(btVector3(0.0f, 0.0f, 1.0f), 0.7f),
+                 btVector3(2.0f, -10.5f, 0.1f), btVector3(0.0f, 3.0f, -1.0f));
+
+        tQuantizedBodyState state;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state);
+
+        BitStream stream;
+        writeBodyState(stream, state, baseline, settings);
+        stream.write(0x5A, 8);      // Sentinel, to check that the reader stops where the writer did
+
+        tQuantizedBodyState decoded;
+        decoded.bPresent = true;
+        readBodyState(stream, baseline, settings, decoded);
+
+        CHECK(isSameBodyState(state, decoded));
+        CHECK_EQUAL(0x5Au, stream.read(8));
+        CHECK(!stream.hasOverflowed());
+    }
+
+
+    TEST_FIXTURE(ReplicationFixture, UnchangedFieldsAreNotWritten)
+    {
+        setState(btVector3(10.0f, 0.5f, -4.0f), btQuaternion(btVector3(1.0f, 0.0f, 0.0f), 0.3f),
+                 btVector3(1.0f, 0.0f, 0.0f), btVector3(0.0f, 0.0f, 0.0f));
+
+        tQuantizedBodyState baseline;
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, baseline);
+
+        // Identical: only the flags of the fields are written
+        BitStream unchanged;
+        writeBodyState(unchanged, baseline, baseline, settings);
+
+        CHECK_EQUAL(4u, unchanged.getNbBits());
+
+        tQuantizedBodyState decoded;
+        decoded.bPresent = true;
+        readBodyState(unchanged, baseline, settings, decoded);
+        CHECK(isSameBodyState(baseline, decoded));
+
+        // Only the position moved a little: smaller than a full orientation
+        tQuantizedBodyState moved = baseline;
+        moved.position[0] += 3;
+        moved.position[2] -= 1;
+
+        BitStream delta;
+        writeBodyState(delta, moved, baseline, settings);
+
+        CHECK(delta.getNbBits() < 4u + 2u + 3u * settings.orientationBits);
+
+        readBodyState(delta, baseline, settings, decoded);
+        CHECK(isSameBodyState(moved, decoded));
+        CHECK(!delta.hasOverflowed());
+    }
+
+
+    TEST_FIXTURE(ReplicationFixture, ChainOfDeltasRoundTrip)
+    {
+        tQuantizedBodyState sent;
+        tQuantizedBodyState received;
+
+        setState(btVector3(0.0f, 20.0f, 0.0f), btQuaternion::getIdentity(),
+                 btVector3(1.0f, 0.0f, 0.0f), btVector3(0.0f, 2.0f, 0.0f));
+        quantizeBodyState(pRigidBody, Vector3::ZERO, settings, sent);
+        received = sent;
+
+        // Each state is encoded relative to the previous one, like a body falling
+        for (unsigned int i = 1; i <= 30; ++i)
+        {
+            btScalar t = btScalar(i) / btScalar(60.0);
+
+            setState(btVector3(t, 20.0f - 4.905f * t * t, 0.0f),
+                     btQuaternion(btVector3(0.0f, 1.0f, 0.0f), 2.0f * t),
+                     btVector3(1.0f, -9.81f * t, 0.0f), btVector3(0.0f, 2.0f, 0.0f));
+
+            tQuantizedBodyState state;
+            quantizeBodyState(pRigidBody, Vector3::ZERO, settings, state);
+
+            BitStream stream;
+            writeBodyState(stream, state, sent, settings);
+
+            BitStream packet(stream.getData(), stream.getSize());
+
+            tQuantizedBodyState decoded;
+            decoded.bPresent = true;
+            readBodyState(packet, received, settings, decoded);
+
+            CHECK(isSameBodyState(state, decoded));
+            CHECK(!packet.hasOverflowed());
+
+            sent = state;
+            received = decoded;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+/** @file   test_SimulationLod.cpp
+    @author Philip Abbet
+
+    Unit tests of the class 'Athena::Physics::SimulationLod'
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/SimulationLod.h>
+#include "PhysicsEnvironment.h"
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+
+
+// Number of boxes in the pile
+static const unsigned int NB_BOXES = 3;
+
+// The bodies of the band are simulated once every INTERVAL substeps
+static const unsigned int INTERVAL = 4;
+
+// Number of steps (short enough for the pile to stay awake)
+static const unsigned int NB_STEPS = 40;
+
+
+// Environment with a pile of boxes resting on the ground, far from the observer
+struct SimulationLodFixture: public PhysicsEnvironment
+{
+    SimulationLodFixture()
+    {
+        createGround();
+
+        for (unsigned int i = 0; i < NB_BOXES; ++i)
+            pBoxes[i] = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(100.0f, Real(i) + 0.5f, 0.0f));
+
+        SimulationLod::tBand band;
+        band.distance = 50.0f;
+        band.interval = INTERVAL;
+
+        Vector3 observer = Vector3::ZERO;
+
+        pLod = pWorld->getSimulationLod();
+        pLod->setBands(&band, 1);
+        pLod->setObservers(&observer, 1);
+    }
+
+    Body*           pBoxes[NB_BOXES];
+    SimulationLod*  pLod;
+};
+
+
+SUITE(SimulationLodTests)
+{
+    TEST_FIXTURE(SimulationLodFixture, RestingPileIsSimulatedAtReducedRate)
+    {
+        unsigned int nbSkipped = 0;
+
+        for (unsigned int i = 0; i < NB_STEPS; ++i)
+        {
+            CHECK_EQUAL(1u, pWorld->stepSimulation(Real(1.0 / 60.0)));
+            nbSkipped += pLod->getNbSkippedBodies();
+        }
+
+        for (unsigned int i = 0; i < NB_BOXES; ++i)
+        {
+            CHECK_EQUAL(1u, pLod->getBand(pBoxes[i]));
+            CHECK(!pBoxes[i]->getRigidBody()->isStaticOrKinematicObject());
+        }
+
+        // The boxes touching each other share the same phase: they skip most of the
+        // substeps together, instead of being promoted to the full rate
+        CHECK(nbSkipped >= NB_BOXES * NB_STEPS / 2);
+
+        // And the pile is still standing
+        for (unsigned int i = 0; i < NB_BOXES; ++i)
+        {
+            btVector3 position = pBoxes[i]->getRigidBody()->getCenterOfMassPosition();
+
+            CHECK_CLOSE(100.0, (double) position.x(), 1e-2);
+            CHECK_CLOSE((double) i + 0.5, (double) position.y(), 5e-2);
+        }
+    }
+}
@@ -0,0 +1,178 @@
+/** @file   test_TriggerIndex.cpp
+    @author Philip Abbet
+
+    Unit tests of the class 'Athena::Physics::TriggerIndex'
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/TriggerIndex.h>
+#include <Athena-Physics/GhostObject.h>
+#include "PhysicsEnvironment.h"
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+
+
+// Maximum number of steps of the tests
+static const unsigned int NB_MAX_STEPS = 120;
+
+
+// Listener recording the events of the triggers
+struct Listener: public TriggerIndex::IListener
+{
+    struct tEvent
+    {
+        bool                bEnter;
+        GhostObject*        pTrigger;
+        CollisionObject*    pObject;
+        unsigned int        step;
+    };
+
+    Listener()
+    : step(0)
+    {
+    }
+
+    virtual void onTriggerEnter(GhostObject* pTrigger, CollisionObject* pObject)
+    {
+        tEvent event = { true, pTrigger, pObject, step };
+        events.push_back(event);
+    }
+
+    virtual void onTriggerExit(GhostObject* pTrigger, CollisionObject* pObject)
+    {
+        tEvent event = { false, pTrigger, pObject, step };
+        events.push_back(event);
+    }
+
+    std::vector<tEvent> events;
+    unsigned int        step;
+};
+
+
+// Environment with a static trigger (a box between the heights 4 and 6)
+struct TriggerIndexFixture: public PhysicsEnvironment
+{
+    TriggerIndexFixture()
+    {
+        Entities::Entity* pEntity = createEntity(Vector3(0.0f, 5.0f, 0.0f), Quaternion::IDENTITY);
+
+        PrimitiveShape* pShape = PrimitiveShape::create("Shape", pEntity->getComponentsList());
+        pShape->createBox(Vector3(4.0f, 2.0f, 4.0f));
+
+        pTrigger = GhostObject::create("Trigger", pEntity->getComponentsList());
+        pTrigger->setStatic();
+        pTrigger->setCollisionShape(pShape);
+
+        pWorld->getTriggerIndex()->setListener(&listener);
+    }
+
+    ~TriggerIndexFixture()
+    {
+        pWorld->getTriggerIndex()->setListener(0);
+    }
+
+    void step()
+    {
+        ++listener.step;
+        pWorld->stepSimulation(Real(1.0 / 60.0));
+    }
+
+    GhostObject*    pTrigger;
+    Listener        listener;
+};
+
+
+SUITE(TriggerIndexTests)
+{
+    TEST_FIXTURE(TriggerIndexFixture, FallingBodyEntersAndLeavesTheTrigger)
+    {
+        Body* pBody = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(0.0f, 10.0f, 0.0f));
+
+        CHECK_EQUAL(1u, pWorld->getTriggerIndex()->getNbTriggers());
+
+        bool bSeenInside = false;
+        for (unsigned int i = 0; (i < NB_MAX_STEPS) && (listener.events.size() < 2); ++i)
+        {
+            step();
+
+            if (listener.events.size() == 1)
+            {
+                CHECK_EQUAL(1u, pTrigger->getNbOverlappingObjects());
+                CHECK(pTrigger->getOverlappingObject(0) == pBody);
+                bSeenInside = true;
+            }
+        }
+
+        CHECK(bSeenInside);
+        CHECK_EQUAL(2u, (unsigned int) listener.events.size());
+        CHECK_EQUAL(0u, pTrigger->getNbOverlappingObjects());
+
+        if (listener.events.size() == 2)
+        {
+            CHECK(listener.events[0].bEnter);
+            CHECK(listener.events[0].pTrigger == pTrigger);
+            CHECK(listener.events[0].pObject == pBody);
+
+            CHECK(!listener.events[1].bEnter);
+            CHECK(listener.events[1].pTrigger == pTrigger);
+            CHECK(listener.events[1].pObject == pBody);
+
+            CHECK(listener.events[0].step < listener.events[1].step);
+        }
+    }
+
+
+    TEST_FIXTURE(TriggerIndexFixture, BodyMovedByTheUserIsDetected)
+    {
+        Body* pBody = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(20.0f, 5.0f, 0.0f));
+        pBody->setKinematic(true);
+
+        step();
+        CHECK(listener.events.empty());
+
+        // Moved into the trigger, then out of it, without simulation
+        pBody->getTransforms()->setPosition(Vector3(0.0f, 5.0f, 0.0f));
+        step();
+
+        CHECK_EQUAL(1u, (unsigned int) listener.events.size());
+        CHECK_EQUAL(1u, pTrigger->getNbOverlappingObjects());
+        CHECK(pTrigger->getOverlappingObject(0) == pBody);
+
+        // Not moved: nothing changes
+        step();
+        step();
+
+        CHECK_EQUAL(1u, (unsigned int) listener.events.size());
+        CHECK_EQUAL(1u, pTrigger->getNbOverlappingObjects());
+
+        pBody->getTransforms()->setPosition(Vector3(-20.0f, 5.0f, 0.0f));
+        step();
+
+        CHECK_EQUAL(2u, (unsigned int) listener.events.size());
+        CHECK_EQUAL(0u, pTrigger->getNbOverlappingObjects());
+
+        if (listener.events.size() == 2)
+        {
+            CHECK(listener.events[0].bEnter);
+            CHECK(listener.events[0].pObject == pBody);
+            CHECK(!listener.events[1].bEnter);
+            CHECK(listener.events[1].pObject == pBody);
+        }
+    }
+
+
+    TEST_FIXTURE(TriggerIndexFixture, BodiesOutsideTheTriggerAreIgnored)
+    {
+        createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(20.0f, 10.0f, 0.0f));
+        createBox(Vector3(1.0f, 1.0f, 1.0f), 0.0f, Vector3(0.0f, 5.0f, 0.0f));
+
+        for (unsigned int i = 0; i < 30; ++i)
+            step();
+
+        // The dynamic body falls beside the trigger, the static one is never tested
+        CHECK(listener.events.empty());
+        CHECK_EQUAL(0u, pTrigger->getNbOverlappingObjects());
+    }
+}
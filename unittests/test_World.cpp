@@ -0,0 +1,193 @@
+/** @file   test_World.cpp
+    @author Philip Abbet
+
+    Unit tests of the class 'Athena::Physics::World'
+*/
+
+#include <UnitTest++.h>
+#include <Athena-Physics/CompoundShape.h>
+#include "PhysicsEnvironment.h"
+
+using namespace Athena;
+using namespace Athena::Physics;
+using namespace Athena::Math;
+
+
+// Number of movements of the sweep batches
+static const unsigned int NB_SWEEPS = 4;
+
+// Number of steps before the state is saved
+static const unsigned int NB_REPLAY_WARMUP_STEPS = 10;
+
+// Number of steps of the replays of a saved state
+static const unsigned int NB_REPLAY_STEPS = 40;
+
+
+// Environment with a ground, and helpers to move shapes above it
+struct WorldFixture: public PhysicsEnvironment
+{
+    WorldFixture()
+    {
+        pGround = createGround();
+
+        for (unsigned int i = 0; i < NB_SWEEPS; ++i)
+        {
+            sweeps[i].from          = Vector3(Real(i), 5.0f, 0.0f);
+            sweeps[i].to            = Vector3(Real(i), -5.0f, 0.0f);
+            sweeps[i].orientation   = Quaternion::IDENTITY;
+
+            // Garbage, that must be overwritten by the sweeps
+            hits[i].pObject     = pGround;
+            hits[i].position    = Vector3(100.0f, 100.0f, 100.0f);
+            hits[i].normal      = Vector3::UNIT_Y;
+            hits[i].fraction    = 0.5f;
+        }
+    }
+
+    Body*               pGround;
+    World::tSweep       sweeps[NB_SWEEPS];
+    World::tSweepHit    hits[NB_SWEEPS];
+};
+
+
+SUITE(WorldTests)
+{
+    TEST_FIXTURE(WorldFixture, SweepBatchWithConvexShape)
+    {
+        Entities::Entity* pEntity = createEntity(Vector3::ZERO, Quaternion::IDENTITY);
+        PrimitiveShape* pShape = PrimitiveShape::create("Shape", pEntity->getComponentsList());
+        pShape->createSphere(1.0f);
+
+        CHECK_EQUAL(NB_SWEEPS, pWorld->sweepBatch(pShape, sweeps, NB_SWEEPS, hits));
+
+        for (unsigned int i = 0; i < NB_SWEEPS; ++i)
+        {
+            CHECK(hits[i].pObject == pGround);
+            CHECK_CLOSE(0.4, (double) hits[i].fraction, 1e-2);
+            CHECK_CLOSE(1.0, (double) hits[i].normal.y, 1e-2);
+        }
+    }
+
+
+    TEST_FIXTURE(WorldFixture, SweepBatchWithConcaveShapeReportsMisses)
+    {
+        Entities::Entity* pEntity = createEntity(Vector3::ZERO, Quaternion::IDENTITY);
+        CompoundShape* pShape = CompoundShape::create("Shape", pEntity->getComponentsList());
+        pShape->addBox(Vector3(1.0f, 1.0f, 1.0f));
+
+        CHECK_EQUAL(0u, pWorld->sweepBatch(pShape, sweeps, NB_SWEEPS, hits));
+
+        for (unsigned int i = 0; i < NB_SWEEPS; ++i)
+        {
+            CHECK(hits[i].pObject == 0);
+            CHECK_CLOSE((double) sweeps[i].to.x, (double) hits[i].position.x, 1e-6);
+            CHECK_CLOSE((double) sweeps[i].to.y, (double) hits[i].position.y, 1e-6);
+            CHECK_CLOSE((double) sweeps[i].to.z, (double) hits[i].position.z, 1e-6);
+            CHECK_CLOSE(0.0, (double) hits[i].normal.length(), 1e-6);
+            CHECK_CLOSE(1.0, (double) hits[i].fraction, 1e-6);
+        }
+    }
+
+
+    TEST_FIXTURE(WorldFixture, SweepWithConcaveShapeReportsMiss)
+    {
+        Entities::Entity* pEntity = createEntity(Vector3::ZERO, Quaternion::IDENTITY);
+        CompoundShape* pShape = CompoundShape::create("Shape", pEntity->getComponentsList());
+        pShape->addBox(Vector3(1.0f, 1.0f, 1.0f));
+
+        CHECK(!pWorld->sweep(pShape, sweeps[0], hits[0]));
+        CHECK(hits[0].pObject == 0);
+        CHECK_CLOSE(1.0, (double) hits[0].fraction, 1e-6);
+    }
+
+
+    TEST_FIXTURE(WorldFixture, SuspendedBodiesKeepTheirIndex)
+    {
+        Body* pBodies[3];
+        unsigned int indices[3];
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            pBodies[i] = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(Real(i) * 3.0f, 1.0f, 0.0f));
+            indices[i] = pBodies[i]->getWorldIndex();
+            CHECK(indices[i] != Body::INVALID_INDEX);
+        }
+
+        pWorld->suspendBodies(pBodies, 2);
+
+        for (unsigned int i = 0; i < 2; ++i)
+        {
+            CHECK(pBodies[i]->isSuspended());
+            CHECK_EQUAL(indices[i], pBodies[i]->getWorldIndex());
+            CHECK(pWorld->getBody(indices[i]) == 0);
+        }
+
+        // The reserved indices aren't given to the new bodies
+        Body* pOther = createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f, Vector3(0.0f, 1.0f, 3.0f));
+        CHECK(pOther->getWorldIndex() != indices[0]);
+        CHECK(pOther->getWorldIndex() != indices[1]);
+
+        // Resumed in another order
+        Body* pResumed[2] = { pBodies[1], pBodies[0] };
+        pWorld->resumeBodies(pResumed, 2);
+
+        for (unsigned int i = 0; i < 3; ++i)
+        {
+            CHECK(!pBodies[i]->isSuspended());
+            CHECK_EQUAL(indices[i], pBodies[i]->getWorldIndex());
+            CHECK(pWorld->getBody(indices[i]) == pBodies[i]);
+        }
+    }
+
+
+    TEST_FIXTURE(WorldFixture, RestoredStateReplaysBitIdentically)
+    {
+        // A pile of boxes, tilted so they fall over each other
+        for (unsigned int i = 0; i < 6; ++i)
+        {
+            btQuaternion q(btVector3(1.0f, 0.0f, 1.0f).normalized(), btScalar(i) * btScalar(0.12));
+            Quaternion orientation(q.w(), q.x(), q.y(), q.z());
+
+            createBox(Vector3(1.0f, 1.0f, 1.0f), 1.0f,
+                      Vector3(Real(i % 2) * 0.3f, Real(i) * 1.1f + 0.6f, 0.0f), orientation);
+        }
+
+        pWorld->setDeterministic(true);
+
+        for (unsigned int i = 0; i < NB_REPLAY_WARMUP_STEPS; ++i)
+            pWorld->stepSimulation(Real(1.0 / 60.0));
+
+        std::vector<unsigned char> state;
+        pWorld->saveState(state);
+
+        // Two replays from the restored state
+        unsigned int hashes[NB_REPLAY_STEPS];
+        std::vector<unsigned char> finalState;
+
+        for (unsigned int n = 0; n < 2; ++n)
+        {
+            CHECK(pWorld->restoreState(state));
+
+            for (unsigned int i = 0; i < NB_REPLAY_STEPS; ++i)
+            {
+                pWorld->stepSimulation(Real(1.0 / 60.0));
+
+                if (n == 0)
+                    hashes[i] = pWorld->computeStateHash();
+                else
+                    CHECK_EQUAL(hashes[i], pWorld->computeStateHash());
+            }
+
+            std::vector<unsigned char> replayState;
+            pWorld->saveState(replayState);
+
+            if (n == 0)
+                finalState = replayState;
+            else
+                CHECK(replayState == finalState);
+        }
+
+        // The boxes really moved during the replays
+        CHECK(finalState != state);
+    }
+}